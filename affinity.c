@@ -0,0 +1,462 @@
+/*
+ * affinity.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "affinity.h"
+#include "MBAssert.h"
+#include "MBDebug.h"
+
+#define AFFINITY_NODE_PATH   "/sys/devices/system/node/node%d/cpulist"
+#define AFFINITY_ONLINE_PATH "/sys/devices/system/node/online"
+
+typedef struct AffinityTopology {
+    uint numNodes;
+    uint *numCpus;
+    int **cpus;
+} AffinityTopology;
+
+static struct {
+    bool loaded;
+    AffinityTopology topo;
+} affinity;
+
+static const char *affinityPolicyStrings[] = {
+    [AFFINITY_INVALID] = "invalid",
+    [AFFINITY_NONE]    = "none",
+    [AFFINITY_SPREAD]  = "spread",
+    [AFFINITY_PACK]    = "pack",
+};
+
+AffinityPolicy Affinity_PolicyFromString(const char *str)
+{
+    for (uint i = AFFINITY_NONE; i < ARRAYSIZE(affinityPolicyStrings); i++) {
+        if (strcmp(str, affinityPolicyStrings[i]) == 0) {
+            return i;
+        }
+    }
+    return AFFINITY_INVALID;
+}
+
+const char *Affinity_PolicyToString(AffinityPolicy policy)
+{
+    ASSERT(policy < ARRAYSIZE(affinityPolicyStrings));
+    return affinityPolicyStrings[policy];
+}
+
+/*
+ * AffinityChoose --
+ *    Affinity_ChooseCpu for a given topology.
+ */
+static int AffinityChoose(const AffinityTopology *topo,
+                          AffinityPolicy policy, uint t, uint *node)
+{
+    uint total = 0;
+    uint numUsable = 0;
+
+    *node = 0;
+    for (uint n = 0; n < topo->numNodes; n++) {
+        total += topo->numCpus[n];
+        if (topo->numCpus[n] > 0) {
+            numUsable++;
+        }
+    }
+    if (policy == AFFINITY_NONE || total == 0) {
+        return -1;
+    }
+
+    if (policy == AFFINITY_SPREAD) {
+        /*
+         * Nodes without CPUs (memory-only nodes, or ones we aren't
+         * allowed to run on) stay in the topology so the node numbers
+         * still match, but the round-robin only counts the others.
+         */
+        uint u = t % numUsable;
+        uint k = t / numUsable;
+
+        for (uint n = 0; n < topo->numNodes; n++) {
+            if (topo->numCpus[n] == 0) {
+                continue;
+            }
+            if (u-- == 0) {
+                *node = n;
+                return topo->cpus[n][k % topo->numCpus[n]];
+            }
+        }
+        NOT_REACHED();
+    }
+
+    ASSERT(policy == AFFINITY_PACK);
+    t %= total;
+    for (uint n = 0; n < topo->numNodes; n++) {
+        if (t < topo->numCpus[n]) {
+            *node = n;
+            return topo->cpus[n][t];
+        }
+        t -= topo->numCpus[n];
+    }
+    NOT_REACHED();
+}
+
+#ifdef __linux__
+
+/*
+ * AffinityParseCpuList --
+ *    Parse a kernel cpulist (like "0-3,8,10-11") into a cpu_set_t.
+ *    Returns the number of CPUs in the list, or 0 if it didn't parse.
+ */
+static uint AffinityParseCpuList(const char *s, cpu_set_t *set)
+{
+    uint count = 0;
+
+    CPU_ZERO(set);
+
+    while (*s != '\0' && *s != '\n') {
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+
+        if (end == s || first < 0) {
+            return 0;
+        }
+        s = end;
+
+        if (*s == '-') {
+            s++;
+            last = strtol(s, &end, 10);
+            if (end == s || last < first) {
+                return 0;
+            }
+            s = end;
+        }
+
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, set);
+            count++;
+        }
+
+        if (*s == ',') {
+            s++;
+        } else if (*s != '\0' && *s != '\n') {
+            return 0;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * AffinityReadList --
+ *    Read a cpulist-style file.  An empty list is fine, since nodes
+ *    with only memory have no CPUs.
+ */
+static bool AffinityReadList(const char *path, cpu_set_t *set)
+{
+    char buf[4096];
+    FILE *f;
+    bool success = FALSE;
+
+    CPU_ZERO(set);
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        return FALSE;
+    }
+
+    if (fgets(buf, sizeof(buf), f) != NULL) {
+        success = buf[0] == '\n' || buf[0] == '\0' ||
+                  AffinityParseCpuList(buf, set) > 0;
+    }
+    fclose(f);
+    return success;
+}
+
+/*
+ * AffinityOnlineNodes --
+ *    Get the ids of the online nodes, which needn't be contiguous.
+ *    Returns the number of nodes, or 0 if there's no NUMA information.
+ */
+static uint AffinityOnlineNodes(cpu_set_t *nodes)
+{
+    if (!AffinityReadList(AFFINITY_ONLINE_PATH, nodes)) {
+        return 0;
+    }
+    return CPU_COUNT(nodes);
+}
+
+/*
+ * AffinityReadNode --
+ *    Read the CPUs of node number n, counting only the online nodes.
+ */
+static bool AffinityReadNode(uint n, cpu_set_t *set)
+{
+    char path[128];
+    cpu_set_t nodes;
+    uint count = AffinityOnlineNodes(&nodes);
+
+    for (int id = 0; count > 0 && id < CPU_SETSIZE; id++) {
+        if (!CPU_ISSET(id, &nodes)) {
+            continue;
+        }
+        if (n-- == 0) {
+            snprintf(path, sizeof(path), AFFINITY_NODE_PATH, id);
+            return AffinityReadList(path, set);
+        }
+    }
+
+    return FALSE;
+}
+
+static void AffinityAddNode(AffinityTopology *topo, const cpu_set_t *set)
+{
+    uint n = topo->numNodes++;
+    uint count = 0;
+
+    topo->numCpus = realloc(topo->numCpus,
+                            topo->numNodes * sizeof(topo->numCpus[0]));
+    topo->cpus = realloc(topo->cpus, topo->numNodes * sizeof(topo->cpus[0]));
+    topo->cpus[n] = malloc(MAX(1, CPU_COUNT(set)) * sizeof(topo->cpus[n][0]));
+    VERIFY(topo->numCpus != NULL);
+    VERIFY(topo->cpus != NULL);
+    VERIFY(topo->cpus[n] != NULL);
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, set)) {
+            topo->cpus[n][count++] = cpu;
+        }
+    }
+    topo->numCpus[n] = count;
+}
+
+/*
+ * AffinityLoad --
+ *    Read the topology, keeping only the CPUs this process is allowed
+ *    to run on.  This is called from the main thread before any engine
+ *    threads are placed.
+ */
+static void AffinityLoad(void)
+{
+    AffinityTopology *topo = &affinity.topo;
+    cpu_set_t allowed;
+    cpu_set_t set;
+
+    if (affinity.loaded) {
+        return;
+    }
+    affinity.loaded = TRUE;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+
+    /*
+     * Nodes are numbered by their order in the online list, so gaps in
+     * the kernel's numbering don't matter here.
+     */
+    for (uint n = 0; AffinityReadNode(n, &set); n++) {
+        CPU_AND(&set, &set, &allowed);
+        AffinityAddNode(topo, &set);
+    }
+
+    if (topo->numNodes == 0) {
+        AffinityAddNode(topo, &allowed);
+    }
+}
+
+uint Affinity_NumNodes(void)
+{
+    cpu_set_t nodes;
+
+    /*
+     * This is also used by freshly forked workers, so it doesn't rely
+     * on the cached topology.
+     */
+    return MAX(1, AffinityOnlineNodes(&nodes));
+}
+
+bool Affinity_PinToCpu(int cpu)
+{
+    cpu_set_t set;
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return FALSE;
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+bool Affinity_PinToNode(uint node)
+{
+    cpu_set_t allowed;
+    cpu_set_t set;
+
+    /*
+     * Stay within the CPUs we were given (by taskset or a cgroup, say).
+     */
+    if (!AffinityReadNode(node, &set) ||
+        sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return FALSE;
+    }
+    CPU_AND(&set, &set, &allowed);
+    if (CPU_COUNT(&set) == 0) {
+        return FALSE;
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#else // __linux__
+
+static void AffinityLoad(void)
+{
+    affinity.loaded = TRUE;
+}
+
+uint Affinity_NumNodes(void)
+{
+    return 1;
+}
+
+bool Affinity_PinToCpu(int cpu)
+{
+    return FALSE;
+}
+
+bool Affinity_PinToNode(uint node)
+{
+    return FALSE;
+}
+
+#endif // __linux__
+
+int Affinity_ChooseCpu(AffinityPolicy policy, uint t, uint *node)
+{
+    AffinityLoad();
+    return AffinityChoose(&affinity.topo, policy, t, node);
+}
+
+void Affinity_PrintTopology(void)
+{
+    AffinityTopology *topo = &affinity.topo;
+
+    AffinityLoad();
+
+    Warning("Topology: %d NUMA nodes\n", topo->numNodes);
+    for (uint n = 0; n < topo->numNodes; n++) {
+        Warning("\tnode %d: %d CPUs", n, topo->numCpus[n]);
+        if (topo->numCpus[n] > 0) {
+            Warning(" (%d-%d)", topo->cpus[n][0],
+                    topo->cpus[n][topo->numCpus[n] - 1]);
+        }
+        Warning("\n");
+    }
+}
+
+void Affinity_UnitTest(void)
+{
+    int cpus0[] = { 0, 1, 2, 3 };
+    int cpus1[] = { 8, 9 };
+    int *cpus[] = { cpus0, cpus1 };
+    uint numCpus[] = { ARRAYSIZE(cpus0), ARRAYSIZE(cpus1) };
+    AffinityTopology topo = { 2, numCpus, cpus };
+    uint node;
+
+    VERIFY(Affinity_PolicyFromString("spread") == AFFINITY_SPREAD);
+    VERIFY(Affinity_PolicyFromString("pack") == AFFINITY_PACK);
+    VERIFY(Affinity_PolicyFromString("none") == AFFINITY_NONE);
+    VERIFY(Affinity_PolicyFromString("invalid") == AFFINITY_INVALID);
+    VERIFY(Affinity_PolicyFromString("bogus") == AFFINITY_INVALID);
+
+    VERIFY(AffinityChoose(&topo, AFFINITY_NONE, 0, &node) == -1);
+
+    VERIFY(AffinityChoose(&topo, AFFINITY_SPREAD, 0, &node) == 0);
+    VERIFY(node == 0);
+    VERIFY(AffinityChoose(&topo, AFFINITY_SPREAD, 1, &node) == 8);
+    VERIFY(node == 1);
+    VERIFY(AffinityChoose(&topo, AFFINITY_SPREAD, 2, &node) == 1);
+    VERIFY(AffinityChoose(&topo, AFFINITY_SPREAD, 5, &node) == 8);
+    VERIFY(node == 1);
+
+    VERIFY(AffinityChoose(&topo, AFFINITY_PACK, 3, &node) == 3);
+    VERIFY(node == 0);
+    VERIFY(AffinityChoose(&topo, AFFINITY_PACK, 5, &node) == 9);
+    VERIFY(node == 1);
+    VERIFY(AffinityChoose(&topo, AFFINITY_PACK, 6, &node) == 0);
+
+    /*
+     * Spread skips nodes without CPUs without doubling up on the others,
+     * as when taskset limits us to node 0 of two.
+     */
+    int *emptyCpus[] = { cpus0, NULL };
+    uint emptyNumCpus[] = { ARRAYSIZE(cpus0), 0 };
+    AffinityTopology emptyTopo = { 2, emptyNumCpus, emptyCpus };
+
+    for (uint t = 0; t < ARRAYSIZE(cpus0); t++) {
+        VERIFY(AffinityChoose(&emptyTopo, AFFINITY_SPREAD, t, &node) ==
+               cpus0[t]);
+        VERIFY(node == 0);
+    }
+
+    int *gapCpus[] = { NULL, cpus0, NULL, cpus1 };
+    uint gapNumCpus[] = { 0, ARRAYSIZE(cpus0), 0, ARRAYSIZE(cpus1) };
+    AffinityTopology gapTopo = { 4, gapNumCpus, gapCpus };
+
+    VERIFY(AffinityChoose(&gapTopo, AFFINITY_SPREAD, 0, &node) == 0);
+    VERIFY(node == 1);
+    VERIFY(AffinityChoose(&gapTopo, AFFINITY_SPREAD, 1, &node) == 8);
+    VERIFY(node == 3);
+    VERIFY(AffinityChoose(&gapTopo, AFFINITY_SPREAD, 2, &node) == 1);
+    VERIFY(node == 1);
+    VERIFY(AffinityChoose(&gapTopo, AFFINITY_SPREAD, 3, &node) == 9);
+    VERIFY(node == 3);
+    VERIFY(AffinityChoose(&gapTopo, AFFINITY_PACK, 4, &node) == 8);
+    VERIFY(node == 3);
+
+#ifdef __linux__
+    cpu_set_t set;
+
+    VERIFY(AffinityParseCpuList("0-3,8,10-11\n", &set) == 7);
+    VERIFY(CPU_ISSET(0, &set));
+    VERIFY(CPU_ISSET(3, &set));
+    VERIFY(!CPU_ISSET(4, &set));
+    VERIFY(CPU_ISSET(8, &set));
+    VERIFY(!CPU_ISSET(9, &set));
+    VERIFY(CPU_ISSET(11, &set));
+    VERIFY(CPU_COUNT(&set) == 7);
+
+    VERIFY(AffinityParseCpuList("5", &set) == 1);
+    VERIFY(CPU_ISSET(5, &set));
+
+    VERIFY(AffinityParseCpuList("0,2\n", &set) == 2);
+    VERIFY(!CPU_ISSET(1, &set));
+
+    VERIFY(AffinityParseCpuList("", &set) == 0);
+    VERIFY(AffinityParseCpuList("3-1", &set) == 0);
+    VERIFY(AffinityParseCpuList("1,x", &set) == 0);
+#endif
+
+    VERIFY(Affinity_NumNodes() >= 1);
+}
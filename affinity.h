@@ -0,0 +1,84 @@
+/*
+ * affinity.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AFFINITY_H_202310181420
+#define _AFFINITY_H_202310181420
+
+#include "MBTypes.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * CPU placement for engine threads and worker processes.
+ *
+ * The NUMA layout comes from /sys/devices/system/node, with the online
+ * nodes numbered in order from 0.  Without it, the CPUs this process may
+ * run on are treated as a single node, and on systems that aren't Linux
+ * there's nothing to pin to at all.
+ */
+
+typedef enum AffinityPolicy {
+    AFFINITY_INVALID = 0,
+
+    /*
+     * Leave placement to the OS.
+     */
+    AFFINITY_NONE,
+
+    /*
+     * Pin each thread to its own CPU, round-robin across the nodes
+     * that have CPUs we can use.
+     */
+    AFFINITY_SPREAD,
+
+    /*
+     * Pin each thread to its own CPU, filling one node before moving
+     * on to the next.
+     */
+    AFFINITY_PACK,
+} AffinityPolicy;
+
+AffinityPolicy Affinity_PolicyFromString(const char *str);
+const char *Affinity_PolicyToString(AffinityPolicy policy);
+
+uint Affinity_NumNodes(void);
+void Affinity_PrintTopology(void);
+
+/*
+ * Pick the CPU for thread number t under the policy, and the node it's
+ * on.  Returns -1 if the thread shouldn't be pinned.
+ */
+int Affinity_ChooseCpu(AffinityPolicy policy, uint t, uint *node);
+
+/*
+ * Restrict the calling thread to one CPU, or to the CPUs of one node.
+ * Memory the thread touches first after that comes from its node.
+ * These return FALSE if that isn't possible here.
+ */
+bool Affinity_PinToCpu(int cpu);
+bool Affinity_PinToNode(uint node);
+
+void Affinity_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _AFFINITY_H_202310181420
@@ -28,7 +28,7 @@
 typedef struct Battle {
     bool initialized;
 
-    BattleScenario bsc;
+    BattleParams bp;
 
     RandomState rs;
 
@@ -67,19 +67,17 @@ Battle *Battle_Create(const BattleScenario *bsc,
      * We need Neutral + 2 fleets.
      */
     ASSERT(bsc->bp.numPlayers >= 3);
-    battle->bsc = *bsc;
+    battle->bp = bsc->bp;
 
     uint numPlayers = bsc->bp.numPlayers;
-    ASSERT(numPlayers < ARRAYSIZE(battle->bs.players));
     battle->bs.numPlayers = numPlayers;
+    battle->bs.players =
+        MBUtil_ZAlloc(numPlayers * sizeof(battle->bs.players[0]));
     for (uint i = 0; i < numPlayers; i++) {
         battle->bs.players[i].playerUID = bsc->players[i].playerUID;
         battle->bs.players[i].alive = TRUE;
         battle->bs.players[i].credits = bsc->bp.startingCredits;
     }
-    for (uint i = numPlayers; i < ARRAYSIZE(battle->bs.players); i++) {
-        battle->bs.players[i].playerUID = PLAYER_ID_INVALID;
-    }
     battle->bs.winner = PLAYER_ID_NEUTRAL;
     battle->bs.winnerUID = PLAYER_ID_NEUTRAL;
 
@@ -99,29 +97,29 @@ Battle *Battle_Create(const BattleScenario *bsc,
         }
 
         for (uint s = 0;
-             s < battle->bsc.bp.startingBases + battle->bsc.bp.startingFighters;
+             s < battle->bp.startingBases + battle->bp.startingFighters;
              s++) {
             MobVector_Grow(&battle->mobs);
             Mob *mob = MobVector_GetLastPtr(&battle->mobs);
 
-            MobType t = s < battle->bsc.bp.startingBases ?
+            MobType t = s < battle->bp.startingBases ?
                         MOB_TYPE_BASE : MOB_TYPE_FIGHTER;
             Mob_Init(mob, t);
             mob->playerID = i;
             mob->mobid = ++battle->lastMobID;
-            if (battle->bsc.bp.restrictedStart) {
+            if (battle->bp.restrictedStart) {
                 // account for NEUTRAL
                 uint p = (i + randomShift) % (numPlayers - 1);
-                float slotW = battle->bsc.bp.width / (numPlayers - 1);
+                float slotW = battle->bp.width / (numPlayers - 1);
                 mob->pos.x = RandomState_Float(&battle->rs, p * slotW,
                                                (p + 1) * slotW);
                 mob->pos.y = RandomState_Float(&battle->rs, 0.0f,
-                                               battle->bsc.bp.height);
+                                               battle->bp.height);
             } else {
                 mob->pos.x = RandomState_Float(&battle->rs, 0.0f,
-                                               battle->bsc.bp.width);
+                                               battle->bp.width);
                 mob->pos.y = RandomState_Float(&battle->rs, 0.0f,
-                                               battle->bsc.bp.height);
+                                               battle->bp.height);
             }
             mob->cmd.target = mob->pos;
         }
@@ -148,6 +146,7 @@ void Battle_Destroy(Battle *battle)
     MobVector_Destroy(&battle->mobs);
     MobVector_Destroy(&battle->pendingSpawns);
     RandomState_Destroy(&battle->rs);
+    free(battle->bs.players);
     battle->initialized = FALSE;
     free(battle);
 }
@@ -158,13 +157,13 @@ static bool BattleCheckMobInvariants(Battle *battle, const Mob *mob)
     ASSERT(mob->image == MOB_IMAGE_FULL);
     ASSERT(mob->pos.x >= 0.0f);
     ASSERT(mob->pos.y >= 0.0f);
-    ASSERT(mob->pos.x <= (uint32)battle->bsc.bp.width);
-    ASSERT(mob->pos.y <= (uint32)battle->bsc.bp.height);
+    ASSERT(mob->pos.x <= (uint32)battle->bp.width);
+    ASSERT(mob->pos.y <= (uint32)battle->bp.height);
 
     ASSERT(mob->cmd.target.x >= 0.0f);
     ASSERT(mob->cmd.target.y >= 0.0f);
-    ASSERT(mob->cmd.target.x <= (uint32)battle->bsc.bp.width);
-    ASSERT(mob->cmd.target.y <= (uint32)battle->bsc.bp.height);
+    ASSERT(mob->cmd.target.x <= (uint32)battle->bp.width);
+    ASSERT(mob->cmd.target.y <= (uint32)battle->bp.height);
 
     return TRUE;
 }
@@ -177,7 +176,7 @@ static int BattleCalcPowerCoreCredits(Battle *battle, const Mob *m)
     }
 
     int powerCore = MobType_GetCost(m->type);
-    return (int)(battle->bsc.bp.powerCoreDropRate * powerCore);
+    return (int)(battle->bp.powerCoreDropRate * powerCore);
 }
 
 static Mob *BattleQueueSpawn(Battle *battle, MobID parentMobid,
@@ -237,7 +236,7 @@ static void BattleRunMobSpawn(Battle *battle, Mob *mob)
         ASSERT(spawnType == MOB_TYPE_MISSILE);
     }
 
-    ASSERT(mob->playerID < ARRAYSIZE(battle->bs.players));
+    ASSERT(mob->playerID < battle->bs.numPlayers);
     if (battle->bs.players[mob->playerID].credits <
         MobType_GetCost(mob->cmd.spawnType)) {
         return;
@@ -332,12 +331,12 @@ BattleRunMobCollision(Battle *battle, Mob *oMob, Mob *iMob)
 
     if (oMob->type == MOB_TYPE_POWER_CORE) {
         ASSERT(iMob->type != MOB_TYPE_POWER_CORE);
-        ASSERT(iMob->playerID < ARRAYSIZE(battle->bs.players));
+        ASSERT(iMob->playerID < battle->bs.numPlayers);
         battle->bs.players[iMob->playerID].credits += oMob->powerCoreCredits;
         oMob->alive = FALSE;
     } else if (iMob->type == MOB_TYPE_POWER_CORE) {
         ASSERT(oMob->type != MOB_TYPE_POWER_CORE);
-        ASSERT(oMob->playerID < ARRAYSIZE(battle->bs.players));
+        ASSERT(oMob->playerID < battle->bs.numPlayers);
         battle->bs.players[oMob->playerID].credits += iMob->powerCoreCredits;
         iMob->alive = FALSE;
     } else {
@@ -769,18 +768,18 @@ void Battle_RunTick(Battle *battle)
     }
 
     // Spawn powerCore
-    battle->powerCoreSpawnBucket += battle->bsc.bp.powerCoreSpawnRate;
-    while (battle->powerCoreSpawnBucket > battle->bsc.bp.minPowerCoreSpawn) {
+    battle->powerCoreSpawnBucket += battle->bp.powerCoreSpawnRate;
+    while (battle->powerCoreSpawnBucket > battle->bp.minPowerCoreSpawn) {
         FPoint pos;
         int powerCore = RandomState_Int(&battle->rs,
-                                   battle->bsc.bp.minPowerCoreSpawn,
-                                   battle->bsc.bp.maxPowerCoreSpawn);
+                                   battle->bp.minPowerCoreSpawn,
+                                   battle->bp.maxPowerCoreSpawn);
         battle->powerCoreSpawnBucket -= powerCore;
 
         pos.x = RandomState_Float(&battle->rs, 0.0f,
-                                  battle->bsc.bp.width);
+                                  battle->bp.width);
         pos.y = RandomState_Float(&battle->rs, 0.0f,
-                                  battle->bsc.bp.height);
+                                  battle->bp.height);
         Mob *spawn = BattleQueueSpawn(battle, MOB_ID_INVALID,
                                       MOB_TYPE_POWER_CORE,
                                       PLAYER_ID_NEUTRAL, &pos);
@@ -821,7 +820,7 @@ void Battle_RunTick(Battle *battle)
             battle->bs.players[p].numMobs++;
 
             if ((mob->type != MOB_TYPE_POWER_CORE &&
-                 !battle->bsc.bp.baseVictory) ||
+                 !battle->bp.baseVictory) ||
                 mob->type == MOB_TYPE_BASE) {
                 battle->bs.players[p].alive = TRUE;
             }
@@ -848,7 +847,7 @@ void Battle_RunTick(Battle *battle)
     for (uint32 i = 0; i < battle->bs.numPlayers; i++) {
         if (battle->bs.players[i].alive) {
             livePlayers++;
-            battle->bs.players[i].credits += battle->bsc.bp.creditsPerTick;
+            battle->bs.players[i].credits += battle->bp.creditsPerTick;
         }
     }
     if (livePlayers <= 1) {
@@ -862,7 +861,7 @@ void Battle_RunTick(Battle *battle)
         }
     }
 
-    if(battle->bs.tick >= battle->bsc.bp.tickLimit) {
+    if(battle->bs.tick >= battle->bp.tickLimit) {
         battle->bs.finished = TRUE;
     }
 }
@@ -27,6 +27,13 @@
     extern "C" {
 #endif
 
+/*
+ * Bump this whenever a change to the engine or the fleets can change the
+ * outcome of a battle with the same scenario and seed, so that old
+ * cached results aren't used.
+ */
+#define BATTLE_ENGINE_VERSION 2
+
 struct Battle;
 typedef struct Battle Battle;
 
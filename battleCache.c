@@ -0,0 +1,483 @@
+/*
+ * battleCache.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "battleCache.h"
+#include "battle.h"
+#include "fleet.h"
+#include "fastMath.h"
+#include "MBUtil.h"
+#include "MBDebug.h"
+#include "MBRegistry.h"
+
+typedef struct BattleCacheHeader {
+    char magic[8];
+    uint32 version;
+    uint32 recordSize;
+} BattleCacheHeader;
+
+#define BATTLE_CACHE_HASH_BASIS  0xcbf29ce484222325ULL
+#define BATTLE_CACHE_CHECK_BASIS 0x84222325cbf29ce4ULL
+
+static uint64 BattleCacheHashBytes(uint64 hash, const void *data, uint len)
+{
+    const uint8 *b = data;
+
+    for (uint i = 0; i < len; i++) {
+        hash ^= b[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64 BattleCacheHashString(uint64 hash, const char *s)
+{
+    return BattleCacheHashBytes(hash, s, strlen(s) + 1);
+}
+
+static uint64 BattleCacheHashUint64(uint64 hash, uint64 x)
+{
+    return BattleCacheHashBytes(hash, &x, sizeof(x));
+}
+
+uint64 BattleCache_HashFleet(const BattlePlayer *player)
+{
+    uint64 hash = BATTLE_CACHE_HASH_BASIS;
+
+    hash = BattleCacheHashString(hash, Fleet_GetName(player->aiType));
+
+    if (player->mreg != NULL) {
+        uint size = MBRegistry_NumEntries(player->mreg);
+        uint64 sum = 0;
+
+        /*
+         * Sum the per-key hashes, so the result doesn't depend on the
+         * order of the keys in the registry.
+         */
+        for (uint i = 0; i < size; i++) {
+            const char *key = MBRegistry_GetKeyAt(player->mreg, i);
+            const char *value = MBRegistry_GetValueAt(player->mreg, i);
+            uint64 h = BATTLE_CACHE_HASH_BASIS;
+
+            if (strncmp(key, "abattle.", 8) == 0) {
+                continue;
+            }
+
+            h = BattleCacheHashString(h, key);
+            h = BattleCacheHashString(h, value);
+            sum += h;
+        }
+
+        hash = BattleCacheHashUint64(hash, sum);
+    }
+
+    return hash;
+}
+
+static uint64 BattleCacheHashParams(uint64 hash, const BattleParams *bp)
+{
+    /*
+     * Hash the fields one at a time, so that padding in the structure
+     * doesn't matter.
+     */
+    hash = BattleCacheHashUint64(hash, bp->numPlayers);
+    hash = BattleCacheHashUint64(hash, bp->width);
+    hash = BattleCacheHashUint64(hash, bp->height);
+    hash = BattleCacheHashUint64(hash, bp->startingCredits);
+    hash = BattleCacheHashUint64(hash, bp->creditsPerTick);
+    hash = BattleCacheHashUint64(hash, bp->tickLimit);
+    hash = BattleCacheHashUint64(hash, bp->restrictedStart);
+    hash = BattleCacheHashUint64(hash, bp->baseVictory);
+    hash = BattleCacheHashBytes(hash, &bp->powerCoreDropRate,
+                                sizeof(bp->powerCoreDropRate));
+    hash = BattleCacheHashBytes(hash, &bp->powerCoreSpawnRate,
+                                sizeof(bp->powerCoreSpawnRate));
+    hash = BattleCacheHashUint64(hash, bp->minPowerCoreSpawn);
+    hash = BattleCacheHashUint64(hash, bp->maxPowerCoreSpawn);
+    hash = BattleCacheHashUint64(hash, bp->startingBases);
+    hash = BattleCacheHashUint64(hash, bp->startingFighters);
+
+    return hash;
+}
+
+uint64 BattleCache_HashParams(const BattleParams *bp)
+{
+    return BattleCacheHashParams(BATTLE_CACHE_HASH_BASIS, bp);
+}
+
+static uint64 BattleCacheHashScenario(uint64 hash, const BattleScenario *bsc,
+                                      const uint64 *fleetHashes,
+                                      uint64 seed)
+{
+    hash = BattleCacheHashUint64(hash, BATTLE_ENGINE_VERSION);
+    hash = BattleCacheHashUint64(hash, FastMath_IsEnabled());
+    hash = BattleCacheHashUint64(hash, seed);
+    hash = BattleCacheHashParams(hash, &bsc->bp);
+
+    for (uint p = 0; p < bsc->bp.numPlayers; p++) {
+        hash = BattleCacheHashUint64(hash, fleetHashes[p]);
+    }
+
+    return hash;
+}
+
+void BattleCache_MakeKey(const BattleScenario *bsc, uint64 seed,
+                         BattleCacheKey *key)
+{
+    uint64 stackHashes[8];
+    uint64 *fleetHashes = stackHashes;
+
+    /*
+     * Most scenarios are a pair of fleets and the neutral player, so
+     * only the big ones need the heap.
+     */
+    if (bsc->bp.numPlayers > ARRAYSIZE(stackHashes)) {
+        fleetHashes = malloc(bsc->bp.numPlayers * sizeof(fleetHashes[0]));
+        VERIFY(fleetHashes != NULL);
+    }
+
+    for (uint p = 0; p < bsc->bp.numPlayers; p++) {
+        fleetHashes[p] = BattleCache_HashFleet(&bsc->players[p]);
+    }
+
+    key->hash = BattleCacheHashScenario(BATTLE_CACHE_HASH_BASIS, bsc,
+                                        fleetHashes, seed);
+    key->check = BattleCacheHashScenario(BATTLE_CACHE_CHECK_BASIS, bsc,
+                                         fleetHashes, seed);
+
+    if (fleetHashes != stackHashes) {
+        free(fleetHashes);
+    }
+}
+
+/*
+ * BattleCache_MakeSeed --
+ *    Derive a battle seed from a base seed, the BattleParams, the fleets
+ *    in seat order and the loop index.  The same matchup gets the same
+ *    seed wherever it falls in a run's scenarios, so it gets the same
+ *    key too.
+ */
+uint64 BattleCache_MakeSeed(const BattleScenario *bsc, uint64 baseSeed,
+                            uint loopIndex)
+{
+    uint64 hash = BATTLE_CACHE_HASH_BASIS;
+
+    hash = BattleCacheHashUint64(hash, baseSeed);
+    hash = BattleCacheHashParams(hash, &bsc->bp);
+
+    for (uint p = 0; p < bsc->bp.numPlayers; p++) {
+        hash = BattleCacheHashUint64(hash,
+                                     BattleCache_HashFleet(&bsc->players[p]));
+    }
+
+    hash = BattleCacheHashUint64(hash, loopIndex);
+    return hash;
+}
+
+static inline bool BattleCacheIsEmpty(const BattleCacheRecord *r)
+{
+    return r->key.hash == 0 && r->key.check == 0;
+}
+
+static inline bool BattleCacheKeyEquals(const BattleCacheKey *a,
+                                        const BattleCacheKey *b)
+{
+    return a->hash == b->hash && a->check == b->check;
+}
+
+static BattleCacheRecord *BattleCacheFind(BattleCache *bc,
+                                          const BattleCacheKey *key)
+{
+    uint mask = bc->capacity - 1;
+    uint i = key->hash & mask;
+
+    ASSERT(bc->capacity > 0);
+
+    while (TRUE) {
+        BattleCacheRecord *r = &bc->table[i];
+        if (BattleCacheIsEmpty(r) || BattleCacheKeyEquals(&r->key, key)) {
+            return r;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static void BattleCacheInsert(BattleCache *bc, const BattleCacheRecord *record)
+{
+    BattleCacheRecord *r;
+
+    if (BattleCacheIsEmpty(record)) {
+        /*
+         * Can't tell this apart from an empty slot, and it's not going to
+         * happen by chance anyway.
+         */
+        return;
+    }
+
+    if (2 * (bc->numRecords + 1) > bc->capacity) {
+        BattleCacheRecord *oldTable = bc->table;
+        uint oldCapacity = bc->capacity;
+
+        bc->capacity = MAX(1024, bc->capacity * 2);
+        bc->table = calloc(bc->capacity, sizeof(bc->table[0]));
+        VERIFY(bc->table != NULL);
+        bc->numRecords = 0;
+
+        for (uint i = 0; i < oldCapacity; i++) {
+            if (!BattleCacheIsEmpty(&oldTable[i])) {
+                BattleCacheInsert(bc, &oldTable[i]);
+            }
+        }
+        free(oldTable);
+    }
+
+    r = BattleCacheFind(bc, &record->key);
+    if (BattleCacheIsEmpty(r)) {
+        bc->numRecords++;
+    }
+    *r = *record;
+}
+
+void BattleCache_Open(BattleCache *bc, const char *file)
+{
+    BattleCacheHeader hdr;
+    BattleCacheRecord record;
+    bool newFile;
+
+    MBUtil_Zero(bc, sizeof(*bc));
+    bc->file = strdup(file);
+
+    bc->f = fopen(file, "r+b");
+    newFile = bc->f == NULL;
+    if (newFile) {
+        bc->f = fopen(file, "w+b");
+        if (bc->f == NULL) {
+            PANIC("Unable to create battle cache: %s\n", file);
+        }
+    }
+
+    if (newFile || fread(&hdr, sizeof(hdr), 1, bc->f) != 1) {
+        MBUtil_Zero(&hdr, sizeof(hdr));
+        memcpy(hdr.magic, BATTLE_CACHE_MAGIC, sizeof(hdr.magic));
+        hdr.version = BATTLE_CACHE_VERSION;
+        hdr.recordSize = sizeof(BattleCacheRecord);
+
+        VERIFY(fseek(bc->f, 0, SEEK_SET) == 0);
+        if (fwrite(&hdr, sizeof(hdr), 1, bc->f) != 1) {
+            PANIC("Unable to write battle cache: %s\n", file);
+        }
+    } else if (memcmp(hdr.magic, BATTLE_CACHE_MAGIC,
+                      sizeof(hdr.magic)) != 0 ||
+               hdr.version != BATTLE_CACHE_VERSION ||
+               hdr.recordSize != sizeof(BattleCacheRecord)) {
+        PANIC("Unsupported battle cache: %s\n", file);
+    }
+    VERIFY(fseek(bc->f, sizeof(hdr), SEEK_SET) == 0);
+
+    /*
+     * Load the existing results.  A partial record at the end (from an
+     * interrupted run) is dropped, and gets overwritten by the next
+     * append.
+     */
+    long end = sizeof(hdr);
+    while (fread(&record, sizeof(record), 1, bc->f) == 1) {
+        BattleCacheInsert(bc, &record);
+        end += sizeof(record);
+    }
+    VERIFY(fseek(bc->f, end, SEEK_SET) == 0);
+
+    if (bc->capacity == 0) {
+        bc->capacity = 1024;
+        bc->table = calloc(bc->capacity, sizeof(bc->table[0]));
+        VERIFY(bc->table != NULL);
+    }
+}
+
+void BattleCache_Close(BattleCache *bc)
+{
+    if (bc->hits + bc->misses > 0) {
+        Warning("Battle cache: %d hits, %d misses, %d results stored.\n",
+                bc->hits, bc->misses, bc->numRecords);
+    }
+
+    fclose(bc->f);
+    free(bc->table);
+    free(bc->file);
+    MBUtil_Zero(bc, sizeof(*bc));
+}
+
+bool BattleCache_Lookup(BattleCache *bc, const BattleCacheKey *key,
+                        BattleCacheRecord *record)
+{
+    BattleCacheRecord *r = BattleCacheFind(bc, key);
+
+    if (BattleCacheIsEmpty(r)) {
+        bc->misses++;
+        return FALSE;
+    }
+
+    bc->hits++;
+    *record = *r;
+    return TRUE;
+}
+
+void BattleCache_Add(BattleCache *bc, const BattleCacheKey *key,
+                     uint winner, uint tick)
+{
+    BattleCacheRecord record;
+
+    MBUtil_Zero(&record, sizeof(record));
+    record.key = *key;
+    record.winner = winner;
+    record.tick = tick;
+
+    BattleCacheInsert(bc, &record);
+
+    if (fwrite(&record, sizeof(record), 1, bc->f) != 1) {
+        PANIC("Unable to write battle cache: %s\n", bc->file);
+    }
+    fflush(bc->f);
+}
+
+void BattleCache_UnitTest(void)
+{
+    char file[] = "/tmp/sr2BattleCacheTestXXXXXX";
+    BattleScenario bsc, bsc2;
+    BattlePlayer players[3], players2[3];
+    BattlePlayer tmp;
+    BattleCacheKey key1, key2, key3;
+    uint64 seed1, seed2;
+    BattleCacheRecord record;
+    BattleCache bc;
+    int fd;
+
+    fd = mkstemp(file);
+    VERIFY(fd >= 0);
+    close(fd);
+    unlink(file);
+
+    MBUtil_Zero(&bsc, sizeof(bsc));
+    MBUtil_Zero(players, sizeof(players));
+    bsc.players = players;
+    bsc.bp.numPlayers = ARRAYSIZE(players);
+    bsc.bp.width = 1600;
+    bsc.bp.height = 1200;
+    bsc.bp.tickLimit = 1000;
+    bsc.players[0].aiType = FLEET_AI_NEUTRAL;
+    bsc.players[1].aiType = FLEET_AI_FLOCK9;
+    bsc.players[1].mreg = MBRegistry_Alloc();
+    bsc.players[2].aiType = FLEET_AI_BUNDLE15;
+    bsc.players[2].mreg = MBRegistry_Alloc();
+
+    MBRegistry_PutCopy(bsc.players[1].mreg, "align.weight.value", "0.5");
+    MBRegistry_PutCopy(bsc.players[1].mreg, "abattle.numWins", "3");
+
+    BattleCache_MakeKey(&bsc, 1, &key1);
+
+    /*
+     * Stats don't change the key, but the seed and parameters do.
+     */
+    MBRegistry_PutCopy(bsc.players[1].mreg, "abattle.numWins", "4");
+    BattleCache_MakeKey(&bsc, 1, &key2);
+    VERIFY(BattleCacheKeyEquals(&key1, &key2));
+
+    BattleCache_MakeKey(&bsc, 2, &key2);
+    VERIFY(!BattleCacheKeyEquals(&key1, &key2));
+
+    MBRegistry_PutCopy(bsc.players[1].mreg, "align.weight.value", "0.6");
+    BattleCache_MakeKey(&bsc, 1, &key3);
+    VERIFY(!BattleCacheKeyEquals(&key1, &key3));
+
+    BattleCache_Open(&bc, file);
+    VERIFY(!BattleCache_Lookup(&bc, &key1, &record));
+    BattleCache_Add(&bc, &key1, 2, 500);
+    BattleCache_Add(&bc, &key2, 0, 1000);
+    for (uint i = 0; i < 2000; i++) {
+        BattleCache_MakeKey(&bsc, 100 + i, &key3);
+        BattleCache_Add(&bc, &key3, 1, i);
+    }
+    BattleCache_Close(&bc);
+
+    /*
+     * The results should still be there after re-opening the file.
+     */
+    BattleCache_Open(&bc, file);
+    VERIFY(bc.numRecords == 2002);
+    VERIFY(BattleCache_Lookup(&bc, &key1, &record));
+    VERIFY(record.winner == 2);
+    VERIFY(record.tick == 500);
+    VERIFY(BattleCache_Lookup(&bc, &key2, &record));
+    VERIFY(record.winner == 0);
+    VERIFY(BattleCache_Lookup(&bc, &key3, &record));
+    VERIFY(record.tick == 1999);
+    BattleCache_Close(&bc);
+
+    /*
+     * A later run with a different population: the same two fleets meet
+     * again as a different scenario, with new stats and their keys in a
+     * different order, and should get the same seed and hit the cache.
+     */
+    seed1 = BattleCache_MakeSeed(&bsc, 7, 0);
+    BattleCache_MakeKey(&bsc, seed1, &key1);
+
+    BattleCache_Open(&bc, file);
+    BattleCache_Add(&bc, &key1, 1, 700);
+    BattleCache_Close(&bc);
+
+    MBUtil_Zero(&bsc2, sizeof(bsc2));
+    MBUtil_Zero(players2, sizeof(players2));
+    bsc2.players = players2;
+    bsc2.bp = bsc.bp;
+    bsc2.players[0].aiType = FLEET_AI_NEUTRAL;
+    bsc2.players[1].aiType = FLEET_AI_FLOCK9;
+    bsc2.players[1].mreg = MBRegistry_Alloc();
+    bsc2.players[2].aiType = FLEET_AI_BUNDLE15;
+    bsc2.players[2].mreg = MBRegistry_Alloc();
+    MBRegistry_PutCopy(bsc2.players[1].mreg, "abattle.numWins", "9");
+    MBRegistry_PutCopy(bsc2.players[1].mreg, "align.weight.value", "0.6");
+
+    seed2 = BattleCache_MakeSeed(&bsc2, 7, 0);
+    VERIFY(seed1 == seed2);
+    BattleCache_MakeKey(&bsc2, seed2, &key2);
+
+    BattleCache_Open(&bc, file);
+    VERIFY(BattleCache_Lookup(&bc, &key2, &record));
+    VERIFY(record.winner == 1);
+    VERIFY(record.tick == 700);
+    VERIFY(bc.hits == 1);
+    BattleCache_Close(&bc);
+
+    /*
+     * The loop index, the base seed and the seating still matter.
+     */
+    VERIFY(BattleCache_MakeSeed(&bsc2, 7, 1) != seed1);
+    VERIFY(BattleCache_MakeSeed(&bsc2, 8, 0) != seed1);
+    tmp = bsc2.players[1];
+    bsc2.players[1] = bsc2.players[2];
+    bsc2.players[2] = tmp;
+    VERIFY(BattleCache_MakeSeed(&bsc2, 7, 0) != seed1);
+
+    MBRegistry_Free(players2[1].mreg);
+    MBRegistry_Free(players2[2].mreg);
+    MBRegistry_Free(bsc.players[1].mreg);
+    MBRegistry_Free(bsc.players[2].mreg);
+    unlink(file);
+}
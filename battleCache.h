@@ -0,0 +1,103 @@
+/*
+ * battleCache.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BATTLECACHE_H_202305061130
+#define _BATTLECACHE_H_202305061130
+
+#include <stdio.h>
+
+#include "MBTypes.h"
+#include "MBAssert.h"
+#include "battleTypes.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * A persistent store of battle results.
+ *
+ * Battles are deterministic for a given scenario, set of fleets and
+ * seed, so a result only has to be computed once.  Each battle is keyed
+ * by a hash of the engine version, the BattleParams, the seed, and each
+ * player's fleet name and parameters in seat order.  The abattle.* keys
+ * are left out of the fleet hashes, so a fleet's stats and age don't
+ * change its identity.
+ *
+ * BattleCache_MakeSeed gives a seed that follows the same matchup from
+ * run to run, so callers that pick their seeds with it get hits whenever
+ * a set of fleets meets again.
+ *
+ * The file is a small header followed by fixed-size records, and new
+ * results are appended as they come in.  The whole file is read into a
+ * hash table when it's opened.
+ */
+
+#define BATTLE_CACHE_MAGIC   "SR2BCACH"
+#define BATTLE_CACHE_VERSION 1
+
+typedef struct BattleCacheKey {
+    uint64 hash;
+    uint64 check;
+} BattleCacheKey;
+
+typedef struct BattleCacheRecord {
+    BattleCacheKey key;
+
+    /*
+     * Index into the scenario's players of the winner, with 0 (the
+     * neutral player) for a draw.
+     */
+    uint32 winner;
+    uint32 tick;
+} BattleCacheRecord;
+
+typedef struct BattleCache {
+    char *file;
+    FILE *f;
+
+    uint numRecords;
+    uint capacity;
+    BattleCacheRecord *table;
+
+    uint hits;
+    uint misses;
+} BattleCache;
+
+void BattleCache_Open(BattleCache *bc, const char *file);
+void BattleCache_Close(BattleCache *bc);
+
+uint64 BattleCache_HashFleet(const BattlePlayer *player);
+uint64 BattleCache_HashParams(const BattleParams *bp);
+void BattleCache_MakeKey(const BattleScenario *bsc, uint64 seed,
+                         BattleCacheKey *key);
+uint64 BattleCache_MakeSeed(const BattleScenario *bsc, uint64 baseSeed,
+                            uint loopIndex);
+
+bool BattleCache_Lookup(BattleCache *bc, const BattleCacheKey *key,
+                        BattleCacheRecord *record);
+void BattleCache_Add(BattleCache *bc, const BattleCacheKey *key,
+                     uint winner, uint tick);
+
+void BattleCache_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _BATTLECACHE_H_202305061130
@@ -22,6 +22,7 @@
 #include "geometry.h"
 #include "MBVarMap.h"
 #include "MBRegistry.h"
+#include "genome.h"
 
 #define MICRON (0.001f)
 
@@ -29,7 +30,6 @@
  * PlayerID's are relative to a single scenario.
  * PlayerUID's are consistent across multiple scenarios in a single run.
  */
-#define MAX_PLAYERS (300)
 typedef uint32 PlayerID;
 typedef uint32 PlayerUID;
 #define PLAYER_ID_INVALID ((uint32)-1)
@@ -205,6 +205,11 @@ typedef struct BattlePlayer {
     PlayerType playerType;
     FleetAIType aiType;
     MBRegistry *mreg;
+
+    /*
+     * Fleet_HashBehavior of the fleet, or 0 if it hasn't been computed.
+     */
+    uint64 behaviorHash;
 } BattlePlayer;
 
 typedef struct BattleParams {
@@ -231,7 +236,13 @@ typedef struct BattleParams {
 
 typedef struct BattleScenario {
     BattleParams bp;
-    BattlePlayer players[MAX_PLAYERS];
+
+    /*
+     * The bp.numPlayers players, owned by whoever built the scenario.
+     * Battle_Create copies what it needs, so they only have to last
+     * until it returns.
+     */
+    BattlePlayer *players;
 } BattleScenario;
 
 typedef struct BattlePlayerStatus {
@@ -245,7 +256,7 @@ typedef struct BattleStatus {
     bool finished;
     uint tick;
 
-    BattlePlayerStatus players[MAX_PLAYERS];
+    BattlePlayerStatus *players;
     uint numPlayers;
     PlayerID winner;
     PlayerUID winnerUID;
@@ -266,6 +277,7 @@ typedef struct FleetAIOps {
     void (*mobDestroyed)(void *aiHandle, Mob *m, void *aiMobHandle);
     void (*runAITick)(void *aiHandle);
     void (*mutateParams)(FleetAIType aiType, MBRegistry *mreg);
+    void (*mutateGenome)(FleetAIType aiType, Genome *g);
     void (*dumpSanitizedParams)(void *aiHandle, MBRegistry *mreg);
 } FleetAIOps;
 
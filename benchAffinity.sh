@@ -0,0 +1,20 @@
+#!/bin/bash
+# benchAffinity.sh -- part of SpaceRobots2
+#
+# Time the bench.sh workload under each engine thread placement.
+
+THREADS=4
+if [ "$1" != "" ]; then
+    THREADS=$1
+    shift
+fi;
+
+./compile.sh develperf
+if [ $? != 0 ]; then exit $? ; fi;
+
+TIMEFORMAT="%R"
+for A in none spread pack; do
+    T=$( { time build/sr2 -H -l 64 -s 1 -R -t $THREADS --affinity $A "$@" \
+           > /dev/null 2>&1 ; } 2>&1 )
+    echo "affinity $A: ${T}s with $THREADS threads"
+done
@@ -209,7 +209,7 @@ static void BineuralFleetDestroy(void *aiHandle);
 static void BineuralFleetRunAITick(void *aiHandle);
 static void *BineuralFleetMobSpawned(void *aiHandle, Mob *m);
 static void BineuralFleetMobDestroyed(void *aiHandle, Mob *m, void *aiMobHandle);
-static void BineuralFleetMutate(FleetAIType aiType, MBRegistry *mreg);
+static void BineuralFleetMutate(FleetAIType aiType, Genome *g);
 static void BineuralFleetDumpSanitizedParams(void *aiHandle, MBRegistry *mreg);
 
 void BineuralFleet_GetOps(FleetAIType aiType, FleetAIOps *ops)
@@ -238,7 +238,7 @@ void BineuralFleet_GetOps(FleetAIType aiType, FleetAIOps *ops)
     ops->runAITick = &BineuralFleetRunAITick;
     ops->mobSpawned = &BineuralFleetMobSpawned;
     ops->mobDestroyed = &BineuralFleetMobDestroyed;
-    ops->mutateParams = &BineuralFleetMutate;
+    ops->mutateGenome = &BineuralFleetMutate;
     ops->dumpSanitizedParams = &BineuralFleetDumpSanitizedParams;
 }
 
@@ -249,7 +249,7 @@ static void BineuralFleetDumpSanitizedParams(void *aiHandle, MBRegistry *mreg)
     sf->gov.dumpSanitizedParams(mreg);
 }
 
-static void BineuralFleetMutate(FleetAIType aiType, MBRegistry *mreg)
+static void BineuralFleetMutate(FleetAIType aiType, Genome *g)
 {
     MutationFloatParams vf[] = {
         // key                     min     max       mag   jump   mutation
@@ -274,14 +274,14 @@ static void BineuralFleetMutate(FleetAIType aiType, MBRegistry *mreg)
     };
 
     float rate = 0.01;
-    MBRegistry_PutCopy(mreg, BINEURAL_SCRAMBLE_KEY, "FALSE");
+    Genome_PutCStr(g, BINEURAL_SCRAMBLE_KEY, "FALSE");
 
     if (Random_Flip(0.10)) {
         rate *= 10.0f;
 
         if (Random_Flip(0.01)) {
             rate = 1.0f;
-            MBRegistry_PutCopy(mreg, BINEURAL_SCRAMBLE_KEY, "TRUE");
+            Genome_PutCStr(g, BINEURAL_SCRAMBLE_KEY, "TRUE");
         }
     }
 
@@ -293,32 +293,32 @@ static void BineuralFleetMutate(FleetAIType aiType, MBRegistry *mreg)
         vb[i].flipRate = MAX(vb[i].flipRate, 0.5f);
     }
 
-    SensorGrid_Mutate(mreg, rate, "");
+    SensorGrid_Mutate(g, rate, "");
 
-    NeuralNet_Mutate(mreg, "shipNet.", rate,
+    NeuralNet_Mutate(g, "shipNet.", rate,
                      NN_TYPE_FORCES,
                      BINEURAL_MAX_INPUTS, BINEURAL_MAX_OUTPUTS,
                      BINEURAL_MAX_NODES, BINEURAL_MAX_NODE_DEGREE);
-    NeuralNet_Mutate(mreg, "fleetNet.", rate,
+    NeuralNet_Mutate(g, "fleetNet.", rate,
                      NN_TYPE_SCALARS,
                      BINEURAL_MAX_INPUTS, BINEURAL_MAX_OUTPUTS,
                      BINEURAL_MAX_NODES, BINEURAL_MAX_NODE_DEGREE);
 
     ASSERT(BINEURAL_MAX_LOCUS == 8);
-    MBRegistry_PutCopy(mreg, "numLoci", "8");
+    Genome_PutCStr(g, "numLoci", "8");
     for (uint i = 0; i < BINEURAL_MAX_LOCUS; i++) {
         char *k = NULL;
         int ret;
         ret = asprintf(&k, "locus[%d].", i);
         VERIFY(ret > 0);
-        NeuralLocus_Mutate(mreg, rate, k);
+        NeuralLocus_Mutate(g, rate, k);
         free(k);
     }
 
-    Mutate_Float(mreg, vf, ARRAYSIZE(vf));
-    Mutate_Bool(mreg, vb, ARRAYSIZE(vb));
+    Mutate_GenomeFloat(g, vf, ARRAYSIZE(vf));
+    Mutate_GenomeBool(g, vb, ARRAYSIZE(vb));
 
-    MBRegistry_Remove(mreg, BINEURAL_SCRAMBLE_KEY);
+    Genome_Remove(g, BINEURAL_SCRAMBLE_KEY);
 }
 
 static void *BineuralFleetCreate(FleetAI *ai)
@@ -16615,7 +16615,7 @@ static void BundleFleetDestroy(void *aiHandle);
 static void BundleFleetRunAITick(void *aiHandle);
 static void *BundleFleetMobSpawned(void *aiHandle, Mob *m);
 static void BundleFleetMobDestroyed(void *aiHandle, Mob *m, void *aiMobHandle);
-static void BundleFleetMutate(FleetAIType aiType, MBRegistry *mreg);
+static void BundleFleetMutate(FleetAIType aiType, Genome *g);
 
 void BundleFleet_GetOps(FleetAIType aiType, FleetAIOps *ops)
 {
@@ -16665,19 +16665,19 @@ void BundleFleet_GetOps(FleetAIType aiType, FleetAIOps *ops)
     ops->runAITick = &BundleFleetRunAITick;
     ops->mobSpawned = &BundleFleetMobSpawned;
     ops->mobDestroyed = &BundleFleetMobDestroyed;
-    ops->mutateParams = &BundleFleetMutate;
+    ops->mutateGenome = &BundleFleetMutate;
 }
 
 static void GetMutationFloatParams(MutationFloatParams *vf,
                                    const char *key,
                                    MutationType bType,
-                                   MBRegistry *mreg)
+                                   Genome *g)
 {
     MBUtil_Zero(vf, sizeof(*vf));
     Mutate_DefaultFloatParams(vf, bType);
     vf->key = key;
 
-    if (MBRegistry_GetBool(mreg, BUNDLE_SCRAMBLE_KEY)) {
+    if (Genome_GetBool(g, BUNDLE_SCRAMBLE_KEY)) {
         vf->mutationRate = 1.0f;
         vf->jumpRate = 1.0f;
     }
@@ -16685,18 +16685,18 @@ static void GetMutationFloatParams(MutationFloatParams *vf,
 
 static void GetMutationStrParams(MutationStrParams *svf,
                                  const char *key,
-                                 MBRegistry *mreg)
+                                 Genome *g)
 {
     MBUtil_Zero(svf, sizeof(*svf));
     svf->key = key;
     svf->flipRate = 0.01f;
 
-    if (MBRegistry_GetBool(mreg, BUNDLE_SCRAMBLE_KEY)) {
+    if (Genome_GetBool(g, BUNDLE_SCRAMBLE_KEY)) {
         svf->flipRate = 0.5f;
     }
 }
 
-static void MutateBundleAtom(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleAtom(FleetAIType aiType, Genome *g,
                              const char *prefix,
                              MutationType bType)
 {
@@ -16708,27 +16708,27 @@ static void MutateBundleAtom(FleetAIType aiType, MBRegistry *mreg,
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".value");
-    GetMutationFloatParams(&vf, MBString_GetCStr(&s), bType, mreg);
-    Mutate_Float(mreg, &vf, 1);
+    GetMutationFloatParams(&vf, MBString_GetCStr(&s), bType, g);
+    Mutate_GenomeFloat(g, &vf, 1);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".mobJitterScale");
     GetMutationFloatParams(&vf, MBString_GetCStr(&s),
-                           MUTATION_TYPE_MOB_JITTER_SCALE, mreg);
-    Mutate_Float(mreg, &vf, 1);
+                           MUTATION_TYPE_MOB_JITTER_SCALE, g);
+    Mutate_GenomeFloat(g, &vf, 1);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".mobJitterScalePow");
     GetMutationFloatParams(&vf, MBString_GetCStr(&s),
-                           MUTATION_TYPE_SCALE_POW, mreg);
-    Mutate_Float(mreg, &vf, 1);
+                           MUTATION_TYPE_SCALE_POW, g);
+    Mutate_GenomeFloat(g, &vf, 1);
 
     MBString_Destroy(&s);
 }
 
-static void MutateBundlePeriodicParams(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundlePeriodicParams(FleetAIType aiType, Genome *g,
                                        const char *prefix)
 {
     CMBString s;
@@ -16737,23 +16737,23 @@ static void MutateBundlePeriodicParams(FleetAIType aiType, MBRegistry *mreg,
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".period");
-    MutateBundleAtom(aiType, mreg, MBString_GetCStr(&s), MUTATION_TYPE_PERIOD);
+    MutateBundleAtom(aiType, g, MBString_GetCStr(&s), MUTATION_TYPE_PERIOD);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".amplitude");
-    MutateBundleAtom(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleAtom(aiType, g, MBString_GetCStr(&s),
                      MUTATION_TYPE_AMPLITUDE);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".tickShift");
-    MutateBundleAtom(aiType, mreg, MBString_GetCStr(&s), MUTATION_TYPE_PERIOD);
+    MutateBundleAtom(aiType, g, MBString_GetCStr(&s), MUTATION_TYPE_PERIOD);
 
     MBString_Destroy(&s);
 }
 
-static void MutateBundleValue(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleValue(FleetAIType aiType, Genome *g,
                               const char *prefix,
                               MutationType bType)
 {
@@ -16769,23 +16769,23 @@ static void MutateBundleValue(FleetAIType aiType, MBRegistry *mreg,
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".valueType");
-    GetMutationStrParams(&svf, MBString_GetCStr(&s), mreg);
-    Mutate_Str(mreg, &svf, 1, options, ARRAYSIZE(options));
+    GetMutationStrParams(&svf, MBString_GetCStr(&s), g);
+    Mutate_GenomeStr(g, &svf, 1, options, ARRAYSIZE(options));
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".value");
-    MutateBundleAtom(aiType, mreg, MBString_GetCStr(&s), bType);
+    MutateBundleAtom(aiType, g, MBString_GetCStr(&s), bType);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".periodic");
-    MutateBundlePeriodicParams(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundlePeriodicParams(aiType, g, MBString_GetCStr(&s));
 
     MBString_Destroy(&s);
 }
 
-static void MutateBundleCheck(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleCheck(FleetAIType aiType, Genome *g,
                               const char *prefix)
 {
     MutationStrParams svf;
@@ -16801,13 +16801,13 @@ static void MutateBundleCheck(FleetAIType aiType, MBRegistry *mreg,
         "quadraticUp", "quadraticDown"
     };
 
-    GetMutationStrParams(&svf, MBString_GetCStr(&s), mreg);
-    Mutate_Str(mreg, &svf, 1, checkOptions, ARRAYSIZE(checkOptions));
+    GetMutationStrParams(&svf, MBString_GetCStr(&s), g);
+    Mutate_GenomeStr(g, &svf, 1, checkOptions, ARRAYSIZE(checkOptions));
 
     MBString_Destroy(&s);
 }
 
-static void MutateBundleCrowd(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleCrowd(FleetAIType aiType, Genome *g,
                               const char *prefix)
 {
     CMBString s;
@@ -16816,24 +16816,24 @@ static void MutateBundleCrowd(FleetAIType aiType, MBRegistry *mreg,
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".type");
-    MutateBundleCheck(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleCheck(aiType, g, MBString_GetCStr(&s));
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".size");
-    MutateBundleValue(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleValue(aiType, g, MBString_GetCStr(&s),
                       MUTATION_TYPE_COUNT);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".radius");
-    MutateBundleValue(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleValue(aiType, g, MBString_GetCStr(&s),
                       MUTATION_TYPE_RADIUS);
 
     MBString_Destroy(&s);
 }
 
-static void MutateBundleRange(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleRange(FleetAIType aiType, Genome *g,
                               const char *prefix)
 {
     CMBString s;
@@ -16842,18 +16842,18 @@ static void MutateBundleRange(FleetAIType aiType, MBRegistry *mreg,
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".type");
-    MutateBundleCheck(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleCheck(aiType, g, MBString_GetCStr(&s));
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".radius");
-    MutateBundleValue(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleValue(aiType, g, MBString_GetCStr(&s),
                       MUTATION_TYPE_RADIUS);
 
     MBString_Destroy(&s);
 }
 
-static void MutateBundleLinearForce(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleLinearForce(FleetAIType aiType, Genome *g,
                                     const char *prefix)
 {
     CMBString s;
@@ -16862,24 +16862,24 @@ static void MutateBundleLinearForce(FleetAIType aiType, MBRegistry *mreg,
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".crowd");
-    MutateBundleCrowd(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleCrowd(aiType, g, MBString_GetCStr(&s));
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".range");
-    MutateBundleRange(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleRange(aiType, g, MBString_GetCStr(&s));
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".weight");
-    MutateBundleValue(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleValue(aiType, g, MBString_GetCStr(&s),
                       MUTATION_TYPE_WEIGHT);
 
     MBString_Destroy(&s);
 }
 
 
-static void MutateBundleForce(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleForce(FleetAIType aiType, Genome *g,
                               const char *prefix)
 {
     CMBString s;
@@ -16890,7 +16890,7 @@ static void MutateBundleForce(FleetAIType aiType, MBRegistry *mreg,
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ""); // push force
-    MutateBundleLinearForce(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleLinearForce(aiType, g, MBString_GetCStr(&s));
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
@@ -16898,15 +16898,15 @@ static void MutateBundleForce(FleetAIType aiType, MBRegistry *mreg,
     MBUtil_Zero(&vb, sizeof(vb));
     vb.key = MBString_GetCStr(&s);
     vb.flipRate = 0.05f;
-    if (MBRegistry_GetBool(mreg, BUNDLE_SCRAMBLE_KEY)) {
+    if (Genome_GetBool(g, BUNDLE_SCRAMBLE_KEY)) {
         vb.flipRate = 0.5f;
     }
-    Mutate_Bool(mreg, &vb, 1);
+    Mutate_GenomeBool(g, &vb, 1);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".tangent");
-    MutateBundleLinearForce(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleLinearForce(aiType, g, MBString_GetCStr(&s));
 
     //XXX: Randomly copy in exact values from push force?
 
@@ -16914,7 +16914,7 @@ static void MutateBundleForce(FleetAIType aiType, MBRegistry *mreg,
 }
 
 
-static void MutateBundleBool(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleBool(FleetAIType aiType, Genome *g,
                               const char *prefix)
 {
     CMBString s;
@@ -16928,32 +16928,32 @@ static void MutateBundleBool(FleetAIType aiType, MBRegistry *mreg,
     MBUtil_Zero(&vb, sizeof(vb));
     vb.key = MBString_GetCStr(&s);
     vb.flipRate = 0.05f;
-    if (MBRegistry_GetBool(mreg, BUNDLE_SCRAMBLE_KEY)) {
+    if (Genome_GetBool(g, BUNDLE_SCRAMBLE_KEY)) {
         vb.flipRate = 0.5f;
     }
-    Mutate_Bool(mreg, &vb, 1);
+    Mutate_GenomeBool(g, &vb, 1);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".crowd");
-    MutateBundleCrowd(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleCrowd(aiType, g, MBString_GetCStr(&s));
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".range");
-    MutateBundleRange(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleRange(aiType, g, MBString_GetCStr(&s));
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".value");
-    MutateBundleValue(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleValue(aiType, g, MBString_GetCStr(&s),
                       MUTATION_TYPE_BOOL);
 
     MBString_Destroy(&s);
 }
 
 
-static void MutateBundleFleetLocus(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleFleetLocus(FleetAIType aiType, Genome *g,
                                    const char *prefix)
 {
     CMBString s;
@@ -16962,7 +16962,7 @@ static void MutateBundleFleetLocus(FleetAIType aiType, MBRegistry *mreg,
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".force");
-    MutateBundleForce(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleForce(aiType, g, MBString_GetCStr(&s));
 
     MutationFloatParams vf[] = {
         // key                min     max       mag   jump   mutation
@@ -16983,7 +16983,7 @@ static void MutateBundleFleetLocus(FleetAIType aiType, MBRegistry *mreg,
     for (uint i = 0; i < ARRAYSIZE(vf); i++) {
         MutationFloatParams mfp = vf[i];
 
-        if (MBRegistry_GetBool(mreg, BUNDLE_SCRAMBLE_KEY)) {
+        if (Genome_GetBool(g, BUNDLE_SCRAMBLE_KEY)) {
             mfp.mutationRate = 1.0f;
             mfp.jumpRate = 1.0f;
         }
@@ -16993,13 +16993,13 @@ static void MutateBundleFleetLocus(FleetAIType aiType, MBRegistry *mreg,
         MBString_AppendCStr(&s, mfp.key);
         mfp.key = MBString_GetCStr(&s);
 
-        Mutate_Float(mreg, &mfp, 1);
+        Mutate_GenomeFloat(g, &mfp, 1);
     }
 
     for (uint i = 0; i < ARRAYSIZE(vb); i++) {
         MutationBoolParams mbp = vb[i];
 
-        if (MBRegistry_GetBool(mreg, BUNDLE_SCRAMBLE_KEY)) {
+        if (Genome_GetBool(g, BUNDLE_SCRAMBLE_KEY)) {
             mbp.flipRate = 0.5f;
         }
 
@@ -17008,13 +17008,13 @@ static void MutateBundleFleetLocus(FleetAIType aiType, MBRegistry *mreg,
         MBString_AppendCStr(&s, mbp.key);
         mbp.key = MBString_GetCStr(&s);
 
-        Mutate_Bool(mreg, &mbp, 1);
+        Mutate_GenomeBool(g, &mbp, 1);
     }
 
     MBString_Destroy(&s);
 }
 
-static void MutateBundleMobLocus(FleetAIType aiType, MBRegistry *mreg,
+static void MutateBundleMobLocus(FleetAIType aiType, Genome *g,
                                  const char *prefix)
 {
     CMBString s;
@@ -17023,54 +17023,54 @@ static void MutateBundleMobLocus(FleetAIType aiType, MBRegistry *mreg,
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".force");
-    MutateBundleForce(aiType, mreg, MBString_GetCStr(&s));
+    MutateBundleForce(aiType, g, MBString_GetCStr(&s));
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".circularPeriod");
-    MutateBundleAtom(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleAtom(aiType, g, MBString_GetCStr(&s),
                      MUTATION_TYPE_PERIOD);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".circularWeight");
-    MutateBundleValue(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleValue(aiType, g, MBString_GetCStr(&s),
                       MUTATION_TYPE_WEIGHT);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".linearXPeriod");
-    MutateBundleAtom(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleAtom(aiType, g, MBString_GetCStr(&s),
                      MUTATION_TYPE_PERIOD);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".linearYPeriod");
-    MutateBundleAtom(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleAtom(aiType, g, MBString_GetCStr(&s),
                      MUTATION_TYPE_PERIOD);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".linearWeight");
-    MutateBundleValue(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleValue(aiType, g, MBString_GetCStr(&s),
                       MUTATION_TYPE_WEIGHT);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".randomPeriod");
-    MutateBundleAtom(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleAtom(aiType, g, MBString_GetCStr(&s),
                      MUTATION_TYPE_PERIOD);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".randomWeight");
-    MutateBundleValue(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleValue(aiType, g, MBString_GetCStr(&s),
                       MUTATION_TYPE_WEIGHT);
 
     MBString_MakeEmpty(&s);
     MBString_AppendCStr(&s, prefix);
     MBString_AppendCStr(&s, ".proximityRadius");
-    MutateBundleValue(aiType, mreg, MBString_GetCStr(&s),
+    MutateBundleValue(aiType, g, MBString_GetCStr(&s),
                       MUTATION_TYPE_RADIUS);
 
     MutationBoolParams vb[] = {
@@ -17082,7 +17082,7 @@ static void MutateBundleMobLocus(FleetAIType aiType, MBRegistry *mreg,
     for (uint i = 0; i < ARRAYSIZE(vb); i++) {
         MutationBoolParams mbp = vb[i];
 
-        if (MBRegistry_GetBool(mreg, BUNDLE_SCRAMBLE_KEY)) {
+        if (Genome_GetBool(g, BUNDLE_SCRAMBLE_KEY)) {
             mbp.flipRate = 0.5f;
         }
 
@@ -17091,13 +17091,13 @@ static void MutateBundleMobLocus(FleetAIType aiType, MBRegistry *mreg,
         MBString_AppendCStr(&s, mbp.key);
         mbp.key = MBString_GetCStr(&s);
 
-        Mutate_Bool(mreg, &mbp, 1);
+        Mutate_GenomeBool(g, &mbp, 1);
     }
 
     MBString_Destroy(&s);
 }
 
-static void BundleFleetMutate(FleetAIType aiType, MBRegistry *mreg)
+static void BundleFleetMutate(FleetAIType aiType, Genome *g)
 {
     MutationFloatParams vf[] = {
         // key                     min     max       mag   jump   mutation
@@ -17132,9 +17132,9 @@ static void BundleFleetMutate(FleetAIType aiType, MBRegistry *mreg)
         //{ "brokenCrowdChecks",           0.05f },
     };
 
-    MBRegistry_PutCopy(mreg, BUNDLE_SCRAMBLE_KEY, "FALSE");
+    Genome_PutCStr(g, BUNDLE_SCRAMBLE_KEY, "FALSE");
     if (Random_Flip(0.01)) {
-        MBRegistry_PutCopy(mreg, BUNDLE_SCRAMBLE_KEY, "TRUE");
+        Genome_PutCStr(g, BUNDLE_SCRAMBLE_KEY, "TRUE");
 
         for (uint i = 0; i < ARRAYSIZE(vf); i++) {
             vf[i].mutationRate = 1.0f;
@@ -17145,42 +17145,42 @@ static void BundleFleetMutate(FleetAIType aiType, MBRegistry *mreg)
         }
     }
 
-    Mutate_Float(mreg, vf, ARRAYSIZE(vf));
-    Mutate_Bool(mreg, vb, ARRAYSIZE(vb));
+    Mutate_GenomeFloat(g, vf, ARRAYSIZE(vf));
+    Mutate_GenomeBool(g, vb, ARRAYSIZE(vb));
 
-    MutateBundleBool(aiType, mreg, "randomIdle");
-    MutateBundleBool(aiType, mreg, "nearBaseRandomIdle");
-    MutateBundleBool(aiType, mreg, "randomizeStoppedVelocity");
-    MutateBundleBool(aiType, mreg, "simpleAttack");
-    MutateBundleBool(aiType, mreg, "flockDuringAttack");
+    MutateBundleBool(aiType, g, "randomIdle");
+    MutateBundleBool(aiType, g, "nearBaseRandomIdle");
+    MutateBundleBool(aiType, g, "randomizeStoppedVelocity");
+    MutateBundleBool(aiType, g, "simpleAttack");
+    MutateBundleBool(aiType, g, "flockDuringAttack");
 
-    MutateBundleForce(aiType, mreg, "align");
-    MutateBundleForce(aiType, mreg, "cohere");
-    MutateBundleForce(aiType, mreg, "separate");
-    MutateBundleForce(aiType, mreg, "attackSeparate");
-    MutateBundleForce(aiType, mreg, "nearestFriend");
+    MutateBundleForce(aiType, g, "align");
+    MutateBundleForce(aiType, g, "cohere");
+    MutateBundleForce(aiType, g, "separate");
+    MutateBundleForce(aiType, g, "attackSeparate");
+    MutateBundleForce(aiType, g, "nearestFriend");
 
-    MutateBundleForce(aiType, mreg, "cores");
-    MutateBundleForce(aiType, mreg, "enemy");
-    MutateBundleForce(aiType, mreg, "enemyBase");
-    MutateBundleForce(aiType, mreg, "enemyBaseGuess");
+    MutateBundleForce(aiType, g, "cores");
+    MutateBundleForce(aiType, g, "enemy");
+    MutateBundleForce(aiType, g, "enemyBase");
+    MutateBundleForce(aiType, g, "enemyBaseGuess");
 
-    MutateBundleForce(aiType, mreg, "center");
-    MutateBundleForce(aiType, mreg, "edges");
-    MutateBundleForce(aiType, mreg, "corners");
-    MutateBundleForce(aiType, mreg, "base");
-    MutateBundleForce(aiType, mreg, "baseDefense");
+    MutateBundleForce(aiType, g, "center");
+    MutateBundleForce(aiType, g, "edges");
+    MutateBundleForce(aiType, g, "corners");
+    MutateBundleForce(aiType, g, "base");
+    MutateBundleForce(aiType, g, "baseDefense");
 
-    MutateBundleValue(aiType, mreg, "curHeadingWeight", MUTATION_TYPE_WEIGHT);
+    MutateBundleValue(aiType, g, "curHeadingWeight", MUTATION_TYPE_WEIGHT);
 
-    MutateBundleFleetLocus(aiType, mreg, "fleetLocus");
-    MutateBundleMobLocus(aiType, mreg, "mobLocus");
+    MutateBundleFleetLocus(aiType, g, "fleetLocus");
+    MutateBundleMobLocus(aiType, g, "mobLocus");
 
-    MutateBundleValue(aiType, mreg, "hold.invProbability",
+    MutateBundleValue(aiType, g, "hold.invProbability",
                       MUTATION_TYPE_INVERSE_PROBABILITY);
-    MutateBundleValue(aiType, mreg, "hold.ticks", MUTATION_TYPE_TICKS);
+    MutateBundleValue(aiType, g, "hold.ticks", MUTATION_TYPE_TICKS);
 
-    MBRegistry_Remove(mreg, BUNDLE_SCRAMBLE_KEY);
+    Genome_Remove(g, BUNDLE_SCRAMBLE_KEY);
 }
 
 static void *BundleFleetCreate(FleetAI *ai)
@@ -0,0 +1,275 @@
+/*
+ * checkpoint.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <SDL2/SDL_timer.h>
+
+#include "checkpoint.h"
+#include "MBUtil.h"
+#include "MBDebug.h"
+
+void Checkpoint_Create(Checkpoint *cp, const char *file, uint intervalSecs,
+                       bool resume, CheckpointSaveFn saveFn,
+                       CheckpointLoadFn loadFn, void *cbData)
+{
+    ASSERT(cp != NULL);
+    ASSERT(file != NULL);
+    ASSERT(saveFn != NULL);
+    ASSERT(loadFn != NULL);
+
+    MBUtil_Zero(cp, sizeof(*cp));
+    cp->file = strdup(file);
+    VERIFY(cp->file != NULL);
+    cp->resume = resume;
+    cp->intervalMS = intervalSecs * 1000;
+    cp->saveFn = saveFn;
+    cp->loadFn = loadFn;
+    cp->cbData = cbData;
+}
+
+void Checkpoint_Destroy(Checkpoint *cp)
+{
+    ASSERT(!cp->active);
+    free(cp->file);
+    MBUtil_Zero(cp, sizeof(*cp));
+}
+
+static uint CheckpointDoneSize(const Checkpoint *cp)
+{
+    return (cp->totalBattles + 7) / 8;
+}
+
+/*
+ * CheckpointLoad --
+ *    Restore the results from an earlier run of the same battles.
+ *    Returns FALSE if there's no checkpoint, or if it's from a different
+ *    run.
+ */
+static bool CheckpointLoad(Checkpoint *cp)
+{
+    CheckpointHeader hdr;
+    uint doneSize = CheckpointDoneSize(cp);
+    bool ok;
+    FILE *f;
+
+    f = fopen(cp->file, "rb");
+    if (f == NULL) {
+        Warning("No checkpoint to resume from: %s\n", cp->file);
+        return FALSE;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        memcmp(hdr.magic, CHECKPOINT_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != CHECKPOINT_VERSION) {
+        PANIC("Unsupported checkpoint: %s\n", cp->file);
+    }
+
+    if (hdr.runKey != cp->runKey ||
+        hdr.totalBattles != cp->totalBattles) {
+        Warning("Checkpoint is from a different run, starting over: %s\n",
+                cp->file);
+        fclose(f);
+        return FALSE;
+    }
+
+    ok = fread(cp->done, 1, doneSize, f) == doneSize;
+    ok = ok && cp->loadFn(cp->cbData, f);
+    fclose(f);
+
+    if (!ok) {
+        PANIC("Truncated checkpoint: %s\n", cp->file);
+    }
+
+    cp->numDone = hdr.numDone;
+    cp->seed = hdr.seed;
+
+    Warning("Resuming from %s: %d of %d battles done.\n",
+            cp->file, cp->numDone, cp->totalBattles);
+    return TRUE;
+}
+
+static void CheckpointWrite(Checkpoint *cp)
+{
+    CheckpointHeader hdr;
+    uint doneSize = CheckpointDoneSize(cp);
+    char *tmpFile = NULL;
+    bool ok;
+    FILE *f;
+
+    VERIFY(asprintf(&tmpFile, "%s.tmp", cp->file) > 0);
+    f = fopen(tmpFile, "wb");
+    if (f == NULL) {
+        PANIC("Unable to write checkpoint: %s\n", tmpFile);
+    }
+
+    MBUtil_Zero(&hdr, sizeof(hdr));
+    memcpy(hdr.magic, CHECKPOINT_MAGIC, sizeof(hdr.magic));
+    hdr.version = CHECKPOINT_VERSION;
+    hdr.totalBattles = cp->totalBattles;
+    hdr.numDone = cp->numDone;
+    hdr.runKey = cp->runKey;
+    hdr.seed = cp->seed;
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    ok = ok && fwrite(cp->done, 1, doneSize, f) == doneSize;
+    ok = ok && cp->saveFn(cp->cbData, f);
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || rename(tmpFile, cp->file) != 0) {
+        PANIC("Unable to write checkpoint: %s\n", cp->file);
+    }
+    free(tmpFile);
+
+    cp->lastWriteMS = SDL_GetTicks();
+}
+
+/*
+ * Checkpoint_Begin --
+ *    Start checkpointing a run of totalBattles battles, and restore the
+ *    earlier results if we're resuming.  Returns TRUE if it resumed, in
+ *    which case the run should use the seed from Checkpoint_GetSeed.
+ */
+bool Checkpoint_Begin(Checkpoint *cp, uint64 runKey, uint64 seed,
+                      uint totalBattles)
+{
+    bool resumed = FALSE;
+
+    ASSERT(!cp->active);
+
+    cp->runKey = runKey;
+    cp->seed = seed;
+    cp->totalBattles = totalBattles;
+    cp->done = calloc(CheckpointDoneSize(cp), sizeof(cp->done[0]));
+    VERIFY(cp->done != NULL);
+    cp->numDone = 0;
+    cp->active = TRUE;
+
+    if (cp->resume) {
+        cp->resume = FALSE;
+        resumed = CheckpointLoad(cp);
+    }
+
+    cp->lastWriteMS = SDL_GetTicks();
+    return resumed;
+}
+
+/*
+ * Checkpoint_MarkDone --
+ *    Record that battle n has finished, and write out the checkpoint if
+ *    it's time to.
+ */
+void Checkpoint_MarkDone(Checkpoint *cp, uint n)
+{
+    ASSERT(cp->active);
+    ASSERT(n < cp->totalBattles);
+    ASSERT(!Checkpoint_IsDone(cp, n));
+
+    cp->done[n / 8] |= 1 << (n % 8);
+    cp->numDone++;
+
+    if (SDL_GetTicks() - cp->lastWriteMS >= cp->intervalMS) {
+        CheckpointWrite(cp);
+    }
+}
+
+void Checkpoint_End(Checkpoint *cp)
+{
+    ASSERT(cp->active);
+
+    CheckpointWrite(cp);
+    free(cp->done);
+    cp->done = NULL;
+    cp->active = FALSE;
+}
+
+static bool CheckpointTestSave(void *cbData, FILE *f)
+{
+    return fwrite(cbData, sizeof(uint64), 1, f) == 1;
+}
+
+static bool CheckpointTestLoad(void *cbData, FILE *f)
+{
+    return fread(cbData, sizeof(uint64), 1, f) == 1;
+}
+
+void Checkpoint_UnitTest(void)
+{
+    char file[] = "/tmp/sr2CheckpointTestXXXXXX";
+    uint64 payload;
+    Checkpoint cp;
+    int fd;
+
+    fd = mkstemp(file);
+    VERIFY(fd >= 0);
+    close(fd);
+    unlink(file);
+
+    /*
+     * Nothing to resume from yet.
+     */
+    Checkpoint_Create(&cp, file, CHECKPOINT_DEFAULT_SECS, TRUE,
+                      CheckpointTestSave, CheckpointTestLoad, &payload);
+    VERIFY(!Checkpoint_Begin(&cp, 0x1234, 77, 20));
+    Checkpoint_MarkDone(&cp, 3);
+    Checkpoint_MarkDone(&cp, 17);
+    payload = 0xabcdef;
+    Checkpoint_End(&cp);
+
+    // Only the first run resumes.
+    VERIFY(!Checkpoint_Begin(&cp, 0x1234, 78, 20));
+    VERIFY(!Checkpoint_IsDone(&cp, 3));
+    VERIFY(Checkpoint_GetSeed(&cp) == 78);
+    Checkpoint_MarkDone(&cp, 3);
+    Checkpoint_MarkDone(&cp, 17);
+    Checkpoint_End(&cp);
+    Checkpoint_Destroy(&cp);
+
+    /*
+     * Resuming the same run brings back its seed, battles and payload.
+     */
+    payload = 0;
+    Checkpoint_Create(&cp, file, CHECKPOINT_DEFAULT_SECS, TRUE,
+                      CheckpointTestSave, CheckpointTestLoad, &payload);
+    VERIFY(Checkpoint_Begin(&cp, 0x1234, 99, 20));
+    VERIFY(Checkpoint_GetSeed(&cp) == 78);
+    VERIFY(payload == 0xabcdef);
+    VERIFY(cp.numDone == 2);
+    for (uint n = 0; n < 20; n++) {
+        VERIFY(Checkpoint_IsDone(&cp, n) == (n == 3 || n == 17));
+    }
+    Checkpoint_End(&cp);
+    Checkpoint_Destroy(&cp);
+
+    /*
+     * A different run starts over.
+     */
+    payload = 0;
+    Checkpoint_Create(&cp, file, CHECKPOINT_DEFAULT_SECS, TRUE,
+                      CheckpointTestSave, CheckpointTestLoad, &payload);
+    VERIFY(!Checkpoint_Begin(&cp, 0x4321, 99, 20));
+    VERIFY(Checkpoint_GetSeed(&cp) == 99);
+    VERIFY(payload == 0);
+    VERIFY(cp.numDone == 0);
+    Checkpoint_End(&cp);
+    Checkpoint_Destroy(&cp);
+
+    unlink(file);
+}
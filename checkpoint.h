@@ -0,0 +1,128 @@
+/*
+ * checkpoint.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHECKPOINT_H_202306031145
+#define _CHECKPOINT_H_202306031145
+
+#include <stdio.h>
+
+#include "MBTypes.h"
+#include "MBAssert.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * Checkpoints for long runs.
+ *
+ * A run periodically saves which of its battles have finished, along
+ * with the results so far, so that a later process can skip the
+ * finished battles after a crash or a preempted job and carry on with
+ * the rest.  The run's seed is saved too, so the remaining battles can
+ * get the same seeds they would have had.
+ *
+ * Battles are numbered from 0 to totalBattles - 1 by the caller, and a
+ * run is identified by a runKey hashed from everything that decides
+ * which battles it has.  The file is a header, a bitmap of the finished
+ * battles, and then whatever the caller's saveFn writes.  It's written
+ * to a temporary file and renamed into place, so a crash mid-write
+ * leaves the previous checkpoint intact.
+ *
+ * Only the first run after Checkpoint_Create resumes from the file.
+ */
+#define CHECKPOINT_MAGIC        "SR2CKPT1"
+#define CHECKPOINT_VERSION      4
+#define CHECKPOINT_DEFAULT_SECS 60
+
+typedef struct CheckpointHeader {
+    char magic[8];
+    uint32 version;
+    uint32 totalBattles;
+    uint32 numDone;
+    uint32 _pad;
+    uint64 runKey;
+    uint64 seed;
+} CheckpointHeader;
+
+/*
+ * Save and restore the caller's results.  They return FALSE if the
+ * file couldn't be written or was cut short.
+ */
+typedef bool (*CheckpointSaveFn)(void *cbData, FILE *f);
+typedef bool (*CheckpointLoadFn)(void *cbData, FILE *f);
+
+typedef struct Checkpoint {
+    char *file;
+    bool resume;
+    uint intervalMS;
+    CheckpointSaveFn saveFn;
+    CheckpointLoadFn loadFn;
+    void *cbData;
+
+    /*
+     * For the current run.
+     */
+    bool active;
+    uint64 runKey;
+    uint64 seed;
+    uint totalBattles;
+    uint8 *done;
+    uint numDone;
+    uint32 lastWriteMS;
+} Checkpoint;
+
+void Checkpoint_Create(Checkpoint *cp, const char *file, uint intervalSecs,
+                       bool resume, CheckpointSaveFn saveFn,
+                       CheckpointLoadFn loadFn, void *cbData);
+void Checkpoint_Destroy(Checkpoint *cp);
+
+bool Checkpoint_Begin(Checkpoint *cp, uint64 runKey, uint64 seed,
+                      uint totalBattles);
+void Checkpoint_End(Checkpoint *cp);
+
+void Checkpoint_MarkDone(Checkpoint *cp, uint n);
+
+static inline bool Checkpoint_IsActive(const Checkpoint *cp)
+{
+    return cp->active;
+}
+
+static inline bool Checkpoint_IsDone(const Checkpoint *cp, uint n)
+{
+    ASSERT(cp->active);
+    ASSERT(n < cp->totalBattles);
+    return (cp->done[n / 8] & (1 << (n % 8))) != 0;
+}
+
+/*
+ * The run's seed, which is the one from the checkpoint when resuming.
+ */
+static inline uint64 Checkpoint_GetSeed(const Checkpoint *cp)
+{
+    ASSERT(cp->active);
+    return cp->seed;
+}
+
+void Checkpoint_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _CHECKPOINT_H_202306031145
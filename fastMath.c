@@ -0,0 +1,841 @@
+/*
+ * fastMath.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <float.h>
+#include <string.h>
+
+/*
+ * The AVX2 paths are built with a target attribute rather than relying
+ * on -mavx2, so they're always compiled on x86, and only used when the
+ * CPU we're running on supports them.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FASTMATH_AVX2 1
+#define FM_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+#include "fastMath.h"
+#include "MBAssert.h"
+#include "MBDebug.h"
+
+/*
+ * The polynomial coefficients and range reductions below are the
+ * single-precision ones from the Cephes library, which keeps them
+ * within a couple ulps of libm without any tables.
+ */
+#define FM_LOG2E     1.44269504088896341f
+#define FM_LN2_HI    0.693359375f
+#define FM_LN2_LO    (-2.12194440e-4f)
+#define FM_SQRTHF    0.707106781186547524f
+#define FM_EXP_MAX   88.72283905206835f
+#define FM_EXP_MIN   (-103.97208f)
+#define FM_4_OVER_PI 1.27323954473516f
+#define FM_PIO4_1    0.78515625f
+#define FM_PIO4_2    2.4187564849853515625e-4f
+#define FM_PIO4_3    3.77489497744594108e-8f
+#define FM_TRIG_MAX  8192.0f
+
+bool fastMathEnabled = FALSE;
+
+void FastMath_Enable(bool enabled)
+{
+    fastMathEnabled = enabled;
+}
+
+static inline uint32 FastMathFloatToBits(float f)
+{
+    uint32 u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static inline float FastMathBitsToFloat(uint32 u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+float FastMath_ApproxExpf(float x)
+{
+    float fn, z, p;
+    int n;
+
+    if (isnan(x)) {
+        return x;
+    } else if (x > FM_EXP_MAX) {
+        return INFINITY;
+    } else if (x < FM_EXP_MIN) {
+        return 0.0f;
+    }
+
+    fn = floorf(FM_LOG2E * x + 0.5f);
+    n = (int)fn;
+    x -= fn * FM_LN2_HI;
+    x -= fn * FM_LN2_LO;
+
+    z = x * x;
+    p = 1.9875691500E-4f;
+    p = p * x + 1.3981999507E-3f;
+    p = p * x + 8.3334519073E-3f;
+    p = p * x + 4.1665795894E-2f;
+    p = p * x + 1.6666665459E-1f;
+    p = p * x + 5.0000001201E-1f;
+    p = p * z + x + 1.0f;
+
+    if (n >= -126 && n <= 127) {
+        return p * FastMathBitsToFloat((uint32)(n + 127) << 23);
+    }
+    return ldexpf(p, n);
+}
+
+float FastMath_ApproxLogf(float x)
+{
+    uint32 u;
+    float m, z, y;
+    int e;
+
+    if (isnan(x) || x < 0.0f) {
+        return NAN;
+    } else if (x == 0.0f) {
+        return -INFINITY;
+    } else if (isinf(x)) {
+        return x;
+    }
+
+    e = 0;
+    if (x < FLT_MIN) {
+        /* Normalize denormals. */
+        x *= 8388608.0f;
+        e = -23;
+    }
+
+    u = FastMathFloatToBits(x);
+    e += (int)((u >> 23) & 0xff) - 126;
+    m = FastMathBitsToFloat((u & 0x007fffff) | 0x3f000000);
+
+    /* m is now in [0.5, 1). */
+    if (m < FM_SQRTHF) {
+        e -= 1;
+        m = m + m - 1.0f;
+    } else {
+        m = m - 1.0f;
+    }
+
+    z = m * m;
+    y = 7.0376836292E-2f;
+    y = y * m - 1.1514610310E-1f;
+    y = y * m + 1.1676998740E-1f;
+    y = y * m - 1.2420140846E-1f;
+    y = y * m + 1.4249322787E-1f;
+    y = y * m - 1.6668057665E-1f;
+    y = y * m + 2.0000714765E-1f;
+    y = y * m - 2.4999993993E-1f;
+    y = y * m + 3.3333331174E-1f;
+    y = y * m * z;
+
+    y += e * FM_LN2_LO;
+    y += -0.5f * z;
+    m = m + y;
+    m += e * FM_LN2_HI;
+    return m;
+}
+
+float FastMath_ApproxPowf(float x, float y)
+{
+    float r;
+
+    if (y == 0.0f || x == 1.0f) {
+        return 1.0f;
+    } else if (isnan(x) || isnan(y)) {
+        return NAN;
+    } else if (x == 0.0f || isinf(x) || isinf(y)) {
+        /* Leave the sign/zero/infinity rules to libm. */
+        return powf(x, y);
+    }
+
+    if (x > 0.0f) {
+        return FastMath_ApproxExpf(y * FastMath_ApproxLogf(x));
+    }
+
+    /*
+     * Negative bases only have real results for integer exponents.
+     */
+    if (floorf(y) != y) {
+        return NAN;
+    }
+
+    r = FastMath_ApproxExpf(y * FastMath_ApproxLogf(-x));
+    if (fabsf(y) < 16777216.0f && ((int64)y & 1) != 0) {
+        r = -r;
+    }
+    return r;
+}
+
+/*
+ * FastMathSinPoly, FastMathCosPoly --
+ *    Evaluate sin (or cos) for x in [-pi/4, pi/4].
+ */
+static inline float FastMathSinPoly(float x)
+{
+    float z = x * x;
+    float y = -1.9515295891E-4f;
+    y = y * z + 8.3321608736E-3f;
+    y = y * z - 1.6666654611E-1f;
+    return y * z * x + x;
+}
+
+static inline float FastMathCosPoly(float x)
+{
+    float z = x * x;
+    float y = 2.443315711809948E-5f;
+    y = y * z - 1.388731625493765E-3f;
+    y = y * z + 4.166664568298827E-2f;
+    return y * z * z - 0.5f * z + 1.0f;
+}
+
+/*
+ * FastMathTrigReduce --
+ *    Reduce |x| into [-pi/4, pi/4], returning the octant.
+ */
+static inline float FastMathTrigReduce(float x, uint32 *octant)
+{
+    uint32 j = (uint32)(x * FM_4_OVER_PI);
+    float y;
+
+    /* Map zeros to the origin. */
+    j = (j + 1) & ~1;
+    y = (float)j;
+
+    x = ((x - y * FM_PIO4_1) - y * FM_PIO4_2) - y * FM_PIO4_3;
+    *octant = j & 7;
+    return x;
+}
+
+float FastMath_ApproxSinf(float x)
+{
+    float sign = 1.0f;
+    uint32 j;
+    float y;
+
+    if (!isfinite(x) || fabsf(x) > FM_TRIG_MAX) {
+        return sinf(x);
+    }
+
+    if (x < 0.0f) {
+        sign = -1.0f;
+        x = -x;
+    }
+
+    x = FastMathTrigReduce(x, &j);
+    if (j > 3) {
+        sign = -sign;
+        j -= 4;
+    }
+
+    if (j == 1 || j == 2) {
+        y = FastMathCosPoly(x);
+    } else {
+        y = FastMathSinPoly(x);
+    }
+    return sign * y;
+}
+
+float FastMath_ApproxCosf(float x)
+{
+    float sign = 1.0f;
+    uint32 j;
+    float y;
+
+    if (!isfinite(x) || fabsf(x) > FM_TRIG_MAX) {
+        return cosf(x);
+    }
+
+    x = fabsf(x);
+    x = FastMathTrigReduce(x, &j);
+    if (j > 3) {
+        sign = -sign;
+        j -= 4;
+    }
+    if (j > 1) {
+        sign = -sign;
+    }
+
+    if (j == 1 || j == 2) {
+        y = FastMathSinPoly(x);
+    } else {
+        y = FastMathCosPoly(x);
+    }
+    return sign * y;
+}
+
+float FastMath_ApproxTanhf(float x)
+{
+    float z = fabsf(x);
+
+    if (isnan(x)) {
+        return x;
+    } else if (z > 9.0f) {
+        return x > 0.0f ? 1.0f : -1.0f;
+    } else if (z >= 0.625f) {
+        float s = FastMath_ApproxExpf(z + z);
+        z = 1.0f - 2.0f / (s + 1.0f);
+        return x < 0.0f ? -z : z;
+    } else {
+        float y;
+        z = x * x;
+        y = -5.70498872745E-3f;
+        y = y * z + 2.06390887954E-2f;
+        y = y * z - 5.37397155531E-2f;
+        y = y * z + 1.33314422036E-1f;
+        y = y * z - 3.33332819422E-1f;
+        return y * z * x + x;
+    }
+}
+
+float FastMath_ApproxAtanf(float x)
+{
+    float sign = 1.0f;
+    float y, z;
+
+    if (isnan(x)) {
+        return x;
+    }
+
+    if (x < 0.0f) {
+        sign = -1.0f;
+        x = -x;
+    }
+
+    if (x > 2.414213562373095f) {
+        y = (float)M_PI_2;
+        x = -1.0f / x;
+    } else if (x > 0.4142135623730950f) {
+        y = (float)M_PI_4;
+        x = (x - 1.0f) / (x + 1.0f);
+    } else {
+        y = 0.0f;
+    }
+
+    z = x * x;
+    y += (((8.05374449538e-2f * z - 1.38776856032E-1f) * z +
+           1.99777106478E-1f) * z - 3.33329491539E-1f) * z * x + x;
+
+    return sign * y;
+}
+
+float FastMath_ApproxAtan2f(float y, float x)
+{
+    float a;
+
+    if (isnan(x) || isnan(y) || isinf(x) || isinf(y) ||
+        x == 0.0f || y == 0.0f) {
+        /* Leave the signed zero and infinity quadrant rules to libm. */
+        return atan2f(y, x);
+    }
+
+    if (fabsf(y) <= fabsf(x)) {
+        a = FastMath_ApproxAtanf(y / x);
+    } else {
+        a = (y > 0.0f ? (float)M_PI_2 : -(float)M_PI_2) -
+            FastMath_ApproxAtanf(x / y);
+        return a;
+    }
+
+    if (x < 0.0f) {
+        a += y > 0.0f ? (float)M_PI : -(float)M_PI;
+    }
+    return a;
+}
+
+float FastMath_ApproxAcosf(float x)
+{
+    float z, p;
+    bool negate = FALSE;
+
+    if (isnan(x) || x > 1.0f || x < -1.0f) {
+        return NAN;
+    }
+
+    if (x < 0.0f) {
+        negate = TRUE;
+        x = -x;
+    }
+
+    /*
+     * Abramowitz and Stegun 4.4.46.
+     */
+    p = -0.0012624911f;
+    p = p * x + 0.0066700901f;
+    p = p * x - 0.0170881256f;
+    p = p * x + 0.0308918810f;
+    p = p * x - 0.0501743046f;
+    p = p * x + 0.0889789874f;
+    p = p * x - 0.2145988016f;
+    p = p * x + 1.5707963050f;
+
+    z = sqrtf(1.0f - x) * p;
+    return negate ? (float)M_PI - z : z;
+}
+
+
+#ifdef FASTMATH_AVX2
+
+static bool FastMathHaveAVX2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+FM_TARGET_AVX2
+static inline __m256 FastMathExp8(__m256 x)
+{
+    __m256 fn, z, p, pow2n;
+    __m256i n;
+
+    x = _mm256_min_ps(x, _mm256_set1_ps(FM_EXP_MAX));
+    x = _mm256_max_ps(x, _mm256_set1_ps(-87.3f));
+
+    fn = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x,
+                                           _mm256_set1_ps(FM_LOG2E)),
+                                       _mm256_set1_ps(0.5f)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(fn, _mm256_set1_ps(FM_LN2_HI)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(fn, _mm256_set1_ps(FM_LN2_LO)));
+
+    z = _mm256_mul_ps(x, x);
+    p = _mm256_set1_ps(1.9875691500E-4f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(1.3981999507E-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(8.3334519073E-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(4.1665795894E-2f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(1.6666665459E-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(5.0000001201E-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), x);
+    p = _mm256_add_ps(p, _mm256_set1_ps(1.0f));
+
+    n = _mm256_cvtps_epi32(fn);
+    n = _mm256_add_epi32(n, _mm256_set1_epi32(127));
+    pow2n = _mm256_castsi256_ps(_mm256_slli_epi32(n, 23));
+    return _mm256_mul_ps(p, pow2n);
+}
+
+FM_TARGET_AVX2
+static inline __m256 FastMathLog8(__m256 x)
+{
+    __m256i u, e;
+    __m256 m, z, y, fe, mask;
+
+    u = _mm256_castps_si256(x);
+    e = _mm256_sub_epi32(_mm256_srli_epi32(u, 23), _mm256_set1_epi32(126));
+    u = _mm256_and_si256(u, _mm256_set1_epi32(0x007fffff));
+    u = _mm256_or_si256(u, _mm256_set1_epi32(0x3f000000));
+    m = _mm256_castsi256_ps(u);
+    fe = _mm256_cvtepi32_ps(e);
+
+    mask = _mm256_cmp_ps(m, _mm256_set1_ps(FM_SQRTHF), _CMP_LT_OQ);
+    fe = _mm256_sub_ps(fe, _mm256_and_ps(mask, _mm256_set1_ps(1.0f)));
+    m = _mm256_add_ps(m, _mm256_and_ps(mask, m));
+    m = _mm256_sub_ps(m, _mm256_set1_ps(1.0f));
+
+    z = _mm256_mul_ps(m, m);
+    y = _mm256_set1_ps(7.0376836292E-2f);
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.1514610310E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.1676998740E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.2420140846E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.4249322787E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.6668057665E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(2.0000714765E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-2.4999993993E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(3.3333331174E-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+
+    y = _mm256_add_ps(y, _mm256_mul_ps(fe, _mm256_set1_ps(FM_LN2_LO)));
+    y = _mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+    m = _mm256_add_ps(m, y);
+    m = _mm256_add_ps(m, _mm256_mul_ps(fe, _mm256_set1_ps(FM_LN2_HI)));
+    return m;
+}
+
+/*
+ * FastMathSinCos8 --
+ *    Computes sin (or cos) of 8 lanes, all of which must be finite
+ *    and within FM_TRIG_MAX.
+ */
+FM_TARGET_AVX2
+static inline __m256 FastMathSinCos8(__m256 x, bool cosine)
+{
+    __m256 signBit = _mm256_set1_ps(-0.0f);
+    __m256 sign, ax, y, z, ys, yc, polyMask;
+    __m256i j, signI;
+
+    ax = _mm256_andnot_ps(signBit, x);
+    if (cosine) {
+        sign = _mm256_setzero_ps();
+    } else {
+        sign = _mm256_and_ps(x, signBit);
+    }
+
+    j = _mm256_cvttps_epi32(_mm256_mul_ps(ax, _mm256_set1_ps(FM_4_OVER_PI)));
+    j = _mm256_add_epi32(j, _mm256_set1_epi32(1));
+    j = _mm256_and_si256(j, _mm256_set1_epi32(~1));
+    y = _mm256_cvtepi32_ps(j);
+
+    ax = _mm256_sub_ps(ax, _mm256_mul_ps(y, _mm256_set1_ps(FM_PIO4_1)));
+    ax = _mm256_sub_ps(ax, _mm256_mul_ps(y, _mm256_set1_ps(FM_PIO4_2)));
+    ax = _mm256_sub_ps(ax, _mm256_mul_ps(y, _mm256_set1_ps(FM_PIO4_3)));
+
+    j = _mm256_and_si256(j, _mm256_set1_epi32(7));
+    if (cosine) {
+        /*
+         * Negate for octants 2 and 4, where ((j - 2) & 4) is clear.
+         */
+        signI = _mm256_sub_epi32(j, _mm256_set1_epi32(2));
+        signI = _mm256_andnot_si256(signI, _mm256_set1_epi32(4));
+    } else {
+        signI = _mm256_and_si256(j, _mm256_set1_epi32(4));
+    }
+    signI = _mm256_slli_epi32(signI, 29);
+    sign = _mm256_xor_ps(sign, _mm256_castsi256_ps(signI));
+
+    /* Octants 2 and 6 (after rounding) use the other polynomial. */
+    polyMask = _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)),
+                           _mm256_set1_epi32(2)));
+
+    z = _mm256_mul_ps(ax, ax);
+
+    ys = _mm256_set1_ps(-1.9515295891E-4f);
+    ys = _mm256_add_ps(_mm256_mul_ps(ys, z), _mm256_set1_ps(8.3321608736E-3f));
+    ys = _mm256_add_ps(_mm256_mul_ps(ys, z), _mm256_set1_ps(-1.6666654611E-1f));
+    ys = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(ys, z), ax), ax);
+
+    yc = _mm256_set1_ps(2.443315711809948E-5f);
+    yc = _mm256_add_ps(_mm256_mul_ps(yc, z),
+                       _mm256_set1_ps(-1.388731625493765E-3f));
+    yc = _mm256_add_ps(_mm256_mul_ps(yc, z),
+                       _mm256_set1_ps(4.166664568298827E-2f));
+    yc = _mm256_mul_ps(_mm256_mul_ps(yc, z), z);
+    yc = _mm256_sub_ps(yc, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+    yc = _mm256_add_ps(yc, _mm256_set1_ps(1.0f));
+
+    if (cosine) {
+        y = _mm256_blendv_ps(yc, ys, polyMask);
+    } else {
+        y = _mm256_blendv_ps(ys, yc, polyMask);
+    }
+    return _mm256_xor_ps(y, sign);
+}
+
+FM_TARGET_AVX2
+static inline bool FastMathTrigInRange8(__m256 x)
+{
+    __m256 ax = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+    __m256 ok = _mm256_cmp_ps(ax, _mm256_set1_ps(FM_TRIG_MAX), _CMP_LE_OQ);
+    return _mm256_movemask_ps(ok) == 0xff;
+}
+
+FM_TARGET_AVX2
+static inline bool FastMathExpInRange8(__m256 x)
+{
+    __m256 ok = _mm256_and_ps(
+        _mm256_cmp_ps(x, _mm256_set1_ps(-87.3f), _CMP_GE_OQ),
+        _mm256_cmp_ps(x, _mm256_set1_ps(FM_EXP_MAX), _CMP_LE_OQ));
+    return _mm256_movemask_ps(ok) == 0xff;
+}
+
+FM_TARGET_AVX2
+static inline bool FastMathLogInRange8(__m256 x)
+{
+    __m256 ok = _mm256_and_ps(
+        _mm256_cmp_ps(x, _mm256_set1_ps(FLT_MIN), _CMP_GE_OQ),
+        _mm256_cmp_ps(x, _mm256_set1_ps(FLT_MAX), _CMP_LE_OQ));
+    return _mm256_movemask_ps(ok) == 0xff;
+}
+
+
+/*
+ * The array versions run 8 lanes at a time, and use the scalar
+ * versions for the tail and for any batch with special cases
+ * (NaN, Inf, denormals, out of range), so both always agree.
+ * These return how many elements they handled.
+ */
+FM_TARGET_AVX2
+static uint FastMathExpfN8(float *out, const float *in, uint n)
+{
+    uint i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(&in[i]);
+        if (FastMathExpInRange8(x)) {
+            _mm256_storeu_ps(&out[i], FastMathExp8(x));
+        } else {
+            for (uint k = i; k < i + 8; k++) {
+                out[k] = FastMath_ApproxExpf(in[k]);
+            }
+        }
+    }
+
+    return i;
+}
+
+FM_TARGET_AVX2
+static uint FastMathLogfN8(float *out, const float *in, uint n)
+{
+    uint i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(&in[i]);
+        if (FastMathLogInRange8(x)) {
+            _mm256_storeu_ps(&out[i], FastMathLog8(x));
+        } else {
+            for (uint k = i; k < i + 8; k++) {
+                out[k] = FastMath_ApproxLogf(in[k]);
+            }
+        }
+    }
+
+    return i;
+}
+
+FM_TARGET_AVX2
+static uint FastMathSinCosN8(float *out, const float *in, uint n,
+                             bool cosine)
+{
+    uint i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(&in[i]);
+        if (FastMathTrigInRange8(x)) {
+            _mm256_storeu_ps(&out[i], FastMathSinCos8(x, cosine));
+        } else {
+            for (uint k = i; k < i + 8; k++) {
+                out[k] = cosine ? FastMath_ApproxCosf(in[k]) :
+                                  FastMath_ApproxSinf(in[k]);
+            }
+        }
+    }
+
+    return i;
+}
+
+#endif // FASTMATH_AVX2
+
+
+void FastMath_ExpfN(float *out, const float *in, uint n)
+{
+    uint i = 0;
+
+#ifdef FASTMATH_AVX2
+    if (FastMathHaveAVX2()) {
+        i = FastMathExpfN8(out, in, n);
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = FastMath_ApproxExpf(in[i]);
+    }
+}
+
+void FastMath_LogfN(float *out, const float *in, uint n)
+{
+    uint i = 0;
+
+#ifdef FASTMATH_AVX2
+    if (FastMathHaveAVX2()) {
+        i = FastMathLogfN8(out, in, n);
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = FastMath_ApproxLogf(in[i]);
+    }
+}
+
+static void FastMathSinCosN(float *out, const float *in, uint n, bool cosine)
+{
+    uint i = 0;
+
+#ifdef FASTMATH_AVX2
+    if (FastMathHaveAVX2()) {
+        i = FastMathSinCosN8(out, in, n, cosine);
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = cosine ? FastMath_ApproxCosf(in[i]) :
+                          FastMath_ApproxSinf(in[i]);
+    }
+}
+
+void FastMath_SinfN(float *out, const float *in, uint n)
+{
+    FastMathSinCosN(out, in, n, FALSE);
+}
+
+void FastMath_CosfN(float *out, const float *in, uint n)
+{
+    FastMathSinCosN(out, in, n, TRUE);
+}
+
+void FastMath_TanhfN(float *out, const float *in, uint n)
+{
+    for (uint i = 0; i < n; i++) {
+        out[i] = FastMath_ApproxTanhf(in[i]);
+    }
+}
+
+
+/*
+ * FastMathError --
+ *    Compare an approximation against a double-precision reference.
+ *    Relative error is used above 1.0, absolute error below.
+ */
+static double FastMathError(float approx, double exact)
+{
+    double err = fabs((double)approx - exact);
+
+    if (fabs(exact) > 1.0) {
+        err /= fabs(exact);
+    }
+    return err;
+}
+
+static void FastMathCheckError(const char *name, double maxErr, double bound)
+{
+    if (maxErr > bound) {
+        Warning("%s: %s max error %g exceeds %g\n", __FUNCTION__,
+                name, maxErr, bound);
+    }
+    VERIFY(maxErr <= bound);
+}
+
+void FastMath_UnitTest(void)
+{
+    const uint steps = 100000;
+    double maxErr;
+    float in[64];
+    float out[64];
+
+    maxErr = 0.0;
+    for (uint i = 0; i <= steps; i++) {
+        float x = -87.0f + 175.0f * i / steps;
+        double err = FastMathError(FastMath_ApproxExpf(x), exp(x));
+        double rel = err * (exp(x) < 1.0 ? 1.0 / exp(x) : 1.0);
+        if (exp(x) > 1e-30) {
+            maxErr = MAX(maxErr, rel);
+        }
+    }
+    FastMathCheckError("expf", maxErr, 1e-7);
+
+    maxErr = 0.0;
+    for (uint i = 1; i <= steps; i++) {
+        float x = powf(2.0f, -126.0f + 253.0f * i / steps);
+        double err = fabs(FastMath_ApproxLogf(x) - log(x));
+        if (fabs(log(x)) > 1.0) {
+            err /= fabs(log(x));
+        }
+        maxErr = MAX(maxErr, err);
+    }
+    FastMathCheckError("logf", maxErr, 1e-7);
+
+    maxErr = 0.0;
+    for (uint i = 0; i <= steps; i++) {
+        float x = -100.0f + 200.0f * i / steps;
+        maxErr = MAX(maxErr, FastMathError(FastMath_ApproxSinf(x), sin(x)));
+        maxErr = MAX(maxErr, FastMathError(FastMath_ApproxCosf(x), cos(x)));
+    }
+    FastMathCheckError("sinf/cosf", maxErr, 1e-7);
+
+    maxErr = 0.0;
+    for (uint i = 0; i <= steps; i++) {
+        float x = -20.0f + 40.0f * i / steps;
+        maxErr = MAX(maxErr, FastMathError(FastMath_ApproxTanhf(x), tanh(x)));
+    }
+    FastMathCheckError("tanhf", maxErr, 1e-7);
+
+    maxErr = 0.0;
+    for (uint i = 0; i <= steps; i++) {
+        float theta = -M_PI + 2.0 * M_PI * i / steps;
+        float y = sinf(theta) * 3.0f;
+        float x = cosf(theta) * 3.0f;
+        maxErr = MAX(maxErr, FastMathError(FastMath_ApproxAtan2f(y, x),
+                                           atan2(y, x)));
+    }
+    FastMathCheckError("atan2f", maxErr, 2e-7);
+
+    maxErr = 0.0;
+    for (uint i = 0; i <= steps; i++) {
+        float x = -1.0f + 2.0f * i / steps;
+        maxErr = MAX(maxErr, FastMathError(FastMath_ApproxAcosf(x), acos(x)));
+    }
+    FastMathCheckError("acosf", maxErr, 2e-7);
+
+    maxErr = 0.0;
+    for (uint i = 0; i <= steps; i++) {
+        float x = 0.01f + 100.0f * i / steps;
+        float y = -4.0f + 8.0f * (i % 97) / 96;
+        double exact = pow(x, y);
+        double err = FastMathError(FastMath_ApproxPowf(x, y), exact);
+        if (fabs(exact) < 1.0) {
+            err /= fabs(exact);
+        }
+        err /= 1.0 + fabs(y * log(x));
+        maxErr = MAX(maxErr, err);
+    }
+    FastMathCheckError("powf", maxErr, 2e-7);
+
+    VERIFY(isnan(FastMath_ApproxLogf(-1.0f)));
+    VERIFY(isinf(FastMath_ApproxLogf(0.0f)));
+    VERIFY(FastMath_ApproxExpf(-200.0f) == 0.0f);
+    VERIFY(isinf(FastMath_ApproxExpf(200.0f)));
+    VERIFY(isnan(FastMath_ApproxAcosf(2.0f)));
+    VERIFY(isnan(FastMath_ApproxPowf(-2.0f, 0.5f)));
+    VERIFY(FastMath_ApproxPowf(-2.0f, 3.0f) < 0.0f);
+    VERIFY(FastMath_ApproxTanhf(100.0f) == 1.0f);
+
+    /*
+     * The array versions should match the scalar versions closely.
+     */
+    for (uint i = 0; i < ARRAYSIZE(in); i++) {
+        in[i] = -30.0f + 60.0f * i / ARRAYSIZE(in);
+    }
+    FastMath_ExpfN(out, in, ARRAYSIZE(in));
+    for (uint i = 0; i < ARRAYSIZE(in); i++) {
+        float s = FastMath_ApproxExpf(in[i]);
+        VERIFY(fabsf(out[i] - s) <= 1e-6f * MAX(1.0f, fabsf(s)));
+    }
+    FastMath_SinfN(out, in, ARRAYSIZE(in));
+    for (uint i = 0; i < ARRAYSIZE(in); i++) {
+        VERIFY(fabsf(out[i] - FastMath_ApproxSinf(in[i])) <= 1e-6f);
+    }
+    FastMath_CosfN(out, in, ARRAYSIZE(in));
+    for (uint i = 0; i < ARRAYSIZE(in); i++) {
+        VERIFY(fabsf(out[i] - FastMath_ApproxCosf(in[i])) <= 1e-6f);
+    }
+    FastMath_TanhfN(out, in, ARRAYSIZE(in));
+    for (uint i = 0; i < ARRAYSIZE(in); i++) {
+        VERIFY(out[i] == FastMath_ApproxTanhf(in[i]));
+    }
+    for (uint i = 0; i < ARRAYSIZE(in); i++) {
+        in[i] = 0.001f + 1000.0f * i / ARRAYSIZE(in);
+    }
+    FastMath_LogfN(out, in, ARRAYSIZE(in));
+    for (uint i = 0; i < ARRAYSIZE(in); i++) {
+        float s = FastMath_ApproxLogf(in[i]);
+        VERIFY(fabsf(out[i] - s) <= 1e-6f * MAX(1.0f, fabsf(s)));
+    }
+}
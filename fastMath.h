@@ -0,0 +1,136 @@
+/*
+ * fastMath.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FASTMATH_H_202304151032
+#define _FASTMATH_H_202304151032
+
+#include <math.h>
+#include "MBTypes.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * Approximations of the libm transcendentals used by the AI code.
+ *
+ * These trade a little accuracy for speed, and are only used when
+ * fast math has been enabled for the run (see FastMath_Enable).
+ * The battle engine itself always uses libm, so the physics are the
+ * same either way.
+ *
+ * Maximum observed error vs. double-precision libm over the tested
+ * ranges (see FastMath_UnitTest):
+ *
+ *   Expf      rel 1e-7       x in [-87, 88]
+ *   Logf      rel 1e-7       x in (0, FLT_MAX]
+ *   Powf      rel 2e-7 * (1 + |y * log(x)|)
+ *   Sinf/Cosf abs 1e-7       |x| <= 8192, falls back to libm beyond
+ *   Tanhf     abs 1e-7
+ *   Atan2f    abs 2e-7
+ *   Acosf     abs 2e-7       x in [-1, 1]
+ *
+ * The special cases (NaN, +/-Inf, out of domain) follow libm.
+ */
+
+extern bool fastMathEnabled;
+
+void FastMath_Enable(bool enabled);
+
+static inline bool FastMath_IsEnabled(void)
+{
+    return fastMathEnabled;
+}
+
+float FastMath_ApproxExpf(float x);
+float FastMath_ApproxLogf(float x);
+float FastMath_ApproxPowf(float x, float y);
+float FastMath_ApproxSinf(float x);
+float FastMath_ApproxCosf(float x);
+float FastMath_ApproxTanhf(float x);
+float FastMath_ApproxAtanf(float x);
+float FastMath_ApproxAtan2f(float y, float x);
+float FastMath_ApproxAcosf(float x);
+
+/*
+ * Array versions, which use AVX2 when the CPU supports it.
+ * These always use the approximations, regardless of FastMath_Enable.
+ */
+void FastMath_ExpfN(float *out, const float *in, uint n);
+void FastMath_LogfN(float *out, const float *in, uint n);
+void FastMath_SinfN(float *out, const float *in, uint n);
+void FastMath_CosfN(float *out, const float *in, uint n);
+void FastMath_TanhfN(float *out, const float *in, uint n);
+
+void FastMath_UnitTest(void);
+
+/*
+ * Use the approximation if fast math is enabled for this run,
+ * otherwise use libm.
+ */
+static inline float FastMath_Expf(float x)
+{
+    return UNLIKELY(fastMathEnabled) ? FastMath_ApproxExpf(x) : expf(x);
+}
+
+static inline float FastMath_Logf(float x)
+{
+    return UNLIKELY(fastMathEnabled) ? FastMath_ApproxLogf(x) : logf(x);
+}
+
+static inline float FastMath_Powf(float x, float y)
+{
+    return UNLIKELY(fastMathEnabled) ? FastMath_ApproxPowf(x, y) : powf(x, y);
+}
+
+static inline float FastMath_Sinf(float x)
+{
+    return UNLIKELY(fastMathEnabled) ? FastMath_ApproxSinf(x) : sinf(x);
+}
+
+static inline float FastMath_Cosf(float x)
+{
+    return UNLIKELY(fastMathEnabled) ? FastMath_ApproxCosf(x) : cosf(x);
+}
+
+static inline float FastMath_Tanhf(float x)
+{
+    return UNLIKELY(fastMathEnabled) ? FastMath_ApproxTanhf(x) : tanhf(x);
+}
+
+static inline float FastMath_Atanf(float x)
+{
+    return UNLIKELY(fastMathEnabled) ? FastMath_ApproxAtanf(x) : atanf(x);
+}
+
+static inline float FastMath_Atan2f(float y, float x)
+{
+    return UNLIKELY(fastMathEnabled) ? FastMath_ApproxAtan2f(y, x) :
+                                       atan2f(y, x);
+}
+
+static inline float FastMath_Acosf(float x)
+{
+    return UNLIKELY(fastMathEnabled) ? FastMath_ApproxAcosf(x) : acosf(x);
+}
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _FASTMATH_H_202304151032
@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Compare win rates with and without --fastMath, using the same seed.
+
+LIBM_POP="build/tmp/popLibm.txt";
+FAST_POP="build/tmp/popFastMath.txt";
+
+OPTS="-H"
+OPTS="${OPTS} -l 64"
+OPTS="${OPTS} -s 1"
+OPTS="${OPTS} -R"
+OPTS="${OPTS} -t 4"
+
+./compile.sh develperf
+if [ $? != 0 ]; then exit $? ; fi;
+
+echo 'sr2: libm'
+time build/sr2 $OPTS --dumpPopulation $LIBM_POP "$@" || exit 1;
+
+echo 'sr2: fastMath'
+time build/sr2 $OPTS --dumpPopulation $FAST_POP --fastMath "$@" || exit 1;
+
+echo
+echo 'Win differences (libm < > fastMath):'
+diff <(grep 'abattle.numWins' $LIBM_POP) <(grep 'abattle.numWins' $FAST_POP)
+exit 0
@@ -16,6 +16,9 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "fleet.h"
 #include "Random.h"
 #include "MBVarMap.h"
@@ -29,7 +32,7 @@ typedef struct Fleet {
     MobVector aiMobs;
     MobVector aiSensors;
 
-    BattleScenario bsc;
+    BattleParams bp;
     RandomState rs;
 } Fleet;
 
@@ -102,7 +105,7 @@ Fleet *Fleet_Create(const BattleScenario *bsc,
 
     RandomState_CreateWithSeed(&fleet->rs, seed);
 
-    fleet->bsc = *bsc;
+    fleet->bp = bsc->bp;
 
     fleet->numAIs = bsc->bp.numPlayers;
     fleet->ais = MBUtil_ZAlloc(fleet->numAIs * sizeof(fleet->ais[0]));
@@ -122,7 +125,7 @@ Fleet *Fleet_Create(const BattleScenario *bsc,
                i == PLAYER_ID_NEUTRAL);
 
         Fleet_CreateAI(&fleet->ais[i], bsc->players[i].aiType,
-                       i, &fleet->bsc.bp, &bsc->players[i], seed);
+                       i, &fleet->bp, &bsc->players[i], seed);
     }
 
     MobVector_CreateEmpty(&fleet->aiMobs);
@@ -203,10 +206,120 @@ void Fleet_DestroyAI(FleetAI *ai)
     }
 }
 
+static uint64 FleetHashBytes(uint64 hash, const void *data, uint len)
+{
+    const uint8 *b = data;
+
+    for (uint i = 0; i < len; i++) {
+        hash ^= b[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/*
+ * Fleet_HashBehavior --
+ *    Hash the parameters that decide how a fleet plays, so that fleets
+ *    that would play identically hash the same.
+ *
+ *    Fleets that can dump their sanitized parameters are created once,
+ *    and everything under the prefixes they dump (like "shipNet.") is
+ *    replaced by the sanitized form.  That way the nodes and inputs
+ *    voided out when a NeuralNet is minimized don't count.  The
+ *    abattle.* keys are left out, and numeric values are hashed by value,
+ *    so "1" and "1.000000" are the same.
+ */
+uint64 Fleet_HashBehavior(FleetAIType aiType, MBRegistry *mreg)
+{
+    FleetAIOps ops;
+    MBRegistry *hreg;
+    uint64 hash = 0;
+    uint size;
+
+    hreg = mreg != NULL ? MBRegistry_AllocCopy(mreg) : MBRegistry_Alloc();
+    VERIFY(hreg != NULL);
+
+    Fleet_GetOps(aiType, &ops);
+    if (ops.dumpSanitizedParams != NULL) {
+        MBRegistry *clean = MBRegistry_Alloc();
+        BattleParams bp;
+        BattlePlayer player;
+        FleetAI ai;
+
+        MBUtil_Zero(&bp, sizeof(bp));
+        MBUtil_Zero(&player, sizeof(player));
+        player.aiType = aiType;
+        player.mreg = mreg;
+        Fleet_CreateAI(&ai, aiType, 0, &bp, &player, 0x0);
+        ai.ops.dumpSanitizedParams(ai.aiHandle, clean);
+        Fleet_DestroyAI(&ai);
+
+        size = MBRegistry_NumEntries(clean);
+        for (uint i = 0; i < size; i++) {
+            const char *key = MBRegistry_GetKeyAt(clean, i);
+            const char *dot = strchr(key, '.');
+            char prefix[128];
+            uint len;
+
+            if (dot == NULL) {
+                MBRegistry_Remove(hreg, key);
+                continue;
+            }
+
+            len = dot - key + 1;
+            VERIFY(len < sizeof(prefix));
+            memcpy(prefix, key, len);
+            prefix[len] = '\0';
+            MBRegistry_RemoveAllWithPrefix(hreg, prefix);
+        }
+        for (uint i = 0; i < size; i++) {
+            MBRegistry_PutCopy(hreg, MBRegistry_GetKeyAt(clean, i),
+                               MBRegistry_GetValueAt(clean, i));
+        }
+
+        MBRegistry_Free(clean);
+    }
+
+    /*
+     * Sum the per-key hashes, so the result doesn't depend on the
+     * order of the keys in the registry.
+     */
+    size = MBRegistry_NumEntries(hreg);
+    for (uint i = 0; i < size; i++) {
+        const char *key = MBRegistry_GetKeyAt(hreg, i);
+        const char *value = MBRegistry_GetValueAt(hreg, i);
+        uint64 h = 0xcbf29ce484222325ULL;
+        char *end;
+        double x;
+
+        if (strncmp(key, "abattle.", strlen("abattle.")) == 0) {
+            continue;
+        }
+
+        h = FleetHashBytes(h, key, strlen(key) + 1);
+
+        x = strtod(value, &end);
+        if (value[0] != '\0' && *end == '\0') {
+            if (x == 0.0) {
+                // Don't let -0 and 0 hash differently.
+                x = 0.0;
+            }
+            h = FleetHashBytes(h, &x, sizeof(x));
+        } else {
+            h = FleetHashBytes(h, value, strlen(value) + 1);
+        }
+        hash += h;
+    }
+
+    MBRegistry_Free(hreg);
+
+    return FleetHashBytes(hash, &aiType, sizeof(aiType));
+}
+
 void Fleet_RunTick(Fleet *fleet, const BattleStatus *bs,
                    Mob *mobs, uint32 numMobs)
 {
-    const BattleParams *bp = &fleet->bsc.bp;
+    const BattleParams *bp = &fleet->bp;
 
     /*
      * Make sure the vectors are big enough that we don't
@@ -39,6 +39,7 @@ void Fleet_CreateAI(FleetAI *ai, FleetAIType aiType,
                     PlayerID id, const BattleParams *bp,
                     const BattlePlayer *player, uint64 seed);
 void Fleet_DestroyAI(FleetAI *ai);
+uint64 Fleet_HashBehavior(FleetAIType aiType, MBRegistry *mreg);
 
 Mob *FleetUtil_FindClosestMob(MobPSet *ms, const FPoint *pos, uint filter);
 Mob *FleetUtil_FindClosestMobInRange(MobPSet *ms, const FPoint *pos, uint filter,
@@ -91,12 +92,40 @@ static inline const char *Fleet_GetName(FleetAIType aiType)
 }
 
 
+/*
+ * Fleets can mutate either a Genome or an MBRegistry, and these
+ * convert between the two as needed.
+ */
+static inline void Fleet_MutateGenome(FleetAIType aiType, Genome *g)
+{
+    FleetAIOps ops;
+    Fleet_GetOps(aiType, &ops);
+
+    if (ops.mutateGenome != NULL) {
+        ops.mutateGenome(aiType, g);
+    } else if (ops.mutateParams != NULL) {
+        MBRegistry *mreg = MBRegistry_Alloc();
+        Genome_SaveRegistry(g, mreg);
+        ops.mutateParams(aiType, mreg);
+        Genome_LoadRegistry(g, mreg);
+        MBRegistry_Free(mreg);
+    }
+}
+
 static inline void Fleet_Mutate(FleetAIType aiType, MBRegistry *mreg)
 {
     FleetAIOps ops;
     Fleet_GetOps(aiType, &ops);
 
-    if (ops.mutateParams != NULL) {
+    if (ops.mutateGenome != NULL) {
+        Genome g;
+        Genome_Create(&g);
+        Genome_LoadRegistry(&g, mreg);
+        ops.mutateGenome(aiType, &g);
+        MBRegistry_MakeEmpty(mreg);
+        Genome_SaveRegistry(&g, mreg);
+        Genome_Destroy(&g);
+    } else if (ops.mutateParams != NULL) {
         ops.mutateParams(aiType, mreg);
     }
 }
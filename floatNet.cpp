@@ -39,9 +39,15 @@ void FloatNet::initialize(uint numInputs, uint numOutputs, uint numInnerNodes)
     myValues.resize(myNumNodes);
     myUsedInputs.resize(myNumInputs);
     myUsedOutputs.resize(myNumOutputs);
+    myLiveOutputs.resize(myNumOutputs);
+    myLiveNodes.resize(myNumNodes);
+    myInvariantNodes.resize(myNumNodes);
 
     myUsedInputs.setAll();
     myUsedOutputs.setAll();
+    myLiveOutputs.setAll();
+    myLiveNodes.setAll();
+    myInvariantNodes.resetAll();
 
     ASSERT(!myHaveOutputOrdering);
 
@@ -84,33 +90,53 @@ void FloatNet::loadZeroNet()
 }
 
 void FloatNet::load(MBRegistry *mreg, const char *prefix)
+{
+    Genome g;
+
+    Genome_Create(&g);
+    Genome_LoadRegistryPrefix(&g, mreg, prefix);
+    load(&g, prefix);
+    Genome_Destroy(&g);
+}
+
+void FloatNet::save(MBRegistry *mreg, const char *prefix)
+{
+    Genome g;
+
+    Genome_Create(&g);
+    save(&g, prefix);
+    Genome_SaveRegistry(&g, mreg);
+    Genome_Destroy(&g);
+}
+
+void FloatNet::load(Genome *g, const char *prefix)
 {
     MBString p;
 
     p = prefix;
     p += "numInputs";
-    myNumInputs = MBRegistry_GetUint(mreg, p.CStr());
+    myNumInputs = Genome_GetUint(g, p.CStr());
     if (myNumInputs <= 0) {
         PANIC("Not enough inputs: myNumInputs=%d\n", myNumInputs);
     }
 
     p = prefix;
     p += "numOutputs";
-    myNumOutputs = MBRegistry_GetUint(mreg, p.CStr());
+    myNumOutputs = Genome_GetUint(g, p.CStr());
     if (myNumOutputs <= 0) {
         PANIC("Not enough outputs: myNumOutputs=%d\n", myNumOutputs);
     }
 
     p = prefix;
     p += "numInnerNodes";
-    if (MBRegistry_ContainsKey(mreg, p.CStr())) {
-        uint numInnerNodes = MBRegistry_GetUint(mreg, p.CStr());
+    if (Genome_ContainsKey(g, p.CStr())) {
+        uint numInnerNodes = Genome_GetUint(g, p.CStr());
         VERIFY(numInnerNodes > 0);
         myNumNodes = myNumInputs + numInnerNodes;
     } else {
         p = prefix;
         p += "numNodes";
-        myNumNodes = MBRegistry_GetUint(mreg, p.CStr());
+        myNumNodes = Genome_GetUint(g, p.CStr());
         VERIFY(myNumNodes > 0);
         myNumNodes += myNumInputs;
         VERIFY(myNumNodes >= myNumOutputs);
@@ -130,14 +156,14 @@ void FloatNet::load(MBRegistry *mreg, const char *prefix)
         free(strp);
         strp = NULL;
 
-        myNodes[i].load(mreg, p.CStr());
+        myNodes[i].load(g, p.CStr());
     }
 
     myValues.resize(myNumNodes);
 
     p = prefix;
     p += "haveOutputOrdering";
-    if (MBRegistry_GetBoolD(mreg, p.CStr(), FALSE)) {
+    if (Genome_GetBoolD(g, p.CStr(), FALSE)) {
         myOutputOrdering.resize(myNumOutputs);
         for (uint i = 0; i < myNumOutputs; i++) {
             char *k = NULL;
@@ -145,7 +171,7 @@ void FloatNet::load(MBRegistry *mreg, const char *prefix)
             int ret = asprintf(&k, "%soutput[%d].node", prefix, i);
             VERIFY(ret > 0);
 
-            myOutputOrdering[i] = MBRegistry_GetUint(mreg, k);
+            myOutputOrdering[i] = Genome_GetUint(g, k);
             VERIFY(myOutputOrdering[i] < myNodes.size());
 
             free(k);
@@ -160,75 +186,53 @@ void FloatNet::load(MBRegistry *mreg, const char *prefix)
     checkInvariants();
 }
 
-void FloatNet::save(MBRegistry *mreg, const char *prefix)
+void FloatNet::save(Genome *g, const char *prefix)
 {
     MBString p;
-    char *v = NULL;
-    int ret;
 
     checkInvariants();
 
     p = prefix;
     p += "numInputs";
-    ret = asprintf(&v, "%d", myNumInputs);
-    VERIFY(ret > 0);
-    MBRegistry_PutCopy(mreg, p.CStr(), v);
-    free(v);
-    v = NULL;
+    Genome_PutInt(g, p.CStr(), myNumInputs);
 
     p = prefix;
     p += "numOutputs";
-    ret = asprintf(&v, "%d", myNumOutputs);
-    VERIFY(ret > 0);
-    MBRegistry_PutCopy(mreg, p.CStr(), v);
-    free(v);
-    v = NULL;
+    Genome_PutInt(g, p.CStr(), myNumOutputs);
 
     p = prefix;
     p += "numInnerNodes";
     ASSERT(myNumNodes > myNumInputs);
     ASSERT(myNumNodes == myNodes.size());
-    ret = asprintf(&v, "%d", myNumNodes - myNumInputs);
-    VERIFY(ret > 0);
-    MBRegistry_PutCopy(mreg, p.CStr(), v);
-    free(v);
-    v = NULL;
-
-    checkInvariants();
+    Genome_PutInt(g, p.CStr(), myNumNodes - myNumInputs);
 
     for (uint i = myNumInputs; i < myNodes.size(); i++) {
         char *strp = NULL;
 
         p = prefix;
-        ret = asprintf(&strp, "node[%d].", i);
+        int ret = asprintf(&strp, "node[%d].", i);
         VERIFY(ret > 0);
         p += strp;
         free(strp);
         strp = NULL;
 
         ASSERT(myNodes[i].index == i);
-        myNodes[i].save(mreg, p.CStr());
+        myNodes[i].save(g, p.CStr());
     }
 
     if (myHaveOutputOrdering) {
         p = prefix;
         p += "haveOutputOrdering";
-        MBRegistry_PutCopy(mreg, p.CStr(), "TRUE");
+        Genome_PutBool(g, p.CStr(), TRUE);
 
         for (uint i = 0; i < myNumOutputs; i++) {
             char *k = NULL;
 
-            ret = asprintf(&k, "%soutput[%d].node", prefix, i);
+            int ret = asprintf(&k, "%soutput[%d].node", prefix, i);
             VERIFY(ret > 0);
 
             ASSERT(myOutputOrdering[i] < myNodes.size());
-            ret = asprintf(&v, "%d", myOutputOrdering[i]);
-            VERIFY(ret > 0);
-
-            MBRegistry_PutCopy(mreg, k, v);
-
-            free(v);
-            v = NULL;
+            Genome_PutInt(g, k, myOutputOrdering[i]);
 
             free(k);
             k = NULL;
@@ -323,6 +327,135 @@ void FloatNet::compute(const MBVector<float> &inputs,
     }
 }
 
+/*
+ * markLiveNodes --
+ *    Walk the net backwards from the live outputs to find every node
+ *    (including input nodes) that they depend on.
+ */
+void FloatNet::markLiveNodes(const CPBitVector &liveOutputs)
+{
+    ASSERT(liveOutputs.size() == myNumOutputs);
+    ASSERT(myLiveNodes.size() == myNumNodes);
+    ASSERT(myNodes.size() == myNumNodes);
+
+    myLiveOutputs = liveOutputs;
+    myLiveNodes.resetAll();
+
+    for (uint i = 0; i < myNumOutputs; i++) {
+        if (myLiveOutputs.get(i)) {
+            myLiveNodes.set(getOutputNode(i));
+        }
+    }
+
+    for (uint i = myNodes.size(); i-- > myNumInputs;) {
+        MLFloatNode *n = &myNodes[i];
+
+        if (!myLiveNodes.get(i)) {
+            continue;
+        }
+
+        for (uint in = 0; in < n->inputs.size(); in++) {
+            uint ni = n->inputs[in];
+
+            if (UNLIKELY(ni >= i)) {
+                /*
+                 * The backwards walk relies on nodes only referencing
+                 * earlier nodes, so if a loaded net doesn't follow that,
+                 * just evaluate everything.
+                 */
+                myLiveNodes.setAll();
+                return;
+            }
+            myLiveNodes.set(ni);
+        }
+    }
+}
+
+
+void FloatNet::computeLive(const MBVector<float> &inputs,
+                           MBVector<float> &outputs)
+{
+    ASSERT(inputs.size() == myNumInputs);
+    ASSERT(outputs.size() == myNumOutputs);
+    ASSERT(myNodes.size() == myNumNodes);
+    ASSERT(myValues.size() == myNumNodes);
+
+    for (uint i = 0; i < myNumInputs; i++) {
+        if (!myInvariantNodes.get(i)) {
+            myValues[i] = myLiveNodes.get(i) ? inputs[i] : 0.0f;
+        }
+    }
+
+    uint size = myNodes.size();
+    for (uint i = myNumInputs; i < size; i++) {
+        if (myLiveNodes.get(i) && !myInvariantNodes.get(i)) {
+            myValues[i] = myNodes[i].compute(myValues);
+        }
+    }
+
+    for (uint i = 0; i < myNumOutputs; i++) {
+        if (myLiveOutputs.get(i)) {
+            uint vi = getOutputNode(i);
+            ASSERT(vi < myValues.size());
+            outputs[i] = myValues[vi];
+        } else {
+            outputs[i] = 0.0f;
+        }
+    }
+}
+
+/*
+ * markInvariantNodes --
+ *    Find the nodes whose value only depends on invariant inputs
+ *    (or on nothing at all).
+ */
+void FloatNet::markInvariantNodes(const CPBitVector &invariantInputs)
+{
+    ASSERT(invariantInputs.size() == myNumInputs);
+    ASSERT(myInvariantNodes.size() == myNumNodes);
+    ASSERT(myNodes.size() == myNumNodes);
+
+    for (uint i = 0; i < myNumInputs; i++) {
+        myInvariantNodes.put(i, invariantInputs.get(i) || myNodes[i].isVoid());
+    }
+
+    for (uint i = myNumInputs; i < myNodes.size(); i++) {
+        MLFloatNode *n = &myNodes[i];
+        bool invariant = TRUE;
+
+        for (uint in = 0; in < n->inputs.size(); in++) {
+            uint ni = n->inputs[in];
+            if (ni >= i || !myInvariantNodes.get(ni)) {
+                invariant = FALSE;
+                break;
+            }
+        }
+
+        myInvariantNodes.put(i, invariant);
+    }
+}
+
+
+void FloatNet::computeInvariant(const MBVector<float> &inputs)
+{
+    ASSERT(inputs.size() == myNumInputs);
+    ASSERT(myValues.size() == myNumNodes);
+
+    for (uint i = 0; i < myNumInputs; i++) {
+        if (myInvariantNodes.get(i)) {
+            myValues[i] = inputs[i];
+        }
+    }
+
+    uint size = myNodes.size();
+    for (uint i = myNumInputs; i < size; i++) {
+        if (myInvariantNodes.get(i)) {
+            myValues[i] = myNodes[i].compute(myValues);
+        }
+    }
+}
+
+
 void FloatNet::constantFolding()
 {
     CPBitVector bv;
@@ -22,6 +22,7 @@
 #include "MBTypes.h"
 #include "MBVector.hpp"
 #include "MBRegistry.h"
+#include "genome.h"
 #include "ml.hpp"
 #include "BitVector.hpp"
 
@@ -42,10 +43,37 @@ class FloatNet
 
         void compute(const MBVector<float> &inputs, MBVector<float> &outputs);
 
+        /*
+         * Demand-driven evaluation: markLiveNodes computes the set of
+         * nodes needed by the requested outputs, and computeLive only
+         * evaluates those nodes.  Outputs that aren't live are zero.
+         */
+        void markLiveNodes(const CPBitVector &liveOutputs);
+        void computeLive(const MBVector<float> &inputs,
+                         MBVector<float> &outputs);
+        bool isInputLive(uint i) {
+            ASSERT(i < myNumInputs);
+            return myLiveNodes.get(i);
+        }
+
+        /*
+         * Partial evaluation: nodes that only depend on invariant inputs
+         * can be computed once with computeInvariant, and are then
+         * skipped by computeLive until the next call.
+         */
+        void markInvariantNodes(const CPBitVector &invariantInputs);
+        void computeInvariant(const MBVector<float> &inputs);
+        bool isInputInvariant(uint i) {
+            ASSERT(i < myNumInputs);
+            return myInvariantNodes.get(i);
+        }
+
         void load(MBRegistry *mreg, const char *prefix);
+        void load(Genome *g, const char *prefix);
         void loadZeroNet();
         void mutate(float rate, uint maxNodeDegree, uint maxNodes);
         void save(MBRegistry *mreg, const char *prefix);
+        void save(Genome *g, const char *prefix);
 
         void minimize();
 
@@ -91,6 +119,9 @@ class FloatNet
 
         CPBitVector myUsedInputs;
         CPBitVector myUsedOutputs;
+        CPBitVector myLiveOutputs;
+        CPBitVector myLiveNodes;
+        CPBitVector myInvariantNodes;
 
         uint myNumInputs;
         uint myNumOutputs;
@@ -102,6 +133,17 @@ class FloatNet
 
         void constantFolding();
         void reachableNodes();
+
+        uint getOutputNode(uint i) {
+            ASSERT(i < myNumOutputs);
+            if (myHaveOutputOrdering) {
+                ASSERT(myOutputOrdering.size() == myNumOutputs);
+                return myOutputOrdering[i];
+            } else {
+                ASSERT(myNodes.size() >= myNumOutputs);
+                return i + myNodes.size() - myNumOutputs;
+            }
+        }
 };
 
 #endif // _FLOATNET_H_202208121158
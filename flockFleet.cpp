@@ -806,6 +806,20 @@ public:
         this->myConfig.locusRandomPeriod =
             (uint)MBRegistry_GetFloat(mreg, "locusRandomPeriod");
 
+        /*
+         * The flocking forces only look at friends, and the separate
+         * radius can grow by up to separateScale.
+         */
+        float separateRadius = this->myConfig.separateRadius;
+        if (this->myConfig.separatePeriod > 0.0f &&
+            this->myConfig.separateScale > 0.0f) {
+            separateRadius += this->myConfig.separateScale;
+        }
+        mySensorGrid->useNeighborRadius(this->myConfig.flockRadius, TRUE);
+        mySensorGrid->useNeighborRadius(separateRadius, TRUE);
+        mySensorGrid->useNeighborRadius(this->myConfig.attackSeparateRadius,
+                                        TRUE);
+
         this->BasicAIGovernor::loadRegistry(mreg);
     }
 
@@ -1274,22 +1288,41 @@ FlockFleetSeparate(AIContext *aic,
                    float radius, float weight) {
     ASSERT(mob->type == MOB_TYPE_FIGHTER);
     SensorGrid *sg = aic->sg;
-
-    MobSet::MobIt mit = sg->friendsIterator(MOB_FLAG_FIGHTER);
     FRPoint repulseVec;
 
     repulseVec.radius = 0.0f;
     repulseVec.theta = 0.0f;
 
-    while (mit.hasNext()) {
-        Mob *f = mit.next();
-        ASSERT(f != NULL);
+    if (radius <= 0.0f) {
+        /*
+         * The neighborhood cache is empty for these, but a zero radius
+         * still repulses fighters sitting on top of this one.
+         */
+        MobSet::MobIt mit = sg->friendsIterator(MOB_FLAG_FIGHTER);
+
+        while (mit.hasNext()) {
+            Mob *f = mit.next();
+            ASSERT(f != NULL);
+
+            if (f->mobid != mob->mobid &&
+                FPoint_Distance(&f->pos, &mob->pos) <= radius) {
+                FlockFleetRepulseVector(aic, &repulseVec, &f->pos,
+                                        &mob->pos, radius);
+            }
+        }
+    } else {
+        MBVector<Mob *> &friends = sg->neighbors(&mob->pos, radius, TRUE);
 
+        for (uint i = 0; i < friends.size(); i++) {
+            Mob *f = friends[i];
+            ASSERT(f != NULL);
 
-        if (f->mobid != mob->mobid &&
-            FPoint_Distance(&f->pos, &mob->pos) <= radius) {
-            FlockFleetRepulseVector(aic, &repulseVec, &f->pos,
-                                    &mob->pos, radius);
+            if (f->type == MOB_TYPE_FIGHTER &&
+                f->mobid != mob->mobid &&
+                FPoint_Distance(&f->pos, &mob->pos) <= radius) {
+                FlockFleetRepulseVector(aic, &repulseVec, &f->pos,
+                                        &mob->pos, radius);
+            }
         }
     }
 
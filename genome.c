@@ -0,0 +1,671 @@
+/*
+ * genome.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "genome.h"
+#include "MBUtil.h"
+#include "Random.h"
+
+static void GenomeEntryClearValue(GenomeEntry *e)
+{
+    free(e->str);
+    e->str = NULL;
+    free(e->floats);
+    e->floats = NULL;
+    free(e->uints);
+    e->uints = NULL;
+    e->numValues = 0;
+    e->f = 0.0f;
+    e->i = 0;
+    e->type = GENOME_VALUE_STR;
+}
+
+static void GenomeEntryDestroy(GenomeEntry *e)
+{
+    GenomeEntryClearValue(e);
+    free(e->key);
+    e->key = NULL;
+}
+
+static void GenomeEntryCopyValue(GenomeEntry *dest, const GenomeEntry *src)
+{
+    GenomeEntryClearValue(dest);
+
+    dest->type = src->type;
+    dest->f = src->f;
+    dest->i = src->i;
+    dest->numValues = src->numValues;
+
+    if (src->str != NULL) {
+        dest->str = strdup(src->str);
+    }
+    if (src->floats != NULL) {
+        uint size = src->numValues * sizeof(src->floats[0]);
+        dest->floats = malloc(MAX(1, size));
+        memcpy(dest->floats, src->floats, size);
+    }
+    if (src->uints != NULL) {
+        uint size = src->numValues * sizeof(src->uints[0]);
+        dest->uints = malloc(MAX(1, size));
+        memcpy(dest->uints, src->uints, size);
+    }
+}
+
+static int GenomeFormatElement(const GenomeEntry *e, uint i,
+                               char *buf, size_t size)
+{
+    if (e->type == GENOME_VALUE_FLOATS) {
+        return snprintf(buf, size, "%f, ", e->floats[i]);
+    } else {
+        return snprintf(buf, size, "%d, ", e->uints[i]);
+    }
+}
+
+/*
+ * GenomeEntryFormat --
+ *    Regenerate the text form of the value if it's been modified.
+ */
+static void GenomeEntryFormat(GenomeEntry *e)
+{
+    char *str = NULL;
+    int ret;
+
+    if (e->str != NULL) {
+        return;
+    }
+
+    if (e->type == GENOME_VALUE_FLOAT) {
+        ret = asprintf(&str, "%f", e->f);
+        VERIFY(ret > 0);
+    } else if (e->type == GENOME_VALUE_INT) {
+        ret = asprintf(&str, "%d", e->i);
+        VERIFY(ret > 0);
+    } else if (e->type == GENOME_VALUE_FLOATS ||
+               e->type == GENOME_VALUE_UINTS) {
+        /*
+         * Match the TextDump vector format.  Large floats take a lot of
+         * digits with %f, so size the string before writing it.
+         */
+        size_t len = 0;
+        size_t cap = 3;
+
+        for (uint i = 0; i < e->numValues; i++) {
+            ret = GenomeFormatElement(e, i, NULL, 0);
+            VERIFY(ret > 0);
+            cap += ret;
+        }
+
+        str = malloc(cap);
+        VERIFY(str != NULL);
+        str[len++] = '{';
+        for (uint i = 0; i < e->numValues; i++) {
+            ret = GenomeFormatElement(e, i, &str[len], cap - len);
+            VERIFY(ret > 0 && ret < cap - len);
+            len += ret;
+        }
+        str[len++] = '}';
+        str[len] = '\0';
+    } else {
+        NOT_REACHED();
+    }
+
+    e->str = str;
+}
+
+/*
+ * GenomeParseVector --
+ *    Parse a vector the same way TextDump_Convert does, so values
+ *    read through a Genome match values read from the registry.
+ */
+static uint GenomeParseVector(const char *str, bool isFloat,
+                              float *floats, uint *uints)
+{
+    uint n = 0;
+    uint i = 0;
+
+    if (str == NULL) {
+        return 0;
+    }
+
+    while (str[i] != '\0') {
+        uint start;
+
+        if (isFloat) {
+            while (str[i] != '\0' && !isdigit(str[i]) && str[i] != '.') {
+                i++;
+            }
+            start = i;
+            while (isdigit(str[i]) || str[i] == '.') {
+                i++;
+            }
+        } else {
+            while (str[i] != '\0' && !isdigit(str[i])) {
+                i++;
+            }
+            start = i;
+            while (isdigit(str[i])) {
+                i++;
+            }
+        }
+
+        if (i > start) {
+            if (floats != NULL) {
+                floats[n] = atof(&str[start]);
+            } else if (uints != NULL) {
+                uints[n] = atoi(&str[start]);
+            }
+            n++;
+        }
+    }
+
+    return n;
+}
+
+static int GenomeFind(const Genome *g, const char *key, bool *found)
+{
+    int lo = 0;
+    int hi = (int)g->numEntries - 1;
+
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = strcmp(g->entries[mid].key, key);
+
+        if (c == 0) {
+            *found = TRUE;
+            return mid;
+        } else if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    *found = FALSE;
+    return lo;
+}
+
+static GenomeEntry *GenomeLookup(const Genome *g, const char *key)
+{
+    bool found;
+    int i = GenomeFind(g, key, &found);
+    return found ? &g->entries[i] : NULL;
+}
+
+/*
+ * GenomeGetEntry --
+ *    Find or create the entry for key.  New entries have no value.
+ */
+static GenomeEntry *GenomeGetEntry(Genome *g, const char *key)
+{
+    bool found;
+    int i = GenomeFind(g, key, &found);
+
+    if (found) {
+        return &g->entries[i];
+    }
+
+    if (g->numEntries >= g->capacity) {
+        g->capacity = MAX(64, g->capacity * 2);
+        g->entries = realloc(g->entries,
+                             g->capacity * sizeof(g->entries[0]));
+        VERIFY(g->entries != NULL);
+    }
+
+    memmove(&g->entries[i + 1], &g->entries[i],
+            (g->numEntries - i) * sizeof(g->entries[0]));
+    g->numEntries++;
+
+    MBUtil_Zero(&g->entries[i], sizeof(g->entries[i]));
+    g->entries[i].key = strdup(key);
+    g->entries[i].type = GENOME_VALUE_STR;
+    return &g->entries[i];
+}
+
+void Genome_Create(Genome *g)
+{
+    MBUtil_Zero(g, sizeof(*g));
+}
+
+void Genome_Destroy(Genome *g)
+{
+    Genome_MakeEmpty(g);
+    free(g->entries);
+    MBUtil_Zero(g, sizeof(*g));
+}
+
+void Genome_MakeEmpty(Genome *g)
+{
+    for (uint i = 0; i < g->numEntries; i++) {
+        GenomeEntryDestroy(&g->entries[i]);
+    }
+    g->numEntries = 0;
+}
+
+void Genome_Copy(Genome *dest, const Genome *src)
+{
+    ASSERT(dest != src);
+    Genome_MakeEmpty(dest);
+
+    if (dest->capacity < src->numEntries) {
+        dest->capacity = src->numEntries;
+        dest->entries = realloc(dest->entries,
+                                dest->capacity * sizeof(dest->entries[0]));
+        VERIFY(dest->entries != NULL);
+    }
+
+    for (uint i = 0; i < src->numEntries; i++) {
+        GenomeEntry *e = &dest->entries[i];
+        MBUtil_Zero(e, sizeof(*e));
+        e->key = strdup(src->entries[i].key);
+        GenomeEntryCopyValue(e, &src->entries[i]);
+    }
+    dest->numEntries = src->numEntries;
+}
+
+void Genome_LoadRegistry(Genome *g, MBRegistry *mreg)
+{
+    Genome_LoadRegistryPrefix(g, mreg, "");
+}
+
+void Genome_LoadRegistryPrefix(Genome *g, MBRegistry *mreg,
+                               const char *prefix)
+{
+    uint size = MBRegistry_NumEntries(mreg);
+    uint prefixLen = strlen(prefix);
+
+    Genome_MakeEmpty(g);
+
+    for (uint i = 0; i < size; i++) {
+        const char *key = MBRegistry_GetKeyAt(mreg, i);
+
+        if (strncmp(key, prefix, prefixLen) == 0) {
+            Genome_PutCStr(g, key, MBRegistry_GetValueAt(mreg, i));
+        }
+    }
+}
+
+void Genome_SaveRegistry(Genome *g, MBRegistry *mreg)
+{
+    for (uint i = 0; i < g->numEntries; i++) {
+        GenomeEntry *e = &g->entries[i];
+        GenomeEntryFormat(e);
+        MBRegistry_PutCopy(mreg, e->key, e->str);
+    }
+}
+
+bool Genome_ContainsKey(const Genome *g, const char *key)
+{
+    return GenomeLookup(g, key) != NULL;
+}
+
+void Genome_Remove(Genome *g, const char *key)
+{
+    bool found;
+    int i = GenomeFind(g, key, &found);
+
+    if (!found) {
+        return;
+    }
+
+    GenomeEntryDestroy(&g->entries[i]);
+    memmove(&g->entries[i], &g->entries[i + 1],
+            (g->numEntries - i - 1) * sizeof(g->entries[0]));
+    g->numEntries--;
+}
+
+void Genome_RemoveAllWithPrefix(Genome *g, const char *prefix)
+{
+    uint len = strlen(prefix);
+    bool found;
+    uint start = GenomeFind(g, prefix, &found);
+    uint end = start;
+
+    /*
+     * Everything with the prefix sorts into one contiguous run.
+     */
+    while (end < g->numEntries &&
+           strncmp(g->entries[end].key, prefix, len) == 0) {
+        GenomeEntryDestroy(&g->entries[end]);
+        end++;
+    }
+
+    memmove(&g->entries[start], &g->entries[end],
+            (g->numEntries - end) * sizeof(g->entries[0]));
+    g->numEntries -= end - start;
+}
+
+const char *Genome_GetCStr(Genome *g, const char *key)
+{
+    GenomeEntry *e = GenomeLookup(g, key);
+
+    if (e == NULL) {
+        return NULL;
+    }
+
+    GenomeEntryFormat(e);
+    return e->str;
+}
+
+float Genome_GetFloat(Genome *g, const char *key)
+{
+    GenomeEntry *e = GenomeLookup(g, key);
+
+    if (e == NULL) {
+        return 0.0f;
+    } else if (e->type == GENOME_VALUE_FLOAT) {
+        return e->f;
+    } else if (e->type == GENOME_VALUE_INT) {
+        return e->i;
+    }
+
+    GenomeEntryFormat(e);
+    if (e->type == GENOME_VALUE_STR) {
+        e->f = atof(e->str);
+        e->type = GENOME_VALUE_FLOAT;
+        return e->f;
+    }
+    return atof(e->str);
+}
+
+int Genome_GetInt(Genome *g, const char *key)
+{
+    GenomeEntry *e = GenomeLookup(g, key);
+
+    if (e == NULL) {
+        return 0;
+    } else if (e->type == GENOME_VALUE_INT) {
+        return e->i;
+    } else if (e->type == GENOME_VALUE_FLOAT) {
+        return (int)e->f;
+    }
+
+    GenomeEntryFormat(e);
+    if (e->type == GENOME_VALUE_STR && strchr(e->str, '.') == NULL) {
+        e->i = atoi(e->str);
+        e->type = GENOME_VALUE_INT;
+        return e->i;
+    }
+    return (int)atof(e->str);
+}
+
+bool Genome_GetBoolD(Genome *g, const char *key, bool defValue)
+{
+    const char *str = Genome_GetCStr(g, key);
+
+    if (str == NULL) {
+        return defValue;
+    }
+
+    if (strcasecmp(str, "TRUE") == 0) {
+        return TRUE;
+    } else if (strcasecmp(str, "FALSE") == 0) {
+        return FALSE;
+    }
+    return atoi(str) != 0;
+}
+
+bool Genome_GetBool(Genome *g, const char *key)
+{
+    return Genome_GetBoolD(g, key, FALSE);
+}
+
+const float *Genome_GetFloats(Genome *g, const char *key, uint *numValues)
+{
+    GenomeEntry *e = GenomeLookup(g, key);
+
+    *numValues = 0;
+    if (e == NULL) {
+        return NULL;
+    }
+
+    if (e->type != GENOME_VALUE_FLOATS) {
+        float *floats;
+        uint n;
+
+        GenomeEntryFormat(e);
+        n = GenomeParseVector(e->str, TRUE, NULL, NULL);
+        floats = malloc(MAX(1, n * sizeof(floats[0])));
+        GenomeParseVector(e->str, TRUE, floats, NULL);
+
+        /*
+         * Keep the text, since it still matches.
+         */
+        free(e->floats);
+        free(e->uints);
+        e->uints = NULL;
+        e->floats = floats;
+        e->numValues = n;
+        e->type = GENOME_VALUE_FLOATS;
+    }
+
+    *numValues = e->numValues;
+    return e->floats;
+}
+
+const uint *Genome_GetUints(Genome *g, const char *key, uint *numValues)
+{
+    GenomeEntry *e = GenomeLookup(g, key);
+
+    *numValues = 0;
+    if (e == NULL) {
+        return NULL;
+    }
+
+    if (e->type != GENOME_VALUE_UINTS) {
+        uint *uints;
+        uint n;
+
+        GenomeEntryFormat(e);
+        n = GenomeParseVector(e->str, FALSE, NULL, NULL);
+        uints = malloc(MAX(1, n * sizeof(uints[0])));
+        GenomeParseVector(e->str, FALSE, NULL, uints);
+
+        free(e->floats);
+        free(e->uints);
+        e->floats = NULL;
+        e->uints = uints;
+        e->numValues = n;
+        e->type = GENOME_VALUE_UINTS;
+    }
+
+    *numValues = e->numValues;
+    return e->uints;
+}
+
+void Genome_PutCStr(Genome *g, const char *key, const char *value)
+{
+    GenomeEntry *e = GenomeGetEntry(g, key);
+
+    ASSERT(value != NULL);
+
+    if (e->str != NULL && strcmp(e->str, value) == 0) {
+        return;
+    }
+
+    GenomeEntryClearValue(e);
+    e->str = strdup(value);
+}
+
+void Genome_PutFloat(Genome *g, const char *key, float value)
+{
+    GenomeEntry *e = GenomeGetEntry(g, key);
+
+    if (e->type == GENOME_VALUE_FLOAT && e->f == value) {
+        return;
+    }
+
+    GenomeEntryClearValue(e);
+    e->type = GENOME_VALUE_FLOAT;
+    e->f = value;
+}
+
+void Genome_PutInt(Genome *g, const char *key, int value)
+{
+    GenomeEntry *e = GenomeGetEntry(g, key);
+
+    if (e->type == GENOME_VALUE_INT && e->i == value) {
+        return;
+    }
+
+    GenomeEntryClearValue(e);
+    e->type = GENOME_VALUE_INT;
+    e->i = value;
+}
+
+void Genome_PutFloats(Genome *g, const char *key,
+                      const float *values, uint numValues)
+{
+    GenomeEntry *e = GenomeGetEntry(g, key);
+
+    if (e->type == GENOME_VALUE_FLOATS && e->numValues == numValues &&
+        memcmp(e->floats, values, numValues * sizeof(values[0])) == 0) {
+        return;
+    }
+
+    GenomeEntryClearValue(e);
+    e->type = GENOME_VALUE_FLOATS;
+    e->numValues = numValues;
+    e->floats = malloc(MAX(1, numValues * sizeof(values[0])));
+    memcpy(e->floats, values, numValues * sizeof(values[0]));
+}
+
+void Genome_PutUints(Genome *g, const char *key,
+                     const uint *values, uint numValues)
+{
+    GenomeEntry *e = GenomeGetEntry(g, key);
+
+    if (e->type == GENOME_VALUE_UINTS && e->numValues == numValues &&
+        memcmp(e->uints, values, numValues * sizeof(values[0])) == 0) {
+        return;
+    }
+
+    GenomeEntryClearValue(e);
+    e->type = GENOME_VALUE_UINTS;
+    e->numValues = numValues;
+    e->uints = malloc(MAX(1, numValues * sizeof(values[0])));
+    memcpy(e->uints, values, numValues * sizeof(values[0]));
+}
+
+void Genome_Crossover(Genome *dest, const Genome *breeder)
+{
+    ASSERT(dest != breeder);
+
+    for (uint i = 0; i < breeder->numEntries; i++) {
+        if (Random_Bit()) {
+            const GenomeEntry *be = &breeder->entries[i];
+            GenomeEntry *de = GenomeGetEntry(dest, be->key);
+            GenomeEntryCopyValue(de, be);
+        }
+    }
+}
+
+void Genome_UnitTest(void)
+{
+    MBRegistry *mreg = MBRegistry_Alloc();
+    MBRegistry *out = MBRegistry_Alloc();
+    Genome g, g2;
+    const float *fv;
+    const uint *uv;
+    uint n;
+
+    MBRegistry_PutCopy(mreg, "b.radius", "12.500000");
+    MBRegistry_PutCopy(mreg, "a.useBase", "TRUE");
+    MBRegistry_PutCopy(mreg, "c.index", "-1");
+    MBRegistry_PutCopy(mreg, "c.fn.node[3].params", "{1.500000, 2.000000, }");
+    MBRegistry_PutCopy(mreg, "c.fn.node[3].inputs", "{1, 2, 0, }");
+    MBRegistry_PutCopy(mreg, "c.fn.node[3].op", "ML_FOP_1x0_IDENTITY");
+
+    Genome_Create(&g);
+    Genome_Create(&g2);
+    Genome_LoadRegistry(&g, mreg);
+
+    VERIFY(Genome_NumEntries(&g) == 6);
+    VERIFY(strcmp(Genome_GetKeyAt(&g, 0), "a.useBase") == 0);
+    VERIFY(Genome_GetBool(&g, "a.useBase"));
+    VERIFY(!Genome_GetBool(&g, "missing"));
+    VERIFY(Genome_GetBoolD(&g, "missing", TRUE));
+    VERIFY(Genome_GetFloat(&g, "b.radius") == 12.5f);
+    VERIFY(Genome_GetInt(&g, "c.index") == -1);
+    VERIFY(Genome_GetFloat(&g, "missing") == 0.0f);
+    VERIFY(Genome_GetCStr(&g, "missing") == NULL);
+
+    fv = Genome_GetFloats(&g, "c.fn.node[3].params", &n);
+    VERIFY(n == 2 && fv[0] == 1.5f && fv[1] == 2.0f);
+    uv = Genome_GetUints(&g, "c.fn.node[3].inputs", &n);
+    VERIFY(n == 3 && uv[0] == 1 && uv[1] == 2 && uv[2] == 0);
+
+    /*
+     * Unmodified values keep their exact text.
+     */
+    Genome_SaveRegistry(&g, out);
+    VERIFY(strcmp(MBRegistry_GetCStr(out, "c.fn.node[3].params"),
+                  "{1.500000, 2.000000, }") == 0);
+    VERIFY(strcmp(MBRegistry_GetCStr(out, "c.index"), "-1") == 0);
+
+    float nfv[] = { 3.0f, 0.25f };
+    uint nuv[] = { 4 };
+    Genome_PutFloats(&g, "c.fn.node[3].params", nfv, ARRAYSIZE(nfv));
+    Genome_PutUints(&g, "c.fn.node[3].inputs", nuv, ARRAYSIZE(nuv));
+    Genome_PutFloat(&g, "b.radius", 3.0f);
+    Genome_PutInt(&g, "c.index", 7);
+    Genome_PutBool(&g, "a.useBase", FALSE);
+    Genome_SaveRegistry(&g, out);
+    VERIFY(strcmp(MBRegistry_GetCStr(out, "c.fn.node[3].params"),
+                  "{3.000000, 0.250000, }") == 0);
+    VERIFY(strcmp(MBRegistry_GetCStr(out, "c.fn.node[3].inputs"),
+                  "{4, }") == 0);
+    VERIFY(MBRegistry_GetFloat(out, "b.radius") == 3.0f);
+    VERIFY(MBRegistry_GetInt(out, "c.index") == 7);
+    VERIFY(!MBRegistry_GetBool(out, "a.useBase"));
+
+    Genome_Copy(&g2, &g);
+    VERIFY(Genome_NumEntries(&g2) == Genome_NumEntries(&g));
+    Genome_RemoveAllWithPrefix(&g2, "c.fn.");
+    VERIFY(Genome_NumEntries(&g2) == 3);
+    VERIFY(Genome_ContainsKey(&g2, "c.index"));
+    VERIFY(!Genome_ContainsKey(&g2, "c.fn.node[3].op"));
+    Genome_Remove(&g2, "c.index");
+    VERIFY(!Genome_ContainsKey(&g2, "c.index"));
+
+    Genome_Crossover(&g2, &g);
+    for (uint i = 0; i < Genome_NumEntries(&g2); i++) {
+        const char *key = Genome_GetKeyAt(&g2, i);
+        VERIFY(Genome_ContainsKey(&g, key));
+    }
+
+    Genome_LoadRegistryPrefix(&g2, mreg, "c.fn.");
+    VERIFY(Genome_NumEntries(&g2) == 3);
+    VERIFY(Genome_ContainsKey(&g2, "c.fn.node[3].op"));
+    VERIFY(!Genome_ContainsKey(&g2, "c.index"));
+
+    /*
+     * Huge floats take far more digits than usual with %f.
+     */
+    float bigfv[] = { 3.0e38f, -3.0e38f, 0.5f };
+    Genome_PutFloats(&g2, "c.fn.node[3].params", bigfv, ARRAYSIZE(bigfv));
+    VERIFY(strlen(Genome_GetCStr(&g2, "c.fn.node[3].params")) > 80);
+
+    Genome_Destroy(&g);
+    Genome_Destroy(&g2);
+    MBRegistry_Free(mreg);
+    MBRegistry_Free(out);
+}
@@ -0,0 +1,151 @@
+/*
+ * genome.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GENOME_H_202304221406
+#define _GENOME_H_202304221406
+
+#include "MBTypes.h"
+#include "MBAssert.h"
+#include "MBRegistry.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * A Genome holds a fleet's parameters in memory while it's being
+ * mutated or bred.
+ *
+ * It uses the same keys as the fleet's MBRegistry, but keeps the values
+ * in binary form once they've been touched, so the mutation code can
+ * update floats and FloatNet vectors without formatting and re-parsing
+ * text each time.  The text form is only regenerated for values that
+ * changed, when the Genome is saved back to a registry.
+ *
+ * Entries are kept sorted by key.
+ */
+
+typedef enum GenomeValueType {
+    GENOME_VALUE_STR,
+    GENOME_VALUE_FLOAT,
+    GENOME_VALUE_INT,
+    GENOME_VALUE_FLOATS,
+    GENOME_VALUE_UINTS,
+} GenomeValueType;
+
+typedef struct GenomeEntry {
+    char *key;
+
+    /*
+     * The text form of the value, or NULL if the binary value has
+     * changed since it was last formatted.
+     */
+    char *str;
+
+    GenomeValueType type;
+    float f;
+    int i;
+    uint numValues;
+    float *floats;
+    uint *uints;
+} GenomeEntry;
+
+typedef struct Genome {
+    GenomeEntry *entries;
+    uint numEntries;
+    uint capacity;
+} Genome;
+
+void Genome_Create(Genome *g);
+void Genome_Destroy(Genome *g);
+void Genome_MakeEmpty(Genome *g);
+void Genome_Copy(Genome *dest, const Genome *src);
+
+void Genome_LoadRegistry(Genome *g, MBRegistry *mreg);
+
+/*
+ * Load only the registry entries whose keys start with prefix, keeping
+ * the prefix on the keys.
+ */
+void Genome_LoadRegistryPrefix(Genome *g, MBRegistry *mreg,
+                               const char *prefix);
+
+void Genome_SaveRegistry(Genome *g, MBRegistry *mreg);
+
+static inline uint Genome_NumEntries(const Genome *g)
+{
+    return g->numEntries;
+}
+
+static inline const char *Genome_GetKeyAt(const Genome *g, uint i)
+{
+    ASSERT(i < g->numEntries);
+    return g->entries[i].key;
+}
+
+bool Genome_ContainsKey(const Genome *g, const char *key);
+void Genome_Remove(Genome *g, const char *key);
+void Genome_RemoveAllWithPrefix(Genome *g, const char *prefix);
+
+/*
+ * Missing keys read as NULL, zero, or FALSE.
+ */
+const char *Genome_GetCStr(Genome *g, const char *key);
+float Genome_GetFloat(Genome *g, const char *key);
+int Genome_GetInt(Genome *g, const char *key);
+bool Genome_GetBool(Genome *g, const char *key);
+bool Genome_GetBoolD(Genome *g, const char *key, bool defValue);
+
+static inline uint Genome_GetUint(Genome *g, const char *key)
+{
+    int i = Genome_GetInt(g, key);
+    return i < 0 ? 0 : (uint)i;
+}
+
+/*
+ * Vectors use the TextDump "{a, b, c, }" format in the registry.
+ * The returned pointer is only valid until the Genome is next modified.
+ */
+const float *Genome_GetFloats(Genome *g, const char *key, uint *numValues);
+const uint *Genome_GetUints(Genome *g, const char *key, uint *numValues);
+
+void Genome_PutCStr(Genome *g, const char *key, const char *value);
+void Genome_PutFloat(Genome *g, const char *key, float value);
+void Genome_PutInt(Genome *g, const char *key, int value);
+void Genome_PutFloats(Genome *g, const char *key,
+                      const float *values, uint numValues);
+void Genome_PutUints(Genome *g, const char *key,
+                     const uint *values, uint numValues);
+
+static inline void Genome_PutBool(Genome *g, const char *key, bool value)
+{
+    Genome_PutCStr(g, key, value ? "TRUE" : "FALSE");
+}
+
+/*
+ * Randomly copy about half of the breeder's entries into dest.
+ */
+void Genome_Crossover(Genome *dest, const Genome *breeder);
+
+void Genome_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _GENOME_H_202304221406
@@ -17,6 +17,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <math.h>
 
@@ -39,6 +40,16 @@
 #include "mutate.h"
 #include "MBStrTable.h"
 #include "MBUnitTest.h"
+#include "fastMath.h"
+#include "population.h"
+#include "battleCache.h"
+#include "resultLog.h"
+#include "affinity.h"
+#include "schedule.h"
+#include "checkpoint.h"
+#include "workerPool.h"
+#include "rating.h"
+#include "serve.h"
 
 // From ml.hpp
 extern void ML_UnitTest();
@@ -58,6 +69,12 @@ typedef enum MainBattleType {
      * Run every fleet 1x1 against each other fleet.
      */
     MAIN_BT_TOURNAMENT,
+
+    /*
+     * Run the current round of pairings for a rated tournament, in both
+     * seat orders.
+     */
+    MAIN_BT_RATED,
 } MainBattleType;
 
 typedef enum MainEngineWorkType {
@@ -66,17 +83,69 @@ typedef enum MainEngineWorkType {
     MAIN_WORK_BATTLE  = 2,
 } MainEngineWorkType;
 
+/*
+ * The work and result units only carry what's particular to one battle.
+ * The scenario itself is rebuilt from its index in mainData.scenarios,
+ * which doesn't change until every queued battle has finished.
+ */
 typedef struct MainEngineWorkUnit {
     MainEngineWorkType type;
     uint battleId;
+    uint bscIndex;
+    uint loopIndex;
     uint64 seed;
-    BattleScenario bsc;
+    bool cacheable;
+    BattleCacheKey cacheKey;
+    float predictedMS;
+
+    /*
+     * This battle's copy of each player's registry, freed by the
+     * engine thread.
+     */
+    MBRegistry **mregs;
 } MainEngineWorkUnit;
 
 typedef struct MainEngineResultUnit {
-    BattleStatus bs;
+    uint bscIndex;
+    uint loopIndex;
+    bool finished;
+    uint tick;
+
+    /*
+     * The winner's seat in the scenario, and its PlayerUID.
+     */
+    PlayerID winner;
+    PlayerUID winnerUID;
+
+    /*
+     * For the result log.
+     */
+    uint64 seed;
+    uint collisions;
+    uint sensorContacts;
+    uint spawns;
+    uint shipSpawns;
+
+    bool cached;
+    bool cacheable;
+    BattleCacheKey cacheKey;
+
+    /*
+     * How long the battle took to run, if it was run.
+     */
+    bool timed;
+    uint32 durationMS;
+    float predictedMS;
 } MainEngineResultUnit;
 
+/*
+ * Each thread has its own slot in the WorkQueues: the main thread
+ * queues battles and collects results from slot 0, and each engine
+ * thread uses the slot after its threadId.
+ */
+#define MAIN_QUEUE_SLOT 0
+#define MAIN_THREAD_QUEUE_SLOT(_threadId) ((_threadId) + 1)
+
 typedef struct MainWinnerData {
     uint battles;
     uint wins;
@@ -84,6 +153,37 @@ typedef struct MainWinnerData {
     uint draws;
 } MainWinnerData;
 
+/*
+ * The winner breakdown, with an entry for each pair of fleets that have
+ * fought, keyed by their PlayerUIDs.  Most pairs in a large population
+ * never meet, so this only grows with the battles actually run.
+ */
+typedef struct MainBreakdownEntry {
+    uint64 key;
+    MainWinnerData wd;
+} MainBreakdownEntry;
+
+typedef struct MainBreakdownData {
+    uint numEntries;
+    uint capacity;
+    MainBreakdownEntry *table;
+} MainBreakdownData;
+
+typedef struct MainDedupeEntry {
+    FleetAIType aiType;
+    uint64 behaviorHash;
+    uint index;
+} MainDedupeEntry;
+
+/*
+ * Fleets by behavior, for finding duplicates (--dedupe).  Empty slots
+ * have a behaviorHash of 0.
+ */
+typedef struct MainDedupeTable {
+    uint capacity;
+    MainDedupeEntry *table;
+} MainDedupeTable;
+
 typedef struct MainEngineThreadData {
     uint threadId;
     SDL_Thread *sdlThread;
@@ -92,9 +192,121 @@ typedef struct MainEngineThreadData {
     uint battleId;
     uint64 seed;
     BattleScenario bsc;
+    uint maxPlayers;
     Battle *battle;
+
+    /*
+     * Where the thread was placed by --affinity, with -1 for anywhere.
+     */
+    int cpu;
+    uint node;
 } MainEngineThreadData;
 
+typedef enum MainSprtDecision {
+    MAIN_SPRT_UNDECIDED = 0,
+    MAIN_SPRT_PASS,
+    MAIN_SPRT_FAIL,
+} MainSprtDecision;
+
+/*
+ * Sequential probability ratio test for stopping a target fleet's
+ * battles once its win rate is known to be on one side of the
+ * defective level.
+ *
+ * H0 is a win rate of p0 = defectiveLevel - delta, and H1 is a win rate
+ * of p1 = defectiveLevel + delta.  Draws count as non-wins, like the
+ * win ratio used by kill.
+ */
+typedef struct MainSprtData {
+    bool enabled;
+    float alpha;
+    float beta;
+    float llrWin;
+    float llrNonWin;
+    float lowerBound;
+    float upperBound;
+    uint numDecided;
+
+    /*
+     * One for each player, sized along with mainData.players.  Written
+     * by the main thread as results come in, and read by the engine
+     * threads to skip queued battles.
+     */
+    volatile MainSprtDecision *decision;
+} MainSprtData;
+
+/*
+ * Common random numbers: every target plays each control on the same
+ * set of seeds, from both seats, so the results for two targets can be
+ * compared battle by battle.
+ *
+ * A cell is one (control, seat order, seed) combination, and outcomes
+ * holds the result of each target in each cell.  The targets and cells
+ * are numbered the same way as the optimize scenarios.
+ */
+typedef enum MainCrnOutcome {
+    MAIN_CRN_MISSING = 0,
+    MAIN_CRN_WIN,
+    MAIN_CRN_NON_WIN,
+} MainCrnOutcome;
+
+typedef struct MainCrnData {
+    bool enabled;
+    bool paired;
+
+    uint numTargets;
+    uint numCells;
+    uint8 *outcomes;
+} MainCrnData;
+
+/*
+ * How many times to re-mutate a fleet that came out as a duplicate.
+ */
+#define MAIN_DEDUPE_MAX_RETRIES 8
+
+/*
+ * Default z-score for dropping clear losers when racing a screen.
+ */
+#define MAIN_RACE_DEFAULT_Z (1.0f)
+
+/*
+ * The battle scenarios for a run.
+ *
+ * They aren't stored, since optimize and tournament runs have a scenario
+ * for every pair of fleets.  Instead, the players in each seat are
+ * worked out from the scenario's index (see MainScenarioSeat) as the
+ * battles are queued.
+ */
+typedef struct MainScenarioData {
+    MainBattleType bt;
+    BattleParams bp;
+    uint numScenarios;
+
+    /*
+     * For optimize, as indices into mainData.players: each target plays
+     * each control, from each seating.
+     */
+    uint seatings;
+    uint numTargets;
+    uint numControls;
+    uint *targets;
+    uint *controls;
+
+    /*
+     * Scratch space for the main thread to build a scenario in.
+     */
+    BattleScenario mainBsc;
+} MainScenarioData;
+
+/*
+ * A population held in memory between the stages of evolve.
+ */
+typedef struct MainPopulation {
+    uint numFleets;
+    uint maxFleets;
+    BattlePlayer *fleets;
+} MainPopulation;
+
 struct MainData {
     bool headless;
     bool frameSkip;
@@ -109,31 +321,61 @@ struct MainData {
     bool reuseSeed;
     uint64 seed;
     RandomState rs;
+    uint64 runSeed;
+    uint numRuns;
 
-    uint numBSCs;
-    BattleScenario *bscs;
-    uint maxBscs;
+    MainScenarioData scenarios;
 
     uint totalBattles;
     bool doneQueueing;
 
+    /*
+     * Indexed by PlayerUID, and grown by MainReservePlayers.
+     */
     uint numPlayers;
-    BattlePlayer players[MAX_PLAYERS];
-    MainWinnerData winners[MAX_PLAYERS];
-    MainWinnerData winnerBreakdown[MAX_PLAYERS][MAX_PLAYERS];
+    uint maxPlayers;
+    BattlePlayer *players;
+    MainWinnerData *winners;
+    MainBreakdownData winnerBreakdown;
 
     bool threadsInitialized;
     bool threadsRequestExit;
     uint numThreads;
+    uint queueSpin;
+    AffinityPolicy affinity;
     MainEngineThreadData *tData;
     WorkQueue workQ;
     WorkQueue resultQ;
+    uint numWorkers;
+    WorkerPool workers;
+    MainEngineThreadData workerData;
+
+    MainSprtData sprt;
+    MainCrnData crn;
+    bool useRating;
+    Rating rating;
+    bool useSchedule;
+    Schedule sched;
+    bool useCheckpoint;
+    Checkpoint ckpt;
+
+    bool useResultCache;
+    BattleCache resultCache;
+
+    bool useResultLog;
+    ResultLog resultLog;
+
+    bool dedupe;
+    uint numDuplicates;
+
+    Serve serve;
 
     volatile bool asyncExit;
 } mainData;
 
 static void MainRunBattle(MainEngineThreadData *tData,
-                          MainEngineWorkUnit *wu);
+                          MainEngineWorkUnit *wu,
+                          MainEngineResultUnit *ru);
 static void MainLoadScenario(MBRegistry *mreg, const char *scenario);
 
 static void MainAddTargetPlayersForOptimize(void);
@@ -162,9 +404,72 @@ static void MainThreadsExit(void);
 
 static void MainProcessSingleResult(MainEngineResultUnit *ru);
 static void MainPrintWinners(void);
+static bool MainSprtIsDecided(uint bscIndex);
+static void MainSprtUpdate(PlayerUID puid);
+static MainWinnerData *MainBreakdownFind(PlayerUID puid1, PlayerUID puid2,
+                                         bool create);
+static void MainBreakdownReset(void);
+static bool MainUseCachedResult(MainEngineWorkUnit *wu);
+static uint64 MainCostMix(uint64 a, uint64 b);
+static void MainDedupeBegin(MainDedupeTable *dt, uint n);
+static void MainDedupeEnd(MainDedupeTable *dt);
+static uint MainDedupeAdd(MainDedupeTable *dt, const BattlePlayer *player,
+                          uint index);
+
+/*
+ * MainReservePlayers --
+ *    Make room for at least n players, along with everything else that's
+ *    indexed by player.  This moves the players, so it can't be called
+ *    while battles are running.
+ */
+static void MainReservePlayers(uint n)
+{
+    uint oldMax = mainData.maxPlayers;
+    uint newMax;
+
+    if (n <= oldMax) {
+        return;
+    }
+
+    newMax = MAX(n, MAX(64, 2 * oldMax));
+
+    mainData.players = realloc(mainData.players,
+                               newMax * sizeof(mainData.players[0]));
+    mainData.winners = realloc(mainData.winners,
+                               newMax * sizeof(mainData.winners[0]));
+    mainData.sprt.decision =
+        realloc((void *)mainData.sprt.decision,
+                newMax * sizeof(mainData.sprt.decision[0]));
+    VERIFY(mainData.players != NULL);
+    VERIFY(mainData.winners != NULL);
+    VERIFY(mainData.sprt.decision != NULL);
+
+    MBUtil_Zero(&mainData.players[oldMax],
+                (newMax - oldMax) * sizeof(mainData.players[0]));
+    MBUtil_Zero(&mainData.winners[oldMax],
+                (newMax - oldMax) * sizeof(mainData.winners[0]));
+    MBUtil_Zero((void *)&mainData.sprt.decision[oldMax],
+                (newMax - oldMax) * sizeof(mainData.sprt.decision[0]));
+
+    mainData.maxPlayers = newMax;
+}
+
+static void MainFreePlayers(void)
+{
+    free(mainData.players);
+    free(mainData.winners);
+    free((void *)mainData.sprt.decision);
+    mainData.players = NULL;
+    mainData.winners = NULL;
+    mainData.sprt.decision = NULL;
+    mainData.numPlayers = 0;
+    mainData.maxPlayers = 0;
+}
 
 static void MainAddNeutralPlayer(void)
 {
+    MainReservePlayers(1);
+
     if (mainData.numPlayers > 0) {
         ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
     } else {
@@ -194,7 +499,7 @@ static void MainLoadAllAsControlPlayers(void)
         FleetAIType aiType = Fleet_GetTypeFromRanking(i);
         if (aiType != FLEET_AI_INVALID) {
             ASSERT(Fleet_GetRanking(aiType) == i);
-            ASSERT(mainData.numPlayers < ARRAYSIZE(mainData.players));
+            MainReservePlayers(mainData.numPlayers + 1);
             mainData.players[mainData.numPlayers].aiType = aiType;
             mainData.players[mainData.numPlayers].playerType = PLAYER_TYPE_CONTROL;
             mainData.numPlayers++;
@@ -214,6 +519,8 @@ static void MainLoadDefaultPlayers(void)
         MainUsePopulation(MBOpt_GetCStr("usePopulation"), TRUE);
     } else {
         uint p = mainData.numPlayers;
+        MainReservePlayers(p + 4);
+
         /*
          * See fleet.c::gRankings for a rough order of fleet strength.
          */
@@ -239,42 +546,157 @@ static void MainLoadDefaultPlayers(void)
         //MBRegistry_PutConst(mainData.players[p].mreg, "holdCount", "1");
         //p++;
 
-        ASSERT(p <= ARRAYSIZE(mainData.players));
+        ASSERT(p <= mainData.maxPlayers);
         mainData.numPlayers = p;
     }
 }
 
+/*
+ * MainScenarioNumPlayers --
+ *    The number of seats in every scenario of the current run.
+ */
+static uint MainScenarioNumPlayers(void)
+{
+    if (mainData.scenarios.bt == MAIN_BT_SINGLE) {
+        return mainData.numPlayers;
+    }
+    return 3;
+}
+
+/*
+ * MainScenarioSeat --
+ *    Find which of mainData.players sits in the given seat of scenario
+ *    bscIndex.
+ */
+static uint MainScenarioSeat(uint bscIndex, uint seat)
+{
+    MainScenarioData *sd = &mainData.scenarios;
+
+    ASSERT(bscIndex < sd->numScenarios);
+    ASSERT(seat < MainScenarioNumPlayers());
+
+    if (sd->bt == MAIN_BT_SINGLE || seat == PLAYER_ID_NEUTRAL) {
+        return seat;
+    }
+
+    if (sd->bt == MAIN_BT_OPTIMIZE) {
+        uint perTarget = sd->numControls * sd->seatings;
+        uint t = bscIndex / perTarget;
+        uint c = (bscIndex % perTarget) / sd->seatings;
+        uint s = bscIndex % sd->seatings;
+        uint tSeat = s == 0 ? 1 : 2;
+
+        return seat == tSeat ? sd->targets[t] : sd->controls[c];
+    } else if (sd->bt == MAIN_BT_TOURNAMENT) {
+        /*
+         * Every fleet plays each of the others, skipping the neutral
+         * fleet and itself.
+         */
+        uint numOpponents = mainData.numPlayers - 2;
+        uint x = 1 + bscIndex / numOpponents;
+        uint y = 1 + bscIndex % numOpponents;
+
+        if (y >= x) {
+            y++;
+        }
+        return seat == 1 ? x : y;
+    } else {
+        uint i = bscIndex / 2;
+        uint s = bscIndex % 2;
+
+        ASSERT(sd->bt == MAIN_BT_RATED);
+        ASSERT(i < mainData.rating.numPairs);
+        return seat == 1 ? mainData.rating.pairs[i][s] :
+                           mainData.rating.pairs[i][1 - s];
+    }
+}
+
+static uint MainScheduleSeat(void *cbData, uint bscIndex, uint seat)
+{
+    return MainScenarioSeat(bscIndex, seat);
+}
+
+/*
+ * MainScenarioBuild --
+ *    Fill in scenario bscIndex, with room in bsc->players for
+ *    MainScenarioNumPlayers players.  The players share their
+ *    registries with mainData.players.
+ */
+static void MainScenarioBuild(uint bscIndex, BattleScenario *bsc)
+{
+    uint numPlayers = MainScenarioNumPlayers();
+
+    bsc->bp = mainData.scenarios.bp;
+    bsc->bp.numPlayers = numPlayers;
+
+    for (uint p = 0; p < numPlayers; p++) {
+        uint i = MainScenarioSeat(bscIndex, p);
+        ASSERT(i < mainData.numPlayers);
+        bsc->players[p] = mainData.players[i];
+    }
+}
+
+/*
+ * MainScenarioTargetIndex --
+ *    Which of the optimize targets plays in scenario bscIndex.
+ */
+static uint MainScenarioTargetIndex(uint bscIndex)
+{
+    MainScenarioData *sd = &mainData.scenarios;
+
+    ASSERT(sd->bt == MAIN_BT_OPTIMIZE);
+    return bscIndex / (sd->numControls * sd->seatings);
+}
+
+/*
+ * MainDestroyScenarios --
+ *    Free everything MainConstructScenarios allocated.
+ */
+static void MainDestroyScenarios(void)
+{
+    MainScenarioData *sd = &mainData.scenarios;
+
+    free(sd->targets);
+    free(sd->controls);
+    free(sd->mainBsc.players);
+    MBUtil_Zero(sd, sizeof(*sd));
+}
+
 static void MainConstructScenarios(bool loadPlayers, MainBattleType bt)
 {
+    MainScenarioData *sd = &mainData.scenarios;
     MBRegistry *mreg = MBRegistry_Alloc();
-    BattleScenario bsc;
 
     MainLoadScenario(mreg, NULL);
     if (mainData.scenario != NULL) {
         MainLoadScenario(mreg, mainData.scenario);
     }
 
-    MBUtil_Zero(&bsc, sizeof(bsc));
-
-    bsc.bp.width = MBRegistry_GetUint(mreg, "width");
-    bsc.bp.height = MBRegistry_GetUint(mreg, "height");
-    bsc.bp.startingCredits = MBRegistry_GetUint(mreg, "startingCredits");
-    bsc.bp.creditsPerTick = MBRegistry_GetUint(mreg, "creditsPerTick");
-    bsc.bp.tickLimit = MBRegistry_GetUint(mreg, "tickLimit");
-    bsc.bp.powerCoreDropRate = MBRegistry_GetFloat(mreg, "powerCoreDropRate");
-    bsc.bp.powerCoreSpawnRate = MBRegistry_GetFloat(mreg, "powerCoreSpawnRate");
-    bsc.bp.minPowerCoreSpawn = MBRegistry_GetUint(mreg, "minPowerCoreSpawn");
-    bsc.bp.maxPowerCoreSpawn = MBRegistry_GetUint(mreg, "maxPowerCoreSpawn");
-    bsc.bp.restrictedStart = MBRegistry_GetBool(mreg, "restrictedStart");
-    bsc.bp.startingBases = MBRegistry_GetUint(mreg, "startingBases");
-    bsc.bp.startingFighters = MBRegistry_GetUint(mreg, "startingFighters");
-    bsc.bp.baseVictory = MBRegistry_GetBool(mreg, "baseVictory");
+    ASSERT(sd->targets == NULL);
+    ASSERT(sd->controls == NULL);
+    ASSERT(sd->mainBsc.players == NULL);
+    MBUtil_Zero(sd, sizeof(*sd));
+    sd->bt = bt;
+
+    sd->bp.width = MBRegistry_GetUint(mreg, "width");
+    sd->bp.height = MBRegistry_GetUint(mreg, "height");
+    sd->bp.startingCredits = MBRegistry_GetUint(mreg, "startingCredits");
+    sd->bp.creditsPerTick = MBRegistry_GetUint(mreg, "creditsPerTick");
+    sd->bp.tickLimit = MBRegistry_GetUint(mreg, "tickLimit");
+    sd->bp.powerCoreDropRate = MBRegistry_GetFloat(mreg, "powerCoreDropRate");
+    sd->bp.powerCoreSpawnRate = MBRegistry_GetFloat(mreg, "powerCoreSpawnRate");
+    sd->bp.minPowerCoreSpawn = MBRegistry_GetUint(mreg, "minPowerCoreSpawn");
+    sd->bp.maxPowerCoreSpawn = MBRegistry_GetUint(mreg, "maxPowerCoreSpawn");
+    sd->bp.restrictedStart = MBRegistry_GetBool(mreg, "restrictedStart");
+    sd->bp.startingBases = MBRegistry_GetUint(mreg, "startingBases");
+    sd->bp.startingFighters = MBRegistry_GetUint(mreg, "startingFighters");
+    sd->bp.baseVictory = MBRegistry_GetBool(mreg, "baseVictory");
 
     MBRegistry_Free(mreg);
     mreg = NULL;
 
     if (mainData.tickLimit != 0) {
-        bsc.bp.tickLimit = mainData.tickLimit;
+        sd->bp.tickLimit = mainData.tickLimit;
     }
 
     if (loadPlayers) {
@@ -298,1533 +720,3697 @@ static void MainConstructScenarios(bool loadPlayers, MainBattleType bt)
     }
 
     if (bt == MAIN_BT_OPTIMIZE) {
-        mainData.maxBscs = p * p + 1;
-        ASSERT(mainData.maxBscs > p);
-        ASSERT(mainData.maxBscs > p * p);
-        ASSERT(mainData.maxBscs * sizeof(mainData.bscs[0]) > mainData.maxBscs);
-        mainData.bscs = malloc(sizeof(mainData.bscs[0]) * mainData.maxBscs);
-
-        mainData.numBSCs = 0;
+        sd->seatings = mainData.crn.enabled ? 2 : 1;
+        sd->targets = malloc(sizeof(sd->targets[0]) * p);
+        sd->controls = malloc(sizeof(sd->controls[0]) * p);
+        VERIFY(sd->targets != NULL);
+        VERIFY(sd->controls != NULL);
 
         ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
 
-        for (uint ti = 0; ti < p; ti++) {
-            if (mainData.players[ti].playerType != PLAYER_TYPE_TARGET) {
-                continue;
-            }
-
-            for (uint ci = 0; ci < p; ci++) {
-                if (mainData.players[ci].playerType != PLAYER_TYPE_CONTROL) {
+        MainDedupeTable dt;
+        MainDedupeBegin(&dt, p);
+        mainData.numDuplicates = 0;
+        for (uint i = 0; i < p; i++) {
+            if (mainData.players[i].playerType == PLAYER_TYPE_CONTROL) {
+                sd->controls[sd->numControls++] = i;
+            } else if (mainData.players[i].playerType == PLAYER_TYPE_TARGET) {
+                if (MainDedupeAdd(&dt, &mainData.players[i], i) < i) {
+                    /*
+                     * This fleet plays the same as an earlier one, so it
+                     * gets that fleet's results instead of its own
+                     * battles.
+                     */
+                    mainData.numDuplicates++;
                     continue;
                 }
-
-                uint b = mainData.numBSCs++;
-                ASSERT(b < mainData.maxBscs);
-                mainData.bscs[b].bp = bsc.bp;
-                mainData.bscs[b].bp.numPlayers = 3;
-                ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
-                mainData.bscs[b].players[0] = mainData.players[0];
-                mainData.bscs[b].players[1] = mainData.players[ti];
-                ASSERT(mainData.players[ti].playerType == PLAYER_TYPE_TARGET);
-                mainData.bscs[b].players[2] = mainData.players[ci];
-                ASSERT(mainData.players[ci].playerType == PLAYER_TYPE_CONTROL);
+                sd->targets[sd->numTargets++] = i;
             }
         }
+        MainDedupeEnd(&dt);
 
-        ASSERT(mainData.numBSCs <= mainData.maxBscs);
-    } else if (bt == MAIN_BT_TOURNAMENT) {
-        // This is too big, but it works.
-        mainData.maxBscs = mainData.numPlayers * mainData.numPlayers;
-        mainData.bscs = malloc(sizeof(mainData.bscs[0]) * mainData.maxBscs);
-
-        mainData.numBSCs = 0;
-        for (uint x = 1; x < mainData.numPlayers; x++) {
+        sd->numScenarios = sd->numTargets * sd->numControls * sd->seatings;
 
+        if (mainData.crn.enabled) {
+            mainData.crn.paired = TRUE;
+            mainData.crn.numTargets = sd->numTargets;
+            mainData.crn.numCells = sd->numControls * sd->seatings;
+        }
+    } else if (bt == MAIN_BT_TOURNAMENT) {
+        for (uint x = 1; x < p; x++) {
             ASSERT(mainData.players[x].playerType == PLAYER_TYPE_CONTROL);
-
-            for (uint y = 1; y < mainData.numPlayers; y++) {
-                if (x == y) {
-                    continue;
-                }
-
-                uint b = mainData.numBSCs++;
-                mainData.bscs[b].bp = bsc.bp;
-                mainData.bscs[b].bp.numPlayers = 3;
-                ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
-                mainData.bscs[b].players[0] = mainData.players[0];
-                mainData.bscs[b].players[1] = mainData.players[x];
-                mainData.bscs[b].players[2] = mainData.players[y];
-            }
         }
-
-        ASSERT(mainData.numBSCs <= mainData.maxBscs);
+        sd->numScenarios = (p - 1) * (p - 2);
+    } else if (bt == MAIN_BT_RATED) {
+        ASSERT(mainData.useRating);
+        sd->numScenarios = 2 * mainData.rating.numPairs;
     } else {
         ASSERT(bt == MAIN_BT_SINGLE);
-
-        mainData.numBSCs = 1;
-        mainData.bscs = malloc(sizeof(mainData.bscs[0]));
-        mainData.bscs[0] = bsc;
-        ASSERT(sizeof(mainData.players) ==
-               sizeof(mainData.bscs[0].players));
-        mainData.bscs[0].bp.numPlayers = mainData.numPlayers;
-        memcpy(&mainData.bscs[0].players, &mainData.players,
-               sizeof(mainData.players));
+        sd->numScenarios = 1;
     }
+
+    sd->mainBsc.players = malloc(MainScenarioNumPlayers() *
+                                 sizeof(sd->mainBsc.players[0]));
+    VERIFY(sd->mainBsc.players != NULL);
 }
 
-static void MainRunScenarios(void)
+static uint64 MainMixSeed(uint64 z, uint64 n)
 {
-    if (!mainData.headless) {
-        if (mainData.numThreads != 1) {
-            PANIC("Multiple threads requires --headless\n");
-        }
-        if (mainData.numBSCs != 1) {
-            PANIC("Multiple scenarios requries --headless\n");
-        }
-        if (mainData.loop != 1) {
-            PANIC("Multiple battles requires --headless\n");
-        }
-        Display_Init(&mainData.bscs[0]);
-        Display_SetFPS(mainData.targetFPS);
+    // splitmix64
+    z += n * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
 
+/*
+ * MainBattleSeed --
+ *    The seed for battle number n of the current run.  Seeds depend only
+ *    on the run seed and the number, so skipping, reordering or resuming
+ *    battles doesn't change the seeds of the others.
+ */
+static uint64 MainBattleSeed(uint64 n)
+{
+    if (n == 0) {
+        return mainData.runSeed;
     }
 
-    ASSERT(mainData.numBSCs > 0);
-    ASSERT(mainData.loop > 0);
-    ASSERT(mainData.numThreads > 0);
+    return MainMixSeed(mainData.runSeed, n);
+}
 
-    mainData.totalBattles = mainData.loop * mainData.numBSCs;
-    mainData.numThreads = MAX(1, mainData.numThreads);
-    mainData.numThreads = MIN(mainData.totalBattles, mainData.numThreads);
-    MainThreadsInit();
+/*
+ * MainUsingResultCache --
+ *    Whether battle results are being looked up in the --resultCache.
+ */
+static bool MainUsingResultCache(void)
+{
+    return mainData.useResultCache && mainData.headless;
+}
 
-    uint battleId = 0;
+/*
+ * MainCacheBattleSeed --
+ *    The seed for a battle when the result cache is in use.  It depends
+ *    only on the command's seed, the fleets in their seats and the loop
+ *    index, not on the run or the scenario number, so a matchup that
+ *    comes up again (like a stable fleet against the same screens in a
+ *    later evolve generation) gets the same seed and hits the cache.
+ */
+static uint64 MainCacheBattleSeed(uint bscIndex, uint loopIndex)
+{
+    uint64 baseSeed = RandomState_GetSeed(&mainData.rs);
+    BattleScenario *bsc = &mainData.scenarios.mainBsc;
 
-    WorkQueue_Lock(&mainData.workQ);
-    for (uint i = 0; i < mainData.loop; i++) {
-        for (uint b = 0; b < mainData.numBSCs; b++) {
-            MainEngineWorkUnit wu;
-            MBUtil_Zero(&wu, sizeof(wu));
-            wu.bsc = mainData.bscs[b];
+    if (mainData.crn.enabled) {
+        /*
+         * CRN needs every scenario in a loop iteration to share a seed.
+         */
+        return MainMixSeed(baseSeed, loopIndex);
+    }
 
-            for (uint p = 0; p < wu.bsc.bp.numPlayers; p++) {
-                if (wu.bsc.players[p].mreg != NULL) {
-                    wu.bsc.players[p].mreg =
-                        MBRegistry_AllocCopy(wu.bsc.players[p].mreg);
-                }
-            }
+    MainScenarioBuild(bscIndex, bsc);
+    return BattleCache_MakeSeed(bsc, baseSeed, loopIndex);
+}
 
-            wu.type = MAIN_WORK_BATTLE;
-            wu.battleId = battleId++;
+/*
+ * MainPrintCrnStats --
+ *    Compare every target against the best one, using the difference in
+ *    their results on each cell they both played.
+ */
+static void MainPrintCrnStats(void)
+{
+    uint numCells = mainData.crn.numCells * mainData.loop;
+    uint numTargets = mainData.crn.numTargets;
+    const uint8 *outcomes = mainData.crn.outcomes;
+    const char **names;
+    float bestScore = -1.0f;
+    uint best = 0;
+
+    if (numTargets == 0 || numCells == 0) {
+        return;
+    }
 
-            if ((i == 0 && b == 0) || mainData.reuseSeed) {
-                /*
-                 * Use the actual seed for the first battle, so that it's
-                 * easy to re-create a single battle from the battle seed
-                 * without specifying --reuseSeed.
-                 */
-                wu.seed = RandomState_GetSeed(&mainData.rs);
-            } else {
-                wu.seed = RandomState_Uint64(&mainData.rs);
+    names = calloc(numTargets, sizeof(names[0]));
+    VERIFY(names != NULL);
+    ASSERT(numTargets == mainData.scenarios.numTargets);
+    for (uint t = 0; t < numTargets; t++) {
+        uint i = mainData.scenarios.targets[t];
+        names[t] = mainData.players[i].playerName;
+    }
+
+    for (uint t = 0; t < numTargets; t++) {
+        uint wins = 0;
+        uint n = 0;
+        for (uint c = 0; c < numCells; c++) {
+            uint8 o = outcomes[t * numCells + c];
+            if (o != MAIN_CRN_MISSING) {
+                n++;
+                wins += o == MAIN_CRN_WIN;
             }
+        }
+        if (n > 0 && wins / (float)n > bestScore) {
+            bestScore = wins / (float)n;
+            best = t;
+        }
+    }
 
-            Warning("Queueing Battle %d of %d...\n", wu.battleId,
-                    mainData.totalBattles);
-            WorkQueue_QueueItemLocked(&mainData.workQ, &wu, sizeof(wu));
+    Warning("\n");
+    Warning("Paired comparison against %s:\n", names[best]);
 
-            if ((battleId + 1) % mainData.numThreads == 0) {
-                WorkQueue_Unlock(&mainData.workQ);
-                uint workTarget = MAX(10, mainData.numThreads * 4);
+    for (uint t = 0; t < numTargets; t++) {
+        float sum = 0.0f;
+        float sumSq = 0.0f;
+        uint n = 0;
 
-                /*
-                 * Try to process the results as they come in, to reduce
-                 * memory usage.
-                 */
-                while (!WorkQueue_IsEmpty(&mainData.resultQ) &&
-                       !WorkQueue_IsCountBelow(&mainData.workQ, workTarget)) {
-                    MainEngineResultUnit ru;
-                    WorkQueue_WaitForItem(&mainData.resultQ, &ru, sizeof(ru));
-                    MainProcessSingleResult(&ru);
-                }
+        if (t == best) {
+            continue;
+        }
 
-                WorkQueue_WaitForCountBelow(&mainData.workQ, workTarget);
-                WorkQueue_Lock(&mainData.workQ);
+        for (uint c = 0; c < numCells; c++) {
+            uint8 ob = outcomes[best * numCells + c];
+            uint8 ot = outcomes[t * numCells + c];
+            if (ob != MAIN_CRN_MISSING && ot != MAIN_CRN_MISSING) {
+                float d = (ot == MAIN_CRN_WIN) - (ob == MAIN_CRN_WIN);
+                sum += d;
+                sumSq += d * d;
+                n++;
             }
         }
-    }
-    WorkQueue_Unlock(&mainData.workQ);
-    Warning("Done Queueing\n");
-    mainData.doneQueueing = TRUE;
 
-    if (!mainData.headless) {
-        Display_Main(mainData.startPaused);
-        mainData.asyncExit = TRUE;
-        Display_Exit();
-    }
+        Warning("Fleet: %s\n", names[t]);
+        if (n < 2) {
+            Warning("\t%3d paired battles\n", n);
+            continue;
+        }
 
-    WorkQueue_WaitForAllFinished(&mainData.workQ);
-    ASSERT(WorkQueue_IsIdle(&mainData.workQ));
-    MainThreadsRequestExit();
+        float mean = sum / n;
+        float var = (sumSq - n * mean * mean) / (n - 1);
+        float se = sqrtf(MAX(0.0f, var) / n);
 
-    WorkQueue_Lock(&mainData.resultQ);
-    uint qSize = WorkQueue_QueueSize(&mainData.resultQ);
-    for (uint i = 0; i < qSize; i++) {
-        MainEngineResultUnit ru;
-        WorkQueue_GetItemLocked(&mainData.resultQ, &ru, sizeof(ru));
-        MainProcessSingleResult(&ru);
+        if (se > 0.0f) {
+            Warning("\t%3d paired battles => %+5.1f%% +/- %4.1f%% (z=%.2f)\n",
+                    n, 100.0f * mean, 100.0f * se, mean / se);
+        } else {
+            Warning("\t%3d paired battles => %+5.1f%% (identical)\n",
+                    n, 100.0f * mean);
+        }
     }
-    WorkQueue_Unlock(&mainData.resultQ);
-    ASSERT(WorkQueue_IsEmpty(&mainData.resultQ));
 
-    MainPrintWinners();
+    free(names);
+}
 
-    free(mainData.bscs);
-    mainData.bscs = NULL;
+static void MainDedupeBegin(MainDedupeTable *dt, uint n)
+{
+    dt->capacity = 16;
+    while (dt->capacity < 2 * n) {
+        dt->capacity *= 2;
+    }
+    dt->table = calloc(dt->capacity, sizeof(dt->table[0]));
+    VERIFY(dt->table != NULL);
+}
 
-    MainThreadsExit();
+static void MainDedupeEnd(MainDedupeTable *dt)
+{
+    free(dt->table);
+    dt->table = NULL;
+    dt->capacity = 0;
 }
 
-static void
-MainAddTargetPlayersForOptimize(void)
+/*
+ * MainDedupeAdd --
+ *    Return the index of the fleet already in the table with the same
+ *    behavior as player.  If there isn't one, add player under index and
+ *    return index.  Only target fleets count as duplicates.
+ */
+static uint MainDedupeAdd(MainDedupeTable *dt, const BattlePlayer *player,
+                          uint index)
 {
-    const int doSimple = 0;
-    const int doSystematic = 1;
-    const int doTable = 2;
-    const int doRandom = 3;
-    int method;
-    BattlePlayer targetPlayers[MAX_PLAYERS];
-    uint32 tpIndex = 0;
-    BattlePlayer *mainPlayers = &mainData.players[0];
-    uint32 mpSize = ARRAYSIZE(mainData.players);
-    uint32 *mpIndex = &mainData.numPlayers;
+    if (!mainData.dedupe || player->behaviorHash == 0 ||
+        player->playerType != PLAYER_TYPE_TARGET) {
+        return index;
+    }
 
-    ASSERT(Fleet_GetTypeFromRanking(-1) == FLEET_AI_INVALID);
-    ASSERT(Fleet_GetTypeFromRanking(FLEET_AI_MAX) == FLEET_AI_INVALID);
+    uint h = MainCostMix(player->aiType, player->behaviorHash) &
+             (dt->capacity - 1);
 
-    /*
-     * Target fleets to optimize.
-     * Customize as needed.
-     */
-    method = doSimple;
-    if (method == doSimple) {
-        targetPlayers[tpIndex].aiType = FLEET_AI_FLOCK9;
-        targetPlayers[tpIndex].playerName = "FlockFleet9.Test";
+    while (dt->table[h].behaviorHash != 0) {
+        if (dt->table[h].aiType == player->aiType &&
+            dt->table[h].behaviorHash == player->behaviorHash) {
+            return dt->table[h].index;
+        }
+        h = (h + 1) & (dt->capacity - 1);
+    }
 
-        // targetPlayers[tpIndex].mreg = MBRegistry_Alloc();
-        // int keep[] = { 0, 2, 18, 24 };
-        // int drop[] = {1, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 19, 20, 21, 22, 23};
-        // for (uint i = 0; i <= 24; i++) {
-        //     char *cstr;
-        //     int ret;
-        //     // bool doKeep = FALSE;
-        //     bool doDrop = FALSE;
-        //     // for (uint k = 0; k < ARRAYSIZE(keep); k++) {
-        //     //     if (i == keep[k]) {
-        //     //         doKeep = TRUE;
-        //     //     }
-        //     // }
-        //     for (uint k = 0; k < ARRAYSIZE(drop); k++) {
-        //         if (i == drop[k]) {
-        //             doDrop = TRUE;
-        //         }
-        //     }
-        //     if (doDrop) {
-        //         ret = asprintf(&cstr, "shipNet.output[%d].valueType", i);
-        //         VERIFY(ret > 0);
-        //         MBRegistry_PutCopy(targetPlayers[tpIndex].mreg,
-        //                             cstr, "NEURAL_VALUE_VOID");
-        //         free(cstr);
-        //     }
-        // }
+    dt->table[h].aiType = player->aiType;
+    dt->table[h].behaviorHash = player->behaviorHash;
+    dt->table[h].index = index;
+    return index;
+}
 
-        tpIndex++;
-    } else if (method == doSystematic) {
-        targetPlayers[tpIndex].aiType = FLEET_AI_BINEURAL5;
-        targetPlayers[tpIndex].playerName = "BineuralFleet5.Base";
-        tpIndex++;
+/*
+ * MainShareDuplicateResults --
+ *    Give each duplicate target fleet skipped by MainConstructScenarios
+ *    the results of the fleet it duplicates.
+ */
+static void MainShareDuplicateResults(void)
+{
+    MainDedupeTable dt;
 
-        for (uint i = 0; i <= 24; i++) {
-            targetPlayers[tpIndex].aiType = FLEET_AI_BINEURAL5;
-            char *cstr;
-            int ret;
-            ret = asprintf(&cstr, "BineuralFleet5.%d", i);
-            VERIFY(ret > 0);
-            targetPlayers[tpIndex].playerName = cstr;
-            // the name leaks here
+    MainDedupeBegin(&dt, mainData.numPlayers);
+    for (uint p = 1; p < mainData.numPlayers; p++) {
+        uint d = MainDedupeAdd(&dt, &mainData.players[p], p);
+        if (d >= p) {
+            continue;
+        }
 
-            targetPlayers[tpIndex].mreg = MBRegistry_Alloc();
+        mainData.winners[p] = mainData.winners[d];
+        for (uint q = 0; q < mainData.numPlayers; q++) {
+            MainWinnerData *wd;
 
-            ret = asprintf(&cstr, "shipNet.output[%d].valueType", i);
-            VERIFY(ret > 0);
-            MBRegistry_PutCopy(targetPlayers[tpIndex].mreg,
-                               cstr, "NEURAL_VALUE_VOID");
-            free(cstr);
-            tpIndex++;
+            /*
+             * Copy out before creating, since that can move the entries.
+             */
+            wd = MainBreakdownFind(d, q, FALSE);
+            if (wd != NULL) {
+                MainWinnerData copy = *wd;
+                *MainBreakdownFind(p, q, TRUE) = copy;
+            }
+            wd = MainBreakdownFind(q, d, FALSE);
+            if (wd != NULL) {
+                MainWinnerData copy = *wd;
+                *MainBreakdownFind(q, p, TRUE) = copy;
+            }
         }
-    }else if (method == doTable) {
-        struct {
-            float attackRange;
-            bool attackExtendedRange;
-            float holdCount;
-        } v[] = {
-            { 100, TRUE,  100, },
-            { 100, TRUE,   50, },
-            { 100, FALSE,  50, },
-        };
+        mainData.sprt.decision[p] = mainData.sprt.decision[d];
+    }
+    MainDedupeEnd(&dt);
 
-        for (uint i = 0; i < ARRAYSIZE(v); i++) {
-            char *vstr[3];
+    Warning("Shared results with %d duplicate fleets.\n",
+            mainData.numDuplicates);
+    mainData.numDuplicates = 0;
+}
 
-            MBUtil_Zero(&vstr, sizeof(vstr));
+static uint64 MainCostMix(uint64 a, uint64 b)
+{
+    uint64 z = a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
 
-            targetPlayers[tpIndex].mreg = MBRegistry_Alloc();
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
 
-            asprintf(&vstr[0], "%1.0f", v[i].attackRange);
-            MBRegistry_PutConst(targetPlayers[tpIndex].mreg, "attackRange", vstr[0]);
+    // Zero marks an empty entry.
+    return z == 0 ? 1 : z;
+}
 
-            asprintf(&vstr[1], "%d", v[i].attackExtendedRange);
-            MBRegistry_PutConst(targetPlayers[tpIndex].mreg, "attackExtendedRange", vstr[1]);
+static void MainBreakdownInsert(MainBreakdownEntry *table, uint capacity,
+                                const MainBreakdownEntry *e)
+{
+    uint h = MainCostMix(0, e->key) & (capacity - 1);
 
-            asprintf(&vstr[2], "%1.0f", v[i].holdCount);
-            MBRegistry_PutConst(targetPlayers[tpIndex].mreg, "holdCount", vstr[2]);
+    while (table[h].key != 0) {
+        h = (h + 1) & (capacity - 1);
+    }
+    table[h] = *e;
+}
 
-            targetPlayers[tpIndex].aiType = FLEET_AI_HOLD;
+/*
+ * MainBreakdownFind --
+ *    Look up the results of puid1 against puid2, adding an empty entry
+ *    if create is set.  Creating an entry can move the others.
+ */
+static MainWinnerData *MainBreakdownFind(PlayerUID puid1, PlayerUID puid2,
+                                         bool create)
+{
+    MainBreakdownData *bd = &mainData.winnerBreakdown;
+    uint64 key = ((uint64)(puid1 + 1) << 32) | puid2;
 
-            char *name = NULL;
-            asprintf(&name, "%s %s:%s:%s",
-                    Fleet_GetName(targetPlayers[tpIndex].aiType),
-                    vstr[0], vstr[1], vstr[2]);
-            targetPlayers[tpIndex].playerName = name;
+    if (create && 2 * (bd->numEntries + 1) > bd->capacity) {
+        MainBreakdownEntry *oldTable = bd->table;
+        uint oldCapacity = bd->capacity;
 
-            tpIndex++;
+        bd->capacity = MAX(64, 2 * oldCapacity);
+        bd->table = calloc(bd->capacity, sizeof(bd->table[0]));
+        VERIFY(bd->table != NULL);
 
-            // XXX: Leak strings!
+        for (uint i = 0; i < oldCapacity; i++) {
+            if (oldTable[i].key != 0) {
+                MainBreakdownInsert(bd->table, bd->capacity, &oldTable[i]);
+            }
         }
-    } else {
-        ASSERT(method == doRandom);
+        free(oldTable);
+    }
 
-        struct {
-            const char *param;
-            float minValue;
-            float maxValue;
-        } v[] = {
-            // { "baseRadius",        50.0f, 500.0f,  },
-            // { "baseWeight",        -1.0f, 1.0f,    },
-            // { "nearBaseRadius",    50.0f, 500.0f,  },
-            // { "baseDefenseRadius", 50.0f, 500.0f,  },
+    if (bd->capacity == 0) {
+        return NULL;
+    }
 
-            // { "enemyBaseRadius",    50.0f, 500.0f, },
-            // { "enemyBaseWeight",    -1.0f, 1.0f,   },
+    uint h = MainCostMix(0, key) & (bd->capacity - 1);
+    while (bd->table[h].key != 0) {
+        if (bd->table[h].key == key) {
+            return &bd->table[h].wd;
+        }
+        h = (h + 1) & (bd->capacity - 1);
+    }
 
-            { "baseRadius",        50.0f, 500.0f,  },
-            { "baseWeight",        -0.01f, 0.01f,  },
-            { "nearBaseRadius",    50.0f, 200.0f,  },
-            { "baseDefenseRadius", 200.0f, 500.0f, },
+    if (!create) {
+        return NULL;
+    }
 
-            { "enemyBaseRadius",  300.0f, 700.0f,  },
-            { "enemyBaseWeight",    0.1f, 0.3f,   },
-        };
+    bd->table[h].key = key;
+    MBUtil_Zero(&bd->table[h].wd, sizeof(bd->table[h].wd));
+    bd->numEntries++;
+    return &bd->table[h].wd;
+}
 
-        for (uint f = 0; f < 5; f++) {
-            char *vstr[6];
-            MBUtil_Zero(vstr, sizeof(vstr));
-            ASSERT(ARRAYSIZE(vstr) >= ARRAYSIZE(v));
-            MBUtil_Zero(&vstr, sizeof(vstr));
+static void MainBreakdownReset(void)
+{
+    MainBreakdownData *bd = &mainData.winnerBreakdown;
 
-            targetPlayers[tpIndex].mreg = MBRegistry_Alloc();
+    free(bd->table);
+    MBUtil_Zero(bd, sizeof(*bd));
+}
 
-            for (uint i = 0; i < ARRAYSIZE(v); i++) {
-                float value = Random_Float(v[i].minValue, v[i].maxValue);
-                asprintf(&vstr[i], "%1.2f", value);
-                MBRegistry_PutConst(targetPlayers[tpIndex].mreg, v[i].param, vstr[i]);
-            }
+static uint MainCheckpointCrnSize(void)
+{
+    if (!mainData.crn.paired) {
+        return 0;
+    }
+    return mainData.crn.numTargets * mainData.crn.numCells * mainData.loop;
+}
 
-            targetPlayers[tpIndex].aiType = FLEET_AI_FLOCK4;
-            char *name = NULL;
-            asprintf(&name, "%s %s:%s %s:%s %s:%s",
-                     Fleet_GetName(targetPlayers[tpIndex].aiType),
-                     vstr[0], vstr[1], vstr[2], vstr[3], vstr[4],
-                     vstr[5]);
-            // asprintf(&name, "%s %s",
-            //              Fleet_GetName(targetPlayers[tpIndex].aiType),
-            //              vstr[0]);
-            targetPlayers[tpIndex].playerName = name;
+/*
+ * MainCheckpointBattle --
+ *    The checkpoint's number for a battle, which is unique within a run.
+ */
+static uint MainCheckpointBattle(uint loopIndex, uint bscIndex)
+{
+    uint n = loopIndex * mainData.scenarios.numScenarios + bscIndex;
 
-            tpIndex++;
+    ASSERT(n < mainData.totalBattles);
+    return n;
+}
 
-            // XXX: Leak strings!
+/*
+ * MainCheckpointSave --
+ *    Save the results so far: the winners for each player, the winner
+ *    breakdown entries, the CRN outcomes for paired runs, and how far
+ *    the result log got (or -1 without one).
+ */
+static bool MainCheckpointSave(void *cbData, FILE *f)
+{
+    uint numPlayers = mainData.numPlayers;
+    uint crnSize = MainCheckpointCrnSize();
+    uint32 numBreakdown = mainData.winnerBreakdown.numEntries;
+    int64 logOffset = -1;
+    bool ok;
+
+    /*
+     * Every battle the checkpoint counts as done is in the result log
+     * before this offset, and none of the others are.
+     */
+    if (mainData.useResultLog) {
+        logOffset = ResultLog_GetOffset(&mainData.resultLog);
+    }
+
+    ok = fwrite(mainData.winners, sizeof(mainData.winners[0]),
+                numPlayers, f) == numPlayers;
+    ok = ok && fwrite(&numBreakdown, sizeof(numBreakdown), 1, f) == 1;
+    for (uint i = 0; ok && i < mainData.winnerBreakdown.capacity; i++) {
+        MainBreakdownEntry *e = &mainData.winnerBreakdown.table[i];
+        ok = e->key == 0 || fwrite(e, sizeof(*e), 1, f) == 1;
+    }
+    ok = ok && (crnSize == 0 ||
+                fwrite(mainData.crn.outcomes, 1, crnSize, f) == crnSize);
+    ok = ok && fwrite(&logOffset, sizeof(logOffset), 1, f) == 1;
+    return ok;
+}
+
+static bool MainCheckpointLoad(void *cbData, FILE *f)
+{
+    uint numPlayers = mainData.numPlayers;
+    uint crnSize = MainCheckpointCrnSize();
+    uint32 numBreakdown = 0;
+    int64 logOffset = -1;
+    bool ok;
+
+    ok = fread(mainData.winners, sizeof(mainData.winners[0]),
+               numPlayers, f) == numPlayers;
+    ok = ok && fread(&numBreakdown, sizeof(numBreakdown), 1, f) == 1;
+    MainBreakdownReset();
+    for (uint i = 0; ok && i < numBreakdown; i++) {
+        MainBreakdownEntry e;
+        ok = fread(&e, sizeof(e), 1, f) == 1;
+        if (ok) {
+            *MainBreakdownFind((e.key >> 32) - 1, (uint32)e.key, TRUE) = e.wd;
         }
     }
+    ok = ok && (crnSize == 0 ||
+                fread(mainData.crn.outcomes, 1, crnSize, f) == crnSize);
+    ok = ok && fread(&logOffset, sizeof(logOffset), 1, f) == 1;
 
     /*
-     * Copy over target players.
+     * The battles after the checkpoint are about to run again, so drop
+     * what they logged last time rather than logging them twice.
      */
-    for (uint i = 0; i < tpIndex; i++) {
-        ASSERT(*mpIndex < mpSize);
-        targetPlayers[i].playerType = PLAYER_TYPE_TARGET;
-        mainPlayers[*mpIndex] = targetPlayers[i];
-        (*mpIndex)++;
+    if (ok && mainData.useResultLog && logOffset >= 0 &&
+        !ResultLog_Truncate(&mainData.resultLog, logOffset)) {
+        Warning("Result log is shorter than the checkpoint expects: %s\n",
+                MBOpt_GetCStr("resultLog"));
     }
+    return ok;
 }
 
-static void
-MainPrintBattleStatus(MainEngineThreadData *tData,
-                      const BattleStatus *bStatus)
+/*
+ * MainCheckpointBegin --
+ *    Set up checkpoints for a run of the current scenarios, and restore
+ *    the earlier results if we're resuming.
+ */
+static void MainCheckpointBegin(void)
 {
-    uint32 stopTimeMS = SDL_GetTicks();
-    uint32 elapsedMS = stopTimeMS - tData->startTimeMS;
-
-    Warning("Finished tick %d\n", bStatus->tick);
-    Warning("\tbattleId = %d\n", tData->battleId);
+    uint64 runKey;
 
-    for (uint i = 0; i < ARRAYSIZE(bStatus->players); i++) {
-        if (bStatus->players[i].playerUID != PLAYER_ID_INVALID) {
-            Warning("\tplayer[%d] numMobs = %d\n", i,
-                    bStatus->players[i].numMobs);
-        }
+    if (!mainData.useCheckpoint) {
+        return;
+    }
+    if (mainData.useRating) {
+        /*
+         * The ratings (and so the pairings) aren't saved.
+         */
+        Warning("Checkpoints aren't supported for rated tournaments.\n");
+        return;
+    }
+    if (mainData.numRuns == 2 && MBOpt_IsPresent("resume")) {
+        /*
+         * The checkpoint file only has the latest run, so later runs
+         * (like the generations of evolve) can't be matched up with it.
+         */
+        Warning("Only the first run resumes from a checkpoint; "
+                "later runs start over.\n");
     }
 
-    Warning("\tseed = 0x%llX\n", tData->seed);
-    Warning("\tcollisions = %d\n", bStatus->collisions);
-    Warning("\tsensor contacts = %d\n", bStatus->sensorContacts);
-    Warning("\tspawns = %d\n", bStatus->spawns);
-    Warning("\tship spawns = %d\n", bStatus->shipSpawns);
-    Warning("\t%d ticks in %d ms\n", bStatus->tick, elapsedMS);
-    Warning("\tavg %.1f ticks/second\n", ((float)bStatus->tick)/elapsedMS * 1000.0f);
+    /*
+     * Identify the run by everything that decides which battles it has,
+     * and the size of the results it saves.
+     */
+    runKey = BattleCache_HashParams(&mainData.scenarios.bp);
+    runKey = MainCostMix(runKey, mainData.scenarios.numScenarios);
+    runKey = MainCostMix(runKey, mainData.loop);
+    runKey = MainCostMix(runKey, mainData.crn.enabled);
+    runKey = MainCostMix(runKey, MainCheckpointCrnSize());
+    runKey = MainCostMix(runKey, mainData.reuseSeed);
+    runKey = MainCostMix(runKey, mainData.numPlayers);
+    for (uint i = 0; i < mainData.numPlayers; i++) {
+        BattlePlayer *player = &mainData.players[i];
+        runKey = MainCostMix(runKey, player->playerType);
+        runKey = MainCostMix(runKey, BattleCache_HashFleet(player));
+    }
 
-    if (mainData.displayFrames > 0) {
-        float fps = ((float)mainData.displayFrames)/(elapsedMS / 1000.0f);
-        Warning("\t%d frames in %d ms\n", mainData.displayFrames, elapsedMS);
-        Warning("\tavg %.1f frames/second\n", fps);
+    if (!Checkpoint_Begin(&mainData.ckpt, runKey, mainData.runSeed,
+                          mainData.totalBattles)) {
+        return;
     }
 
-    Warning("\n");
+    mainData.runSeed = Checkpoint_GetSeed(&mainData.ckpt);
 
-    if (bStatus->finished) {
-        BattlePlayer *bpp = &mainData.players[bStatus->winnerUID];
-        ASSERT(bStatus->winnerUID < ARRAYSIZE(mainData.players));
-        Warning("Winner: %s\n", bpp->playerName);
+    /*
+     * The SPRT decisions follow from the winners.
+     */
+    if (mainData.sprt.enabled) {
+        for (uint p = 0; p < mainData.numPlayers; p++) {
+            if (mainData.players[p].playerType == PLAYER_TYPE_TARGET) {
+                MainSprtUpdate(mainData.players[p].playerUID);
+            }
+        }
     }
 }
 
-static void MainRecordWinner(MainWinnerData *wd, PlayerUID puid,
-                             BattleStatus *bs)
+/*
+ * MainCopyPlayerRegs --
+ *    Make a battle's own copy of each player's registry for scenario
+ *    bscIndex.
+ */
+static MBRegistry **MainCopyPlayerRegs(uint bscIndex)
 {
-    BattlePlayer *bpp = &mainData.players[puid];
-    ASSERT(puid < ARRAYSIZE(mainData.players));
-    ASSERT(puid == bpp->playerUID);
+    uint numPlayers = MainScenarioNumPlayers();
+    MBRegistry **mregs = calloc(numPlayers, sizeof(mregs[0]));
 
-    if (puid == bs->winnerUID) {
-        wd->wins++;
-    } else if (bs->winnerUID == PLAYER_ID_NEUTRAL) {
-        wd->draws++;
-    } else {
-        wd->losses++;
+    VERIFY(mregs != NULL);
+    for (uint p = 0; p < numPlayers; p++) {
+        MBRegistry *mreg = mainData.players[MainScenarioSeat(bscIndex, p)].mreg;
+        if (mreg != NULL) {
+            mregs[p] = MBRegistry_AllocCopy(mreg);
+        }
     }
-    wd->battles++;
-
-    ASSERT(wd->wins >= 0);
-    ASSERT(wd->losses >= 0);
-    ASSERT(wd->draws >= 0);
-    ASSERT(wd->battles >= 0);
-    ASSERT(wd->wins + wd->losses + wd->draws == wd->battles);
+    return mregs;
 }
 
-static void MainPrintWinnerData(MainWinnerData *wd)
+static void MainFreePlayerRegs(MBRegistry **mregs)
 {
-    int wins = wd->wins;
-    int losses = wd->losses;
-    int battles = wd->battles;
-    int draws = wd->draws;
-    float percent = 100.0f * wins / (float)battles;
+    for (uint p = 0; p < MainScenarioNumPlayers(); p++) {
+        if (mregs[p] != NULL) {
+            MBRegistry_Free(mregs[p]);
+        }
+    }
+    free(mregs);
+}
 
-    ASSERT(wd->wins >= 0);
-    ASSERT(wd->losses >= 0);
-    ASSERT(wd->draws >= 0);
-    ASSERT(wd->battles >= 0);
-    ASSERT(wd->wins + wd->losses + wd->draws == wd->battles);
-
-    Warning("\t%3d wins, %3d losses, %3d draws, %3d total => %4.1f%% wins\n",
-            wins, losses, draws,  battles, percent);
+/*
+ * Multi-process mode (--workers).
+ *
+ * The main process becomes a coordinator, and forks the workers once
+ * the scenarios are set up, so each worker starts with its own copy of
+ * the players and scenarios, and only the work and result units go
+ * through the WorkerPool.
+ */
+static void MainWorkerInit(void *cbData, uint workerId)
+{
+    MainEngineThreadData *tData = cbData;
+    uint numNodes;
+
+    MBUtil_Zero(tData, sizeof(*tData));
+    tData->threadId = workerId;
+    snprintf(&tData->threadName[0], sizeof(tData->threadName),
+             "worker%d", workerId);
+    tData->cpu = -1;
+
+    numNodes = Affinity_NumNodes();
+    if (mainData.affinity != AFFINITY_NONE) {
+        tData->cpu = Affinity_ChooseCpu(mainData.affinity, workerId,
+                                        &tData->node);
+        if (tData->cpu >= 0 && !Affinity_PinToCpu(tData->cpu)) {
+            Warning("Unable to pin %s to CPU %d\n", tData->threadName,
+                    tData->cpu);
+        }
+    } else if (numNodes > 1) {
+        /*
+         * This fails for nodes without any CPUs we can use, which leaves
+         * the worker wherever the OS puts it.
+         */
+        tData->node = workerId % numNodes;
+        if (!Affinity_PinToNode(tData->node)) {
+            Warning("Unable to pin %s to node %d\n", tData->threadName,
+                    tData->node);
+        }
+    }
 }
 
-static void MainPrintWinners(void)
+static void MainWorkerRun(void *cbData, void *work, void *result)
 {
-    uint32 totalBattles = 0;
+    MainEngineThreadData *tData = cbData;
+    MainEngineWorkUnit *wu = work;
 
-    if (mainData.printWinnerBreakdown) {
-        Warning("\n");
-        Warning("Winner Breakdown:\n");
-        for (uint p1 = 0; p1 < mainData.numPlayers; p1++) {
-            Warning("Fleet %s:\n", mainData.players[p1].playerName);
-            for (uint p2 = 0; p2 < mainData.numPlayers; p2++) {
-                if (mainData.winnerBreakdown[p1][p2].battles > 0) {
-                    Warning("\tvs %s:\n", mainData.players[p2].playerName);
-                    MainPrintWinnerData(&mainData.winnerBreakdown[p1][p2]);
-                }
-            }
-        }
-    }
+    ASSERT(wu->type == MAIN_WORK_BATTLE);
+    wu->mregs = MainCopyPlayerRegs(wu->bscIndex);
+    MainRunBattle(tData, wu, result);
+    MainFreePlayerRegs(wu->mregs);
+}
 
-    Warning("\n");
-    Warning("Summary:\n");
+static void MainWorkerExit(void *cbData)
+{
+    MainEngineThreadData *tData = cbData;
 
-    for (uint i = 0; i < mainData.numPlayers; i++) {
-        totalBattles += mainData.winners[i].wins;
-    }
+    free(tData->bsc.players);
+    tData->bsc.players = NULL;
+}
 
-    for (uint i = 0; i < mainData.numPlayers; i++) {
-        Warning("Fleet: %s\n", mainData.players[i].playerName);
-        MainPrintWinnerData(&mainData.winners[i]);
-    }
+static void MainWorkerResult(void *cbData, const void *work, void *result)
+{
+    const MainEngineWorkUnit *wu = work;
+    MainEngineResultUnit *ru = result;
 
-    Warning("Total Battles: %d\n", totalBattles);
+    ASSERT(ru->bscIndex == wu->bscIndex);
+    ASSERT(ru->loopIndex == wu->loopIndex);
+    MainProcessSingleResult(ru);
 }
 
-static void MainDumpAddToKey(MBRegistry *source, MBRegistry *dest,
-                             const MBString *destPrefix,
-                             const char *key,
-                             uint value)
+static const WorkerPoolOps gMainWorkerOps = {
+    MainWorkerInit,
+    MainWorkerRun,
+    MainWorkerExit,
+    MainWorkerResult,
+};
+
+static void MainRunScenarios(void)
 {
-    uint x;
-    MBString destKey;
+    bool useWorkers = mainData.numWorkers > 0;
 
+    if (!mainData.headless) {
+        if (mainData.numThreads != 1) {
+            PANIC("Multiple threads requires --headless\n");
+        }
+        if (useWorkers) {
+            PANIC("--workers requires --headless\n");
+        }
+        if (mainData.scenarios.numScenarios != 1) {
+            PANIC("Multiple scenarios requries --headless\n");
+        }
+        if (mainData.loop != 1) {
+            PANIC("Multiple battles requires --headless\n");
+        }
+        MainScenarioBuild(0, &mainData.scenarios.mainBsc);
+        Display_Init(&mainData.scenarios.mainBsc);
+        Display_SetFPS(mainData.targetFPS);
 
-    MBString_Create(&destKey);
+    }
 
+    ASSERT(mainData.scenarios.numScenarios > 0);
+    ASSERT(mainData.loop > 0);
+    ASSERT(mainData.numThreads > 0);
 
-    MBString_MakeEmpty(&destKey);
-    if (destPrefix != NULL) {
-        MBString_Copy(&destKey, destPrefix);
+    mainData.totalBattles = mainData.loop * mainData.scenarios.numScenarios;
+    mainData.doneQueueing = FALSE;
+
+    /*
+     * Commands that run several stages (like evolve) start the threads
+     * themselves and keep them across runs.
+     */
+    bool ownThreads = !useWorkers && !mainData.threadsInitialized;
+    if (ownThreads) {
+        mainData.numThreads = MAX(1, mainData.numThreads);
+        mainData.numThreads = MIN(mainData.totalBattles, mainData.numThreads);
+        MainThreadsInit();
     }
 
-    MBString_AppendCStr(&destKey, key);
-    if (source != NULL) {
-        x = MBRegistry_GetUint(source, key);
-    } else {
-        x = 0;
+    uint battleId = 0;
+
+    if (mainData.crn.paired) {
+        uint size = mainData.crn.numTargets * mainData.crn.numCells *
+                    mainData.loop;
+        mainData.crn.outcomes = calloc(MAX(1, size),
+                                       sizeof(mainData.crn.outcomes[0]));
+        VERIFY(mainData.crn.outcomes != NULL);
     }
 
-    if (value + x == 0) {
-        MBRegistry_Remove(dest, MBString_GetCStr(&destKey));
-    } else {
-        MBString tmp;
-        MBString_Create(&tmp);
-        MBString_IntToString(&tmp, value + x);
-        MBRegistry_PutCopy(dest, MBString_GetCStr(&destKey),
-                           MBString_GetCStr(&tmp));
-        MBString_Destroy(&tmp);
+    MBUtil_Zero((void *)mainData.sprt.decision,
+                mainData.numPlayers * sizeof(mainData.sprt.decision[0]));
+    mainData.sprt.numDecided = 0;
+
+    if (mainData.useSchedule) {
+        uint numRunners = mainData.numWorkers > 0 ?
+                          mainData.numWorkers : mainData.numThreads;
+        Schedule_BeginRun(&mainData.sched, &mainData.scenarios.bp,
+                          mainData.players, mainData.numPlayers,
+                          mainData.scenarios.numScenarios,
+                          MainScenarioNumPlayers(), MainScheduleSeat, NULL,
+                          numRunners);
     }
 
-    MBString_Destroy(&destKey);
-}
+    /*
+     * The first run uses the actual seed, so that it's easy to re-create
+     * a single battle from the battle seed.  Later runs (like the
+     * generations of evolve) draw their own.
+     */
+    if (mainData.numRuns == 0 || mainData.reuseSeed) {
+        mainData.runSeed = RandomState_GetSeed(&mainData.rs);
+    } else {
+        mainData.runSeed = RandomState_Uint64(&mainData.rs);
+    }
+    mainData.numRuns++;
 
-static void MainDumpPopulation(const char *outputFile, bool targetOnly)
-{
-    uint32 i;
-    MBRegistry *popReg;
-    MBString prefix;
-    MBString key;
-    MBString tmp;
-    uint32 numFleets = 0;
-    uint32 fleetI = 1;
+    MainCheckpointBegin();
 
-    ASSERT(outputFile != NULL);
+    if (useWorkers) {
+        WorkerPool_Start(&mainData.workers, mainData.numWorkers,
+                         sizeof(MainEngineWorkUnit),
+                         sizeof(MainEngineResultUnit),
+                         &gMainWorkerOps, &mainData.workerData);
+    }
 
-    MBString_Create(&prefix);
-    MBString_Create(&key);
-    MBString_Create(&tmp);
+    if (Serve_IsConnected(&mainData.serve)) {
+        Serve_ReportPlayers(&mainData.serve, mainData.players,
+                            mainData.numPlayers);
+    }
 
-    popReg = MBRegistry_Alloc();
-    VERIFY(popReg != NULL);
+    if (mainData.useResultLog) {
+        ResultLog_AddRun(&mainData.resultLog, mainData.players,
+                         mainData.numPlayers);
+    }
 
-    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
-    for (i = 1; i < mainData.numPlayers; i++) {
-        if (targetOnly &&
-            mainData.players[i].playerType != PLAYER_TYPE_TARGET) {
-            continue;
+    /*
+     * With --workers there are no engine threads, and the results come
+     * back through MainWorkerResult instead of the queues.
+     */
+    if (!useWorkers) {
+        WorkQueue_BeginBatch(&mainData.workQ, MAIN_QUEUE_SLOT);
+    }
+    for (uint i = 0; i < mainData.loop; i++) {
+        if (mainData.useSchedule) {
+            Schedule_BeginLoop(&mainData.sched);
         }
 
-        MainWinnerData *wd = &mainData.winners[i];
-        const char *fleetName = Fleet_GetName(mainData.players[i].aiType);
-
-        numFleets++;
+        for (uint k = 0; k < mainData.scenarios.numScenarios; k++) {
+            MainEngineWorkUnit wu;
+            uint b = k;
+            float predictedMS = 0.0f;
 
-        MBString_CopyCStr(&prefix, "fleet");
-        MBString_IntToString(&tmp, fleetI);
-        fleetI++;
-        MBString_AppendStr(&prefix, &tmp);
-        MBString_AppendCStr(&prefix, ".");
+            if (mainData.useSchedule) {
+                ScheduleItem item = Schedule_Next(&mainData.sched);
+                b = item.bscIndex;
+                predictedMS = item.predictedMS;
+            }
 
-        /*
-         * Copy them over first, so we can override some of them.
-         * Because we're using unique prefixes, we can assume that the
-         * key isn't already in the registry.
-         */
-        if (mainData.players[i].mreg != NULL) {
-            MBRegistry_PutAllUnique(popReg, mainData.players[i].mreg,
-                                    MBString_GetCStr(&prefix));
-        }
+            if (MainSprtIsDecided(b)) {
+                continue;
+            }
 
-        MBString_Copy(&key, &prefix);
-        MBString_AppendCStr(&key, "abattle.fleetName");
-        MBRegistry_PutCopy(popReg, MBString_GetCStr(&key), fleetName);
+            MBUtil_Zero(&wu, sizeof(wu));
+            wu.type = MAIN_WORK_BATTLE;
+            wu.battleId = battleId++;
+            wu.bscIndex = b;
+            wu.loopIndex = i;
 
-        MBString_Copy(&key, &prefix);
-        MBString_AppendCStr(&key, "abattle.playerType");
-        MBRegistry_PutCopy(popReg, MBString_GetCStr(&key),
-                           PlayerType_ToString(mainData.players[i].playerType));
+            /*
+             * The first battle gets the run seed itself, so it can be
+             * re-created without specifying --reuseSeed.  With CRN every
+             * scenario in a loop iteration shares the same seed.
+             */
+            if (mainData.reuseSeed) {
+                wu.seed = mainData.runSeed;
+            } else if (MainUsingResultCache()) {
+                wu.seed = MainCacheBattleSeed(b, i);
+            } else if (mainData.crn.enabled) {
+                wu.seed = MainBattleSeed(i);
+            } else {
+                wu.seed = MainBattleSeed((uint64)i *
+                                         mainData.scenarios.numScenarios + b);
+            }
 
-        MainDumpAddToKey(mainData.players[i].mreg, popReg,
-                         &prefix, "abattle.numBattles", wd->battles);
-        MainDumpAddToKey(mainData.players[i].mreg, popReg,
-                         &prefix, "abattle.numWins", wd->wins);
-        MainDumpAddToKey(mainData.players[i].mreg, popReg,
-                         &prefix, "abattle.numLosses", wd->losses);
-        MainDumpAddToKey(mainData.players[i].mreg, popReg,
-                         &prefix, "abattle.numDraws", wd->draws);
-    }
+            /*
+             * Skip battles that finished before the resume.
+             */
+            if (Checkpoint_IsActive(&mainData.ckpt) &&
+                Checkpoint_IsDone(&mainData.ckpt, MainCheckpointBattle(i, b))) {
+                continue;
+            }
 
-    MBString_IntToString(&tmp, numFleets);
-    MBRegistry_PutCopy(popReg, "numFleets", MBString_GetCStr(&tmp));
+            if (MainUseCachedResult(&wu)) {
+                continue;
+            }
 
-    MBRegistry_Save(popReg, outputFile);
+            if (mainData.useSchedule) {
+                wu.predictedMS = predictedMS;
+                Schedule_Assign(&mainData.sched, wu.predictedMS);
+            }
 
-    MBString_Destroy(&prefix);
-    MBString_Destroy(&key);
-    MBString_Destroy(&tmp);
-    MBRegistry_Free(popReg);
-}
-static void MainUsePopulation(const char *file,
-                              bool incrementAge)
-{
-    MBRegistry *popReg;
-    MBRegistry *fleetReg;
-    uint32 numFleets;
-    uint32 numTargetFleets = 0;
-    MBString tmp;
-    BattlePlayer *mainPlayers = &mainData.players[0];
-    uint32 mpSize = ARRAYSIZE(mainData.players);
-    uint32 *mpIndex = &mainData.numPlayers;
+            Warning("Queueing Battle %d of %d...\n", wu.battleId,
+                    mainData.totalBattles);
 
-    MainAddNeutralPlayer();
+            if (useWorkers) {
+                /*
+                 * The workers make their own registry copies.
+                 */
+                WorkerPool_Submit(&mainData.workers, wu.battleId, &wu);
+                continue;
+            }
 
-    MBString_Create(&tmp);
+            wu.mregs = MainCopyPlayerRegs(b);
+            WorkQueue_QueueItem(&mainData.workQ, MAIN_QUEUE_SLOT,
+                                &wu, sizeof(wu));
 
-    popReg = MBRegistry_Alloc();
-    VERIFY(popReg != NULL);
+            if ((battleId + 1) % mainData.numThreads == 0) {
+                WorkQueue_EndBatch(&mainData.workQ, MAIN_QUEUE_SLOT);
+                uint workTarget = MAX(10, mainData.numThreads * 4);
 
-    fleetReg = MBRegistry_Alloc();
-    VERIFY(fleetReg != NULL);
+                /*
+                 * Try to process the results as they come in, to reduce
+                 * memory usage.
+                 */
+                while (!WorkQueue_IsEmpty(&mainData.resultQ) &&
+                       !WorkQueue_IsCountBelow(&mainData.workQ, workTarget)) {
+                    MainEngineResultUnit ru;
+                    WorkQueue_WaitForItem(&mainData.resultQ, MAIN_QUEUE_SLOT,
+                                          &ru, sizeof(ru));
+                    MainProcessSingleResult(&ru);
+                    WorkQueue_FinishItem(&mainData.resultQ);
+                }
 
-    ASSERT(file != NULL);
-    MBRegistry_Load(popReg, file);
+                WorkQueue_WaitForCountBelow(&mainData.workQ, workTarget);
+                WorkQueue_BeginBatch(&mainData.workQ, MAIN_QUEUE_SLOT);
+            }
+        }
+    }
+    if (!useWorkers) {
+        WorkQueue_EndBatch(&mainData.workQ, MAIN_QUEUE_SLOT);
+    }
+    Warning("Done Queueing\n");
+    mainData.doneQueueing = TRUE;
 
-    if (!MBRegistry_ContainsKey(popReg, "numFleets")) {
-        PANIC("Missing key: numFleets (file=%s)\n", file);
+    if (!mainData.headless) {
+        Display_Main(mainData.startPaused);
+        mainData.asyncExit = TRUE;
+        Display_Exit();
     }
-    numFleets = MBRegistry_GetUint(popReg, "numFleets");
-    if (numFleets == 0) {
-        PANIC("Bad value for numFleets=%d (file=%s)\n", numFleets, file);
+
+    if (useWorkers) {
+        WorkerPool_Finish(&mainData.workers);
+    } else {
+        MainEngineResultUnit ru;
+
+        WorkQueue_WaitForAllFinished(&mainData.workQ);
+        ASSERT(WorkQueue_IsIdle(&mainData.workQ));
+        if (ownThreads) {
+            MainThreadsRequestExit();
+        }
+
+        while (WorkQueue_TryGetItem(&mainData.resultQ, MAIN_QUEUE_SLOT,
+                                    &ru, sizeof(ru))) {
+            MainProcessSingleResult(&ru);
+            WorkQueue_FinishItem(&mainData.resultQ);
+        }
+        ASSERT(WorkQueue_IsIdle(&mainData.resultQ));
     }
 
-    /*
-     * Load fleets.
-     */
-    for (uint32 i = 1; i <= numFleets; i++) {
-        MBRegistry_MakeEmpty(fleetReg);
+    if (mainData.useResultLog) {
+        ResultLog_Flush(&mainData.resultLog);
+    }
 
-        MBString_IntToString(&tmp, i);
-        MBString_PrependCStr(&tmp, "fleet");
-        MBString_AppendCStr(&tmp, ".");
+    if (mainData.useSchedule) {
+        Schedule_EndRun(&mainData.sched);
+    }
 
-        MBRegistry_SplitOnPrefix(fleetReg, popReg, MBString_GetCStr(&tmp),
-                                 FALSE);
+    if (Checkpoint_IsActive(&mainData.ckpt)) {
+        Checkpoint_End(&mainData.ckpt);
+    }
 
-        ASSERT(*mpIndex < mpSize);
+    if (mainData.numDuplicates > 0) {
+        MainShareDuplicateResults();
+    }
 
-        if (MBRegistry_GetCStr(fleetReg, "abattle.fleetName") == NULL) {
-            MBRegistry_DebugDump(fleetReg);
-            PANIC("Missing key: fleetName, i=%d\n", i);
-        }
-        if (MBRegistry_ContainsKey(fleetReg, "abattle.playerName")) {
-            mainPlayers[*mpIndex].playerName =
-                strdup(MBRegistry_GetCStr(fleetReg, "abattle.playerName"));
-        } else {
-            mainPlayers[*mpIndex].playerName =
-                strdup(MBRegistry_GetCStr(fleetReg, "abattle.fleetName"));
-        }
+    if (!mainData.useRating) {
+        /*
+         * Rated tournaments print the winners once at the end, instead
+         * of after every round.
+         */
+        MainPrintWinners();
+    }
 
-        if (MBRegistry_ContainsKey(fleetReg, "abattle.age")) {
-            if (incrementAge) {
-                uint age = MBRegistry_GetUint(fleetReg, "abattle.age");
-                MBString_IntToString(&tmp, age + 1);
-                MBRegistry_PutCopy(fleetReg, "abattle.age",
-                                   MBString_GetCStr(&tmp));
-            }
-        } else {
-            MBRegistry_PutCopy(fleetReg, "abattle.age", "0");
+    if (Serve_IsConnected(&mainData.serve)) {
+        for (uint i = 1; i < mainData.numPlayers; i++) {
+            MainWinnerData *wd = &mainData.winners[i];
+            Serve_ReportFleet(&mainData.serve, &mainData.players[i],
+                              wd->battles, wd->wins, wd->losses, wd->draws);
         }
+        Serve_Flush(&mainData.serve);
+    }
 
-        mainPlayers[*mpIndex].mreg = MBRegistry_AllocCopy(fleetReg);
-        mainPlayers[*mpIndex].playerType =
-            PlayerType_FromString(MBRegistry_GetCStr(fleetReg, "abattle.playerType"));
-        VERIFY(mainPlayers[*mpIndex].playerType != PLAYER_TYPE_INVALID);
-        VERIFY(mainPlayers[*mpIndex].playerType < PLAYER_TYPE_MAX);
+    if (mainData.sprt.enabled) {
+        Warning("SPRT decided %d fleets.\n", mainData.sprt.numDecided);
+    }
 
-        if (mainPlayers[*mpIndex].playerType == PLAYER_TYPE_TARGET) {
-            numTargetFleets++;
-        }
+    if (mainData.crn.paired) {
+        MainPrintCrnStats();
 
-        const char *fleetName = MBRegistry_GetCStr(fleetReg, "abattle.fleetName");
-        mainPlayers[*mpIndex].aiType = Fleet_GetTypeFromName(fleetName);
-        if (mainPlayers[*mpIndex].aiType == FLEET_AI_INVALID) {
-            PANIC("Unknown Fleet Name: %s\n", fleetName);
-        }
-        (*mpIndex)++;
+        free(mainData.crn.outcomes);
+        mainData.crn.outcomes = NULL;
+        mainData.crn.paired = FALSE;
     }
 
-    MBRegistry_Free(popReg);
-    MBRegistry_Free(fleetReg);
-    MBString_Destroy(&tmp);
+    MainDestroyScenarios();
+
+    if (ownThreads) {
+        MainThreadsExit();
+    }
 }
 
-static uint32 MainFleetCompetition(BattlePlayer *mainPlayers, uint32 mpSize,
-                                   uint32 startingMPIndex, uint32 numFleets,
-                                   bool useWinRatio)
+static void
+MainAddTargetPlayersForOptimize(void)
 {
-    float w1, w2;
+    const int doSimple = 0;
+    const int doSystematic = 1;
+    const int doTable = 2;
+    const int doRandom = 3;
+    int method;
+    BattlePlayer targetPlayers[64];
+    uint32 tpIndex = 0;
+    BattlePlayer *mainPlayers;
+    uint32 *mpIndex = &mainData.numPlayers;
+
+    MBUtil_Zero(targetPlayers, sizeof(targetPlayers));
+
+    ASSERT(Fleet_GetTypeFromRanking(-1) == FLEET_AI_INVALID);
+    ASSERT(Fleet_GetTypeFromRanking(FLEET_AI_MAX) == FLEET_AI_INVALID);
+
+    /*
+     * Target fleets to optimize.
+     * Customize as needed.
+     */
+    method = doSimple;
+    if (method == doSimple) {
+        targetPlayers[tpIndex].aiType = FLEET_AI_FLOCK9;
+        targetPlayers[tpIndex].playerName = "FlockFleet9.Test";
+
+        // targetPlayers[tpIndex].mreg = MBRegistry_Alloc();
+        // int keep[] = { 0, 2, 18, 24 };
+        // int drop[] = {1, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 19, 20, 21, 22, 23};
+        // for (uint i = 0; i <= 24; i++) {
+        //     char *cstr;
+        //     int ret;
+        //     // bool doKeep = FALSE;
+        //     bool doDrop = FALSE;
+        //     // for (uint k = 0; k < ARRAYSIZE(keep); k++) {
+        //     //     if (i == keep[k]) {
+        //     //         doKeep = TRUE;
+        //     //     }
+        //     // }
+        //     for (uint k = 0; k < ARRAYSIZE(drop); k++) {
+        //         if (i == drop[k]) {
+        //             doDrop = TRUE;
+        //         }
+        //     }
+        //     if (doDrop) {
+        //         ret = asprintf(&cstr, "shipNet.output[%d].valueType", i);
+        //         VERIFY(ret > 0);
+        //         MBRegistry_PutCopy(targetPlayers[tpIndex].mreg,
+        //                             cstr, "NEURAL_VALUE_VOID");
+        //         free(cstr);
+        //     }
+        // }
+
+        tpIndex++;
+    } else if (method == doSystematic) {
+        targetPlayers[tpIndex].aiType = FLEET_AI_BINEURAL5;
+        targetPlayers[tpIndex].playerName = "BineuralFleet5.Base";
+        tpIndex++;
+
+        for (uint i = 0; i <= 24; i++) {
+            targetPlayers[tpIndex].aiType = FLEET_AI_BINEURAL5;
+            char *cstr;
+            int ret;
+            ret = asprintf(&cstr, "BineuralFleet5.%d", i);
+            VERIFY(ret > 0);
+            targetPlayers[tpIndex].playerName = cstr;
+            // the name leaks here
+
+            targetPlayers[tpIndex].mreg = MBRegistry_Alloc();
+
+            ret = asprintf(&cstr, "shipNet.output[%d].valueType", i);
+            VERIFY(ret > 0);
+            MBRegistry_PutCopy(targetPlayers[tpIndex].mreg,
+                               cstr, "NEURAL_VALUE_VOID");
+            free(cstr);
+            tpIndex++;
+        }
+    }else if (method == doTable) {
+        struct {
+            float attackRange;
+            bool attackExtendedRange;
+            float holdCount;
+        } v[] = {
+            { 100, TRUE,  100, },
+            { 100, TRUE,   50, },
+            { 100, FALSE,  50, },
+        };
+
+        for (uint i = 0; i < ARRAYSIZE(v); i++) {
+            char *vstr[3];
+
+            MBUtil_Zero(&vstr, sizeof(vstr));
+
+            targetPlayers[tpIndex].mreg = MBRegistry_Alloc();
+
+            asprintf(&vstr[0], "%1.0f", v[i].attackRange);
+            MBRegistry_PutConst(targetPlayers[tpIndex].mreg, "attackRange", vstr[0]);
+
+            asprintf(&vstr[1], "%d", v[i].attackExtendedRange);
+            MBRegistry_PutConst(targetPlayers[tpIndex].mreg, "attackExtendedRange", vstr[1]);
+
+            asprintf(&vstr[2], "%1.0f", v[i].holdCount);
+            MBRegistry_PutConst(targetPlayers[tpIndex].mreg, "holdCount", vstr[2]);
+
+            targetPlayers[tpIndex].aiType = FLEET_AI_HOLD;
+
+            char *name = NULL;
+            asprintf(&name, "%s %s:%s:%s",
+                    Fleet_GetName(targetPlayers[tpIndex].aiType),
+                    vstr[0], vstr[1], vstr[2]);
+            targetPlayers[tpIndex].playerName = name;
+
+            tpIndex++;
+
+            // XXX: Leak strings!
+        }
+    } else {
+        ASSERT(method == doRandom);
+
+        struct {
+            const char *param;
+            float minValue;
+            float maxValue;
+        } v[] = {
+            // { "baseRadius",        50.0f, 500.0f,  },
+            // { "baseWeight",        -1.0f, 1.0f,    },
+            // { "nearBaseRadius",    50.0f, 500.0f,  },
+            // { "baseDefenseRadius", 50.0f, 500.0f,  },
+
+            // { "enemyBaseRadius",    50.0f, 500.0f, },
+            // { "enemyBaseWeight",    -1.0f, 1.0f,   },
+
+            { "baseRadius",        50.0f, 500.0f,  },
+            { "baseWeight",        -0.01f, 0.01f,  },
+            { "nearBaseRadius",    50.0f, 200.0f,  },
+            { "baseDefenseRadius", 200.0f, 500.0f, },
+
+            { "enemyBaseRadius",  300.0f, 700.0f,  },
+            { "enemyBaseWeight",    0.1f, 0.3f,   },
+        };
+
+        for (uint f = 0; f < 5; f++) {
+            char *vstr[6];
+            MBUtil_Zero(vstr, sizeof(vstr));
+            ASSERT(ARRAYSIZE(vstr) >= ARRAYSIZE(v));
+            MBUtil_Zero(&vstr, sizeof(vstr));
+
+            targetPlayers[tpIndex].mreg = MBRegistry_Alloc();
+
+            for (uint i = 0; i < ARRAYSIZE(v); i++) {
+                float value = Random_Float(v[i].minValue, v[i].maxValue);
+                asprintf(&vstr[i], "%1.2f", value);
+                MBRegistry_PutConst(targetPlayers[tpIndex].mreg, v[i].param, vstr[i]);
+            }
+
+            targetPlayers[tpIndex].aiType = FLEET_AI_FLOCK4;
+            char *name = NULL;
+            asprintf(&name, "%s %s:%s %s:%s %s:%s",
+                     Fleet_GetName(targetPlayers[tpIndex].aiType),
+                     vstr[0], vstr[1], vstr[2], vstr[3], vstr[4],
+                     vstr[5]);
+            // asprintf(&name, "%s %s",
+            //              Fleet_GetName(targetPlayers[tpIndex].aiType),
+            //              vstr[0]);
+            targetPlayers[tpIndex].playerName = name;
+
+            tpIndex++;
+
+            // XXX: Leak strings!
+        }
+    }
+
+    /*
+     * Copy over target players.
+     */
+    ASSERT(tpIndex <= ARRAYSIZE(targetPlayers));
+    MainReservePlayers(*mpIndex + tpIndex);
+    mainPlayers = mainData.players;
+    for (uint i = 0; i < tpIndex; i++) {
+        targetPlayers[i].playerType = PLAYER_TYPE_TARGET;
+        mainPlayers[*mpIndex] = targetPlayers[i];
+        (*mpIndex)++;
+    }
+}
+
+static void
+MainPrintBattleStatus(MainEngineThreadData *tData,
+                      const BattleStatus *bStatus)
+{
+    uint32 stopTimeMS = SDL_GetTicks();
+    uint32 elapsedMS = stopTimeMS - tData->startTimeMS;
+
+    Warning("Finished tick %d\n", bStatus->tick);
+    Warning("\tbattleId = %d\n", tData->battleId);
+
+    for (uint i = 0; i < bStatus->numPlayers; i++) {
+        if (bStatus->players[i].playerUID != PLAYER_ID_INVALID) {
+            Warning("\tplayer[%d] numMobs = %d\n", i,
+                    bStatus->players[i].numMobs);
+        }
+    }
+
+    Warning("\tseed = 0x%llX\n", tData->seed);
+    Warning("\tcollisions = %d\n", bStatus->collisions);
+    Warning("\tsensor contacts = %d\n", bStatus->sensorContacts);
+    Warning("\tspawns = %d\n", bStatus->spawns);
+    Warning("\tship spawns = %d\n", bStatus->shipSpawns);
+    Warning("\t%d ticks in %d ms\n", bStatus->tick, elapsedMS);
+    Warning("\tavg %.1f ticks/second\n", ((float)bStatus->tick)/elapsedMS * 1000.0f);
+
+    if (mainData.displayFrames > 0) {
+        float fps = ((float)mainData.displayFrames)/(elapsedMS / 1000.0f);
+        Warning("\t%d frames in %d ms\n", mainData.displayFrames, elapsedMS);
+        Warning("\tavg %.1f frames/second\n", fps);
+    }
+
+    Warning("\n");
+
+    if (bStatus->finished) {
+        BattlePlayer *bpp = &mainData.players[bStatus->winnerUID];
+        ASSERT(bStatus->winnerUID < mainData.numPlayers);
+        Warning("Winner: %s\n", bpp->playerName);
+    }
+}
+
+static void MainRecordWinner(MainWinnerData *wd, PlayerUID puid,
+                             PlayerUID winnerUID)
+{
+    BattlePlayer *bpp = &mainData.players[puid];
+    ASSERT(puid < mainData.numPlayers);
+    ASSERT(puid == bpp->playerUID);
+
+    if (puid == winnerUID) {
+        wd->wins++;
+    } else if (winnerUID == PLAYER_ID_NEUTRAL) {
+        wd->draws++;
+    } else {
+        wd->losses++;
+    }
+    wd->battles++;
+
+    ASSERT(wd->wins >= 0);
+    ASSERT(wd->losses >= 0);
+    ASSERT(wd->draws >= 0);
+    ASSERT(wd->battles >= 0);
+    ASSERT(wd->wins + wd->losses + wd->draws == wd->battles);
+}
+
+static void MainPrintWinnerData(MainWinnerData *wd)
+{
+    int wins = wd->wins;
+    int losses = wd->losses;
+    int battles = wd->battles;
+    int draws = wd->draws;
+    float percent = 100.0f * wins / (float)battles;
+
+    ASSERT(wd->wins >= 0);
+    ASSERT(wd->losses >= 0);
+    ASSERT(wd->draws >= 0);
+    ASSERT(wd->battles >= 0);
+    ASSERT(wd->wins + wd->losses + wd->draws == wd->battles);
+
+    Warning("\t%3d wins, %3d losses, %3d draws, %3d total => %4.1f%% wins\n",
+            wins, losses, draws,  battles, percent);
+}
+
+static void MainPrintWinners(void)
+{
+    uint32 totalBattles = 0;
+
+    if (mainData.printWinnerBreakdown) {
+        Warning("\n");
+        Warning("Winner Breakdown:\n");
+        for (uint p1 = 0; p1 < mainData.numPlayers; p1++) {
+            Warning("Fleet %s:\n", mainData.players[p1].playerName);
+            for (uint p2 = 0; p2 < mainData.numPlayers; p2++) {
+                MainWinnerData *wd = MainBreakdownFind(p1, p2, FALSE);
+                if (wd != NULL && wd->battles > 0) {
+                    Warning("\tvs %s:\n", mainData.players[p2].playerName);
+                    MainPrintWinnerData(wd);
+                }
+            }
+        }
+    }
+
+    Warning("\n");
+    Warning("Summary:\n");
+
+    for (uint i = 0; i < mainData.numPlayers; i++) {
+        totalBattles += mainData.winners[i].wins;
+    }
+
+    for (uint i = 0; i < mainData.numPlayers; i++) {
+        Warning("Fleet: %s\n", mainData.players[i].playerName);
+        MainPrintWinnerData(&mainData.winners[i]);
+    }
+
+    Warning("Total Battles: %d\n", totalBattles);
+}
+
+static void MainDumpAddToKey(MBRegistry *source, MBRegistry *dest,
+                             const MBString *destPrefix,
+                             const char *key,
+                             uint value)
+{
+    uint x;
+    MBString destKey;
+
+
+    MBString_Create(&destKey);
+
+
+    MBString_MakeEmpty(&destKey);
+    if (destPrefix != NULL) {
+        MBString_Copy(&destKey, destPrefix);
+    }
+
+    MBString_AppendCStr(&destKey, key);
+    if (source != NULL) {
+        x = MBRegistry_GetUint(source, key);
+    } else {
+        x = 0;
+    }
+
+    if (value + x == 0) {
+        MBRegistry_Remove(dest, MBString_GetCStr(&destKey));
+    } else {
+        MBString tmp;
+        MBString_Create(&tmp);
+        MBString_IntToString(&tmp, value + x);
+        MBRegistry_PutCopy(dest, MBString_GetCStr(&destKey),
+                           MBString_GetCStr(&tmp));
+        MBString_Destroy(&tmp);
+    }
+
+    MBString_Destroy(&destKey);
+}
+
+/*
+ * MainMakeDumpFleet --
+ *    Build the registry that gets saved for player i, with the
+ *    results from this run added to its stats.
+ */
+static MBRegistry *MainMakeDumpFleet(uint32 i)
+{
+    MBRegistry *fleetReg;
+    MainWinnerData *wd = &mainData.winners[i];
+    BattlePlayer *player = &mainData.players[i];
+    const char *fleetName = Fleet_GetName(player->aiType);
+
+    if (player->mreg != NULL) {
+        fleetReg = MBRegistry_AllocCopy(player->mreg);
+    } else {
+        fleetReg = MBRegistry_Alloc();
+    }
+    VERIFY(fleetReg != NULL);
+
+    MBRegistry_PutCopy(fleetReg, "abattle.fleetName", fleetName);
+    MBRegistry_PutCopy(fleetReg, "abattle.playerType",
+                       PlayerType_ToString(player->playerType));
+
+    MainDumpAddToKey(player->mreg, fleetReg,
+                     NULL, "abattle.numBattles", wd->battles);
+    MainDumpAddToKey(player->mreg, fleetReg,
+                     NULL, "abattle.numWins", wd->wins);
+    MainDumpAddToKey(player->mreg, fleetReg,
+                     NULL, "abattle.numLosses", wd->losses);
+    MainDumpAddToKey(player->mreg, fleetReg,
+                     NULL, "abattle.numDraws", wd->draws);
+
+    if (mainData.sprt.enabled &&
+        player->playerType == PLAYER_TYPE_TARGET) {
+        MainSprtDecision d = mainData.sprt.decision[i];
+
+        MBRegistry_RemoveAllWithPrefix(fleetReg, "abattle.sprt");
+        if (d == MAIN_SPRT_UNDECIDED) {
+            MBRegistry_PutCopy(fleetReg, "abattle.sprtDecision", "UNDECIDED");
+        } else {
+            char buf[32];
+            float confidence;
+
+            if (d == MAIN_SPRT_PASS) {
+                MBRegistry_PutCopy(fleetReg, "abattle.sprtDecision", "PASS");
+                confidence = 1.0f - mainData.sprt.alpha;
+            } else {
+                ASSERT(d == MAIN_SPRT_FAIL);
+                MBRegistry_PutCopy(fleetReg, "abattle.sprtDecision", "FAIL");
+                confidence = 1.0f - mainData.sprt.beta;
+            }
+
+            snprintf(buf, sizeof(buf), "%0.3f", confidence);
+            MBRegistry_PutCopy(fleetReg, "abattle.sprtConfidence", buf);
+        }
+    }
+
+    return fleetReg;
+}
+
+/*
+ * MainDumpBinaryPopulation --
+ *    If the file already holds the same fleets, only the stats have
+ *    changed, and those can be updated in place.  Otherwise write out
+ *    a new file.
+ */
+static void MainDumpBinaryPopulation(const char *outputFile,
+                                     MBRegistry **fleetRegs,
+                                     uint32 numFleets)
+{
+    bool inPlace = FALSE;
+
+    if (Population_IsBinaryFile(outputFile)) {
+        Population pop;
+        Population_Open(&pop, outputFile, TRUE);
+
+        if (Population_NumFleets(&pop) == numFleets) {
+            inPlace = TRUE;
+            for (uint32 f = 0; f < numFleets; f++) {
+                if (Population_GetFleetHash(&pop, f + 1) !=
+                    Population_HashFleet(fleetRegs[f])) {
+                    inPlace = FALSE;
+                    break;
+                }
+            }
+        }
+
+        if (inPlace) {
+            for (uint32 f = 0; f < numFleets; f++) {
+                inPlace = Population_UpdateStats(&pop, f + 1, fleetRegs[f]);
+                if (!inPlace) {
+                    break;
+                }
+            }
+        }
+
+        Population_Close(&pop);
+    }
+
+    if (!inPlace) {
+        PopulationWriter w;
+        PopulationWriter_Open(&w, outputFile);
+        for (uint32 f = 0; f < numFleets; f++) {
+            PopulationWriter_AddFleet(&w, fleetRegs[f]);
+        }
+        PopulationWriter_Close(&w, NULL);
+    }
+}
+
+static void MainDumpPopulation(const char *outputFile, bool targetOnly)
+{
+    uint32 i;
+    MBRegistry **fleetRegs;
+    uint32 numFleets = 0;
+
+    ASSERT(outputFile != NULL);
+
+    fleetRegs = malloc(mainData.numPlayers * sizeof(fleetRegs[0]));
+    VERIFY(fleetRegs != NULL);
+
+    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+    for (i = 1; i < mainData.numPlayers; i++) {
+        if (targetOnly &&
+            mainData.players[i].playerType != PLAYER_TYPE_TARGET) {
+            continue;
+        }
+
+        ASSERT(numFleets < mainData.numPlayers);
+        fleetRegs[numFleets++] = MainMakeDumpFleet(i);
+    }
+
+    if (Population_IsBinaryName(outputFile) ||
+        Population_IsBinaryFile(outputFile)) {
+        MainDumpBinaryPopulation(outputFile, fleetRegs, numFleets);
+    } else {
+        MBRegistry *popReg;
+        MBString prefix;
+        MBString tmp;
+
+        popReg = MBRegistry_Alloc();
+        VERIFY(popReg != NULL);
+
+        MBString_Create(&prefix);
+        MBString_Create(&tmp);
+
+        for (i = 0; i < numFleets; i++) {
+            MBString_CopyCStr(&prefix, "fleet");
+            MBString_IntToString(&tmp, i + 1);
+            MBString_AppendStr(&prefix, &tmp);
+            MBString_AppendCStr(&prefix, ".");
+
+            /*
+             * Because we're using unique prefixes, we can assume that the
+             * key isn't already in the registry.
+             */
+            MBRegistry_PutAllUnique(popReg, fleetRegs[i],
+                                    MBString_GetCStr(&prefix));
+        }
+
+        MBString_IntToString(&tmp, numFleets);
+        MBRegistry_PutCopy(popReg, "numFleets", MBString_GetCStr(&tmp));
+
+        MBRegistry_Save(popReg, outputFile);
+
+        MBString_Destroy(&prefix);
+        MBString_Destroy(&tmp);
+        MBRegistry_Free(popReg);
+    }
+
+    for (i = 0; i < numFleets; i++) {
+        MBRegistry_Free(fleetRegs[i]);
+    }
+    free(fleetRegs);
+}
+
+static void MainUsePopulation(const char *file,
+                              bool incrementAge)
+{
+    MBRegistry *popReg = NULL;
+    MBRegistry *fleetReg;
+    Population pop;
+    bool binary;
+    uint32 numFleets;
+    uint32 numTargetFleets = 0;
+    MBString tmp;
+    BattlePlayer *mainPlayers;
+    uint32 mpSize;
+    uint32 *mpIndex = &mainData.numPlayers;
+
+    MainAddNeutralPlayer();
+
+    MBString_Create(&tmp);
+
+    fleetReg = MBRegistry_Alloc();
+    VERIFY(fleetReg != NULL);
+
+    ASSERT(file != NULL);
+    binary = Population_IsBinaryFile(file);
+
+    if (binary) {
+        /*
+         * Binary populations are indexed, so each fleet can be loaded
+         * directly out of the file.
+         */
+        Population_Open(&pop, file, FALSE);
+        numFleets = Population_NumFleets(&pop);
+    } else {
+        popReg = MBRegistry_Alloc();
+        VERIFY(popReg != NULL);
+        MBRegistry_Load(popReg, file);
+
+        if (!MBRegistry_ContainsKey(popReg, "numFleets")) {
+            PANIC("Missing key: numFleets (file=%s)\n", file);
+        }
+        numFleets = MBRegistry_GetUint(popReg, "numFleets");
+    }
+
+    if (numFleets == 0) {
+        PANIC("Bad value for numFleets=%d (file=%s)\n", numFleets, file);
+    }
+
+    MainReservePlayers(*mpIndex + numFleets);
+    mainPlayers = mainData.players;
+    mpSize = mainData.maxPlayers;
+
+    /*
+     * Load fleets.
+     */
+    for (uint32 i = 1; i <= numFleets; i++) {
+        MBRegistry_MakeEmpty(fleetReg);
+
+        if (binary) {
+            Population_LoadFleet(&pop, i, fleetReg);
+        } else {
+            MBString_IntToString(&tmp, i);
+            MBString_PrependCStr(&tmp, "fleet");
+            MBString_AppendCStr(&tmp, ".");
+
+            MBRegistry_SplitOnPrefix(fleetReg, popReg, MBString_GetCStr(&tmp),
+                                     FALSE);
+        }
+
+        ASSERT(*mpIndex < mpSize);
+
+        if (MBRegistry_GetCStr(fleetReg, "abattle.fleetName") == NULL) {
+            MBRegistry_DebugDump(fleetReg);
+            PANIC("Missing key: fleetName, i=%d\n", i);
+        }
+        if (MBRegistry_ContainsKey(fleetReg, "abattle.playerName")) {
+            mainPlayers[*mpIndex].playerName =
+                strdup(MBRegistry_GetCStr(fleetReg, "abattle.playerName"));
+        } else {
+            mainPlayers[*mpIndex].playerName =
+                strdup(MBRegistry_GetCStr(fleetReg, "abattle.fleetName"));
+        }
+
+        if (MBRegistry_ContainsKey(fleetReg, "abattle.age")) {
+            if (incrementAge) {
+                uint age = MBRegistry_GetUint(fleetReg, "abattle.age");
+                MBString_IntToString(&tmp, age + 1);
+                MBRegistry_PutCopy(fleetReg, "abattle.age",
+                                   MBString_GetCStr(&tmp));
+            }
+        } else {
+            MBRegistry_PutCopy(fleetReg, "abattle.age", "0");
+        }
+
+        mainPlayers[*mpIndex].mreg = MBRegistry_AllocCopy(fleetReg);
+        mainPlayers[*mpIndex].playerType =
+            PlayerType_FromString(MBRegistry_GetCStr(fleetReg, "abattle.playerType"));
+        VERIFY(mainPlayers[*mpIndex].playerType != PLAYER_TYPE_INVALID);
+        VERIFY(mainPlayers[*mpIndex].playerType < PLAYER_TYPE_MAX);
+
+        if (mainPlayers[*mpIndex].playerType == PLAYER_TYPE_TARGET) {
+            numTargetFleets++;
+        }
+
+        const char *fleetName = MBRegistry_GetCStr(fleetReg, "abattle.fleetName");
+        mainPlayers[*mpIndex].aiType = Fleet_GetTypeFromName(fleetName);
+        if (mainPlayers[*mpIndex].aiType == FLEET_AI_INVALID) {
+            PANIC("Unknown Fleet Name: %s\n", fleetName);
+        }
+
+        if (mainData.dedupe &&
+            mainPlayers[*mpIndex].playerType == PLAYER_TYPE_TARGET) {
+            mainPlayers[*mpIndex].behaviorHash =
+                Fleet_HashBehavior(mainPlayers[*mpIndex].aiType, fleetReg);
+        }
+        (*mpIndex)++;
+    }
+
+    if (binary) {
+        Population_Close(&pop);
+    } else {
+        MBRegistry_Free(popReg);
+    }
+    MBRegistry_Free(fleetReg);
+    MBString_Destroy(&tmp);
+}
+
+static uint32 MainFleetCompetition(BattlePlayer *mainPlayers, uint32 mpSize,
+                                   uint32 startingMPIndex, uint32 numFleets,
+                                   bool useWinRatio)
+{
+    float w1, w2;
     uint f1 = MainFindRandomFleet(mainPlayers, mpSize,
                                   startingMPIndex, numFleets,
                                   useWinRatio, &w1);
 
-    uint f2 = MainFindRandomFleet(mainPlayers, mpSize,
-                                  startingMPIndex, numFleets,
-                                  useWinRatio, &w2);
+    uint f2 = MainFindRandomFleet(mainPlayers, mpSize,
+                                  startingMPIndex, numFleets,
+                                  useWinRatio, &w2);
+
+    if (Random_Bit() || w1 >= w2) {
+        return f1;
+    } else {
+        return f2;
+    }
+}
+
+static uint32 MainFindRandomFleet(BattlePlayer *mainPlayers, uint32 mpSize,
+                                  uint32 startingMPIndex, uint32 numFleets,
+                                  bool useWinRatio, float *weightOut)
+{
+    uint32 iterations = 0;
+    uint32 i;
+
+    i = Random_Int(0, numFleets - 1);
+    while (TRUE) {
+        uint32 fi = i + startingMPIndex;
+        MBRegistry *fleetReg = mainPlayers[fi].mreg;
+        float sProb;
+        uint32 numBattles = MBRegistry_GetUint(fleetReg, "abattle.numBattles");
+        uint32 weight;
+
+        if (useWinRatio) {
+            weight = MBRegistry_GetUint(fleetReg, "abattle.numWins");
+        } else {
+            weight = MBRegistry_GetUint(fleetReg, "abattle.numLosses") +
+                     MBRegistry_GetUint(fleetReg, "abattle.numDraws");
+        }
+
+        sProb = numBattles > 0 ? weight / (float)numBattles : 0.0f;
+
+        sProb += (iterations / numFleets) + 0.01;
+        sProb = MIN(1.0f, sProb);
+        sProb = MAX(0.0f, sProb);
+        if (mainPlayers[fi].playerType == PLAYER_TYPE_TARGET) {
+            if (Random_Flip(sProb)) {
+                ASSERT(fi < mpSize);
+
+                if (weightOut != NULL) {
+                    *weightOut = sProb;
+                }
+                return fi;
+            }
+        }
+
+        //i = (i + 1) % numFleets;
+        i = Random_Int(0, numFleets - 1);
+        iterations++;
+
+        if (iterations > numFleets * 101) {
+            PANIC("Unable to select enough fleets\n");
+        }
+    }
+
+    NOT_REACHED();
+}
+
+static bool MainIsFleetDefective(BattlePlayer *player,
+                                 float defectiveLevel)
+{
+    MBRegistry *fleetReg = player->mreg;
+    uint numBattles;
+
+    if (defectiveLevel == 0.0f) {
+        return FALSE;
+    }
+
+    if (player->playerType != PLAYER_TYPE_TARGET) {
+        /*
+         * Keep anything that's not targeted.
+         */
+        return FALSE;
+    }
+
+    numBattles = MBRegistry_GetUint(fleetReg, "abattle.numBattles");
+    if (numBattles == 0) {
+        /*
+         * Keep brand-new fleets.
+         */
+        return FALSE;
+    }
+
+    uint numWins = MBRegistry_GetUint(fleetReg, "abattle.numWins");
+    float winRatio = (float)numWins / (float)numBattles;
+
+    if (winRatio < 0.0f) {
+        /*
+         * Something funny happened, probably someone manually editing
+         * the population file wrong.
+         */
+        return FALSE;
+    }
+
+    if (winRatio < defectiveLevel) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void MainKillFleet(BattlePlayer *mainPlayers,
+                          uint32 mpSize, uint32 *mpIndex,
+                          uint32 startingMPIndex, uint32 *numFleets,
+                          uint32 *numTargetFleets,
+                          uint32 fi)
+{
+    uint lastI = startingMPIndex + *numFleets - 1;
+    VERIFY(mainPlayers[fi].playerType == PLAYER_TYPE_TARGET);
+    MBRegistry_Free(mainPlayers[fi].mreg);
+    mainPlayers[fi] = mainPlayers[lastI];
+    MBUtil_Zero(&mainPlayers[lastI], sizeof(mainPlayers[lastI]));
+    mainPlayers[lastI].playerType = PLAYER_TYPE_INVALID;
+
+    ASSERT(*numFleets > 0);
+    (*numFleets)--;
+
+    if (numTargetFleets != NULL) {
+        ASSERT(*numTargetFleets > 0);
+        (*numTargetFleets)--;
+    }
+
+    if (mpIndex != NULL) {
+        ASSERT(*mpIndex > 0);
+        (*mpIndex)--;
+    }
+}
+
+
+static void MainMutateFleet(BattlePlayer *mainPlayers, uint32 mpSize,
+                            BattlePlayer *dest,
+                            uint32 mi, uint32 bi)
+{
+    BattlePlayer *src = &mainPlayers[mi];
+    BattlePlayer *breeder = &mainPlayers[bi];
+
+    ASSERT(mi < mpSize);
+
+    ASSERT(dest->playerType == PLAYER_TYPE_INVALID);
+    ASSERT(src->playerType == PLAYER_TYPE_TARGET);
+
+    Genome g;
+
+    MBRegistry_Free(dest->mreg);
+    *dest =*src;
+    dest->mreg = MBRegistry_Alloc();
+
+    dest->playerType = PLAYER_TYPE_TARGET;
+
+    /*
+     * Work on a Genome, and only convert back to text once we're done.
+     */
+    Genome_Create(&g);
+    Genome_LoadRegistry(&g, src->mreg);
+
+    /*
+     * Occaisonally, randomly mix traits with another fleet.
+     * This increases the odds that two beneficial traits will end up together
+     * without having to independently evolve twice.
+     */
+    if (Random_Flip(0.1f) &&
+        src != breeder &&
+        breeder->aiType == src->aiType &&
+        breeder->mreg != NULL) {
+        Genome bg;
+        Genome_Create(&bg);
+        Genome_LoadRegistry(&bg, breeder->mreg);
+        Genome_Crossover(&g, &bg);
+        Genome_Destroy(&bg);
+
+        MainDumpAddToKey(breeder->mreg, breeder->mreg, NULL, "abattle.numSpawn", 1);
+    }
+
+    MainDumpAddToKey(src->mreg, src->mreg, NULL, "abattle.numSpawn", 1);
+
+    Fleet_MutateGenome(src->aiType, &g);
+
+    Genome_Remove(&g, "abattle.numBattles");
+    Genome_Remove(&g, "abattle.numWins");
+    Genome_Remove(&g, "abattle.numLosses");
+    Genome_Remove(&g, "abattle.numDraws");
+    Genome_Remove(&g, "abattle.numSpawn");
+    Genome_RemoveAllWithPrefix(&g, "abattle.sprt");
+    Genome_PutCStr(&g, "abattle.age", "0");
+
+    Genome_SaveRegistry(&g, dest->mreg);
+    Genome_Destroy(&g);
+
+    dest->behaviorHash = 0;
+    if (mainData.dedupe) {
+        dest->behaviorHash = Fleet_HashBehavior(dest->aiType, dest->mreg);
+    }
+}
+
+static int MainEngineThreadMain(void *data)
+{
+    MainEngineThreadData *tData = data;
+    MainEngineWorkUnit wu;
+
+    /*
+     * Pin the thread before it allocates anything, so that its battles
+     * are allocated on its own node.
+     */
+    if (tData->cpu >= 0 && !Affinity_PinToCpu(tData->cpu)) {
+        Warning("Unable to pin %s to CPU %d\n", tData->threadName, tData->cpu);
+    }
+
+    while (TRUE) {
+        WorkQueue_WaitForItem(&mainData.workQ,
+                              MAIN_THREAD_QUEUE_SLOT(tData->threadId),
+                              &wu, sizeof(wu));
+
+        if (wu.type == MAIN_WORK_BATTLE) {
+            /*
+             * If SPRT already decided the battle, the result can't
+             * change the outcome anymore, so it's skipped.
+             */
+            if (!MainSprtIsDecided(wu.bscIndex)) {
+                MainEngineResultUnit ru;
+                MainRunBattle(tData, &wu, &ru);
+                WorkQueue_QueueItem(&mainData.resultQ,
+                                    MAIN_THREAD_QUEUE_SLOT(tData->threadId),
+                                    &ru, sizeof(ru));
+            }
+
+            MainFreePlayerRegs(wu.mregs);
+        } else if (wu.type == MAIN_WORK_EXIT) {
+            free(tData->bsc.players);
+            tData->bsc.players = NULL;
+            return 0;
+        } else {
+            NOT_IMPLEMENTED();
+        }
+
+        WorkQueue_FinishItem(&mainData.workQ);
+    }
+}
+
+static void MainRunBattle(MainEngineThreadData *tData,
+                          MainEngineWorkUnit *wu,
+                          MainEngineResultUnit *ru)
+{
+    bool finished = FALSE;
+    const BattleStatus *bStatus;
+
+    uint numPlayers = MainScenarioNumPlayers();
+
+    tData->battleId = wu->battleId;
+    tData->seed = wu->seed;
+
+    /*
+     * Build this battle's scenario, with the battle's own registries.
+     */
+    if (numPlayers > tData->maxPlayers) {
+        free(tData->bsc.players);
+        tData->bsc.players =
+            malloc(numPlayers * sizeof(tData->bsc.players[0]));
+        VERIFY(tData->bsc.players != NULL);
+        tData->maxPlayers = numPlayers;
+    }
+    MainScenarioBuild(wu->bscIndex, &tData->bsc);
+    for (uint i = 0; i < numPlayers; i++) {
+        tData->bsc.players[i].mreg = wu->mregs[i];
+    }
+
+    tData->battle = Battle_Create(&tData->bsc, wu->seed);
+
+    Warning("Starting Battle %d of %d...\n", tData->battleId,
+            mainData.totalBattles);
+    Warning("\n");
+
+    tData->startTimeMS = SDL_GetTicks();
+
+    while (!finished && !mainData.asyncExit) {
+        Mob *bMobs;
+        uint32 numMobs;
+
+        // Run the simulation
+        Battle_RunTick(tData->battle);
+
+        // Draw
+        if (!mainData.headless) {
+            bMobs = Battle_AcquireMobs(tData->battle, &numMobs);
+            Mob *dMobs = Display_AcquireMobs(numMobs, mainData.frameSkip);
+            if (dMobs != NULL) {
+                mainData.displayFrames++;
+                memcpy(dMobs, bMobs, numMobs * sizeof(bMobs[0]));
+                Display_ReleaseMobs();
+            }
+            Battle_ReleaseMobs(tData->battle);
+        }
+
+        bStatus = Battle_AcquireStatus(tData->battle);
+        if (mainData.numThreads == 1) {
+            uint s = mainData.headless ? 5000 : 500;
+            if (bStatus->tick % s == 0) {
+                MainPrintBattleStatus(tData, bStatus);
+            }
+        }
+        if (bStatus->finished) {
+            finished = TRUE;
+        }
+        Battle_ReleaseStatus(tData->battle);
+    }
+
+    bStatus = Battle_AcquireStatus(tData->battle);
+    MainPrintBattleStatus(tData, bStatus);
+
+    MBUtil_Zero(ru, sizeof(*ru));
+    ru->finished = bStatus->finished;
+    ru->tick = bStatus->tick;
+    ru->winner = bStatus->winner;
+    ru->winnerUID = bStatus->winnerUID;
+    ru->seed = wu->seed;
+    ru->collisions = bStatus->collisions;
+    ru->sensorContacts = bStatus->sensorContacts;
+    ru->spawns = bStatus->spawns;
+    ru->shipSpawns = bStatus->shipSpawns;
+    ru->bscIndex = wu->bscIndex;
+    ru->loopIndex = wu->loopIndex;
+    ru->cacheable = wu->cacheable && finished;
+    ru->cacheKey = wu->cacheKey;
+    ru->timed = finished;
+    ru->durationMS = SDL_GetTicks() - tData->startTimeMS;
+    ru->predictedMS = wu->predictedMS;
+    Battle_ReleaseStatus(tData->battle);
+
+    Warning("Battle %d of %d %s!\n", tData->battleId, mainData.totalBattles,
+            finished ? "Finished" : "Aborted");
+    Warning("\n");
+
+    Battle_Destroy(tData->battle);
+    tData->battle = NULL;
+}
+
+/*
+ * MainSprtIsDecided --
+ *    Is every target fleet in this battle already decided?
+ */
+static bool MainSprtIsDecided(uint bscIndex)
+{
+    bool anyTarget = FALSE;
+
+    if (!mainData.sprt.enabled) {
+        return FALSE;
+    }
+
+    for (uint p = 0; p < MainScenarioNumPlayers(); p++) {
+        BattlePlayer *player =
+            &mainData.players[MainScenarioSeat(bscIndex, p)];
+        if (player->playerType == PLAYER_TYPE_TARGET) {
+            PlayerUID puid = player->playerUID;
+            ASSERT(puid < mainData.numPlayers);
+            anyTarget = TRUE;
+            if (mainData.sprt.decision[puid] == MAIN_SPRT_UNDECIDED) {
+                return FALSE;
+            }
+        }
+    }
+
+    return anyTarget;
+}
+
+static void MainSprtUpdate(PlayerUID puid)
+{
+    MainWinnerData *wd = &mainData.winners[puid];
+    float llr;
+
+    ASSERT(puid < mainData.numPlayers);
+    if (mainData.sprt.decision[puid] != MAIN_SPRT_UNDECIDED) {
+        return;
+    }
+
+    llr = wd->wins * mainData.sprt.llrWin +
+          (wd->battles - wd->wins) * mainData.sprt.llrNonWin;
+
+    if (llr >= mainData.sprt.upperBound) {
+        mainData.sprt.decision[puid] = MAIN_SPRT_PASS;
+        mainData.sprt.numDecided++;
+    } else if (llr <= mainData.sprt.lowerBound) {
+        mainData.sprt.decision[puid] = MAIN_SPRT_FAIL;
+        mainData.sprt.numDecided++;
+    }
+}
+
+/*
+ * MainSprtInit --
+ *    Set up the SPRT from the command line, if it was requested.
+ */
+static void MainSprtInit(void)
+{
+    float defectiveLevel;
+    float delta = 0.05f;
+    float p0, p1;
+
+    if (!MBOpt_IsPresent("sprt")) {
+        return;
+    }
+    if (!MBOpt_IsPresent("defectiveLevel")) {
+        PANIC("--sprt requires --defectiveLevel\n");
+    }
+
+    defectiveLevel = MBOpt_GetFloat("defectiveLevel");
+    mainData.sprt.alpha = 0.05f;
+    mainData.sprt.beta = 0.05f;
+    if (MBOpt_IsPresent("sprtAlpha")) {
+        mainData.sprt.alpha = MBOpt_GetFloat("sprtAlpha");
+    }
+    if (MBOpt_IsPresent("sprtBeta")) {
+        mainData.sprt.beta = MBOpt_GetFloat("sprtBeta");
+    }
+    if (MBOpt_IsPresent("sprtDelta")) {
+        delta = MBOpt_GetFloat("sprtDelta");
+    }
+
+    VERIFY(mainData.sprt.alpha > 0.0f && mainData.sprt.alpha < 1.0f);
+    VERIFY(mainData.sprt.beta > 0.0f && mainData.sprt.beta < 1.0f);
+    VERIFY(delta > 0.0f);
+
+    p0 = MAX(0.001f, defectiveLevel - delta);
+    p1 = MIN(0.999f, defectiveLevel + delta);
+    VERIFY(p0 < p1);
+
+    mainData.sprt.llrWin = logf(p1 / p0);
+    mainData.sprt.llrNonWin = logf((1.0f - p1) / (1.0f - p0));
+    mainData.sprt.lowerBound =
+        logf(mainData.sprt.beta / (1.0f - mainData.sprt.alpha));
+    mainData.sprt.upperBound =
+        logf((1.0f - mainData.sprt.beta) / mainData.sprt.alpha);
+    mainData.sprt.enabled = TRUE;
+}
+
+/*
+ * MainUseCachedResult --
+ *    If the battle's result is already in the result cache, process it
+ *    instead of running the battle.
+ */
+static bool MainUseCachedResult(MainEngineWorkUnit *wu)
+{
+    MainEngineResultUnit ru;
+    BattleCacheRecord record;
+
+    if (!MainUsingResultCache()) {
+        return FALSE;
+    }
+
+    BattleScenario *bsc = &mainData.scenarios.mainBsc;
+
+    MainScenarioBuild(wu->bscIndex, bsc);
+    BattleCache_MakeKey(bsc, wu->seed, &wu->cacheKey);
+    wu->cacheable = TRUE;
+
+    if (!BattleCache_Lookup(&mainData.resultCache, &wu->cacheKey, &record)) {
+        return FALSE;
+    }
+
+    VERIFY(record.winner < bsc->bp.numPlayers);
+
+    MBUtil_Zero(&ru, sizeof(ru));
+    ru.bscIndex = wu->bscIndex;
+    ru.loopIndex = wu->loopIndex;
+    ru.finished = TRUE;
+    ru.tick = record.tick;
+    ru.winner = record.winner;
+    ru.winnerUID = bsc->players[record.winner].playerUID;
+    ru.seed = wu->seed;
+    ru.cached = TRUE;
+
+    MainProcessSingleResult(&ru);
+    return TRUE;
+}
+
+static void MainLogResult(MainEngineResultUnit *ru)
+{
+    BattleScenario *bsc = &mainData.scenarios.mainBsc;
+    ResultLogBattle battle;
+
+    MainScenarioBuild(ru->bscIndex, bsc);
+
+    MBUtil_Zero(&battle, sizeof(battle));
+    battle.seed = ru->seed;
+    battle.loopIndex = ru->loopIndex;
+    battle.tick = ru->tick;
+    battle.winnerUID = ru->winnerUID;
+    battle.collisions = ru->collisions;
+    battle.sensorContacts = ru->sensorContacts;
+    battle.spawns = ru->spawns;
+    battle.shipSpawns = ru->shipSpawns;
+    battle.durationMS = ru->timed ? ru->durationMS : 0;
+    battle.numPlayers = bsc->bp.numPlayers;
+    if (ru->finished) {
+        battle.flags |= RESULT_LOG_FLAG_FINISHED;
+    }
+    if (ru->cached) {
+        battle.flags |= RESULT_LOG_FLAG_CACHED;
+    }
+
+    ResultLog_AddBattle(&mainData.resultLog, &battle, bsc->players);
+}
+
+static void MainProcessSingleResult(MainEngineResultUnit *ru)
+{
+    uint b = ru->bscIndex;
+    uint numPlayers = MainScenarioNumPlayers();
+
+    ASSERT(b < mainData.scenarios.numScenarios);
+
+    for (uint p = 0; p < numPlayers; p++) {
+        PlayerUID puid = mainData.players[MainScenarioSeat(b, p)].playerUID;
+        ASSERT(puid < mainData.numPlayers);
+        MainRecordWinner(&mainData.winners[puid], puid, ru->winnerUID);
+
+        if (mainData.sprt.enabled &&
+            mainData.players[puid].playerType == PLAYER_TYPE_TARGET) {
+            MainSprtUpdate(puid);
+        }
+    }
+    if (numPlayers == 3) {
+        PlayerUID puid1 = mainData.players[MainScenarioSeat(b, 1)].playerUID;
+        PlayerUID puid2 = mainData.players[MainScenarioSeat(b, 2)].playerUID;
+        ASSERT(MainScenarioSeat(b, 0) == PLAYER_ID_NEUTRAL);
+        MainRecordWinner(MainBreakdownFind(puid1, puid2, TRUE),
+                         puid1, ru->winnerUID);
+        MainRecordWinner(MainBreakdownFind(puid2, puid1, TRUE),
+                         puid2, ru->winnerUID);
+
+        if (mainData.useRating) {
+            Rating_Update(&mainData.rating, puid1, puid2, ru->winnerUID);
+        }
+    }
+
+    if (mainData.crn.paired) {
+        ASSERT(ru->loopIndex < mainData.loop);
+
+        uint t = MainScenarioTargetIndex(b);
+        uint numCells = mainData.crn.numCells * mainData.loop;
+        uint cell = (b % mainData.crn.numCells) * mainData.loop +
+                    ru->loopIndex;
+        PlayerUID tuid =
+            mainData.players[mainData.scenarios.targets[t]].playerUID;
+
+        mainData.crn.outcomes[t * numCells + cell] =
+            ru->winnerUID == tuid ? MAIN_CRN_WIN : MAIN_CRN_NON_WIN;
+    }
+
+    if (ru->timed && mainData.useSchedule) {
+        Schedule_Record(&mainData.sched, ru->bscIndex, ru->durationMS,
+                        ru->predictedMS);
+    }
+
+    if (Serve_IsConnected(&mainData.serve) && numPlayers == 3) {
+        Serve_ReportBattle(&mainData.serve, ru->loopIndex,
+                           mainData.players[MainScenarioSeat(b, 1)].playerUID,
+                           mainData.players[MainScenarioSeat(b, 2)].playerUID,
+                           ru->winnerUID, ru->tick);
+    }
+
+    if (ru->cacheable) {
+        ASSERT(mainData.useResultCache);
+        BattleCache_Add(&mainData.resultCache, &ru->cacheKey,
+                        ru->winner, ru->tick);
+    }
+
+    if (mainData.useResultLog) {
+        MainLogResult(ru);
+    }
+
+    if (Checkpoint_IsActive(&mainData.ckpt)) {
+        Checkpoint_MarkDone(&mainData.ckpt,
+                            MainCheckpointBattle(ru->loopIndex,
+                                                 ru->bscIndex));
+    }
+}
+
+static void MainScenarioFile(MBString *filename, const char *scenario)
+{
+    MBString_AppendCStr(filename, "scenarios/");
+    MBString_AppendCStr(filename, scenario);
+    MBString_AppendCStr(filename, ".sc");
+}
+
+static void MainLoadScenario(MBRegistry *mreg, const char *scenario)
+{
+    MBString filename;
+    bool useDefault = FALSE;
+
+    struct {
+        const char *key;
+        const char *value;
+    } defaultValues[] = {
+        { "width",  "1600",            },
+        { "height", "1200",            },
+        { "startingCredits", "400",    },
+        { "creditsPerTick", "1",       },
+        { "tickLimit", "50000",        },
+        { "powerCoreDropRate", "0.25", },
+        { "powerCoreSpawnRate", "2.0", },
+        { "minPowerCoreSpawn", "10",   },
+        { "maxPowerCoreSpawn", "20",   },
+        { "restrictedStart", "TRUE",   },
+        { "startingBases",    "1",     },
+        { "startingFighters", "0",     },
+        { "baseVictory", "FALSE",      },
+    };
+
+    if (scenario == NULL) {
+        scenario = "default";
+        useDefault = TRUE;
+    }
+
+    MBString_Create(&filename);
+    MainScenarioFile(&filename, scenario);
+
+    if (access(MBString_GetCStr(&filename), F_OK) == -1) {
+        PANIC("Cannot access: %s\n", MBString_GetCStr(&filename));
+    }
+
+    if (useDefault) {
+        for (uint i = 0; i < ARRAYSIZE(defaultValues); i++) {
+            MBRegistry_PutConst(mreg, defaultValues[i].key,
+                                defaultValues[i].value);
+        }
+    }
+
+    MBRegistry_LoadSubset(mreg, MBString_GetCStr(&filename));
+    MBString_Destroy(&filename);
+
+    if (useDefault) {
+        for (uint i = 0; i < ARRAYSIZE(defaultValues); i++) {
+            ASSERT(strcmp(MBRegistry_GetCStr(mreg, defaultValues[i].key),
+                          defaultValues[i].value) == 0);
+        }
+    }
+}
+
+static void MainSanitizeFleetCmd()
+{
+    /*
+     * This is a hack-job, but it works well enough for now.
+     */
+    uint fleetNum = MBOpt_GetUint("dumpFleet");
+    FleetAI ai;
+    MBRegistry *popReg = MBRegistry_Alloc();
+    MBRegistry *fleetReg = MBRegistry_Alloc();
+    MBRegistry *cleanReg = MBRegistry_Alloc();
+    MBString tmp;
+    const char *file = MBOpt_GetCStr("usePopulation");
+
+    VERIFY(popReg != NULL);
+    VERIFY(fleetReg != NULL);
+
+    MBString_Create(&tmp);
+
+    if (Population_IsBinaryFile(file)) {
+        Population pop;
+        Population_Open(&pop, file, FALSE);
+        Population_LoadFleet(&pop, fleetNum, fleetReg);
+        Population_Close(&pop);
+    } else {
+        MBRegistry_Load(popReg, file);
+
+        MBString_IntToString(&tmp, fleetNum);
+        MBString_PrependCStr(&tmp, "fleet");
+        MBString_AppendCStr(&tmp, ".");
+
+        MBRegistry_SplitOnPrefix(fleetReg, popReg, MBString_GetCStr(&tmp),
+                                 FALSE);
+    }
+
+    const char *fleetStr = MBRegistry_GetCStr(fleetReg, "abattle.fleetName");
+    FleetAIType aiType = Fleet_GetTypeFromName(fleetStr);
+
+    BattleParams bp;
+    MBUtil_Zero(&bp, sizeof(bp));
+
+    BattlePlayer player;
+    MBUtil_Zero(&player, sizeof(player));
+    player.mreg = fleetReg;
+    Fleet_CreateAI(&ai, aiType, 0, &bp, &player, 0x0);
+
+    if (ai.ops.dumpSanitizedParams == NULL) {
+        PANIC("Unsupported fleet: %s\n", fleetStr);
+    }
+
+    ai.ops.dumpSanitizedParams(ai.aiHandle, cleanReg);
+
+    MBRegistry_SaveToConsole(cleanReg);
+
+    MBRegistry_Free(popReg);
+    MBRegistry_Free(fleetReg);
+    MBRegistry_Free(cleanReg);
+    MBString_Destroy(&tmp);
+}
+
+static void MainThreadsInit(void)
+{
+    uint numSlots = MAIN_THREAD_QUEUE_SLOT(mainData.numThreads);
+    WorkQueue_Create(&mainData.workQ, sizeof(MainEngineWorkUnit), numSlots);
+    WorkQueue_Create(&mainData.resultQ, sizeof(MainEngineResultUnit),
+                     numSlots);
+    WorkQueue_SetSpinCount(&mainData.workQ, mainData.queueSpin);
+    WorkQueue_SetSpinCount(&mainData.resultQ, mainData.queueSpin);
+
+    if (mainData.affinity != AFFINITY_NONE) {
+        Affinity_PrintTopology();
+        Warning("Placing %d engine threads with --affinity %s:\n",
+                mainData.numThreads, Affinity_PolicyToString(mainData.affinity));
+    }
+
+    uint tDataSize = mainData.numThreads * sizeof(mainData.tData[0]);
+    mainData.tData = malloc(tDataSize);
+    for (uint i = 0; i < mainData.numThreads; i++) {
+        MainEngineThreadData *tData = &mainData.tData[i];
+
+        MBUtil_Zero(tData, sizeof(*tData));
+
+        tData->cpu = Affinity_ChooseCpu(mainData.affinity, i, &tData->node);
+        if (tData->cpu >= 0) {
+            Warning("\tbattle%d: CPU %d, node %d\n", i, tData->cpu,
+                    tData->node);
+        }
+
+        tData->threadId = i;
+        uint threadNameLen = sizeof(tData->threadName);
+        snprintf(&tData->threadName[0], threadNameLen, "battle%d", i);
+        tData->threadName[threadNameLen - 1] = '\0';
+
+        tData->sdlThread =
+            SDL_CreateThread(MainEngineThreadMain, &tData->threadName[0], tData);
+        ASSERT(tData->sdlThread != NULL);
+    }
+
+    mainData.threadsInitialized = TRUE;
+}
+
+static void MainThreadsRequestExit(void)
+{
+    ASSERT(mainData.threadsInitialized);
+    for (uint i = 0; i < mainData.numThreads; i++) {
+        MainEngineWorkUnit wu;
+        MBUtil_Zero(&wu, sizeof(wu));
+        wu.type = MAIN_WORK_EXIT;
+        WorkQueue_QueueItem(&mainData.workQ, MAIN_QUEUE_SLOT,
+                            &wu, sizeof(wu));
+    }
+
+    mainData.threadsRequestExit = TRUE;
+}
+
+static void MainThreadsExit(void)
+{
+    ASSERT(mainData.threadsInitialized);
+    ASSERT(mainData.threadsRequestExit);
+
+    for (uint i = 0; i < mainData.numThreads; i++) {
+        SDL_WaitThread(mainData.tData[i].sdlThread, NULL);
+    }
+    ASSERT(WorkQueue_IsEmpty(&mainData.workQ));
+
+    WorkQueue_Destroy(&mainData.workQ);
+    WorkQueue_Destroy(&mainData.resultQ);
+    free(mainData.tData);
+    mainData.tData = NULL;
+
+    mainData.threadsInitialized = FALSE;
+    mainData.threadsRequestExit = FALSE;
+}
+
+static void MainCleanupSinglePlayer(uint p)
+{
+    ASSERT(p < mainData.numPlayers);
+    ASSERT(mainData.players[p].playerType != PLAYER_TYPE_INVALID);
+
+    if (mainData.players[p].mreg != NULL) {
+        MBRegistry_Free(mainData.players[p].mreg);
+        mainData.players[p].mreg = NULL;
+    }
+    mainData.players[p].playerType = PLAYER_TYPE_INVALID;
+}
 
-    if (Random_Bit() || w1 >= w2) {
-        return f1;
-    } else {
-        return f2;
+static void MainCleanupPlayers(void)
+{
+    for (uint p = 0; p < mainData.numPlayers; p++) {
+        MainCleanupSinglePlayer(p);
     }
 }
 
-static uint32 MainFindRandomFleet(BattlePlayer *mainPlayers, uint32 mpSize,
-                                  uint32 startingMPIndex, uint32 numFleets,
-                                  bool useWinRatio, float *weightOut)
+/*
+ * MainMutatePopulation --
+ *    Breed count new fleets from the current players into mutants,
+ *    which must be zeroed.
+ */
+static void MainMutatePopulation(BattlePlayer *mutants, uint count)
 {
-    uint32 iterations = 0;
-    uint32 i;
+    uint numRetries = 0;
+    MainDedupeTable dt;
 
-    i = Random_Int(0, numFleets - 1);
-    while (TRUE) {
-        uint32 fi = i + startingMPIndex;
-        MBRegistry *fleetReg = mainPlayers[fi].mreg;
-        float sProb;
-        uint32 numBattles = MBRegistry_GetUint(fleetReg, "abattle.numBattles");
-        uint32 weight;
+    /*
+     * The mutants go in the table after the players.
+     */
+    MainDedupeBegin(&dt, mainData.numPlayers + count);
+    for (uint p = 1; p < mainData.numPlayers; p++) {
+        MainDedupeAdd(&dt, &mainData.players[p], p);
+    }
 
-        if (useWinRatio) {
-            weight = MBRegistry_GetUint(fleetReg, "abattle.numWins");
-        } else {
-            weight = MBRegistry_GetUint(fleetReg, "abattle.numLosses") +
-                     MBRegistry_GetUint(fleetReg, "abattle.numDraws");
+    for (uint i = 0; i < count; i++) {
+        uint mIndex = mainData.numPlayers + i;
+        uint attempt = 0;
+
+        while (TRUE) {
+            uint32 mi = MainFleetCompetition(&mainData.players[0],
+                                             mainData.numPlayers,
+                                             1, mainData.numPlayers - 1,
+                                             TRUE);
+            uint32 bi = MainFleetCompetition(&mainData.players[0],
+                                             mainData.numPlayers,
+                                             1, mainData.numPlayers - 1,
+                                             TRUE);
+            MainMutateFleet(&mainData.players[0], mainData.numPlayers,
+                            &mutants[i], mi, bi);
+
+            /*
+             * Low mutation rates often don't change anything that
+             * matters, so try again rather than adding a fleet that
+             * plays exactly like an existing one.
+             */
+            if (attempt >= MAIN_DEDUPE_MAX_RETRIES ||
+                MainDedupeAdd(&dt, &mutants[i], mIndex) == mIndex) {
+                break;
+            }
+
+            MBRegistry_Free(mutants[i].mreg);
+            MBUtil_Zero(&mutants[i], sizeof(mutants[i]));
+            mutants[i].playerType = PLAYER_TYPE_INVALID;
+            attempt++;
+            numRetries++;
         }
+    }
 
-        sProb = numBattles > 0 ? weight / (float)numBattles : 0.0f;
+    MainDedupeEnd(&dt);
 
-        sProb += (iterations / numFleets) + 0.01;
-        sProb = MIN(1.0f, sProb);
-        sProb = MAX(0.0f, sProb);
-        if (mainPlayers[fi].playerType == PLAYER_TYPE_TARGET) {
-            if (Random_Flip(sProb)) {
-                ASSERT(fi < mpSize);
+    if (numRetries > 0) {
+        Warning("Re-mutated %d duplicate fleets.\n", numRetries);
+    }
+}
 
-                if (weightOut != NULL) {
-                    *weightOut = sProb;
-                }
-                return fi;
-            }
-        }
+static void MainMutateCmd(void)
+{
+    BattlePlayer *mutants;
+    const char *outputFile = MBOpt_GetCStr("outputFile");
+    const char *inputFile = MBOpt_GetCStr("usePopulation");
 
-        //i = (i + 1) % numFleets;
-        i = Random_Int(0, numFleets - 1);
-        iterations++;
+    if (outputFile == NULL) {
+        PANIC("--outputFile required for mutate\n");
+    }
+    if (inputFile == NULL) {
+        PANIC("--usePopulation required for mutate\n");
+    }
 
-        if (iterations > numFleets * 101) {
-            PANIC("Unable to select enough fleets\n");
-        }
+    ASSERT(mainData.numPlayers == 0);
+    MainUsePopulation(MBOpt_GetCStr("usePopulation"), FALSE);
+
+    VERIFY(mainData.numPlayers > 0);
+
+    uint actualMutateCount = MBOpt_GetUint("mutationCount");
+
+    mutants = calloc(MAX(1, actualMutateCount), sizeof(mutants[0]));
+    VERIFY(mutants != NULL);
+    MainMutatePopulation(mutants, actualMutateCount);
+
+    // Dump the original population (with updated numSpawns)
+    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+    MainDumpPopulation(inputFile, FALSE);
+    MainCleanupPlayers();
+
+    // Dump the new mutants to the outputFile
+    mainData.numPlayers = 0;
+    MBUtil_Zero(&mainData.players[0], sizeof(mainData.players[0]));
+    MainAddNeutralPlayer();
+
+    MainReservePlayers(mainData.numPlayers + actualMutateCount);
+    for (uint i = 0; i < actualMutateCount; i++) {
+        mainData.players[mainData.numPlayers] = mutants[i];
+        mainData.numPlayers++;
     }
+    free(mutants);
 
-    NOT_REACHED();
+    MainDumpPopulation(outputFile, FALSE);
+    MainCleanupPlayers();
 }
 
-static bool MainIsFleetDefective(BattlePlayer *player,
-                                 float defectiveLevel)
+static void MainDefaultCmd(void)
 {
-    MBRegistry *fleetReg = player->mreg;
-    uint numBattles;
+    MainBattleType bt = MAIN_BT_SINGLE;
 
-    if (defectiveLevel == 0.0f) {
-        return FALSE;
+    MainConstructScenarios(TRUE, bt);
+    MainRunScenarios();
+
+    if (MBOpt_IsPresent("dumpPopulation")) {
+        MainDumpPopulation(MBOpt_GetCStr("dumpPopulation"), FALSE);
     }
 
-    if (player->playerType != PLAYER_TYPE_TARGET) {
-        /*
-         * Keep anything that's not targeted.
-         */
-        return FALSE;
+    MainCleanupPlayers();
+}
+
+/*
+ * MainKillFleets --
+ *    Kill the defective fleets, and then enough more to bring the
+ *    population within [minPop, maxPop], or to satisfy killRatio.
+ *    Returns the number of fleets killed.
+ */
+static uint MainKillFleets(float defectiveLevel, uint minPop, uint maxPop,
+                           float killRatio)
+{
+    // Account for FLEET_AI_NEUTRAL
+    uint numFleets = mainData.numPlayers - 1;
+    uint actualKillCount = 0;
+
+    if (numFleets <= minPop) {
+        Warning("Population is already too low pop=%d, minPop=%d\n",
+                numFleets, minPop);
+        Warning("Not killing anything.\n");
+        return 0;
     }
 
-    numBattles = MBRegistry_GetUint(fleetReg, "abattle.numBattles");
-    if (numBattles == 0) {
-        /*
-         * Keep brand-new fleets.
-         */
-        return FALSE;
+    /*
+     * Merge duplicate fleets into the first copy.  The duplicates' stats
+     * were copied from the first copy by MainShareDuplicateResults, so
+     * they aren't added again.  Killing a fleet moves the last one into
+     * its place, so the ones before i keep their indices.
+     */
+    uint numMerged = 0;
+    uint i = 1;
+    MainDedupeTable dt;
+    MainDedupeBegin(&dt, mainData.numPlayers);
+    while (mainData.dedupe && numFleets > minPop && i < mainData.numPlayers) {
+        BattlePlayer *dup = &mainData.players[i];
+        uint d = MainDedupeAdd(&dt, dup, i);
+
+        if (d < i) {
+            MBRegistry *mreg = mainData.players[d].mreg;
+
+            if (MBRegistry_GetUint(dup->mreg, "abattle.age") >
+                MBRegistry_GetUint(mreg, "abattle.age")) {
+                MBRegistry_PutCopy(mreg, "abattle.age",
+                                   MBRegistry_GetCStr(dup->mreg,
+                                                      "abattle.age"));
+            }
+
+            MainKillFleet(&mainData.players[0], mainData.numPlayers,
+                          NULL, 1, &numFleets, NULL, i);
+            mainData.numPlayers--;
+            numMerged++;
+            actualKillCount++;
+        } else {
+            i++;
+        }
     }
 
-    uint numWins = MBRegistry_GetUint(fleetReg, "abattle.numWins");
-    float winRatio = (float)numWins / (float)numBattles;
+    if (numMerged > 0) {
+        Warning("Merged %d duplicate fleets.\n", numMerged);
+    }
+    MainDedupeEnd(&dt);
 
-    if (winRatio < 0.0f) {
-        /*
-         * Something funny happened, probably someone manually editing
-         * the population file wrong.
-         */
-        return FALSE;
+    /*
+     * Kill defective fleets.
+     */
+    i = 1;
+    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+    while (numFleets > minPop && i < mainData.numPlayers) {
+        ASSERT(numFleets > 0);
+        ASSERT(numFleets < mainData.numPlayers);
+        ASSERT(mainData.numPlayers > 1);
+        ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+
+        if (MainIsFleetDefective(&mainData.players[i], defectiveLevel)) {
+            MainKillFleet(&mainData.players[0], mainData.numPlayers,
+                          NULL, 1, &numFleets, NULL, i);
+            /*
+             * Re-use the same i index because we swapped the fleet
+             * out.
+             */
+            ASSERT(i > 0);
+            i--;
+
+            ASSERT(numFleets >= 0);
+            ASSERT(mainData.numPlayers > 0);
+            mainData.numPlayers--;
+            ASSERT(mainData.numPlayers > 0);
+            ASSERT(numFleets < mainData.numPlayers);
+
+            actualKillCount++;
+        }
+
+        i++;
     }
 
-    if (winRatio < defectiveLevel) {
-        return TRUE;
+    if (actualKillCount > 0) {
+        Warning("Killed %d defective fleets.\n", actualKillCount);
     }
 
-    return FALSE;
+    uint targetKillCount = numFleets * killRatio;
+
+    if (minPop > 0) {
+        targetKillCount = MIN(numFleets - minPop, targetKillCount);
+    }
+    if (numFleets > maxPop) {
+        targetKillCount = MAX(numFleets - maxPop, targetKillCount);
+    }
+
+    ASSERT(targetKillCount <= numFleets);
+
+    while (targetKillCount > 0) {
+        ASSERT(numFleets > 0);
+        ASSERT(numFleets < mainData.numPlayers);
+        ASSERT(mainData.numPlayers > 1);
+        ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+
+        uint32 ki = MainFleetCompetition(&mainData.players[0],
+                                         mainData.numPlayers,
+                                         1, numFleets, FALSE);
+        MainKillFleet(&mainData.players[0], mainData.numPlayers,
+                      NULL, 1, &numFleets, NULL, ki);
+        targetKillCount--;
+        actualKillCount++;
+        ASSERT(numFleets >= 0);
+        ASSERT(mainData.numPlayers > 0);
+        mainData.numPlayers--;
+        ASSERT(mainData.numPlayers > 0);
+        ASSERT(numFleets < mainData.numPlayers);
+    }
+
+    ASSERT(numFleets >= minPop);
+    ASSERT(numFleets <= maxPop);
+
+    Warning("Killed %d total fleets.\n", actualKillCount);
+    Warning("%d fleets remaining.\n", numFleets);
+
+    return actualKillCount;
 }
 
-static void MainKillFleet(BattlePlayer *mainPlayers,
-                          uint32 mpSize, uint32 *mpIndex,
-                          uint32 startingMPIndex, uint32 *numFleets,
-                          uint32 *numTargetFleets,
-                          uint32 fi)
+static void MainKillCmd(void)
 {
-    uint lastI = startingMPIndex + *numFleets - 1;
-    VERIFY(mainPlayers[fi].playerType == PLAYER_TYPE_TARGET);
-    mainPlayers[fi] = mainPlayers[lastI];
-    MBUtil_Zero(&mainPlayers[lastI], sizeof(mainPlayers[lastI]));
-    mainPlayers[lastI].playerType = PLAYER_TYPE_INVALID;
+    const char *file = MBOpt_GetCStr("usePopulation");
+
+    if (file == NULL) {
+        PANIC("--usePopulation required for kill\n");
+    }
+
+    ASSERT(mainData.numPlayers == 0);
+    MainUsePopulation(MBOpt_GetCStr("usePopulation"), FALSE);
+    VERIFY(mainData.numPlayers > 0);
+
+    // Account for FLEET_AI_NEUTRAL
+    uint numFleets = mainData.numPlayers - 1;
+
+    uint actualKillCount;
+    uint minPop = 0;
+    uint maxPop = numFleets;
+    float killRatio = 0.0f;
+    if (MBOpt_IsPresent("minPop")) {
+        minPop = MBOpt_GetUint("minPop");
+    }
+    if (MBOpt_IsPresent("maxPop")) {
+        maxPop = MBOpt_GetUint("maxPop");
+    }
+    if (MBOpt_IsPresent("killRatio")) {
+        killRatio = MBOpt_GetFloat("killRatio");
+    }
 
-    ASSERT(*numFleets > 0);
-    (*numFleets)--;
+    actualKillCount = MainKillFleets(MBOpt_GetFloat("defectiveLevel"),
+                                     minPop, maxPop, killRatio);
 
-    if (numTargetFleets != NULL) {
-        ASSERT(*numTargetFleets > 0);
-        (*numTargetFleets)--;
+    // Dump the original population (with updated numSpawns)
+    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+    if (actualKillCount > 0 || MBOpt_IsPresent("resetAfter")) {
+        if (MBOpt_IsPresent("resetAfter")) {
+            MainResetFleetStats();
+        }
+        MainDumpPopulation(file, FALSE);
     }
 
-    if (mpIndex != NULL) {
-        ASSERT(*mpIndex > 0);
-        (*mpIndex)--;
-    }
+    MainCleanupPlayers();
 }
 
-
-static void MainMutateFleet(BattlePlayer *mainPlayers, uint32 mpSize,
-                            BattlePlayer *dest,
-                            uint32 mi, uint32 bi)
+static void MainMeasureCmd(void)
 {
-    BattlePlayer *src = &mainPlayers[mi];
-    BattlePlayer *breeder = &mainPlayers[bi];
-
-    ASSERT(mi < mpSize);
-
-    ASSERT(dest->playerType == PLAYER_TYPE_INVALID);
-    ASSERT(src->playerType == PLAYER_TYPE_TARGET);
+    const char *file = MBOpt_GetCStr("usePopulation");
+    if (file == NULL) {
+        PANIC("--usePopulation required for measure\n");
+    }
 
-    MBRegistry_Free(dest->mreg);
-    *dest =*src;
-    dest->mreg = MBRegistry_AllocCopy(src->mreg);
+    const char *controlFile = MBOpt_GetCStr("controlPopulation");
+    if (controlFile == NULL) {
+        PANIC("--controlPopulation required for measure\n");
+    }
 
-    dest->playerType = PLAYER_TYPE_TARGET;
+    ASSERT(mainData.numPlayers == 0);
+    MainUsePopulation(controlFile, FALSE);
+    VERIFY(mainData.numPlayers > 0);
 
-    /*
-     * Occaisonally, randomly mix traits with another fleet.
-     * This increases the odds that two beneficial traits will end up together
-     * without having to independently evolve twice.
-     */
-    if (Random_Flip(0.1f) &&
-        src != breeder &&
-        breeder->aiType == src->aiType &&
-        breeder->mreg != NULL) {
-        uint size = MBRegistry_NumEntries(breeder->mreg);
-        for (uint i = 0; i < size; i++) {
-            if (Random_Bit()) {
-                const char *key = MBRegistry_GetKeyAt(breeder->mreg, i);
-                const char *value = MBRegistry_GetValueAt(breeder->mreg, i);
-                MBRegistry_PutCopy(dest->mreg, key, value);
-            }
+    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+    for (uint i = 1; i < mainData.numPlayers; i++) {
+        if (mainData.players[i].playerType != PLAYER_TYPE_CONTROL) {
+            PANIC("measure needs a control fleet\n");
         }
+    }
+    uint lastControl = mainData.numPlayers - 1;
 
-        MainDumpAddToKey(breeder->mreg, breeder->mreg, NULL, "abattle.numSpawn", 1);
+    MainUsePopulation(file, TRUE);
+    VERIFY(mainData.numPlayers > 0);
+    for (uint i = lastControl + 1; i < mainData.numPlayers; i++) {
+        VERIFY(mainData.players[i].playerType == PLAYER_TYPE_TARGET);
     }
 
-    MainDumpAddToKey(src->mreg, src->mreg, NULL, "abattle.numSpawn", 1);
+    MainConstructScenarios(FALSE, MAIN_BT_OPTIMIZE);
+    MainRunScenarios();
 
-    Fleet_Mutate(src->aiType, dest->mreg);
+    MainDumpPopulation(file, TRUE);
 
-    MBRegistry_Remove(dest->mreg, "abattle.numBattles");
-    MBRegistry_Remove(dest->mreg, "abattle.numWins");
-    MBRegistry_Remove(dest->mreg, "abattle.numLosses");
-    MBRegistry_Remove(dest->mreg, "abattle.numDraws");
-    MBRegistry_Remove(dest->mreg, "abattle.numSpawn");
-    MBRegistry_PutConst(dest->mreg, "abattle.age", "0");
+    MainCleanupPlayers();
 }
 
-static int MainEngineThreadMain(void *data)
+static void MainOptimizeCmd(void)
 {
-    MainEngineThreadData *tData = data;
-    MainEngineWorkUnit wu;
-
-    while (TRUE) {
-        WorkQueue_WaitForItem(&mainData.workQ, &wu, sizeof(wu));
+    const char *file = MBOpt_GetCStr("usePopulation");
+    const char *controlFile = MBOpt_GetCStr("controlPopulation");
 
-        if (wu.type == MAIN_WORK_BATTLE) {
-            MainRunBattle(tData, &wu);
-        } else if (wu.type == MAIN_WORK_EXIT) {
-            return 0;
-        } else {
-            NOT_IMPLEMENTED();
-        }
+    ASSERT(mainData.numPlayers == 0);
+    if (controlFile == NULL) {
+        MainLoadAllAsControlPlayers();
+    } else {
+        MainUsePopulation(controlFile, FALSE);
+    }
 
-        WorkQueue_FinishItem(&mainData.workQ);
+    VERIFY(mainData.numPlayers > 0);
+    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+    for (uint i = 1; i < mainData.numPlayers; i++) {
+        VERIFY(mainData.players[i].playerType == PLAYER_TYPE_CONTROL);
     }
-}
+    uint lastControl = mainData.numPlayers - 1;
 
-static void MainRunBattle(MainEngineThreadData *tData,
-                          MainEngineWorkUnit *wu)
-{
-    bool finished = FALSE;
-    const BattleStatus *bStatus;
+    if (file == NULL) {
+        MainAddTargetPlayersForOptimize();
+    } else {
+        MainUsePopulation(file, TRUE);
+    }
 
-    tData->battleId = wu->battleId;
-    tData->seed = wu->seed;
-    tData->bsc = wu->bsc;
-    tData->battle = Battle_Create(&tData->bsc, wu->seed);
+    VERIFY(mainData.numPlayers > 1);
+    for (uint i = lastControl + 1; i < mainData.numPlayers; i++) {
+        VERIFY(mainData.players[i].playerType == PLAYER_TYPE_TARGET);
+    }
 
-    Warning("Starting Battle %d of %d...\n", tData->battleId,
-            mainData.totalBattles);
-    Warning("\n");
+    MainConstructScenarios(FALSE, MAIN_BT_OPTIMIZE);
+    MainRunScenarios();
+    MainCleanupPlayers();
+}
 
-    tData->startTimeMS = SDL_GetTicks();
+/*
+ * MainRatedTournament --
+ *    Instead of the full round robin, play rounds of rating-based
+ *    matchups, so each fleet plays O(log p) other fleets.
+ */
+static void MainRatedTournament(void)
+{
+    Rating *r = &mainData.rating;
+    uint numFleets = mainData.numPlayers - 1;
+    uint rounds;
+    uint *order;
+    uint n;
 
-    while (!finished && !mainData.asyncExit) {
-        Mob *bMobs;
-        uint32 numMobs;
+    VERIFY(numFleets >= 2);
 
-        // Run the simulation
-        Battle_RunTick(tData->battle);
+    if (MBOpt_IsPresent("rounds")) {
+        rounds = MBOpt_GetUint("rounds");
+    } else {
+        rounds = 2 * (uint)ceilf(log2f(numFleets));
+    }
+    rounds = MAX(1, rounds);
 
-        // Draw
-        if (!mainData.headless) {
-            bMobs = Battle_AcquireMobs(tData->battle, &numMobs);
-            Mob *dMobs = Display_AcquireMobs(numMobs, mainData.frameSkip);
-            if (dMobs != NULL) {
-                mainData.displayFrames++;
-                memcpy(dMobs, bMobs, numMobs * sizeof(bMobs[0]));
-                Display_ReleaseMobs();
-            }
-            Battle_ReleaseMobs(tData->battle);
-        }
+    mainData.useRating = TRUE;
+    Rating_Create(r, mainData.numPlayers);
 
-        bStatus = Battle_AcquireStatus(tData->battle);
-        if (mainData.numThreads == 1) {
-            uint s = mainData.headless ? 5000 : 500;
-            if (bStatus->tick % s == 0) {
-                MainPrintBattleStatus(tData, bStatus);
-            }
-        }
-        if (bStatus->finished) {
-            finished = TRUE;
-        }
-        Battle_ReleaseStatus(tData->battle);
+    /*
+     * Keep the same engine threads for every round, unless the battles
+     * go to worker processes instead.
+     */
+    if (mainData.numWorkers == 0) {
+        mainData.numThreads = MAX(1, mainData.numThreads);
+        MainThreadsInit();
     }
 
-    {
-        MainEngineResultUnit ru;
-
-        bStatus = Battle_AcquireStatus(tData->battle);
-        MainPrintBattleStatus(tData, bStatus);
+    for (uint round = 0; round < rounds; round++) {
+        Warning("Starting round %d of %d...\n", round + 1, rounds);
+        Rating_PairPlayers(r);
+        MainConstructScenarios(FALSE, MAIN_BT_RATED);
+        MainRunScenarios();
+    }
 
-        MBUtil_Zero(&ru, sizeof(ru));
-        ru.bs = *bStatus;
-        WorkQueue_QueueItem(&mainData.resultQ, &ru, sizeof(ru));
-        Battle_ReleaseStatus(tData->battle);
+    if (mainData.threadsInitialized) {
+        MainThreadsRequestExit();
+        MainThreadsExit();
     }
 
-    Warning("Battle %d of %d %s!\n", tData->battleId, mainData.totalBattles,
-            finished ? "Finished" : "Aborted");
+    MainPrintWinners();
+
+    order = malloc(mainData.numPlayers * sizeof(order[0]));
+    VERIFY(order != NULL);
+    n = Rating_SortPlayers(r, order);
     Warning("\n");
+    Warning("Ratings:\n");
+    for (uint i = n; i > 0; i--) {
+        uint p = order[i - 1];
+        Warning("\t%3d. %6.1f (%3d battles) %s\n", n - i + 1,
+                r->rating[p], r->games[p],
+                mainData.players[p].playerName);
+    }
 
-    Battle_Destroy(tData->battle);
-    tData->battle = NULL;
+    free(order);
 
-    for (uint i = 0; i < tData->bsc.bp.numPlayers; i++) {
-        if (tData->bsc.players[i].mreg != NULL) {
-            MBRegistry_Free(tData->bsc.players[i].mreg);
-            tData->bsc.players[i].mreg = NULL;
-        }
+    if (MBOpt_IsPresent("updateRankings")) {
+        Rating_UpdateRankingsFile(r, mainData.players,
+                                  MBOpt_GetCStr("updateRankings"));
     }
+
+    Rating_Destroy(r);
+    mainData.useRating = FALSE;
 }
 
-static void MainProcessSingleResult(MainEngineResultUnit *ru)
+static void MainTournamentCmd(void)
 {
-    for (uint p = 0; p < ru->bs.numPlayers; p++) {
-        PlayerUID puid = ru->bs.players[p].playerUID;
-        ASSERT(puid < ARRAYSIZE(mainData.winners));
-        MainRecordWinner(&mainData.winners[puid], puid, &ru->bs);
+    const char *file = MBOpt_GetCStr("usePopulation");
+
+    mainData.printWinnerBreakdown = TRUE;
+
+    ASSERT(mainData.numPlayers == 0);
+    MainAddNeutralPlayer();
+
+    if (file == NULL) {
+        MainLoadAllAsControlPlayers();
+    } else {
+        MainUsePopulation(file, TRUE);
     }
-    if (ru->bs.numPlayers == 3) {
-        PlayerUID puid1 = ru->bs.players[1].playerUID;
-        PlayerUID puid2 = ru->bs.players[2].playerUID;
-        ASSERT(ru->bs.players[0].playerUID == PLAYER_ID_NEUTRAL);
-        MainRecordWinner(&mainData.winnerBreakdown[puid1][puid2],
-                         puid1, &ru->bs);
-        MainRecordWinner(&mainData.winnerBreakdown[puid2][puid1],
-                         puid2, &ru->bs);
+
+    if (MBOpt_IsPresent("rated")) {
+        mainData.printWinnerBreakdown = FALSE;
+        MainRatedTournament();
+    } else {
+        MainConstructScenarios(FALSE, MAIN_BT_TOURNAMENT);
+        MainRunScenarios();
     }
+    MainCleanupPlayers();
 }
 
-static void MainLoadScenario(MBRegistry *mreg, const char *scenario)
+static void MainMergeCmd(void)
 {
-    MBString filename;
-    bool useDefault = FALSE;
-
-    struct {
-        const char *key;
-        const char *value;
-    } defaultValues[] = {
-        { "width",  "1600",            },
-        { "height", "1200",            },
-        { "startingCredits", "400",    },
-        { "creditsPerTick", "1",       },
-        { "tickLimit", "50000",        },
-        { "powerCoreDropRate", "0.25", },
-        { "powerCoreSpawnRate", "2.0", },
-        { "minPowerCoreSpawn", "10",   },
-        { "maxPowerCoreSpawn", "20",   },
-        { "restrictedStart", "TRUE",   },
-        { "startingBases",    "1",     },
-        { "startingFighters", "0",     },
-        { "baseVictory", "FALSE",      },
-    };
+    const char *file = MBOpt_GetCStr("usePopulation");
+    if (file == NULL) {
+        PANIC("--usePopulation required for merge\n");
+    }
 
-    if (scenario == NULL) {
-        scenario = "default";
-        useDefault = TRUE;
+    const char *inputFile = MBOpt_GetCStr("inputPopulation");
+    if (inputFile == NULL) {
+        PANIC("--inputPopulation required for merge\n");
     }
 
-    MBString_Create(&filename);
-    MBString_AppendCStr(&filename, "scenarios/");
-    MBString_AppendCStr(&filename, scenario);
-    MBString_AppendCStr(&filename, ".sc");
+    ASSERT(mainData.numPlayers == 0);
+    MainAddNeutralPlayer();
 
-    if (access(MBString_GetCStr(&filename), F_OK) == -1) {
-        PANIC("Cannot access: %s\n", MBString_GetCStr(&filename));
-    }
+    MainUsePopulation(file, FALSE);
+    VERIFY(mainData.numPlayers > 0);
 
-    if (useDefault) {
-        for (uint i = 0; i < ARRAYSIZE(defaultValues); i++) {
-            MBRegistry_PutConst(mreg, defaultValues[i].key,
-                                defaultValues[i].value);
-        }
-    }
+    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
 
-    MBRegistry_LoadSubset(mreg, MBString_GetCStr(&filename));
-    MBString_Destroy(&filename);
+    MainUsePopulation(inputFile, FALSE);
+    VERIFY(mainData.numPlayers > 0);
 
-    if (useDefault) {
-        for (uint i = 0; i < ARRAYSIZE(defaultValues); i++) {
-            ASSERT(strcmp(MBRegistry_GetCStr(mreg, defaultValues[i].key),
-                          defaultValues[i].value) == 0);
+    MainDumpPopulation(file, FALSE);
+    MainCleanupPlayers();
+}
+
+static void MainResetFleetStats(void)
+{
+    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+    for (uint i = 1; i < mainData.numPlayers; i++) {
+        MBRegistry *mreg = mainData.players[i].mreg;
+        if (mreg != NULL) {
+            MBRegistry_Remove(mreg, "abattle.numBattles");
+            MBRegistry_Remove(mreg, "abattle.numWins");
+            MBRegistry_Remove(mreg, "abattle.numLosses");
+            MBRegistry_Remove(mreg, "abattle.numDraws");
+            MBRegistry_RemoveAllWithPrefix(mreg, "abattle.sprt");
         }
     }
 }
 
-static void MainSanitizeFleetCmd()
+static void MainResetCmd(void)
 {
-    /*
-     * This is a hack-job, but it works well enough for now.
-     */
-    uint fleetNum = MBOpt_GetUint("dumpFleet");
-    FleetAI ai;
-    MBRegistry *popReg = MBRegistry_Alloc();
-    MBRegistry *fleetReg = MBRegistry_Alloc();
-    MBRegistry *cleanReg = MBRegistry_Alloc();
-    MBString tmp;
-
-    VERIFY(popReg != NULL);
-    VERIFY(fleetReg != NULL);
-
-    MBRegistry_Load(popReg, MBOpt_GetCStr("usePopulation"));
-
-    MBString_Create(&tmp);
+    const char *file = MBOpt_GetCStr("usePopulation");
+    if (file == NULL) {
+        PANIC("--usePopulation required for reset\n");
+    }
 
-    MBString_IntToString(&tmp, fleetNum);
-    MBString_PrependCStr(&tmp, "fleet");
-    MBString_AppendCStr(&tmp, ".");
+    ASSERT(mainData.numPlayers == 0);
+    MainAddNeutralPlayer();
 
-    MBRegistry_SplitOnPrefix(fleetReg, popReg, MBString_GetCStr(&tmp),
-                             FALSE);
+    MainUsePopulation(file, FALSE);
+    VERIFY(mainData.numPlayers > 0);
 
-    const char *fleetStr = MBRegistry_GetCStr(fleetReg, "abattle.fleetName");
-    FleetAIType aiType = Fleet_GetTypeFromName(fleetStr);
+    MainResetFleetStats();
 
-    BattleParams bp;
-    MBUtil_Zero(&bp, sizeof(bp));
+    MainDumpPopulation(file, FALSE);
+    MainCleanupPlayers();
+}
 
-    BattlePlayer player;
-    MBUtil_Zero(&player, sizeof(player));
-    player.mreg = fleetReg;
-    Fleet_CreateAI(&ai, aiType, 0, &bp, &player, 0x0);
+static void MainConvertPopulationCmd(void)
+{
+    const char *file = MBOpt_GetCStr("usePopulation");
+    const char *outputFile = MBOpt_GetCStr("outputFile");
+    MBRegistry *popReg;
 
-    if (ai.ops.dumpSanitizedParams == NULL) {
-        PANIC("Unsupported fleet: %s\n", fleetStr);
+    if (file == NULL) {
+        PANIC("--usePopulation required for convertPopulation\n");
+    }
+    if (outputFile == NULL) {
+        PANIC("--outputFile required for convertPopulation\n");
     }
 
-    ai.ops.dumpSanitizedParams(ai.aiHandle, cleanReg);
+    popReg = MBRegistry_Alloc();
+    VERIFY(popReg != NULL);
 
-    MBRegistry_SaveToConsole(cleanReg);
+    Population_Load(popReg, file);
+    Population_Save(popReg, outputFile);
 
     MBRegistry_Free(popReg);
-    MBRegistry_Free(fleetReg);
-    MBRegistry_Free(cleanReg);
-    MBString_Destroy(&tmp);
 }
 
-static void MainThreadsInit(void)
+static void MainPopulationReserve(MainPopulation *pop, uint n)
 {
-    WorkQueue_Create(&mainData.workQ, sizeof(MainEngineWorkUnit));
-    WorkQueue_Create(&mainData.resultQ, sizeof(MainEngineResultUnit));
-
-    uint tDataSize = mainData.numThreads * sizeof(mainData.tData[0]);
-    mainData.tData = malloc(tDataSize);
-    for (uint i = 0; i < mainData.numThreads; i++) {
-        MainEngineThreadData *tData = &mainData.tData[i];
-
-        MBUtil_Zero(tData, sizeof(*tData));
-
-        tData->threadId = i;
-        uint threadNameLen = sizeof(tData->threadName);
-        snprintf(&tData->threadName[0], threadNameLen, "battle%d", i);
-        tData->threadName[threadNameLen - 1] = '\0';
-
-        tData->sdlThread =
-            SDL_CreateThread(MainEngineThreadMain, &tData->threadName[0], tData);
-        ASSERT(tData->sdlThread != NULL);
+    if (n <= pop->maxFleets) {
+        return;
     }
 
-    mainData.threadsInitialized = TRUE;
+    pop->maxFleets = MAX(n, MAX(64, 2 * pop->maxFleets));
+    pop->fleets = realloc(pop->fleets,
+                          pop->maxFleets * sizeof(pop->fleets[0]));
+    VERIFY(pop->fleets != NULL);
 }
 
-static void MainThreadsRequestExit(void)
+static void MainPopulationAdd(MainPopulation *pop, const BattlePlayer *player)
 {
-    ASSERT(mainData.threadsInitialized);
-    for (uint i = 0; i < mainData.numThreads; i++) {
-        MainEngineWorkUnit wu;
-        MBUtil_Zero(&wu, sizeof(wu));
-        wu.type = MAIN_WORK_EXIT;
-        WorkQueue_QueueItem(&mainData.workQ, &wu, sizeof(wu));
-    }
+    MainPopulationReserve(pop, pop->numFleets + 1);
+    pop->fleets[pop->numFleets++] = *player;
+}
 
-    mainData.threadsRequestExit = TRUE;
+/*
+ * MainPopulationDestroy --
+ *    Free an empty population's storage.  The fleets themselves have to
+ *    have been moved out already.
+ */
+static void MainPopulationDestroy(MainPopulation *pop)
+{
+    ASSERT(pop->numFleets == 0);
+    free(pop->fleets);
+    MBUtil_Zero(pop, sizeof(*pop));
 }
 
-static void MainThreadsExit(void)
+/*
+ * MainEvolveLoad --
+ *    Load a population file into pop.
+ */
+static void MainEvolveLoad(MainPopulation *pop, const char *file)
 {
-    ASSERT(mainData.threadsInitialized);
-    ASSERT(mainData.threadsRequestExit);
+    ASSERT(mainData.numPlayers == 0);
+    MainUsePopulation(file, FALSE);
+    VERIFY(mainData.numPlayers > 0);
 
-    for (uint i = 0; i < mainData.numThreads; i++) {
-        SDL_WaitThread(mainData.tData[i].sdlThread, NULL);
+    MBUtil_Zero(pop, sizeof(*pop));
+    MainPopulationReserve(pop, mainData.numPlayers - 1);
+    for (uint i = 1; i < mainData.numPlayers; i++) {
+        MainPopulationAdd(pop, &mainData.players[i]);
+        MBUtil_Zero(&mainData.players[i], sizeof(mainData.players[i]));
     }
-    ASSERT(WorkQueue_IsEmpty(&mainData.workQ));
-
-    WorkQueue_Destroy(&mainData.workQ);
-    WorkQueue_Destroy(&mainData.resultQ);
-    free(mainData.tData);
-    mainData.tData = NULL;
-
-    mainData.threadsInitialized = FALSE;
+    mainData.numPlayers = 0;
 }
 
-static void MainCleanupSinglePlayer(uint p)
+/*
+ * MainEvolvePush --
+ *    Add the fleets from pop to the current players, either moving them
+ *    (which leaves pop empty, with its storage freed) or using copies of
+ *    their registries.
+ */
+static void MainEvolvePush(MainPopulation *pop, bool copy)
 {
-    ASSERT(p < mainData.numPlayers);
-    ASSERT(mainData.players[p].playerType != PLAYER_TYPE_INVALID);
+    MainAddNeutralPlayer();
+    MainReservePlayers(mainData.numPlayers + pop->numFleets);
 
-    if (mainData.players[p].mreg != NULL) {
-        MBRegistry_Free(mainData.players[p].mreg);
-        mainData.players[p].mreg = NULL;
+    for (uint i = 0; i < pop->numFleets; i++) {
+        mainData.players[mainData.numPlayers] = pop->fleets[i];
+        if (copy) {
+            mainData.players[mainData.numPlayers].mreg =
+                MBRegistry_AllocCopy(pop->fleets[i].mreg);
+        } else {
+            MBUtil_Zero(&pop->fleets[i], sizeof(pop->fleets[i]));
+        }
+        mainData.numPlayers++;
+    }
+
+    if (!copy) {
+        pop->numFleets = 0;
+        MainPopulationDestroy(pop);
     }
-    mainData.players[p].playerType = PLAYER_TYPE_INVALID;
 }
 
-static void MainCleanupPlayers(void)
+/*
+ * MainEvolvePop --
+ *    Move the players from firstPlayer onwards back into pop.
+ */
+static void MainEvolvePop(MainPopulation *pop, uint firstPlayer)
 {
-    for (uint p = 0; p < mainData.numPlayers; p++) {
-        MainCleanupSinglePlayer(p);
+    ASSERT(firstPlayer > 0);
+    MainPopulationReserve(pop, pop->numFleets +
+                               mainData.numPlayers - firstPlayer);
+    for (uint i = firstPlayer; i < mainData.numPlayers; i++) {
+        MainPopulationAdd(pop, &mainData.players[i]);
+        MBUtil_Zero(&mainData.players[i], sizeof(mainData.players[i]));
     }
+    mainData.numPlayers = firstPlayer;
 }
 
-static void MainMutateCmd(void)
+static void MainEvolveResetWinners(void)
 {
-    BattlePlayer mutants[MAX_PLAYERS];
-    const char *outputFile = MBOpt_GetCStr("outputFile");
-    const char *inputFile = MBOpt_GetCStr("usePopulation");
+    MBUtil_Zero(mainData.winners,
+                mainData.maxPlayers * sizeof(mainData.winners[0]));
+    MainBreakdownReset();
+}
 
-    if (outputFile == NULL) {
-        PANIC("--outputFile required for mutate\n");
-    }
-    if (inputFile == NULL) {
-        PANIC("--usePopulation required for mutate\n");
+static void MainEvolveSave(MainPopulation *pop, const char *file)
+{
+    ASSERT(mainData.numPlayers == 0);
+    MainEvolveResetWinners();
+    MainEvolvePush(pop, FALSE);
+    MainDumpPopulation(file, FALSE);
+    MainEvolvePop(pop, 1);
+    mainData.numPlayers = 0;
+}
+
+/*
+ * MainEvolveMeasure --
+ *    The in-memory version of the measure command.
+ */
+static void MainEvolveMeasure(MainPopulation *target,
+                              MainPopulation *control, uint loop,
+                              bool incrementAge)
+{
+    if (target->numFleets == 0 || control->numFleets == 0 || loop == 0) {
+        return;
     }
 
     ASSERT(mainData.numPlayers == 0);
-    MainUsePopulation(MBOpt_GetCStr("usePopulation"), FALSE);
+    MainEvolvePush(control, TRUE);
 
-    VERIFY(mainData.numPlayers > 0);
+    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+    for (uint i = 1; i < mainData.numPlayers; i++) {
+        if (mainData.players[i].playerType != PLAYER_TYPE_CONTROL) {
+            PANIC("Screen populations need control fleets\n");
+        }
+    }
+    uint lastControl = mainData.numPlayers - 1;
 
-    uint targetMutateCount = MBOpt_GetUint("mutationCount");
-    uint actualMutateCount = 0;
+    MainEvolvePush(target, FALSE);
+    for (uint i = lastControl + 1; i < mainData.numPlayers; i++) {
+        VERIFY(mainData.players[i].playerType == PLAYER_TYPE_TARGET);
+        if (incrementAge) {
+            MainDumpAddToKey(mainData.players[i].mreg,
+                             mainData.players[i].mreg,
+                             NULL, "abattle.age", 1);
+        }
+    }
 
-    VERIFY(targetMutateCount <= ARRAYSIZE(mutants));
-    MBUtil_Zero(mutants, sizeof(mutants));
+    MainEvolveResetWinners();
+    mainData.loop = loop;
+    MainConstructScenarios(FALSE, MAIN_BT_OPTIMIZE);
+    MainRunScenarios();
 
-    while (targetMutateCount > 0) {
-        uint32 mi = MainFleetCompetition(&mainData.players[0],
-                                         mainData.numPlayers,
-                                         1, mainData.numPlayers - 1, TRUE);
-        uint32 bi = MainFleetCompetition(&mainData.players[0],
-                                         mainData.numPlayers,
-                                         1, mainData.numPlayers - 1, TRUE);
-        MainMutateFleet(&mainData.players[0], mainData.numPlayers,
-                        &mutants[actualMutateCount], mi, bi);
-        targetMutateCount--;
-        actualMutateCount++;
+    for (uint i = lastControl + 1; i < mainData.numPlayers; i++) {
+        MBRegistry *fleetReg = MainMakeDumpFleet(i);
+        MBRegistry_Free(mainData.players[i].mreg);
+        mainData.players[i].mreg = fleetReg;
     }
 
-    // Dump the original population (with updated numSpawns)
-    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
-    MainDumpPopulation(inputFile, FALSE);
+    MainEvolvePop(target, lastControl + 1);
     MainCleanupPlayers();
-
-    // Dump the new mutants to the outputFile
     mainData.numPlayers = 0;
-    mainData.players[0].aiType = FLEET_AI_NEUTRAL;
-    mainData.players[0].playerType = PLAYER_TYPE_NEUTRAL;
-    mainData.numPlayers++;
+}
 
-    for (uint i = 0; i < actualMutateCount; i++) {
-        mainData.players[mainData.numPlayers] = mutants[i];
-        mainData.numPlayers++;
-    }
+/*
+ * MainWilsonUpperBound --
+ *    Upper end of the Wilson score interval for a win rate of
+ *    wins / battles.
+ */
+static float MainWilsonUpperBound(uint wins, uint battles, float z)
+{
+    ASSERT(battles > 0);
+    ASSERT(wins <= battles);
 
-    MainDumpPopulation(outputFile, FALSE);
-    MainCleanupPlayers();
+    float n = battles;
+    float p = wins / n;
+    float z2 = z * z;
+    float center = p + z2 / (2.0f * n);
+    float spread = z * sqrtf(p * (1.0f - p) / n + z2 / (4.0f * n * n));
+
+    return (center + spread) / (1.0f + z2 / n);
 }
 
-static void MainDefaultCmd(void)
+/*
+ * MainRaceScreen --
+ *    Measure pop against control like MainEvolveMeasure would with
+ *    maxIterations, but in rounds that double in length, so that fleets
+ *    stop getting battles once their kill decision is known.
+ *
+ *    A fleet is decided when no result from the remaining battles could
+ *    change which side of defectiveLevel its win ratio ends up on, and
+ *    those fleets come out on the same side as they would after the full
+ *    screen.  If z > 0, a fleet is also decided when it's probably
+ *    losing: the upper bound of its Wilson interval is already below
+ *    defectiveLevel.  That's a statistical call, so some of those fleets
+ *    would have recovered with the full screen.  The caller still does
+ *    the actual killing.
+ */
+static void MainRaceScreen(MainPopulation *pop, MainPopulation *control,
+                           uint maxIterations, float defectiveLevel, float z)
 {
-    MainBattleType bt = MAIN_BT_SINGLE;
+    MainPopulation active;
+    uint numControls = control->numFleets;
+    uint numFleets = pop->numFleets;
+    uint seatings = mainData.crn.enabled ? 2 : 1;
+    uint battlesPerLoop = numControls * seatings;
+    uint iterations = 0;
+    uint rung = 1;
+    uint totalBattles = 0;
+
+    active = *pop;
+    MBUtil_Zero(pop, sizeof(*pop));
+    MainPopulationReserve(pop, numFleets);
+
+    while (active.numFleets > 0 && iterations < maxIterations) {
+        uint loop = MIN(rung, maxIterations - iterations);
+
+        totalBattles += active.numFleets * battlesPerLoop * loop;
+        MainEvolveMeasure(&active, control, loop, iterations == 0);
+        iterations += loop;
+        rung *= 2;
 
-    MainConstructScenarios(TRUE, bt);
-    MainRunScenarios();
+        /*
+         * Each loop iteration gives a fleet one battle against each
+         * control in each seating.
+         */
+        uint remaining = (maxIterations - iterations) * battlesPerLoop;
+        uint i = 0;
+        while (i < active.numFleets) {
+            MBRegistry *mreg = active.fleets[i].mreg;
+            uint battles = MBRegistry_GetUint(mreg, "abattle.numBattles");
+            uint wins = MBRegistry_GetUint(mreg, "abattle.numWins");
+            float finalBattles = battles + remaining;
+            bool decided = FALSE;
+
+            if (remaining == 0) {
+                decided = TRUE;
+            } else if (wins >= defectiveLevel * finalBattles) {
+                // It can't lose enough to become defective.
+                decided = TRUE;
+            } else if (wins + remaining < defectiveLevel * finalBattles) {
+                // It can't win enough to stop being defective.
+                decided = TRUE;
+            } else if (z > 0.0f && battles > 0 &&
+                       MainWilsonUpperBound(wins, battles, z) <
+                       defectiveLevel) {
+                decided = TRUE;
+            }
 
-    if (MBOpt_IsPresent("dumpPopulation")) {
-        MainDumpPopulation(MBOpt_GetCStr("dumpPopulation"), FALSE);
+            if (decided) {
+                MainPopulationAdd(pop, &active.fleets[i]);
+                active.fleets[i] = active.fleets[active.numFleets - 1];
+                active.numFleets--;
+            } else {
+                i++;
+            }
+        }
     }
 
-    MainCleanupPlayers();
+    for (uint i = 0; i < active.numFleets; i++) {
+        MainPopulationAdd(pop, &active.fleets[i]);
+    }
+    active.numFleets = 0;
+    MainPopulationDestroy(&active);
+    ASSERT(pop->numFleets == numFleets);
+
+    Warning("Raced %d fleets in %d battles (%d for the full screen).\n",
+            numFleets, totalBattles,
+            numFleets * battlesPerLoop * maxIterations);
 }
 
-static void MainKillCmd(void)
+static void MainEvolveKill(MainPopulation *pop, float defectiveLevel,
+                           uint minPop, uint maxPop, bool resetAfter)
+{
+    ASSERT(mainData.numPlayers == 0);
+    MainEvolvePush(pop, FALSE);
+    MainKillFleets(defectiveLevel, minPop, maxPop, 0.0f);
+    if (resetAfter) {
+        MainResetFleetStats();
+    }
+    MainEvolvePop(pop, 1);
+    mainData.numPlayers = 0;
+}
+
+static void MainEvolveCmd(void)
 {
+    struct {
+        const char *name;
+        const char *defaultFile;
+        uint defaultIterations;
+        MainPopulation pop;
+        bool present;
+        uint iterations;
+        float defectiveLevel;
+    } screens[] = {
+        { "screen1", "zoo/screen1.zoo", 3,  },
+        { "screen2", "zoo/screen2.zoo", 5,  },
+        { "screen3", "zoo/screen3.zoo", 10, },
+    };
+    MainPopulation screenS;
+    MainPopulation stable;
+    MainPopulation noob;
+    MBString tmp;
     const char *file = MBOpt_GetCStr("usePopulation");
+    const char *screenSFile = "zoo/screenS.zoo";
+    uint generations = 1;
+    uint stablePop = 50;
+    uint noobPop = 50;
+    uint saveInterval = 1;
+    uint screenSNewIterations = 20;
+    uint screenSStaleIterations = 1;
+    float screenSDefective = 0.1f;
+    bool race = MBOpt_IsPresent("race");
+    float raceZ = MAIN_RACE_DEFAULT_Z;
 
     if (file == NULL) {
-        PANIC("--usePopulation required for kill\n");
+        PANIC("--usePopulation required for evolve\n");
     }
 
-    ASSERT(mainData.numPlayers == 0);
-    MainUsePopulation(MBOpt_GetCStr("usePopulation"), FALSE);
-    VERIFY(mainData.numPlayers > 0);
-
-    // Account for FLEET_AI_NEUTRAL
-    uint numFleets = mainData.numPlayers - 1;
+    if (MBOpt_IsPresent("raceZ")) {
+        raceZ = MBOpt_GetFloat("raceZ");
+    }
 
-    uint actualKillCount = 0;
-    uint minPop = 0;
-    uint maxPop = numFleets;
-    if (MBOpt_IsPresent("minPop")) {
-        minPop = MBOpt_GetUint("minPop");
+    if (MBOpt_IsPresent("generations")) {
+        generations = MBOpt_GetUint("generations");
     }
-    if (MBOpt_IsPresent("maxPop")) {
-        maxPop = MBOpt_GetUint("maxPop");
+    if (MBOpt_IsPresent("stablePop")) {
+        stablePop = MBOpt_GetUint("stablePop");
     }
-    if (numFleets <= minPop) {
-        Warning("Population is already too low pop=%d, minPop=%d\n",
-                numFleets, minPop);
-        Warning("Not killing anything.\n");
-        MainCleanupPlayers();
-        return;
+    if (MBOpt_IsPresent("noobPop")) {
+        noobPop = MBOpt_GetUint("noobPop");
+    }
+    if (MBOpt_IsPresent("saveInterval")) {
+        saveInterval = MBOpt_GetUint("saveInterval");
+    }
+    if (MBOpt_IsPresent("screenS")) {
+        screenSFile = MBOpt_GetCStr("screenS");
     }
+    if (MBOpt_IsPresent("screenSNewIterations")) {
+        screenSNewIterations = MBOpt_GetUint("screenSNewIterations");
+    }
+    if (MBOpt_IsPresent("screenSStaleIterations")) {
+        screenSStaleIterations = MBOpt_GetUint("screenSStaleIterations");
+    }
+    if (MBOpt_IsPresent("screenSDefective")) {
+        screenSDefective = MBOpt_GetFloat("screenSDefective");
+    }
+    MBString_Create(&tmp);
 
     /*
-     * Kill defective fleets.
+     * The screens don't change, so only load them once.  Like evolve.sh,
+     * screens 1-3 are skipped if their files don't exist.
      */
-    float defectiveLevel = MBOpt_GetFloat("defectiveLevel");
-    uint i = 1;
-    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
-    while (numFleets > minPop && i < mainData.numPlayers) {
-        ASSERT(numFleets > 0);
-        ASSERT(numFleets < mainData.numPlayers);
-        ASSERT(mainData.numPlayers > 1);
-        ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+    for (uint s = 0; s < ARRAYSIZE(screens); s++) {
+        const char *screenFile = screens[s].defaultFile;
 
-        if (MainIsFleetDefective(&mainData.players[i], defectiveLevel)) {
-            MainKillFleet(&mainData.players[0], mainData.numPlayers,
-                          NULL, 1, &numFleets, NULL, i);
-            /*
-             * Re-use the same i index because we swapped the fleet
-             * out.
-             */
-            ASSERT(i > 0);
-            i--;
-
-            ASSERT(numFleets >= 0);
-            ASSERT(mainData.numPlayers > 0);
-            mainData.numPlayers--;
-            ASSERT(mainData.numPlayers > 0);
-            ASSERT(numFleets < mainData.numPlayers);
+        MBString_CopyCStr(&tmp, screens[s].name);
+        if (MBOpt_IsPresent(MBString_GetCStr(&tmp))) {
+            screenFile = MBOpt_GetCStr(MBString_GetCStr(&tmp));
+        }
 
-            actualKillCount++;
+        screens[s].present = access(screenFile, R_OK) == 0;
+        if (screens[s].present) {
+            MainEvolveLoad(&screens[s].pop, screenFile);
         }
 
-        i++;
-    }
+        MBString_AppendCStr(&tmp, "Iterations");
+        screens[s].iterations = screens[s].defaultIterations;
+        if (MBOpt_IsPresent(MBString_GetCStr(&tmp))) {
+            screens[s].iterations = MBOpt_GetUint(MBString_GetCStr(&tmp));
+        }
 
-    if (actualKillCount > 0) {
-        Warning("Killed %d defective fleets.\n", actualKillCount);
+        MBString_CopyCStr(&tmp, screens[s].name);
+        MBString_AppendCStr(&tmp, "Defective");
+        screens[s].defectiveLevel = 0.1f;
+        if (MBOpt_IsPresent(MBString_GetCStr(&tmp))) {
+            screens[s].defectiveLevel = MBOpt_GetFloat(MBString_GetCStr(&tmp));
+        }
     }
 
-    uint targetKillCount = 0;
+    MainEvolveLoad(&screenS, screenSFile);
+    MainEvolveLoad(&stable, file);
+    MBUtil_Zero(&noob, sizeof(noob));
 
-    if (MBOpt_IsPresent("killRatio")) {
-        targetKillCount = numFleets * MBOpt_GetFloat("killRatio");
+    /*
+     * Keep the same engine threads for every stage, unless the battles
+     * go to worker processes instead.
+     */
+    if (mainData.numWorkers == 0) {
+        mainData.numThreads = MAX(1, mainData.numThreads);
+        MainThreadsInit();
     }
 
-    if (minPop > 0) {
-        targetKillCount = MIN(numFleets - minPop, targetKillCount);
-    }
-    if (numFleets > maxPop) {
-        targetKillCount = MAX(numFleets - maxPop, targetKillCount);
-    }
+    for (uint g = 0; g < generations; g++) {
+        Warning("Starting generation %d of %d...\n", g + 1, generations);
 
-    ASSERT(targetKillCount <= numFleets);
+        MainEvolveMeasure(&stable, &screenS, screenSStaleIterations, TRUE);
+        MainEvolveKill(&stable, screenSDefective, stablePop, stablePop, FALSE);
 
-    while (targetKillCount > 0) {
-        ASSERT(numFleets > 0);
-        ASSERT(numFleets < mainData.numPlayers);
-        ASSERT(mainData.numPlayers > 1);
-        ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+        /*
+         * Mutate the stable population into the noobs.
+         */
+        ASSERT(noob.numFleets == 0);
+        VERIFY(stable.numFleets > 0);
+        MainPopulationReserve(&noob, noobPop);
+        MBUtil_Zero(noob.fleets, noobPop * sizeof(noob.fleets[0]));
+        MainEvolvePush(&stable, FALSE);
+        MainMutatePopulation(noob.fleets, noobPop);
+        noob.numFleets = noobPop;
+        MainEvolvePop(&stable, 1);
+        mainData.numPlayers = 0;
+
+        for (uint s = 0; s < ARRAYSIZE(screens); s++) {
+            if (screens[s].present) {
+                if (race) {
+                    MainRaceScreen(&noob, &screens[s].pop,
+                                   screens[s].iterations,
+                                   screens[s].defectiveLevel, raceZ);
+                } else {
+                    MainEvolveMeasure(&noob, &screens[s].pop,
+                                      screens[s].iterations, TRUE);
+                }
+                MainEvolveKill(&noob, screens[s].defectiveLevel,
+                               0, noob.numFleets, TRUE);
+                Warning("%d noob fleets left after %s.\n",
+                        noob.numFleets, screens[s].name);
+            }
+        }
 
-        uint32 ki = MainFleetCompetition(&mainData.players[0],
-                                         mainData.numPlayers,
-                                         1, numFleets, FALSE);
-        MainKillFleet(&mainData.players[0], mainData.numPlayers,
-                      NULL, 1, &numFleets, NULL, ki);
-        targetKillCount--;
-        actualKillCount++;
-        ASSERT(numFleets >= 0);
-        ASSERT(mainData.numPlayers > 0);
-        mainData.numPlayers--;
-        ASSERT(mainData.numPlayers > 0);
-        ASSERT(numFleets < mainData.numPlayers);
-    }
+        // Final screen (keep results)
+        MainEvolveMeasure(&noob, &screenS, screenSNewIterations, TRUE);
+        MainEvolveKill(&noob, screenSDefective, 0, noob.numFleets, FALSE);
 
-    ASSERT(numFleets >= minPop);
-    ASSERT(numFleets <= maxPop);
+        /*
+         * Merge the survivors into the stable population.
+         */
+        for (uint i = 0; i < noob.numFleets; i++) {
+            MainPopulationAdd(&stable, &noob.fleets[i]);
+        }
+        noob.numFleets = 0;
+        MainPopulationDestroy(&noob);
 
-    Warning("Killed %d total fleets.\n", actualKillCount);
-    Warning("%d fleets remaining.\n", numFleets);
+        Warning("Finished generation %d of %d with %d fleets.\n",
+                g + 1, generations, stable.numFleets);
 
-    // Dump the original population (with updated numSpawns)
-    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
-    if (actualKillCount > 0 || MBOpt_IsPresent("resetAfter")) {
-        if (MBOpt_IsPresent("resetAfter")) {
-            MainResetFleetStats();
+        if (saveInterval > 0 &&
+            ((g + 1) % saveInterval == 0 || g + 1 == generations)) {
+            MainEvolveSave(&stable, file);
         }
-        MainDumpPopulation(file, FALSE);
     }
 
+    if (mainData.threadsInitialized) {
+        MainThreadsRequestExit();
+        MainThreadsExit();
+    }
+
+    if (saveInterval == 0) {
+        MainEvolveSave(&stable, file);
+    }
+
+    MainEvolvePush(&stable, FALSE);
+    MainEvolvePush(&screenS, FALSE);
+    for (uint s = 0; s < ARRAYSIZE(screens); s++) {
+        MainEvolvePush(&screens[s].pop, FALSE);
+    }
     MainCleanupPlayers();
+    mainData.numPlayers = 0;
+
+    MBString_Destroy(&tmp);
 }
 
-static void MainMeasureCmd(void)
+/*
+ * MainRaceCmd --
+ *    Like running measure and then kill --resetAfter on a screen, but
+ *    racing the fleets so the ones with a clear result get fewer
+ *    battles.
+ */
+static void MainRaceCmd(void)
 {
+    MainPopulation target;
+    MainPopulation control;
     const char *file = MBOpt_GetCStr("usePopulation");
+    const char *controlFile = MBOpt_GetCStr("controlPopulation");
+    float raceZ = MAIN_RACE_DEFAULT_Z;
+
     if (file == NULL) {
-        PANIC("--usePopulation required for measure\n");
+        PANIC("--usePopulation required for race\n");
     }
-
-    const char *controlFile = MBOpt_GetCStr("controlPopulation");
     if (controlFile == NULL) {
-        PANIC("--controlPopulation required for measure\n");
+        PANIC("--controlPopulation required for race\n");
     }
-
-    ASSERT(mainData.numPlayers == 0);
-    MainUsePopulation(controlFile, FALSE);
-    VERIFY(mainData.numPlayers > 0);
-
-    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
-    for (uint i = 1; i < mainData.numPlayers; i++) {
-        if (mainData.players[i].playerType != PLAYER_TYPE_CONTROL) {
-            PANIC("measure needs a control fleet\n");
-        }
+    if (!MBOpt_IsPresent("defectiveLevel")) {
+        PANIC("--defectiveLevel required for race\n");
     }
-    uint lastControl = mainData.numPlayers - 1;
-
-    MainUsePopulation(file, TRUE);
-    VERIFY(mainData.numPlayers > 0);
-    for (uint i = lastControl + 1; i < mainData.numPlayers; i++) {
-        VERIFY(mainData.players[i].playerType == PLAYER_TYPE_TARGET);
+    if (MBOpt_IsPresent("raceZ")) {
+        raceZ = MBOpt_GetFloat("raceZ");
     }
 
-    MainConstructScenarios(FALSE, MAIN_BT_OPTIMIZE);
-    MainRunScenarios();
+    MainEvolveLoad(&control, controlFile);
+    MainEvolveLoad(&target, file);
 
-    MainDumpPopulation(file, TRUE);
+    MainRaceScreen(&target, &control, mainData.loop,
+                   MBOpt_GetFloat("defectiveLevel"), raceZ);
+    MainEvolveKill(&target, MBOpt_GetFloat("defectiveLevel"),
+                   0, target.numFleets, TRUE);
+    MainEvolveSave(&target, file);
 
+    MainEvolvePush(&target, FALSE);
+    MainEvolvePush(&control, FALSE);
     MainCleanupPlayers();
+    mainData.numPlayers = 0;
 }
 
-static void MainOptimizeCmd(void)
+/*
+ * MainServeFreePopulation --
+ *    Free a population from the serve cache.
+ */
+static void MainServeFreePopulation(void *cbData, void *p)
 {
-    const char *file = MBOpt_GetCStr("usePopulation");
-    const char *controlFile = MBOpt_GetCStr("controlPopulation");
+    MainPopulation *pop = p;
 
     ASSERT(mainData.numPlayers == 0);
-    if (controlFile == NULL) {
-        MainLoadAllAsControlPlayers();
+    MainEvolvePush(pop, FALSE);
+    MainCleanupPlayers();
+    mainData.numPlayers = 0;
+    free(pop);
+}
+
+static void *MainServeLoadPopulation(void *cbData, const char *file)
+{
+    MainPopulation *pop = malloc(sizeof(*pop));
+
+    VERIFY(pop != NULL);
+    MainEvolveLoad(pop, file);
+    return pop;
+}
+
+/*
+ * MainServeCheckPopulation --
+ *    Check everything that MainUsePopulation would panic over, so a bad
+ *    file fails the request instead of the server.  Returns what's wrong
+ *    with the file, or NULL.
+ */
+static const char *MainServeCheckPopulation(void *cbData, const char *file)
+{
+    MBRegistry *popReg = NULL;
+    MBRegistry *fleetReg;
+    Population pop;
+    bool binary;
+    uint numFleets = 0;
+    const char *err = NULL;
+    MBString tmp;
+
+    binary = Population_IsBinaryFile(file);
+    if (binary) {
+        err = Population_Check(file);
+        if (err != NULL) {
+            return err;
+        }
+        Population_Open(&pop, file, FALSE);
+        numFleets = Population_NumFleets(&pop);
     } else {
-        MainUsePopulation(controlFile, FALSE);
+        popReg = MBRegistry_Alloc();
+        VERIFY(popReg != NULL);
+        MBRegistry_Load(popReg, file);
+        if (MBRegistry_ContainsKey(popReg, "numFleets")) {
+            numFleets = MBRegistry_GetUint(popReg, "numFleets");
+        }
     }
 
-    VERIFY(mainData.numPlayers > 0);
-    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
-    for (uint i = 1; i < mainData.numPlayers; i++) {
-        VERIFY(mainData.players[i].playerType == PLAYER_TYPE_CONTROL);
+    if (numFleets == 0) {
+        err = "population has no fleets";
     }
-    uint lastControl = mainData.numPlayers - 1;
 
-    if (file == NULL) {
-        MainAddTargetPlayersForOptimize();
-    } else {
-        MainUsePopulation(file, TRUE);
+    MBString_Create(&tmp);
+    fleetReg = MBRegistry_Alloc();
+    VERIFY(fleetReg != NULL);
+
+    for (uint i = 1; err == NULL && i <= numFleets; i++) {
+        const char *fleetName;
+        const char *playerType;
+
+        MBRegistry_MakeEmpty(fleetReg);
+        if (binary) {
+            Population_LoadFleet(&pop, i, fleetReg);
+        } else {
+            MBString_IntToString(&tmp, i);
+            MBString_PrependCStr(&tmp, "fleet");
+            MBString_AppendCStr(&tmp, ".");
+            MBRegistry_SplitOnPrefix(fleetReg, popReg, MBString_GetCStr(&tmp),
+                                     FALSE);
+        }
+
+        fleetName = MBRegistry_GetCStr(fleetReg, "abattle.fleetName");
+        playerType = MBRegistry_GetCStr(fleetReg, "abattle.playerType");
+        if (fleetName == NULL ||
+            Fleet_GetTypeFromName(fleetName) == FLEET_AI_INVALID) {
+            err = "population has an unknown fleet";
+        } else if (playerType == NULL ||
+                   (strcmp(playerType, "Neutral") != 0 &&
+                    strcmp(playerType, "Control") != 0 &&
+                    strcmp(playerType, "Target") != 0)) {
+            err = "population has an unknown player type";
+        }
     }
 
-    VERIFY(mainData.numPlayers > 1);
-    for (uint i = lastControl + 1; i < mainData.numPlayers; i++) {
-        VERIFY(mainData.players[i].playerType == PLAYER_TYPE_TARGET);
+    MBRegistry_Free(fleetReg);
+    MBString_Destroy(&tmp);
+    if (binary) {
+        Population_Close(&pop);
+    } else {
+        MBRegistry_Free(popReg);
     }
+    return err;
+}
 
-    MainConstructScenarios(FALSE, MAIN_BT_OPTIMIZE);
-    MainRunScenarios();
-    MainCleanupPlayers();
+static void MainServeCopyPopulation(MainPopulation *dest,
+                                    const MainPopulation *src)
+{
+    MBUtil_Zero(dest, sizeof(*dest));
+    MainPopulationReserve(dest, src->numFleets);
+    for (uint i = 0; i < src->numFleets; i++) {
+        MainPopulationAdd(dest, &src->fleets[i]);
+        if (src->fleets[i].mreg != NULL) {
+            dest->fleets[i].mreg = MBRegistry_AllocCopy(src->fleets[i].mreg);
+        }
+    }
 }
 
-static void MainTournamentCmd(void)
+static const char *MainServeMeasure(void *cbData, const char *file,
+                                    const char *controlFile, uint loop)
 {
-    const char *file = MBOpt_GetCStr("usePopulation");
+    MainPopulation *control;
+    MainPopulation *target;
+    const char *err;
 
-    mainData.printWinnerBreakdown = TRUE;
+    control = Serve_GetPopulation(&mainData.serve, controlFile, &err);
+    if (control == NULL) {
+        return err;
+    }
+    for (uint i = 0; i < control->numFleets; i++) {
+        if (control->fleets[i].playerType != PLAYER_TYPE_CONTROL) {
+            return "measure needs a control fleet";
+        }
+    }
+
+    /*
+     * The target is changed by the measurement, so it gets a copy.
+     */
+    target = Serve_GetPopulation(&mainData.serve, file, &err);
+    if (target == NULL) {
+        return err;
+    }
+    for (uint i = 0; i < target->numFleets; i++) {
+        if (target->fleets[i].playerType != PLAYER_TYPE_TARGET) {
+            return "measure needs target fleets";
+        }
+    }
+    MainPopulation *copy = malloc(sizeof(*copy));
+    VERIFY(copy != NULL);
+    MainServeCopyPopulation(copy, target);
+
+    MainEvolveResetWinners();
+    MainEvolveMeasure(copy, control, loop, TRUE);
+    MainEvolveSave(copy, file);
+    Serve_ForgetPopulation(&mainData.serve, file);
 
+    MainServeFreePopulation(NULL, copy);
+    return NULL;
+}
+
+static const char *MainServeRunTournament(const char *file,
+                                          const char *fleet1,
+                                          const char *fleet2, uint loop)
+{
     ASSERT(mainData.numPlayers == 0);
-    MainAddNeutralPlayer();
 
-    if (file == NULL) {
+    if (fleet1 != NULL) {
+        const char *names[] = { fleet1, fleet2 };
+
+        MainAddNeutralPlayer();
+        MainReservePlayers(mainData.numPlayers + ARRAYSIZE(names));
+        for (uint i = 0; i < ARRAYSIZE(names); i++) {
+            FleetAIType aiType = Fleet_GetTypeFromName(names[i]);
+            if (aiType == FLEET_AI_INVALID || aiType == FLEET_AI_NEUTRAL) {
+                MainCleanupPlayers();
+                mainData.numPlayers = 0;
+                return "unknown fleet";
+            }
+            mainData.players[mainData.numPlayers].aiType = aiType;
+            mainData.players[mainData.numPlayers].playerType =
+                PLAYER_TYPE_CONTROL;
+            mainData.numPlayers++;
+        }
+    } else if (strcmp(file, "-") == 0) {
         MainLoadAllAsControlPlayers();
     } else {
-        MainUsePopulation(file, TRUE);
+        const char *err;
+        MainPopulation *pop = Serve_GetPopulation(&mainData.serve, file, &err);
+        if (pop == NULL) {
+            return err;
+        }
+        for (uint i = 0; i < pop->numFleets; i++) {
+            if (pop->fleets[i].playerType != PLAYER_TYPE_CONTROL) {
+                return "tournament needs control fleets";
+            }
+        }
+        MainEvolvePush(pop, TRUE);
+    }
+
+    if (mainData.numPlayers < 3) {
+        MainCleanupPlayers();
+        mainData.numPlayers = 0;
+        return "tournament needs two fleets";
     }
 
+    MainEvolveResetWinners();
+    mainData.loop = loop;
     MainConstructScenarios(FALSE, MAIN_BT_TOURNAMENT);
     MainRunScenarios();
+
     MainCleanupPlayers();
+    mainData.numPlayers = 0;
+    return NULL;
 }
 
-static void MainMergeCmd(void)
+static const char *MainServeTournament(void *cbData, const char *file,
+                                       uint loop)
 {
-    const char *file = MBOpt_GetCStr("usePopulation");
-    if (file == NULL) {
-        PANIC("--usePopulation required for merge\n");
-    }
-
-    const char *inputFile = MBOpt_GetCStr("inputPopulation");
-    if (inputFile == NULL) {
-        PANIC("--inputPopulation required for merge\n");
-    }
-
-    ASSERT(mainData.numPlayers == 0);
-    mainData.players[0].aiType = FLEET_AI_NEUTRAL;
-    mainData.players[0].playerType = PLAYER_TYPE_NEUTRAL;
-    mainData.numPlayers++;
-
-    MainUsePopulation(file, FALSE);
-    VERIFY(mainData.numPlayers > 0);
+    return MainServeRunTournament(file, NULL, NULL, loop);
+}
 
-    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
+static const char *MainServePair(void *cbData, const char *fleet1,
+                                 const char *fleet2, uint loop)
+{
+    return MainServeRunTournament(NULL, fleet1, fleet2, loop);
+}
 
-    MainUsePopulation(inputFile, FALSE);
-    VERIFY(mainData.numPlayers > 0);
+static bool MainServeScenarioExists(void *cbData, const char *scenario)
+{
+    MBString filename;
+    bool exists;
 
-    MainDumpPopulation(file, FALSE);
-    MainCleanupPlayers();
+    MBString_Create(&filename);
+    MainScenarioFile(&filename, scenario);
+    exists = access(MBString_GetCStr(&filename), R_OK) == 0;
+    MBString_Destroy(&filename);
+    return exists;
 }
 
-static void MainResetFleetStats(void)
+/*
+ * MainServeSetScenario --
+ *    Use a client's scenario, or go back to the one from the command
+ *    line if scenario is NULL.
+ */
+static void MainServeSetScenario(void *cbData, const char *scenario)
 {
-    ASSERT(mainData.players[0].aiType == FLEET_AI_NEUTRAL);
-    for (uint i = 1; i < mainData.numPlayers; i++) {
-        MBRegistry *mreg = mainData.players[i].mreg;
-        if (mreg != NULL) {
-            MBRegistry_Remove(mreg, "abattle.numBattles");
-            MBRegistry_Remove(mreg, "abattle.numWins");
-            MBRegistry_Remove(mreg, "abattle.numLosses");
-            MBRegistry_Remove(mreg, "abattle.numDraws");
-        }
+    if (scenario == NULL && MBOpt_IsPresent("scenario")) {
+        scenario = MBOpt_GetCStr("scenario");
     }
+    mainData.scenario = scenario;
 }
 
-static void MainResetCmd(void)
+static const ServeOps gMainServeOps = {
+    MainServeScenarioExists,
+    MainServeSetScenario,
+    MainServeMeasure,
+    MainServeTournament,
+    MainServePair,
+    MainServeCheckPopulation,
+    MainServeLoadPopulation,
+    MainServeFreePopulation,
+};
+
+static void MainServeCmd(void)
 {
-    const char *file = MBOpt_GetCStr("usePopulation");
-    if (file == NULL) {
-        PANIC("--usePopulation required for reset\n");
+    const char *path = SERVE_DEFAULT_SOCKET;
+
+    if (MBOpt_IsPresent("socket")) {
+        path = MBOpt_GetCStr("socket");
     }
 
-    ASSERT(mainData.numPlayers == 0);
-    mainData.players[0].aiType = FLEET_AI_NEUTRAL;
-    mainData.players[0].playerType = PLAYER_TYPE_NEUTRAL;
-    mainData.numPlayers++;
+    Serve_Create(&mainData.serve, &gMainServeOps, NULL);
 
-    MainUsePopulation(file, FALSE);
-    VERIFY(mainData.numPlayers > 0);
+    if (mainData.numWorkers == 0) {
+        mainData.numThreads = MAX(1, mainData.numThreads);
+        MainThreadsInit();
+    }
 
-    MainResetFleetStats();
+    Serve_Run(&mainData.serve, path);
 
-    MainDumpPopulation(file, FALSE);
-    MainCleanupPlayers();
+    if (mainData.threadsInitialized) {
+        MainThreadsRequestExit();
+        MainThreadsExit();
+    }
+
+    Serve_Destroy(&mainData.serve);
 }
 
 static void MainUnitTests()
@@ -1835,6 +4421,18 @@ static void MainUnitTests()
         MobPSet_UnitTest();
         Geometry_UnitTest();
         ML_UnitTest();
+        FastMath_UnitTest();
+        Genome_UnitTest();
+        Population_UnitTest();
+        BattleCache_UnitTest();
+        ResultLog_UnitTest();
+        WorkQueue_UnitTest();
+        Affinity_UnitTest();
+        Schedule_UnitTest();
+        Checkpoint_UnitTest();
+        WorkerPool_UnitTest();
+        Rating_UnitTest();
+        Serve_UnitTest();
     } else {
         Warning("Unit tests disabled on non-devel build.\n");
     }
@@ -1855,6 +4453,19 @@ static void MainParseCmdLine(int argc, char **argv)
         { "-L", "--tickLimit",         TRUE,  "Time limit in ticks"           },
         { "-t", "--numThreads",        TRUE,  "Number of engine threads"      },
         { "-R", "--reuseSeed",         FALSE, "Reuse the seed across battles" },
+        { NULL, "--fastMath",          FALSE, "Use fast math in the AI"       },
+        { NULL, "--resultCache",       TRUE,  "Battle result cache file"      },
+        { NULL, "--resultLog",         TRUE,  "Log every battle to <arg> (.jsonl for JSON)" },
+        { NULL, "--crn",               FALSE, "Shared seeds and mirrored seating" },
+        { NULL, "--dedupe",            FALSE, "Share results between identical fleets" },
+        { NULL, "--queueSpin",         TRUE,  "Idle spins before threads park" },
+        { NULL, "--schedule",          FALSE, "Queue longest battles first"   },
+        { NULL, "--scheduleNew",       FALSE, "Queue new fleets' battles first" },
+        { NULL, "--workers",           TRUE,  "Run battles in <arg> processes" },
+        { NULL, "--affinity",          TRUE,  "Thread placement: none, spread or pack" },
+        { NULL, "--checkpoint",        TRUE,  "Save progress to <arg> during runs" },
+        { NULL, "--checkpointSecs",    TRUE,  "Seconds between checkpoints"   },
+        { NULL, "--resume",            FALSE, "Resume the first run (only) from --checkpoint" },
     };
 
     MBOption display_opts[] = {
@@ -1881,13 +4492,60 @@ static void MainParseCmdLine(int argc, char **argv)
     };
     MBOption measure_opts[] = {
         { "-C", "--controlPopulation", TRUE,  "Population file for control fleets" },
+        { NULL, "--sprt",              FALSE, "Stop each fleet once its result is clear" },
+        { NULL, "--defectiveLevel",    TRUE,  "Win ratio threshold for --sprt" },
+        { NULL, "--sprtAlpha",         TRUE,  "SPRT false-pass rate"          },
+        { NULL, "--sprtBeta",          TRUE,  "SPRT false-fail rate"          },
+        { NULL, "--sprtDelta",         TRUE,  "SPRT indifference half-width"  },
     };
     MBOption optimize_opts[] = {
         { "-C", "--controlPopulation", TRUE,  "Population file for control fleets" },
+        { NULL, "--sprt",              FALSE, "Stop each fleet once its result is clear" },
+        { NULL, "--defectiveLevel",    TRUE,  "Win ratio threshold for --sprt" },
+        { NULL, "--sprtAlpha",         TRUE,  "SPRT false-pass rate"          },
+        { NULL, "--sprtBeta",          TRUE,  "SPRT false-fail rate"          },
+        { NULL, "--sprtDelta",         TRUE,  "SPRT indifference half-width"  },
     };
     MBOption merge_opts[] = {
         { "-i", "--inputPopulation",   TRUE,  "Input file for extra population" },
     };
+    MBOption evolve_opts[] = {
+        { "-g", "--generations",       TRUE,  "Number of generations"         },
+        { NULL, "--stablePop",         TRUE,  "Stable population size"        },
+        { NULL, "--noobPop",           TRUE,  "New fleets per generation"     },
+        { NULL, "--saveInterval",      TRUE,  "Generations between saves"     },
+        { NULL, "--screen1",           TRUE,  "Population file for screen1"   },
+        { NULL, "--screen1Iterations", TRUE,  "Battles per fleet for screen1" },
+        { NULL, "--screen1Defective",  TRUE,  "Defective win ratio for screen1" },
+        { NULL, "--screen2",           TRUE,  "Population file for screen2"   },
+        { NULL, "--screen2Iterations", TRUE,  "Battles per fleet for screen2" },
+        { NULL, "--screen2Defective",  TRUE,  "Defective win ratio for screen2" },
+        { NULL, "--screen3",           TRUE,  "Population file for screen3"   },
+        { NULL, "--screen3Iterations", TRUE,  "Battles per fleet for screen3" },
+        { NULL, "--screen3Defective",  TRUE,  "Defective win ratio for screen3" },
+        { NULL, "--screenS",           TRUE,  "Population file for screenS"   },
+        { NULL, "--screenSNewIterations",   TRUE, "screenS battles for new fleets" },
+        { NULL, "--screenSStaleIterations", TRUE, "screenS battles for stable fleets" },
+        { NULL, "--screenSDefective",  TRUE,  "Defective win ratio for screenS" },
+        { NULL, "--race",              FALSE, "Race fleets through screens 1-3" },
+        { NULL, "--raceZ",             TRUE,  "Z-score to drop clear losers early" },
+    };
+    MBOption race_opts[] = {
+        { "-C", "--controlPopulation", TRUE,  "Population file for control fleets" },
+        { NULL, "--defectiveLevel",    TRUE,  "Defective win ratio"           },
+        { NULL, "--raceZ",             TRUE,  "Z-score to drop clear losers early" },
+    };
+    MBOption tournament_opts[] = {
+        { NULL, "--rated",             FALSE, "Rating-based matchups instead of round robin" },
+        { NULL, "--rounds",            TRUE,  "Rounds for --rated"            },
+        { NULL, "--updateRankings",    TRUE,  "Rewrite gRankings in this fleet.c" },
+    };
+    MBOption serve_opts[] = {
+        { NULL, "--socket",            TRUE,  "UNIX socket to listen on"      },
+    };
+    MBOption convertPopulation_opts[] = {
+        { "-o", "--outputFile",        TRUE,  "Output population file (.bpop for binary)" },
+    };
 
     MBOpt_SetProgram("sr2", NULL);
     MBOpt_LoadOptions(NULL, opts, ARRAYSIZE(opts));
@@ -1902,7 +4560,13 @@ static void MainParseCmdLine(int argc, char **argv)
     MBOpt_LoadOptions("optimize", optimize_opts, ARRAYSIZE(optimize_opts));
     MBOpt_LoadOptions("reset", NULL, 0);
     MBOpt_LoadOptions("merge", merge_opts, ARRAYSIZE(merge_opts));
-    MBOpt_LoadOptions("tournament", NULL, 0);
+    MBOpt_LoadOptions("convertPopulation", convertPopulation_opts,
+                      ARRAYSIZE(convertPopulation_opts));
+    MBOpt_LoadOptions("evolve", evolve_opts, ARRAYSIZE(evolve_opts));
+    MBOpt_LoadOptions("race", race_opts, ARRAYSIZE(race_opts));
+    MBOpt_LoadOptions("tournament", tournament_opts,
+                      ARRAYSIZE(tournament_opts));
+    MBOpt_LoadOptions("serve", serve_opts, ARRAYSIZE(serve_opts));
     MBOpt_LoadOptions("run", NULL, 0);
     MBOpt_Init(argc, argv);
 
@@ -1932,6 +4596,39 @@ static void MainParseCmdLine(int argc, char **argv)
 
     mainData.seed = MBOpt_GetUint64("seed");
     mainData.reuseSeed = MBOpt_GetBool("reuseSeed");
+    mainData.crn.enabled = MBOpt_IsPresent("crn");
+    mainData.dedupe = MBOpt_IsPresent("dedupe");
+    mainData.useSchedule = MBOpt_IsPresent("schedule") ||
+                           MBOpt_IsPresent("scheduleNew");
+    Schedule_Create(&mainData.sched, MBOpt_IsPresent("scheduleNew"));
+    if (MBOpt_IsPresent("workers")) {
+        mainData.numWorkers = MBOpt_GetUint("workers");
+    }
+
+    mainData.affinity = AFFINITY_NONE;
+    if (MBOpt_IsPresent("affinity")) {
+        const char *str = MBOpt_GetCStr("affinity");
+        mainData.affinity = Affinity_PolicyFromString(str);
+        if (mainData.affinity == AFFINITY_INVALID) {
+            PANIC("Unknown --affinity: %s\n", str);
+        }
+    }
+    if (MBOpt_IsPresent("queueSpin")) {
+        mainData.queueSpin = MBOpt_GetUint("queueSpin");
+    }
+
+    if (MBOpt_IsPresent("checkpoint")) {
+        uint secs = CHECKPOINT_DEFAULT_SECS;
+        if (MBOpt_IsPresent("checkpointSecs")) {
+            secs = MBOpt_GetUint("checkpointSecs");
+        }
+        mainData.useCheckpoint = TRUE;
+        Checkpoint_Create(&mainData.ckpt, MBOpt_GetCStr("checkpoint"), secs,
+                          MBOpt_IsPresent("resume"), MainCheckpointSave,
+                          MainCheckpointLoad, NULL);
+    } else if (MBOpt_IsPresent("resume")) {
+        PANIC("--resume requires --checkpoint\n");
+    }
 
     mainData.tickLimit = MBOpt_GetInt("tickLimit");
 
@@ -1942,6 +4639,8 @@ static void MainParseCmdLine(int argc, char **argv)
     }
     ASSERT(mainData.numThreads >= 1);
 
+    FastMath_Enable(MBOpt_IsPresent("fastMath"));
+
     mainData.scenario = NULL;
     if (MBOpt_IsPresent("scenario")) {
         mainData.scenario = MBOpt_GetCStr("scenario");
@@ -1965,6 +4664,16 @@ int main(int argc, char **argv)
 
     SDL_Init(mainData.headless ? 0 : SDL_INIT_VIDEO);
 
+    if (MBOpt_IsPresent("resultCache")) {
+        BattleCache_Open(&mainData.resultCache, MBOpt_GetCStr("resultCache"));
+        mainData.useResultCache = TRUE;
+    }
+
+    if (MBOpt_IsPresent("resultLog")) {
+        ResultLog_Open(&mainData.resultLog, MBOpt_GetCStr("resultLog"));
+        mainData.useResultLog = TRUE;
+    }
+
     Warning("Starting SpaceRobots2 %s...\n", mb_debug ? "(debug enabled)" : "");
     Warning("\n");
 
@@ -1987,15 +4696,25 @@ int main(int argc, char **argv)
     } else if (strcmp(cmd, "kill") == 0) {
         MainKillCmd();
     } else if (strcmp(cmd, "measure") == 0) {
+        MainSprtInit();
         MainMeasureCmd();
     } else if (strcmp(cmd, "reset") == 0) {
         MainResetCmd();
     } else if (strcmp(cmd, "merge") == 0) {
         MainMergeCmd();
     } else if (strcmp(cmd, "optimize") == 0) {
+        MainSprtInit();
         MainOptimizeCmd();
     } else if (strcmp(cmd, "tournament") == 0) {
         MainTournamentCmd();
+    } else if (strcmp(cmd, "race") == 0) {
+        MainRaceCmd();
+    } else if (strcmp(cmd, "evolve") == 0) {
+        MainEvolveCmd();
+    } else if (strcmp(cmd, "serve") == 0) {
+        MainServeCmd();
+    } else if (strcmp(cmd, "convertPopulation") == 0) {
+        MainConvertPopulationCmd();
     } else if (strcmp(cmd, "display") == 0 ||
                strcmp(cmd, "run") == 0 ||
                strcmp(cmd, "default") == 0) {
@@ -2004,6 +4723,20 @@ int main(int argc, char **argv)
         PANIC("Unknown command: %s\n", cmd);
     }
 
+    if (mainData.useResultCache) {
+        BattleCache_Close(&mainData.resultCache);
+    }
+    if (mainData.useResultLog) {
+        ResultLog_Close(&mainData.resultLog);
+    }
+    if (mainData.useCheckpoint) {
+        Checkpoint_Destroy(&mainData.ckpt);
+    }
+
+    Schedule_Destroy(&mainData.sched);
+    MainBreakdownReset();
+    MainFreePlayers();
+
     RandomState_Destroy(&mainData.rs);
 
     SDL_Quit();
@@ -147,6 +147,13 @@ public:
 
         // XXX: Void invalid inputs/outputs.
 
+        for (i = 0; i < inputs.size(); i++) {
+            NeuralValue_UseNeighborRadius(&myAIC, &inputDescs[i].value);
+        }
+        for (i = 0; i < outputs.size(); i++) {
+            NeuralValue_UseNeighborRadius(&myAIC, &outputDescs[i].value);
+        }
+
         this->BasicAIGovernor::loadRegistry(mreg);
     }
 
@@ -272,7 +279,7 @@ static void MatrixFleetDestroy(void *aiHandle);
 static void MatrixFleetRunAITick(void *aiHandle);
 static void *MatrixFleetMobSpawned(void *aiHandle, Mob *m);
 static void MatrixFleetMobDestroyed(void *aiHandle, Mob *m, void *aiMobHandle);
-static void MatrixFleetMutate(FleetAIType aiType, MBRegistry *mreg);
+static void MatrixFleetMutate(FleetAIType aiType, Genome *g);
 
 void MatrixFleet_GetOps(FleetAIType aiType, FleetAIOps *ops)
 {
@@ -292,11 +299,11 @@ void MatrixFleet_GetOps(FleetAIType aiType, FleetAIOps *ops)
     ops->runAITick = &MatrixFleetRunAITick;
     ops->mobSpawned = &MatrixFleetMobSpawned;
     ops->mobDestroyed = &MatrixFleetMobDestroyed;
-    ops->mutateParams = &MatrixFleetMutate;
+    ops->mutateGenome = &MatrixFleetMutate;
     //ops->dumpSanitizedParams = &MatrixFleetDumpSanitizedParams;
 }
 
-static void MatrixFleetMutate(FleetAIType aiType, MBRegistry *mreg)
+static void MatrixFleetMutate(FleetAIType aiType, Genome *g)
 {
     MutationFloatParams vf[] = {
         // key                     min     max       mag   jump   mutation
@@ -321,14 +328,14 @@ static void MatrixFleetMutate(FleetAIType aiType, MBRegistry *mreg)
     };
 
     float rate = 0.10;
-    MBRegistry_PutCopy(mreg, MATRIX_SCRAMBLE_KEY, "FALSE");
+    Genome_PutCStr(g, MATRIX_SCRAMBLE_KEY, "FALSE");
 
     if (Random_Flip(0.10)) {
         rate *= 10.0f;
 
         if (Random_Flip(0.01)) {
             rate = 1.0f;
-            MBRegistry_PutCopy(mreg, MATRIX_SCRAMBLE_KEY, "TRUE");
+            Genome_PutCStr(g, MATRIX_SCRAMBLE_KEY, "TRUE");
         }
 
         if (rate >= 1.0f) {
@@ -344,17 +351,17 @@ static void MatrixFleetMutate(FleetAIType aiType, MBRegistry *mreg)
         vb[i].flipRate = MAX(vb[i].flipRate, 0.5f);
     }
 
-    SensorGrid_Mutate(mreg, rate, "");
+    SensorGrid_Mutate(g, rate, "");
 
-    Mutate_Float(mreg, vf, ARRAYSIZE(vf));
-    Mutate_Bool(mreg, vb, ARRAYSIZE(vb));
+    Mutate_GenomeFloat(g, vf, ARRAYSIZE(vf));
+    Mutate_GenomeBool(g, vb, ARRAYSIZE(vb));
 
     MBString s;
     uint i;
     uint numInputs, numOutputs;
 
     s = "numInputs";
-    numInputs = MBRegistry_GetUint(mreg, s.CStr());
+    numInputs = Genome_GetUint(g, s.CStr());
     if (numInputs == 0) {
         numInputs = MATRIX_DEFAULT_NODES;
     }
@@ -362,12 +369,12 @@ static void MatrixFleetMutate(FleetAIType aiType, MBRegistry *mreg)
         char *lcstr = NULL;
         int ret = asprintf(&lcstr, "input[%d].", i);
         VERIFY(ret > 0);
-        NeuralInput_Mutate(mreg, rate, NN_TYPE_FORCES, lcstr);
+        NeuralInput_Mutate(g, rate, NN_TYPE_FORCES, lcstr);
         free(lcstr);
     }
 
     s = "numOutputs";
-    numOutputs = MBRegistry_GetUint(mreg, s.CStr());
+    numOutputs = Genome_GetUint(g, s.CStr());
     if (numOutputs == 0) {
         numOutputs = MATRIX_DEFAULT_NODES;
     }
@@ -375,63 +382,60 @@ static void MatrixFleetMutate(FleetAIType aiType, MBRegistry *mreg)
         char *lcstr = NULL;
         int ret = asprintf(&lcstr, "output[%d].", i);
         VERIFY(ret > 0);
-        NeuralOutput_Mutate(mreg, rate, NN_TYPE_FORCES, lcstr);
+        NeuralOutput_Mutate(g, rate, NN_TYPE_FORCES, lcstr);
         free(lcstr);
     }
 
-    MBVector<float> row;
     MBVector<float> weights;
     weights.resize(numInputs * numOutputs);
-    row.resize(numInputs);
 
     MutationFloatParams mfp;
     Mutate_DefaultFloatParams(&mfp, MUTATION_TYPE_WEIGHT);
     mfp.mutationRate = (mfp.mutationRate + rate) / 2.0f;
 
     for (i = 0; i < numOutputs; i++) {
-        MBString rowStr;
+        const float *rowValues;
+        uint rowSize;
         uint j;
 
         char *lcstr = NULL;
         int ret = asprintf(&lcstr, "weight[%d]", i);
         VERIFY(ret > 0);
-        rowStr = MBRegistry_GetCStr(mreg, lcstr);
-        TextDump_Convert(rowStr, row);
-        free(lcstr);
+        rowValues = Genome_GetFloats(g, lcstr, &rowSize);
 
         for (j = 0; j < numInputs; j++) {
             uint w = i * numInputs + j;
 
-            if (j < row.size()) {
-                weights[w] = row[j];
+            if (j < rowSize) {
+                weights[w] = rowValues[j];
             } else {
                 weights[w] = Mutate_FloatRaw(0.0f, TRUE, &mfp);
             }
         }
+        free(lcstr);
     }
 
     for (uint w = 0; w < weights.size(); w++) {
         weights[w] = Mutate_FloatRaw(weights[w], FALSE, &mfp);
     }
 
-    row.resize(numInputs);
+    float *rowValues = (float *)malloc(MAX(1, numInputs) * sizeof(float));
     for (i = 0; i < numOutputs; i++) {
-        MBString rowStr;
         uint j;
         for (j = 0; j < numInputs; j++) {
             uint w = i * numInputs + j;
-            row[j] = weights[w];
+            rowValues[j] = weights[w];
         }
 
         char *lcstr = NULL;
         int ret = asprintf(&lcstr, "weight[%d]", i);
         VERIFY(ret > 0);
-        TextDump_Convert(row, rowStr);
-        MBRegistry_PutCopy(mreg, lcstr, rowStr.CStr());
+        Genome_PutFloats(g, lcstr, rowValues, numInputs);
         free(lcstr);
     }
+    free(rowValues);
 
-    MBRegistry_Remove(mreg, MATRIX_SCRAMBLE_KEY);
+    Genome_Remove(g, MATRIX_SCRAMBLE_KEY);
 }
 
 static void *MatrixFleetCreate(FleetAI *ai)
@@ -22,6 +22,7 @@
 #include "textDump.hpp"
 #include "Random.h"
 #include "mutate.h"
+#include "fastMath.h"
 
 #define CLAMP_UNIT(_x) (ML_ClampUnit(_x))
 
@@ -344,7 +345,7 @@ static float MLGaussian(float x, float mean, float stddev)
     float e = (x - mean) / stddev;
     e = (-1.0f / 2.0f) * e * e;
 
-    return c * expf(e);
+    return c * FastMath_Expf(e);
 }
 
 
@@ -495,31 +496,31 @@ float MLFloatNode::computeWork()
         case ML_FOP_1x0_SQRT:
             return sqrtf(getInput(0));
         case ML_FOP_1x0_ARC_COSINE:
-            return acosf(getInput(0));
+            return FastMath_Acosf(getInput(0));
         case ML_FOP_1x0_ARC_SINE:
             return asinf(getInput(0));
         case ML_FOP_1x0_ARC_TANGENT:
-            return atanf(getInput(0));
+            return FastMath_Atanf(getInput(0));
         case ML_FOP_1x0_HYP_COSINE:
             return coshf(getInput(0));
         case ML_FOP_1x0_HYP_SINE:
             return sinhf(getInput(0));
         case ML_FOP_1x0_HYP_TANGENT:
-            return tanhf(getInput(0));
+            return FastMath_Tanhf(getInput(0));
         case ML_FOP_1x0_EXP:
-            return expf(getInput(0));
+            return FastMath_Expf(getInput(0));
         case ML_FOP_1x0_LN:
-            return logf(getInput(0));
+            return FastMath_Logf(getInput(0));
         case ML_FOP_1x0_ABS:
             return fabsf(getInput(0));
         case ML_FOP_1x0_SIN:
-            return sinf(getInput(0));
+            return FastMath_Sinf(getInput(0));
         case ML_FOP_1x0_UNIT_SINE:
-            return 0.5f * sinf(getInput(0)) + 0.5f;
+            return 0.5f * FastMath_Sinf(getInput(0)) + 0.5f;
         case ML_FOP_1x0_ABS_SINE:
-            return fabsf(sinf(getInput(0)));
+            return fabsf(FastMath_Sinf(getInput(0)));
         case ML_FOP_1x0_COS:
-            return cosf(getInput(0));
+            return FastMath_Cosf(getInput(0));
         case ML_FOP_1x0_TAN:
             return tanf(getInput(0));
         case ML_FOP_1x0_PROB_NOT:
@@ -724,13 +725,13 @@ float MLFloatNode::computeWork()
             float p = getParam(0);
             float s = getParam(1);
             float t = getInput(0);
-            return sinf(t/p + s);
+            return FastMath_Sinf(t/p + s);
         }
         case ML_FOP_1x2_COSINE: {
             float p = getParam(0);
             float s = getParam(1);
             float t = getInput(0);
-            return cosf(t/p + s);
+            return FastMath_Cosf(t/p + s);
         }
 
         case ML_FOP_1x2_INSIDE_RANGE: {
@@ -831,14 +832,14 @@ float MLFloatNode::computeWork()
             float p0 = getParam(0);
             float p1 = getParam(1);
             float p2 = getParam(2);
-            return p0 * atanf(p1 * (f + p2));
+            return p0 * FastMath_Atanf(p1 * (f + p2));
         }
         case ML_FOP_1x3_ARC_COSINE: {
             float f = getInput(0);
             float p0 = getParam(0);
             float p1 = getParam(1);
             float p2 = getParam(2);
-            return p0 * acosf(p1 * (f + p2));
+            return p0 * FastMath_Acosf(p1 * (f + p2));
         }
         case ML_FOP_1x3_HYP_COSINE: {
             float f = getInput(0);
@@ -859,35 +860,35 @@ float MLFloatNode::computeWork()
             float p0 = getParam(0);
             float p1 = getParam(1);
             float p2 = getParam(2);
-            return p0 * tanhf(p1 * (f + p2));
+            return p0 * FastMath_Tanhf(p1 * (f + p2));
         }
         case ML_FOP_1x3_EXP: {
             float f = getInput(0);
             float p0 = getParam(0);
             float p1 = getParam(1);
             float p2 = getParam(2);
-            return p0 * expf(p1 * (f + p2));
+            return p0 * FastMath_Expf(p1 * (f + p2));
         }
         case ML_FOP_1x3_LN: {
             float f = getInput(0);
             float p0 = getParam(0);
             float p1 = getParam(1);
             float p2 = getParam(2);
-            return p0 * logf(p1 * (f + p2));
+            return p0 * FastMath_Logf(p1 * (f + p2));
         }
         case ML_FOP_1x3_SIN: {
             float f = getInput(0);
             float p0 = getParam(0);
             float p1 = getParam(1);
             float p2 = getParam(2);
-            return p0 * sinf(p1 * (f + p2));
+            return p0 * FastMath_Sinf(p1 * (f + p2));
         }
         case ML_FOP_1x3_COS: {
             float f = getInput(0);
             float p0 = getParam(0);
             float p1 = getParam(1);
             float p2 = getParam(2);
-            return p0 * cosf(p1 * (f + p2));
+            return p0 * FastMath_Cosf(p1 * (f + p2));
         }
         case ML_FOP_1x3_TAN: {
             float f = getInput(0);
@@ -919,13 +920,13 @@ float MLFloatNode::computeWork()
         }
 
         case ML_FOP_1x1_POW:
-            return powf(getInput(0), getParam(0));
+            return FastMath_Powf(getInput(0), getParam(0));
         case ML_FOP_2x0_POW:
-            return powf(getInput(0), getInput(1));
+            return FastMath_Powf(getInput(0), getInput(1));
         case ML_FOP_1x2_POW:
-            return getParam(1) * powf(getInput(0), getParam(0));
+            return getParam(1) * FastMath_Powf(getInput(0), getParam(0));
         case ML_FOP_3x0_POW:
-            return getInput(2) * powf(getInput(0), getInput(1));
+            return getInput(2) * FastMath_Powf(getInput(0), getInput(1));
 
         case ML_FOP_2x0_SUM:
             return getInput(0) + getInput(1);
@@ -1132,7 +1133,7 @@ float MLFloatNode::computeWork()
                 for (uint i = 0; i < inputs.size(); i++) {
                     f *= getInput(i);
                 }
-                f = powf(f, 1.0f / inputs.size());
+                f = FastMath_Powf(f, 1.0f / inputs.size());
             }
 
             return f;
@@ -1144,7 +1145,7 @@ float MLFloatNode::computeWork()
                 for (uint i = 0; i < inputs.size(); i++) {
                     f *= getInput(i) * getParam(i);
                 }
-                f = powf(f, 1.0f / inputs.size());
+                f = FastMath_Powf(f, 1.0f / inputs.size());
             }
 
             return f;
@@ -1163,7 +1164,7 @@ float MLFloatNode::computeWork()
             }
 
             if (count > 0) {
-                f = powf(f, 1.0f / count);
+                f = FastMath_Powf(f, 1.0f / count);
             }
 
             return f;
@@ -1380,7 +1381,7 @@ float MLFloatNode::computeWork()
                 f += getInput(i);
             }
 
-            return CLAMP_UNIT(logf(f));
+            return CLAMP_UNIT(FastMath_Logf(f));
         }
         case ML_FOP_Nx0_ACTIVATE_LN_DOWN: {
             float f = 0.0f;
@@ -1389,7 +1390,7 @@ float MLFloatNode::computeWork()
                 f += getInput(i);
             }
 
-            return CLAMP_UNIT(1.0f - logf(f));
+            return CLAMP_UNIT(1.0f - FastMath_Logf(f));
         }
         case ML_FOP_NxN_ACTIVATE_POLYNOMIAL: {
             float f = 0.0f;
@@ -1435,7 +1436,7 @@ float MLFloatNode::computeWork()
                 f += getInput(i);
             }
 
-            return CLAMP_UNIT(tanhf(f));
+            return CLAMP_UNIT(FastMath_Tanhf(f));
         }
         case ML_FOP_Nx0_ACTIVATE_LOGISTIC: {
             float f = 0.0f;
@@ -1444,7 +1445,7 @@ float MLFloatNode::computeWork()
                 f += getInput(i);
             }
 
-            float s = 1.0f / (1.0f + expf(-f));
+            float s = 1.0f / (1.0f + FastMath_Expf(-f));
             return CLAMP_UNIT(s);
         }
         case ML_FOP_Nx0_ACTIVATE_SOFTPLUS: {
@@ -1454,7 +1455,7 @@ float MLFloatNode::computeWork()
                 f += getInput(i);
             }
 
-            float s = logf(1 + expf(f));
+            float s = FastMath_Logf(1 + FastMath_Expf(f));
             return CLAMP_UNIT(s);
         }
         case ML_FOP_Nx0_ACTIVATE_GAUSSIAN: {
@@ -1464,7 +1465,7 @@ float MLFloatNode::computeWork()
                 f += getInput(i);
             }
 
-            float s = expf(-(f * f));
+            float s = FastMath_Expf(-(f * f));
             return CLAMP_UNIT(s);
         }
         case ML_FOP_Nx0_ACTIVATE_GAUSSIAN_PROB_INVERSE: {
@@ -1474,7 +1475,7 @@ float MLFloatNode::computeWork()
                 f += getInput(i);
             }
 
-            float s = 1.0f - expf(-(f * f));
+            float s = 1.0f - FastMath_Expf(-(f * f));
             return CLAMP_UNIT(s);
         }
         case ML_FOP_Nx0_ACTIVATE_GAUSSIAN_UP: {
@@ -1486,7 +1487,7 @@ float MLFloatNode::computeWork()
 
             f -= 1.0f;
 
-            float s = expf(-(f * f));
+            float s = FastMath_Expf(-(f * f));
             return CLAMP_UNIT(s);
         }
         case ML_FOP_Nx0_ACTIVATE_GAUSSIAN_UP_PROB_INVERSE: {
@@ -1498,7 +1499,7 @@ float MLFloatNode::computeWork()
 
             f -= 1.0f;
 
-            float s = 1.0f - expf(-(f * f));
+            float s = 1.0f - FastMath_Expf(-(f * f));
             return CLAMP_UNIT(s);
         }
         case ML_FOP_Nx2_ACTIVATE_GAUSSIAN: {
@@ -1743,7 +1744,7 @@ float MLFloatNode::computeWork()
             float f = 0.0;
 
             for (uint i = 0; i < inputs.size(); i++) {
-                f += powf(getInput(i), getParam(0));
+                f += FastMath_Powf(getInput(i), getParam(0));
             }
             return f;
         }
@@ -1751,7 +1752,7 @@ float MLFloatNode::computeWork()
             float f = 0.0;
 
             for (uint i = 0; i < inputs.size(); i++) {
-                f += powf(getInput(i), getParam(i));
+                f += FastMath_Powf(getInput(i), getParam(i));
             }
             return f;
         }
@@ -1759,7 +1760,8 @@ float MLFloatNode::computeWork()
             float f = 0.0;
 
             for (uint i = 0; i < inputs.size(); i++) {
-                f += getParam(2*i + 1) * powf(getInput(i), getParam(2 * i));
+                f += getParam(2*i + 1) *
+                     FastMath_Powf(getInput(i), getParam(2 * i));
             }
             return f;
         }
@@ -1975,6 +1977,69 @@ void MLFloatNode::save(MBRegistry *mreg, const char *prefix)
 }
 
 
+void MLFloatNode::load(Genome *g, const char *prefix)
+{
+    MBString p;
+    const uint *iv;
+    const float *fv;
+    uint n;
+
+    p = prefix;
+    p += "op";
+    op = ML_StringToFloatOp(Genome_GetCStr(g, p.CStr()));
+    if (op == ML_FOP_INVALID) {
+        op = ML_FOP_0x0_ZERO;
+    }
+    VERIFY(op < ML_FOP_MAX);
+
+    p = prefix;
+    p += "inputs";
+    iv = Genome_GetUints(g, p.CStr(), &n);
+    inputs.resize(n);
+    for (uint i = 0; i < n; i++) {
+        inputs[i] = iv[i];
+    }
+
+    p = prefix;
+    p += "params";
+    fv = Genome_GetFloats(g, p.CStr(), &n);
+    params.resize(n);
+    for (uint i = 0; i < n; i++) {
+        params[i] = fv[i];
+    }
+}
+
+void MLFloatNode::save(Genome *g, const char *prefix)
+{
+    MBString p;
+    uint n;
+
+    p = prefix;
+    p += "op";
+    Genome_PutCStr(g, p.CStr(), ML_FloatOpToString(op));
+
+    p = prefix;
+    p += "inputs";
+    n = inputs.size();
+    uint *iv = (uint *)malloc(MAX(1, n) * sizeof(iv[0]));
+    for (uint i = 0; i < n; i++) {
+        iv[i] = inputs[i];
+    }
+    Genome_PutUints(g, p.CStr(), iv, n);
+    free(iv);
+
+    p = prefix;
+    p += "params";
+    n = params.size();
+    float *fv = (float *)malloc(MAX(1, n) * sizeof(fv[0]));
+    for (uint i = 0; i < n; i++) {
+        fv[i] = params[i];
+    }
+    Genome_PutFloats(g, p.CStr(), fv, n);
+    free(fv);
+}
+
+
 void MLFloatOp_GetNumParams(MLFloatOp op, uint *numInputsP, uint *numParamsP)
 {
     uint numInputsIn = *numInputsP;
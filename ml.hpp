@@ -22,6 +22,7 @@
 #include <math.h>
 
 #include "MBRegistry.h"
+#include "genome.h"
 #include "MBVector.hpp"
 
 /*
@@ -306,8 +307,10 @@ class MLFloatNode {
         }
 
         void load(MBRegistry *mreg, const char *prefix);
+        void load(Genome *g, const char *prefix);
         void mutate(float rate, uint maxInputs, uint maxParams);
         void save(MBRegistry *mreg, const char *prefix);
+        void save(Genome *g, const char *prefix);
 
         void minimize();
         void makeVoid();
@@ -105,18 +105,28 @@ static inline void MobFilter_UseFn(MobFilter *mf, MobFilterFn func,
     mf->fnF.func = func;
 }
 
-static inline void MobFilter_UseRange(MobFilter *mf, const FPoint *pos,
-                                      float radius)
+static inline void MobFilter_UseRangeSquared(MobFilter *mf, const FPoint *pos,
+                                             float radiusSquared)
 {
     ASSERT(mf->filterTypeFlags < MOB_FILTER_TFLAG_MAX);
     ASSERT((mf->filterTypeFlags & MOB_FILTER_TFLAG_RANGE) == 0);
 
-    if (radius <= 0.0f) {
+    if (radiusSquared <= 0.0f) {
         mf->filterTypeFlags |= MOB_FILTER_TFLAG_EMPTY;
     } else {
         mf->filterTypeFlags |= MOB_FILTER_TFLAG_RANGE;
         mf->rangeF.pos = *pos;
-        mf->rangeF.radiusSquared = radius * radius;
+        mf->rangeF.radiusSquared = radiusSquared;
+    }
+}
+
+static inline void MobFilter_UseRange(MobFilter *mf, const FPoint *pos,
+                                      float radius)
+{
+    if (radius <= 0.0f) {
+        MobFilter_UseRangeSquared(mf, pos, 0.0f);
+    } else {
+        MobFilter_UseRangeSquared(mf, pos, radius * radius);
     }
 }
 
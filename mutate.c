@@ -231,17 +231,8 @@ void Mutate_FloatType(MBRegistry *mreg, const char *key, MutationType type)
     Mutate_Float(mreg, &mp, 1);
 }
 
-void Mutate_Index(MBRegistry *mreg, const char *key, float rate)
+static int MutateIndexRaw(int x)
 {
-    int x, ret;
-    char *v = NULL;
-
-    if (!Random_Flip(rate)) {
-        return;
-    }
-
-    x = MBRegistry_GetInt(mreg, key);
-
     if (Random_Flip(0.01f)) {
         x = -1;
     } else if (Random_Flip(0.1f)) {
@@ -254,8 +245,94 @@ void Mutate_Index(MBRegistry *mreg, const char *key, float rate)
         x = Random_Int(-1, MAX(1, x + 1));
     }
 
+    return x;
+}
+
+void Mutate_Index(MBRegistry *mreg, const char *key, float rate)
+{
+    int x, ret;
+    char *v = NULL;
+
+    if (!Random_Flip(rate)) {
+        return;
+    }
+
+    x = MutateIndexRaw(MBRegistry_GetInt(mreg, key));
+
     ret = asprintf(&v, "%d", x);
     VERIFY(ret > 0);
     MBRegistry_PutCopy(mreg, key, v);
     free(v);
 }
+
+/*
+ * The Genome versions below draw from Random in the same order as the
+ * MBRegistry versions above for any single value, but the values stay
+ * in binary instead of going through "%f" text between mutations, so a
+ * given seed doesn't reproduce the mutations from the MBRegistry path.
+ */
+void Mutate_GenomeFloat(Genome *g, MutationFloatParams *mpa, uint32 numParams)
+{
+    ASSERT(mpa != NULL);
+
+    for (uint32 i = 0; i < numParams; i++) {
+        MutationFloatParams *mp = &mpa[i];
+        if (Random_Flip(mp->mutationRate)) {
+            bool missing = !Genome_ContainsKey(g, mp->key);
+            float value = Genome_GetFloat(g, mp->key);
+            value = Mutate_FloatRaw(value, missing, mp);
+            Genome_PutFloat(g, mp->key, value);
+        }
+    }
+}
+
+void Mutate_GenomeFloatType(Genome *g, const char *key, MutationType type)
+{
+    MutationFloatParams mp;
+    Mutate_DefaultFloatParams(&mp, type);
+    mp.key = key;
+    Mutate_GenomeFloat(g, &mp, 1);
+}
+
+void Mutate_GenomeBool(Genome *g, MutationBoolParams *mpa, uint32 numParams)
+{
+    ASSERT(mpa != NULL);
+
+    for (uint32 i = 0; i < numParams; i++) {
+        MutationBoolParams *mp = &mpa[i];
+        if (Random_Flip(mp->flipRate)) {
+            bool value;
+
+            if (Genome_ContainsKey(g, mp->key)) {
+                value = !Genome_GetBool(g, mp->key);
+            } else {
+                value = Random_Bit();
+            }
+            Genome_PutBool(g, mp->key, value);
+        }
+    }
+}
+
+void Mutate_GenomeStr(Genome *g, MutationStrParams *mpa, uint32 numParams,
+                      const char **options, uint32 numOptions)
+{
+    ASSERT(mpa != NULL);
+    ASSERT(numOptions > 0);
+
+    for (uint32 i = 0; i < numParams; i++) {
+        MutationStrParams *mp = &mpa[i];
+        if (Random_Flip(mp->flipRate)) {
+            uint choice = Random_Int(0, numOptions - 1);
+            Genome_PutCStr(g, mp->key, options[choice]);
+        }
+    }
+}
+
+void Mutate_GenomeIndex(Genome *g, const char *key, float rate)
+{
+    if (!Random_Flip(rate)) {
+        return;
+    }
+
+    Genome_PutInt(g, key, MutateIndexRaw(Genome_GetInt(g, key)));
+}
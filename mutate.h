@@ -20,6 +20,7 @@
 #define _MUTATE_H_20211117
 
 #include "MBRegistry.h"
+#include "genome.h"
 
 #ifdef __cplusplus
 	extern "C" {
@@ -75,6 +76,13 @@ void Mutate_Bool(MBRegistry *mreg, MutationBoolParams *mp, uint32 numParams);
 void Mutate_Str(MBRegistry *mreg, MutationStrParams *mp, uint32 numParams,
                 const char **options, uint32 numOptions);
 
+void Mutate_GenomeFloatType(Genome *g, const char *key, MutationType type);
+void Mutate_GenomeFloat(Genome *g, MutationFloatParams *mp, uint32 numParams);
+void Mutate_GenomeIndex(Genome *g, const char *key, float rate);
+void Mutate_GenomeBool(Genome *g, MutationBoolParams *mp, uint32 numParams);
+void Mutate_GenomeStr(Genome *g, MutationStrParams *mp, uint32 numParams,
+                      const char **options, uint32 numOptions);
+
 #ifdef __cplusplus
     }
 #endif
@@ -22,6 +22,7 @@
 #include "mobFilter.h"
 #include "ml.hpp"
 #include "flockFleet.hpp"
+#include "fastMath.h"
 
 static bool NeuralForceGeneMidway(AIContext *nc,
                                   Mob *mob,
@@ -700,7 +701,7 @@ void NeuralInput_Load(MBRegistry *mreg,
     NeuralValue_Load(mreg, &desc->value, s.CStr());
 }
 
-void NeuralLocus_Mutate(MBRegistry *mreg,
+void NeuralLocus_Mutate(Genome *g,
                         float rate, const char *prefix)
 {
     MBString s;
@@ -708,25 +709,31 @@ void NeuralLocus_Mutate(MBRegistry *mreg,
     NeuralLocusDesc desc;
     MutationBoolParams bf;
 
-    NeuralLocus_Load(mreg, &desc, prefix);
+    s = prefix;
+    s += "locusType";
+    v = Genome_GetCStr(g, s.CStr());
+    if (v == NULL) {
+        v = NeuralLocus_ToString(NEURAL_LOCUS_VOID);
+    }
+    desc.locusType = NeuralLocus_FromString(v);
 
     if (Random_Flip(rate)) {
         s = prefix;
         s += "locusType";
         desc.locusType = NeuralLocus_Random();
         v = NeuralLocus_ToString(desc.locusType);
-        MBRegistry_PutCopy(mreg, s.CStr(), v);
+        Genome_PutCStr(g, s.CStr(), v);
     }
 
     s = prefix;
     s += "speed";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_SPEED);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_SPEED);
 
     s = prefix;
     s += "speedLimited";
     bf.key = s.CStr();
     bf.flipRate = MIN(0.5f, rate);
-    Mutate_Bool(mreg, &bf, 1);
+    Mutate_GenomeBool(g, &bf, 1);
 
     /*
      * Mutate all the fields, not just the active ones for the current
@@ -741,46 +748,46 @@ void NeuralLocus_Mutate(MBRegistry *mreg,
     // NEURAL_LOCUS_ORBIT
     s = prefix;
     s += "radius";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_RADIUS);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_RADIUS);
 
     // NEURAL_LOCUS_ORBIT || NEURAL_LOCUS_TRACK
 
     s = prefix;
     s += "focus.";
-    NeuralForce_Mutate(mreg, rate, s.CStr());
+    NeuralForce_Mutate(g, rate, s.CStr());
 
     // NEURAL_LOCUS_ORBIT || NEURAL_LOCUS_PATROL_EDGES
     s = prefix;
     s += "period";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_PERIOD);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_PERIOD);
 
     // NEURAL_LOCUS_PATROL_MAP
     s = prefix;
     s += "linearPeriod";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_PERIOD);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_PERIOD);
 
     s = prefix;
     s += "linearXPeriodOffset";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_PERIOD_OFFSET);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_PERIOD_OFFSET);
 
     s = prefix;
     s += "linearYPeriodOffset";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_PERIOD_OFFSET);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_PERIOD_OFFSET);
 
     s = prefix;
     s += "linearWeight";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_WEIGHT);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_WEIGHT);
 
     s = prefix;
     s += "circularPeriod";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_PERIOD);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_PERIOD);
 
     s = prefix;
     s += "circularWeight";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_WEIGHT);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_WEIGHT);
 }
 
-void NeuralCondition_Mutate(MBRegistry *mreg,
+void NeuralCondition_Mutate(Genome *g,
                             float rate,
                             NeuralNetType nnType,
                             const char *prefix)
@@ -799,59 +806,55 @@ void NeuralCondition_Mutate(MBRegistry *mreg,
     s += "squad.active";
     bf.key = s.CStr();
     bf.flipRate = MIN(0.5f, rate);
-    Mutate_Bool(mreg, &bf, 1);
+    Mutate_GenomeBool(g, &bf, 1);
 
     s = prefix;
     s += "squad.invert";
     bf.key = s.CStr();
     bf.flipRate = MIN(0.5f, rate);
-    Mutate_Bool(mreg, &bf, 1);
+    Mutate_GenomeBool(g, &bf, 1);
 
     s = prefix;
     s += "squad.desc.";
-    NeuralSquad_Mutate(mreg, rate, prefix);
+    NeuralSquad_Mutate(g, rate, prefix);
 
     s = prefix;
     s += "squad.limit0";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_UNIT);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_UNIT);
 
     s = prefix;
     s += "squad.limit1";
-    Mutate_FloatType(mreg, s.CStr(), MUTATION_TYPE_UNIT);
+    Mutate_GenomeFloatType(g, s.CStr(), MUTATION_TYPE_UNIT);
 }
 
-void NeuralForce_Mutate(MBRegistry *mreg, float rate, const char *prefix)
+void NeuralForce_Mutate(Genome *g, float rate, const char *prefix)
 {
     MBString s;
-    NeuralForceDesc desc;
     MutationFloatParams vf;
 
-    NeuralForce_Load(mreg, &desc, prefix);
-
     Mutate_DefaultFloatParams(&vf, MUTATION_TYPE_RADIUS);
     s = prefix;
     s += "radius";
     vf.key = s.CStr();
-    Mutate_Float(mreg, &vf, 1);
+    Mutate_GenomeFloat(g, &vf, 1);
 
     Mutate_DefaultFloatParams(&vf, MUTATION_TYPE_RADIUS);
     s = prefix;
     s += "range";
     vf.key = s.CStr();
-    Mutate_Float(mreg, &vf, 1);
+    Mutate_GenomeFloat(g, &vf, 1);
 
     s = prefix;
     s += "forceType";
     if (Random_Flip(rate)) {
         NeuralForceType ft = NeuralForce_Random();
         const char *v = NeuralForce_ToString(ft);;
-        MBRegistry_PutCopy(mreg, s.CStr(), v);
-        desc.forceType = ft;
+        Genome_PutCStr(g, s.CStr(), v);
     }
 
     s = prefix;
     s += "index";
-    Mutate_Index(mreg, s.CStr(), rate);
+    Mutate_GenomeIndex(g, s.CStr(), rate);
 
     MutationBoolParams bf;
     const char *strs[] = {
@@ -864,45 +867,45 @@ void NeuralForce_Mutate(MBRegistry *mreg, float rate, const char *prefix)
         s += strs[i];
         bf.key = s.CStr();
         bf.flipRate = rate / 2.0f;
-        Mutate_Bool(mreg, &bf, 1);
+        Mutate_GenomeBool(g, &bf, 1);
     }
 }
 
-void NeuralSquad_Mutate(MBRegistry *mreg,
+void NeuralSquad_Mutate(Genome *g,
                         float rate, const char *prefix)
 {
     MBString s;
 
     s = prefix;
     s += "seed";
-    Mutate_Index(mreg, s.CStr(), rate);
+    Mutate_GenomeIndex(g, s.CStr(), rate);
 
     s = prefix;
     s += "numSquads";
-    Mutate_Index(mreg, s.CStr(), rate);
+    Mutate_GenomeIndex(g, s.CStr(), rate);
 
     s = prefix;
     s += "squadType";
     if (Random_Flip(rate)) {
         NeuralSquadType st = NeuralSquad_Random();
         const char *v = NeuralSquad_ToString(st);
-        MBRegistry_PutCopy(mreg, s.CStr(), v);
+        Genome_PutCStr(g, s.CStr(), v);
     }
 }
 
-void NeuralOutput_Mutate(MBRegistry *mreg,
+void NeuralOutput_Mutate(Genome *g,
                          float rate, NeuralNetType nnType,
                          const char *prefix)
 {
     MBString s;
 
     s = prefix;
-    NeuralValue_Mutate(mreg, rate, TRUE, nnType, s.CStr());
+    NeuralValue_Mutate(g, rate, TRUE, nnType, s.CStr());
 
     if (NN_USE_CONDITIONS) {
         s = prefix;
         s += "condition.";
-        NeuralCondition_Mutate(mreg, rate, nnType, s.CStr());
+        NeuralCondition_Mutate(g, rate, nnType, s.CStr());
     }
 
     s = prefix;
@@ -910,31 +913,39 @@ void NeuralOutput_Mutate(MBRegistry *mreg,
     if (Random_Flip(rate)) {
         NeuralCombinerType ct = NeuralCombiner_Random();
         const char *v = NeuralCombiner_ToString(ct);
-        MBRegistry_PutCopy(mreg, s.CStr(), v);
+        Genome_PutCStr(g, s.CStr(), v);
     }
 }
 
-void NeuralInput_Mutate(MBRegistry *mreg,
+void NeuralInput_Mutate(Genome *g,
                         float rate, NeuralNetType nnType,
                         const char *prefix)
 {
     MBString s;
 
     s = prefix;
-    NeuralValue_Mutate(mreg, rate, FALSE, nnType, s.CStr());
+    NeuralValue_Mutate(g, rate, FALSE, nnType, s.CStr());
 }
 
-void NeuralValue_Mutate(MBRegistry *mreg,
+void NeuralValue_Mutate(Genome *g,
                         float rate, bool isOutput, NeuralNetType nnType,
                         const char *prefix)
 {
     NeuralValueDesc desc;
     MBString s;
+    const char *cstr;
 
-    NeuralValue_Load(mreg, &desc, prefix);
-
+    /*
+     * Only the valueType is needed to pick which fields to mutate.
+     */
     s = prefix;
     s += "valueType";
+    cstr = Genome_GetCStr(g, s.CStr());
+    if (cstr == NULL) {
+        cstr = NeuralValue_ToString(NEURAL_VALUE_ZERO);
+    }
+    desc.valueType = NeuralValue_FromString(cstr);
+    VERIFY(desc.valueType < NEURAL_VALUE_MAX);
 
     if (isOutput) {
         if (nnType == NN_TYPE_FORCES) {
@@ -947,10 +958,10 @@ void NeuralValue_Mutate(MBRegistry *mreg,
         desc.valueType = NeuralValue_Random();
     }
     const char *v = NeuralValue_ToString(desc.valueType);
-    MBRegistry_PutCopy(mreg, s.CStr(), v);
+    Genome_PutCStr(g, s.CStr(), v);
 
     if (desc.valueType == NEURAL_VALUE_FORCE) {
-        NeuralForce_Mutate(mreg, rate, prefix);
+        NeuralForce_Mutate(g, rate, prefix);
     } else if (desc.valueType == NEURAL_VALUE_CROWD) {
         MutationFloatParams vf;
 
@@ -958,18 +969,18 @@ void NeuralValue_Mutate(MBRegistry *mreg,
         s = prefix;
         s += "radius";
         vf.key = s.CStr();
-        Mutate_Float(mreg, &vf, 1);
+        Mutate_GenomeFloat(g, &vf, 1);
 
         s = prefix;
         s += "crowdType";
         if (Random_Flip(rate)) {
             NeuralCrowdType ct = NeuralCrowd_Random();
             const char *v = NeuralCrowd_ToString(ct);
-            MBRegistry_PutCopy(mreg, s.CStr(), v);
+            Genome_PutCStr(g, s.CStr(), v);
             desc.crowdDesc.crowdType = ct;
         }
     } else if (desc.valueType == NEURAL_VALUE_SQUAD) {
-        NeuralSquad_Mutate(mreg, rate, prefix);
+        NeuralSquad_Mutate(g, rate, prefix);
     } else if (desc.valueType == NEURAL_VALUE_TICK) {
         MutationFloatParams vf;
 
@@ -977,14 +988,14 @@ void NeuralValue_Mutate(MBRegistry *mreg,
         s = prefix;
         s += "frequency";
         vf.key = s.CStr();
-        Mutate_Float(mreg, &vf, 1);
+        Mutate_GenomeFloat(g, &vf, 1);
 
         s = prefix;
         s += "waveType";
         if (Random_Flip(rate)) {
             NeuralWaveType wi = NeuralWave_Random();
             const char *v = NeuralWave_ToString(wi);
-            MBRegistry_PutCopy(mreg, s.CStr(), v);
+            Genome_PutCStr(g, s.CStr(), v);
             desc.tickDesc.waveType = wi;
         }
     } else if (desc.valueType == NEURAL_VALUE_SCALAR) {
@@ -994,7 +1005,7 @@ void NeuralValue_Mutate(MBRegistry *mreg,
         if (!isOutput) {
             s = prefix;
             s += "scalarID";
-            Mutate_Index(mreg, s.CStr(), rate);
+            Mutate_GenomeIndex(g, s.CStr(), rate);
         }
     } else if (desc.valueType == NEURAL_VALUE_ZERO ||
                desc.valueType == NEURAL_VALUE_ONE ||
@@ -1199,10 +1210,10 @@ static bool NeuralForceGetSeparateFocus(AIContext *nc,
 {
     FPoint force;
     uint x = 0;
-    MobSet::MobIt mit = nc->sg->friendsIterator(MOB_FLAG_FIGHTER);
 
     MobFilter f;
     MobFilter_Init(&f);
+    MobFilter_UseType(&f, MOB_FLAG_FIGHTER);
     MobFilter_UseRange(&f, &self->pos, desc->radius);
 
     if (desc->forceType == NEURAL_FORCE_FORWARD_SEPARATE ||
@@ -1232,19 +1243,28 @@ static bool NeuralForceGetSeparateFocus(AIContext *nc,
     FPoint_Zero(&force);
 
     if (!MobFilter_IsTriviallyEmpty(&f)) {
-        Mob *ma[512];
-        uint mn = 0;
-        mit.nextBatch(ma, &mn, ARRAYSIZE(ma));
-        MobFilter_Batch(ma, &mn, &f);
-
-        while (mn > 0) {
-            mn--;
-            Mob *m = ma[mn];
-            ASSERT(m != NULL);
-
-            if (m->mobid != self->mobid) {
-                NeuralForceGetRepulseFocus(nc, &self->pos, &m->pos, &force);
-                x++;
+        MBVector<Mob *> &friends = nc->sg->neighbors(&self->pos,
+                                                     desc->radius, TRUE);
+        uint i = 0;
+
+        while (i < friends.size()) {
+            Mob *ma[512];
+            uint mn = 0;
+
+            while (mn < ARRAYSIZE(ma) && i < friends.size()) {
+                ma[mn++] = friends[i++];
+            }
+            MobFilter_Batch(ma, &mn, &f);
+
+            while (mn > 0) {
+                mn--;
+                Mob *m = ma[mn];
+                ASSERT(m != NULL);
+
+                if (m->mobid != self->mobid) {
+                    NeuralForceGetRepulseFocus(nc, &self->pos, &m->pos, &force);
+                    x++;
+                }
             }
         }
     }
@@ -1947,6 +1967,163 @@ bool NeuralForce_GetFocus(AIContext *nc,
     NOT_REACHED();
 }
 
+/*
+ * NeuralValue_UseNeighborRadius --
+ *    Make the SensorGrid neighborhood cache cover the radius that this
+ *    value gathers its neighbors at, if it's a flocking force.
+ *    Forces that aren't covered here still work, but they gather their
+ *    neighbors without the cache.
+ */
+void NeuralValue_UseNeighborRadius(AIContext *nc, NeuralValueDesc *desc)
+{
+    ASSERT(nc != NULL);
+    ASSERT(nc->sg != NULL);
+    ASSERT(desc != NULL);
+
+    if (desc->valueType != NEURAL_VALUE_FORCE) {
+        return;
+    }
+
+    switch (desc->forceDesc.forceType) {
+        case NEURAL_FORCE_ALIGN:
+        case NEURAL_FORCE_ALIGN_BIAS_CENTER:
+        case NEURAL_FORCE_ALIGN2:
+        case NEURAL_FORCE_FORWARD_ALIGN:
+        case NEURAL_FORCE_BACKWARD_ALIGN:
+        case NEURAL_FORCE_ADVANCE_ALIGN:
+        case NEURAL_FORCE_RETREAT_ALIGN:
+        case NEURAL_FORCE_COHERE:
+        case NEURAL_FORCE_FORWARD_COHERE:
+        case NEURAL_FORCE_BACKWARD_COHERE:
+        case NEURAL_FORCE_ADVANCE_COHERE:
+        case NEURAL_FORCE_RETREAT_COHERE:
+        case NEURAL_FORCE_SEPARATE:
+        case NEURAL_FORCE_FORWARD_SEPARATE:
+        case NEURAL_FORCE_BACKWARD_SEPARATE:
+        case NEURAL_FORCE_ADVANCE_SEPARATE:
+        case NEURAL_FORCE_RETREAT_SEPARATE:
+            nc->sg->useNeighborRadius(desc->forceDesc.radius, TRUE);
+            break;
+
+        case NEURAL_FORCE_ENEMY_ALIGN:
+        case NEURAL_FORCE_FORWARD_ENEMY_ALIGN:
+        case NEURAL_FORCE_BACKWARD_ENEMY_ALIGN:
+        case NEURAL_FORCE_ADVANCE_ENEMY_ALIGN:
+        case NEURAL_FORCE_RETREAT_ENEMY_ALIGN:
+        case NEURAL_FORCE_ENEMY_COHERE:
+        case NEURAL_FORCE_ENEMY_COHERE2:
+        case NEURAL_FORCE_FORWARD_ENEMY_COHERE:
+        case NEURAL_FORCE_BACKWARD_ENEMY_COHERE:
+        case NEURAL_FORCE_ADVANCE_ENEMY_COHERE:
+        case NEURAL_FORCE_RETREAT_ENEMY_COHERE:
+        case NEURAL_FORCE_ENEMY_MISSILE_COHERE:
+        case NEURAL_FORCE_FORWARD_ENEMY_MISSILE_COHERE:
+        case NEURAL_FORCE_BACKWARD_ENEMY_MISSILE_COHERE:
+        case NEURAL_FORCE_ADVANCE_ENEMY_MISSILE_COHERE:
+        case NEURAL_FORCE_RETREAT_ENEMY_MISSILE_COHERE:
+        case NEURAL_FORCE_ENEMY_MISSILE_ALIGN:
+        case NEURAL_FORCE_FORWARD_ENEMY_MISSILE_ALIGN:
+        case NEURAL_FORCE_BACKWARD_ENEMY_MISSILE_ALIGN:
+        case NEURAL_FORCE_ADVANCE_ENEMY_MISSILE_ALIGN:
+        case NEURAL_FORCE_RETREAT_ENEMY_MISSILE_ALIGN:
+            nc->sg->useNeighborRadius(desc->forceDesc.radius, FALSE);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*
+ * NeuralForce_IsFocusMobInvariant --
+ *    Returns TRUE if NeuralForce_GetFocus returns the same point for
+ *    every mob in the fleet on a given tick, so the focus can be
+ *    computed once per tick and shared.
+ *    Forces that may draw from the fleet RandomState are never shared.
+ */
+bool NeuralForce_IsFocusMobInvariant(NeuralForceDesc *desc)
+{
+    ASSERT(desc != NULL);
+
+    switch (desc->forceType) {
+        case NEURAL_FORCE_VOID:
+        case NEURAL_FORCE_ZERO:
+            return FALSE;
+
+        case NEURAL_FORCE_CENTER:
+        case NEURAL_FORCE_BASE:
+        case NEURAL_FORCE_BASE_LAX:
+        case NEURAL_FORCE_BASE_MIRROR_LAX:
+        case NEURAL_FORCE_BASE_DEFENSE:
+        case NEURAL_FORCE_BASE_FARTHEST_FRIEND:
+        case NEURAL_FORCE_BASE_CONTROL_LIMIT:
+        case NEURAL_FORCE_ENEMY_BASE:
+        case NEURAL_FORCE_ENEMY_BASE_GUESS:
+        case NEURAL_FORCE_ENEMY_BASE_GUESS_LAX:
+        case NEURAL_FORCE_MIDWAY:
+        case NEURAL_FORCE_MIDWAY_GUESS:
+        case NEURAL_FORCE_MIDWAY_GUESS_LAX:
+        case NEURAL_FORCE_UNEXPLORED:
+        case NEURAL_FORCE_LAST_TARGET_SHADOW:
+            return TRUE;
+
+        /*
+         * These use the heading or the repulse helpers, which can
+         * consume randomness.
+         */
+        case NEURAL_FORCE_HEADING:
+        case NEURAL_FORCE_FORWARD_ALIGN:
+        case NEURAL_FORCE_BACKWARD_ALIGN:
+        case NEURAL_FORCE_FORWARD_COHERE:
+        case NEURAL_FORCE_BACKWARD_COHERE:
+        case NEURAL_FORCE_FORWARD_ENEMY_ALIGN:
+        case NEURAL_FORCE_BACKWARD_ENEMY_ALIGN:
+        case NEURAL_FORCE_FORWARD_ENEMY_COHERE:
+        case NEURAL_FORCE_BACKWARD_ENEMY_COHERE:
+        case NEURAL_FORCE_FORWARD_ENEMY_MISSILE_COHERE:
+        case NEURAL_FORCE_BACKWARD_ENEMY_MISSILE_COHERE:
+        case NEURAL_FORCE_FORWARD_ENEMY_MISSILE_ALIGN:
+        case NEURAL_FORCE_BACKWARD_ENEMY_MISSILE_ALIGN:
+        case NEURAL_FORCE_SEPARATE:
+        case NEURAL_FORCE_FORWARD_SEPARATE:
+        case NEURAL_FORCE_BACKWARD_SEPARATE:
+        case NEURAL_FORCE_ADVANCE_SEPARATE:
+        case NEURAL_FORCE_RETREAT_SEPARATE:
+        case NEURAL_FORCE_EDGES:
+        case NEURAL_FORCE_CORNERS:
+            return FALSE;
+
+        /*
+         * Handled by the NeuralNet or by other fleets.
+         */
+        case NEURAL_FORCE_LOCUS:
+        case NEURAL_FORCE_NEXT_LOCUS:
+        case NEURAL_FORCE_FLOCK1:
+        case NEURAL_FORCE_FLOCK2:
+        case NEURAL_FORCE_FLOCK3:
+        case NEURAL_FORCE_FLOCK4:
+        case NEURAL_FORCE_FLOCK5:
+        case NEURAL_FORCE_FLOCK6:
+        case NEURAL_FORCE_FLOCK7:
+        case NEURAL_FORCE_FLOCK8:
+        case NEURAL_FORCE_FLOCK9:
+        case NEURAL_FORCE_GENE_MIDWAY:
+        case NEURAL_FORCE_GENE_ENEMY_MISSILE:
+        case NEURAL_FORCE_GENE_RETREAT_COHERE:
+        case NEURAL_FORCE_GENE_RETREAT_COHERE2:
+        case NEURAL_FORCE_GENE_RETREAT_ENEMY_ALIGN:
+        case NEURAL_FORCE_GENE_ADVANCE_SEPARATE:
+            return FALSE;
+
+        default:
+            /*
+             * Everything else is relative to the mob, unless we're
+             * using the base in its place.
+             */
+            return desc->useBase;
+    }
+}
+
 /*
  * NeuralForceGetFocusMobPosHelper --
  */
@@ -2280,11 +2457,11 @@ float NeuralTick_GetValue(AIContext *nc, NeuralTickDesc *desc)
     if (desc->waveType == NEURAL_WAVE_NONE) {
         return t;
     } else if (desc->waveType == NEURAL_WAVE_SINE) {
-        return sinf(t / desc->frequency);
+        return FastMath_Sinf(t / desc->frequency);
     } else if (desc->waveType == NEURAL_WAVE_UNIT_SINE) {
-        return 0.5f * sinf(t / desc->frequency) + 0.5f;
+        return 0.5f * FastMath_Sinf(t / desc->frequency) + 0.5f;
     } else if (desc->waveType == NEURAL_WAVE_ABS_SINE) {
-        return fabsf(sinf(t / desc->frequency));
+        return fabsf(FastMath_Sinf(t / desc->frequency));
     } else if (desc->waveType == NEURAL_WAVE_FMOD) {
         return fmodf(t, desc->frequency);
     } else {
@@ -2353,6 +2530,48 @@ float NeuralValue_GetValue(AIContext *nc,
 }
 
 
+/*
+ * NeuralValue_IsMobInvariant --
+ *    Returns TRUE if the value is the same for every mob in the fleet
+ *    on a given tick, so it can be computed once per tick.
+ *    Anything that draws from the fleet RandomState is treated as
+ *    mob-specific.
+ */
+bool NeuralValue_IsMobInvariant(NeuralValueDesc *desc)
+{
+    ASSERT(desc != NULL);
+
+    switch (desc->valueType) {
+        case NEURAL_VALUE_ZERO:
+        case NEURAL_VALUE_VOID:
+        case NEURAL_VALUE_ONE:
+        case NEURAL_VALUE_NEGATIVE_ONE:
+        case NEURAL_VALUE_TICK:
+        case NEURAL_VALUE_CREDITS:
+        case NEURAL_VALUE_FRIEND_SHIPS:
+        case NEURAL_VALUE_FRIEND_MISSILES:
+        case NEURAL_VALUE_ENEMY_SHIPS:
+        case NEURAL_VALUE_ENEMY_MISSILES:
+        case NEURAL_VALUE_SCALAR:
+            return TRUE;
+        case NEURAL_VALUE_CROWD:
+            return desc->crowdDesc.radius <= 0.0f ||
+                   desc->crowdDesc.crowdType == NEURAL_CROWD_BASE_ENEMY_SHIP ||
+                   desc->crowdDesc.crowdType == NEURAL_CROWD_BASE_FRIEND_SHIP;
+        case NEURAL_VALUE_FORCE:
+            /*
+             * Even with useBase, the range is measured from the mob.
+             */
+        case NEURAL_VALUE_MOBID:
+        case NEURAL_VALUE_SQUAD:
+        case NEURAL_VALUE_RANDOM_UNIT:
+            return FALSE;
+        default:
+            PANIC("Unknown NeuralValue type=%d\n", desc->valueType);
+    }
+}
+
+
 void NeuralLocus_RunTick(AIContext *aic, NeuralLocusDesc *desc,
                          NeuralLocusPosition *lpos)
 {
@@ -21,6 +21,7 @@
 
 #include "geometry.h"
 #include "MBRegistry.h"
+#include "genome.h"
 #include "aiTypes.hpp"
 
 #define NN_USE_CONDITIONS FALSE
@@ -369,22 +370,24 @@ void NeuralOutput_Load(MBRegistry *mreg,
 void NeuralInput_Load(MBRegistry *mreg,
                       NeuralInputDesc *desc, const char *prefix);
 
-void NeuralValue_Mutate(MBRegistry *mreg, float rate, bool isOutput,
+void NeuralValue_Mutate(Genome *g, float rate, bool isOutput,
                         NeuralNetType nnType,
                         const char *prefix);
-void NeuralForce_Mutate(MBRegistry *mreg, float rate, const char *prefix);
-void NeuralLocus_Mutate(MBRegistry *mreg, float rate, const char *prefix);
-void NeuralSquad_Mutate(MBRegistry *mreg, float rate, const char *prefix);
-void NeuralCondition_Mutate(MBRegistry *mreg, float rate, NeuralNetType nnType,
+void NeuralForce_Mutate(Genome *g, float rate, const char *prefix);
+void NeuralLocus_Mutate(Genome *g, float rate, const char *prefix);
+void NeuralSquad_Mutate(Genome *g, float rate, const char *prefix);
+void NeuralCondition_Mutate(Genome *g, float rate, NeuralNetType nnType,
                             const char *prefix);
-void NeuralOutput_Mutate(MBRegistry *mreg, float rate, NeuralNetType nnType, const char *prefix);
-void NeuralInput_Mutate(MBRegistry *mreg, float rate, NeuralNetType nnType, const char *prefix);
+void NeuralOutput_Mutate(Genome *g, float rate, NeuralNetType nnType, const char *prefix);
+void NeuralInput_Mutate(Genome *g, float rate, NeuralNetType nnType, const char *prefix);
 
 float NeuralValue_GetValue(AIContext *nc, Mob *mob,
                            NeuralValueDesc *desc, uint i);
 float NeuralCrowd_GetValue(AIContext *nc, Mob *mob, NeuralCrowdDesc *desc);
 float NeuralSquad_GetValue(AIContext *nc, Mob *mob, NeuralSquadDesc *desc);
 float NeuralTick_GetValue(AIContext *nc, NeuralTickDesc *desc);
+bool NeuralValue_IsMobInvariant(NeuralValueDesc *desc);
+void NeuralValue_UseNeighborRadius(AIContext *nc, NeuralValueDesc *desc);
 
 bool NeuralCondition_AppliesToMob(AIContext *nc, Mob *m, NeuralConditionDesc *condDesc);
 
@@ -397,6 +400,7 @@ float NeuralForce_FocusToValue(AIContext *nc, Mob *mob,
                                FPoint *focusPoint, bool haveFocus);
 bool NeuralForce_GetFocus(AIContext *nc, Mob *mob,
                           NeuralForceDesc *desc, FPoint *focusPoint);
+bool NeuralForce_IsFocusMobInvariant(NeuralForceDesc *desc);
 bool NeuralForce_GetForce(AIContext *nc, Mob *mob,
                           NeuralForceDesc *desc, FRPoint *rForce);
 float NeuralForce_GetRange(AIContext *nc, Mob *mob, NeuralForceDesc *desc);
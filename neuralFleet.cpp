@@ -167,7 +167,7 @@ static void NeuralFleetDestroy(void *aiHandle);
 static void NeuralFleetRunAITick(void *aiHandle);
 static void *NeuralFleetMobSpawned(void *aiHandle, Mob *m);
 static void NeuralFleetMobDestroyed(void *aiHandle, Mob *m, void *aiMobHandle);
-static void NeuralFleetMutate(FleetAIType aiType, MBRegistry *mreg);
+static void NeuralFleetMutate(FleetAIType aiType, Genome *g);
 static void NeuralFleetDumpSanitizedParams(void *aiHandle, MBRegistry *mreg);
 
 void NeuralFleet_GetOps(FleetAIType aiType, FleetAIOps *ops)
@@ -214,7 +214,7 @@ void NeuralFleet_GetOps(FleetAIType aiType, FleetAIOps *ops)
     ops->runAITick = &NeuralFleetRunAITick;
     ops->mobSpawned = &NeuralFleetMobSpawned;
     ops->mobDestroyed = &NeuralFleetMobDestroyed;
-    ops->mutateParams = &NeuralFleetMutate;
+    ops->mutateGenome = &NeuralFleetMutate;
     ops->dumpSanitizedParams = &NeuralFleetDumpSanitizedParams;
 }
 
@@ -225,7 +225,7 @@ static void NeuralFleetDumpSanitizedParams(void *aiHandle, MBRegistry *mreg)
     sf->gov.dumpSanitizedParams(mreg);
 }
 
-static void NeuralFleetMutate(FleetAIType aiType, MBRegistry *mreg)
+static void NeuralFleetMutate(FleetAIType aiType, Genome *g)
 {
     MutationFloatParams vf[] = {
         // key                     min     max       mag   jump   mutation
@@ -253,7 +253,7 @@ static void NeuralFleetMutate(FleetAIType aiType, MBRegistry *mreg)
         { "gatherAbandonStale",          0.02f },
     };
 
-    MBRegistry_PutCopy(mreg, NEURAL_SCRAMBLE_KEY, "FALSE");
+    Genome_PutCStr(g, NEURAL_SCRAMBLE_KEY, "FALSE");
 
     // NeuralFleets have ~1000 entries, so 0.001 is roughly 1 entry mutated.
     // This distributes the mutation range from 1~100 entries per generation,
@@ -261,7 +261,7 @@ static void NeuralFleetMutate(FleetAIType aiType, MBRegistry *mreg)
     float rate = Random_Int(1, 100) * 0.001;
 
     if (Random_Flip(0.001)) {
-        MBRegistry_PutCopy(mreg, NEURAL_SCRAMBLE_KEY, "TRUE");
+        Genome_PutCStr(g, NEURAL_SCRAMBLE_KEY, "TRUE");
 
         for (uint i = 0; i < ARRAYSIZE(vf); i++) {
             vf[i].mutationRate = 1.0f;
@@ -273,15 +273,15 @@ static void NeuralFleetMutate(FleetAIType aiType, MBRegistry *mreg)
         rate = 1.0f;
     }
 
-    NeuralNet_Mutate(mreg, "shipNet.", rate,
+    NeuralNet_Mutate(g, "shipNet.", rate,
                      NN_TYPE_FORCES,
                      NEURAL_MAX_INPUTS, NEURAL_MAX_OUTPUTS,
                      NEURAL_MAX_NODES, NEURAL_MAX_NODE_DEGREE);
 
-    Mutate_Float(mreg, vf, ARRAYSIZE(vf));
-    Mutate_Bool(mreg, vb, ARRAYSIZE(vb));
+    Mutate_GenomeFloat(g, vf, ARRAYSIZE(vf));
+    Mutate_GenomeBool(g, vb, ARRAYSIZE(vb));
 
-    MBRegistry_Remove(mreg, NEURAL_SCRAMBLE_KEY);
+    Genome_Remove(g, NEURAL_SCRAMBLE_KEY);
 }
 
 static void *NeuralFleetCreate(FleetAI *ai)
@@ -21,21 +21,214 @@ extern "C" {
 #include "MBRegistry.h"
 }
 
+#include <string.h>
+#include <SDL2/SDL_atomic.h>
+
 #include "mutate.h"
 
 #include "neuralNet.hpp"
 #include "textDump.hpp"
 
+/*
+ * Process-wide cache of loaded and minimized nets, keyed by the registry
+ * entries under the net's prefix.
+ *
+ * The same control fleets get loaded for every battle in a measure or
+ * optimize run, so this lets each battle copy the already parsed net
+ * instead of going back through the registry strings.  The cached nets
+ * are never changed or evaluated, so they're safe to share across the
+ * engine threads.  The lock only covers finding an entry and taking a
+ * reference to it; the copy itself happens outside the lock, and the
+ * reference keeps the net alive if it's evicted in the meantime.
+ *
+ * Entries are found by a hash of the registry text, but a hit also has
+ * to match the full text, so a hash collision can't hand a battle some
+ * other fleet's net.
+ *
+ * Only the nets are cached.  The fleet registry copies in
+ * Fleet_CreateAI and the FleetConfig_PushDefaults pass are still done
+ * for every battle; they're plain string copies, while the nets are
+ * the part that goes through textDump parsing and minimizing.
+ */
+#define NEURAL_NET_CACHE_SIZE 256
+
+typedef struct NeuralNetCacheSpec {
+    SDL_atomic_t refCount;
+    MBString text;
+    NeuralNet nn;
+} NeuralNetCacheSpec;
+
+typedef struct NeuralNetCacheEntry {
+    uint64 hash;
+    NeuralNetType nnType;
+    NeuralNetCacheSpec *spec;
+} NeuralNetCacheEntry;
+
+static SDL_SpinLock gNeuralNetCacheLock;
+static NeuralNetCacheEntry gNeuralNetCache[NEURAL_NET_CACHE_SIZE];
+static uint gNeuralNetCacheNext;
+
+static uint64 NeuralNetHashString(uint64 hash, const char *str)
+{
+    const uint64 fnvPrime = 0x100000001b3ULL;
+
+    while (*str != '\0') {
+        hash ^= (uint8)*str;
+        hash *= fnvPrime;
+        str++;
+    }
+
+    return hash;
+}
+
+/*
+ * NeuralNetRegistryText --
+ *    Build the cache key text for the registry entries under prefix,
+ *    one "key\nvalue\n" pair per entry.  Registry keys and values
+ *    never contain newlines, so the text is unambiguous.
+ */
+static void NeuralNetRegistryText(MBRegistry *mreg, const char *prefix,
+                                  MBString *text)
+{
+    uint prefixLen = strlen(prefix);
+    uint size = MBRegistry_NumEntries(mreg);
+
+    *text = prefix;
+    *text += "\n";
+
+    for (uint i = 0; i < size; i++) {
+        const char *key = MBRegistry_GetKeyAt(mreg, i);
+
+        if (strncmp(key, prefix, prefixLen) == 0) {
+            *text += key;
+            *text += "\n";
+            *text += MBRegistry_GetValueAt(mreg, i);
+            *text += "\n";
+        }
+    }
+}
+
+static NeuralNetCacheEntry *NeuralNetCacheFind(uint64 hash,
+                                               MBString *text,
+                                               NeuralNetType nnType)
+{
+    for (uint i = 0; i < ARRAYSIZE(gNeuralNetCache); i++) {
+        NeuralNetCacheEntry *e = &gNeuralNetCache[i];
+        if (e->spec != NULL && e->hash == hash && e->nnType == nnType &&
+            strcmp(e->spec->text.CStr(), text->CStr()) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void NeuralNetCacheRelease(NeuralNetCacheSpec *spec)
+{
+    if (spec != NULL && SDL_AtomicDecRef(&spec->refCount)) {
+        delete spec;
+    }
+}
+
+void NeuralNet::copySpec(const NeuralNet &nn)
+{
+    nnType = nn.nnType;
+    floatNet = nn.floatNet;
+    inputDescs = nn.inputDescs;
+    outputDescs = nn.outputDescs;
+    inputFocus = nn.inputFocus;
+    outputFocus = nn.outputFocus;
+
+    inputs.resize(inputDescs.size());
+    outputs.resize(outputDescs.size());
+    liveOutputs.resize(outputDescs.size());
+    invariantValid = FALSE;
+}
+
 void NeuralNet::load(MBRegistry *mreg, const char *prefix,
                      NeuralNetType nnTypeIn)
 {
-    MBString str;
-    const char *cstr;
+    NeuralNetCacheEntry *e;
+    NeuralNetCacheSpec *spec = NULL;
+    NeuralNetCacheSpec *evicted;
+    MBString text;
+    uint64 hash;
 
     ASSERT(mreg != NULL);
     ASSERT(prefix != NULL);
 
     ASSERT(nnTypeIn == NN_TYPE_FORCES || nnTypeIn == NN_TYPE_SCALARS);
+
+    NeuralNetRegistryText(mreg, prefix, &text);
+    hash = NeuralNetHashString(0xcbf29ce484222325ULL, text.CStr());
+
+    SDL_AtomicLock(&gNeuralNetCacheLock);
+    e = NeuralNetCacheFind(hash, &text, nnTypeIn);
+    if (e != NULL) {
+        spec = e->spec;
+        SDL_AtomicIncRef(&spec->refCount);
+    }
+    SDL_AtomicUnlock(&gNeuralNetCacheLock);
+
+    if (spec != NULL) {
+        copySpec(spec->nn);
+        NeuralNetCacheRelease(spec);
+        useNeighborRadii();
+        return;
+    }
+
+    loadWork(mreg, prefix, nnTypeIn);
+
+    spec = new NeuralNetCacheSpec();
+    SDL_AtomicSet(&spec->refCount, 1);
+    spec->text = text.CStr();
+    spec->nn.copySpec(*this);
+
+    SDL_AtomicLock(&gNeuralNetCacheLock);
+    if (NeuralNetCacheFind(hash, &text, nnTypeIn) != NULL) {
+        // Another thread beat us to it.
+        evicted = spec;
+    } else {
+        e = &gNeuralNetCache[gNeuralNetCacheNext];
+        gNeuralNetCacheNext++;
+        gNeuralNetCacheNext %= ARRAYSIZE(gNeuralNetCache);
+
+        evicted = e->spec;
+        e->hash = hash;
+        e->nnType = nnTypeIn;
+        e->spec = spec;
+    }
+    SDL_AtomicUnlock(&gNeuralNetCacheLock);
+
+    NeuralNetCacheRelease(evicted);
+    useNeighborRadii();
+}
+
+
+/*
+ * useNeighborRadii --
+ *    Size the SensorGrid neighborhood cache for this net's flocking
+ *    forces, so each mob gathers its neighbors once per tick.
+ */
+void NeuralNet::useNeighborRadii()
+{
+    if (aic.sg == NULL) {
+        return;
+    }
+
+    for (uint i = 0; i < inputDescs.size(); i++) {
+        NeuralValue_UseNeighborRadius(&aic, &inputDescs[i].value);
+    }
+    for (uint i = 0; i < outputDescs.size(); i++) {
+        NeuralValue_UseNeighborRadius(&aic, &outputDescs[i].value);
+    }
+}
+
+void NeuralNet::loadWork(MBRegistry *mreg, const char *prefix,
+                         NeuralNetType nnTypeIn)
+{
+    MBString str;
+    const char *cstr;
+
     nnType = nnTypeIn;
 
     str = prefix;
@@ -56,6 +249,9 @@ void NeuralNet::load(MBRegistry *mreg, const char *prefix,
 
     inputs.resize(numInputs);
     outputs.resize(numOutputs);
+    liveOutputs.resize(numOutputs);
+    inputFocus.resize(numInputs);
+    outputFocus.resize(numOutputs);
 
     inputDescs.resize(numInputs);
     outputDescs.resize(numOutputs);
@@ -121,6 +317,35 @@ void NeuralNet::minimize()
             voidInputNode(i);
         }
     }
+
+    /*
+     * Re-use the same bitvector to mark the inputs that are the same
+     * for every mob, so the FloatNet can split off that subgraph.
+     */
+    for (uint i = 0; i < inputDescs.size(); i++) {
+        inputBV.put(i, NeuralValue_IsMobInvariant(&inputDescs[i].value));
+    }
+    floatNet.markInvariantNodes(inputBV);
+    invariantValid = FALSE;
+
+    ASSERT(inputFocus.size() == inputDescs.size());
+    ASSERT(outputFocus.size() == outputDescs.size());
+    for (uint i = 0; i < inputDescs.size(); i++) {
+        classifyFocus(&inputDescs[i].value, &inputFocus[i]);
+    }
+    for (uint i = 0; i < outputDescs.size(); i++) {
+        classifyFocus(&outputDescs[i].value, &outputFocus[i]);
+    }
+}
+
+
+void NeuralNet::classifyFocus(NeuralValueDesc *desc, NeuralFocusCache *fc)
+{
+    MBUtil_Zero(fc, sizeof(*fc));
+
+    if (desc->valueType == NEURAL_VALUE_FORCE) {
+        fc->invariant = NeuralForce_IsFocusMobInvariant(&desc->forceDesc);
+    }
 }
 
 void NeuralNet::minimizeScalars(NeuralNet &nnConsumer)
@@ -185,7 +410,7 @@ void NeuralNet::dumpSanitizedParams(MBRegistry *mreg, const char *prefix)
 }
 
 
-void NeuralNet_Mutate(MBRegistry *mreg, const char *prefix, float rate,
+void NeuralNet_Mutate(Genome *g, const char *prefix, float rate,
                       NeuralNetType nnType,
                       uint maxInputs, uint maxOutputs, uint maxNodes,
                       uint maxNodeDegree)
@@ -197,12 +422,12 @@ void NeuralNet_Mutate(MBRegistry *mreg, const char *prefix, float rate,
     str = prefix;
     str += "fn.numInputs";
     cstr = str.CStr();
-    if (MBRegistry_ContainsKey(mreg, cstr) &&
-        MBRegistry_GetUint(mreg, cstr) > 0 &&
+    if (Genome_ContainsKey(g, cstr) &&
+        Genome_GetUint(g, cstr) > 0 &&
         rate < 1.0f) {
         str = prefix;
         str += "fn.";
-        fn.load(mreg, str.CStr());
+        fn.load(g, str.CStr());
     } else {
         fn.initialize(maxInputs, maxOutputs, maxNodes);
         fn.loadZeroNet();
@@ -212,14 +437,14 @@ void NeuralNet_Mutate(MBRegistry *mreg, const char *prefix, float rate,
 
     str = prefix;
     str += "fn.";
-    MBRegistry_RemoveAllWithPrefix(mreg, str.CStr());
-    fn.save(mreg, str.CStr());
+    Genome_RemoveAllWithPrefix(g, str.CStr());
+    fn.save(g, str.CStr());
 
     for (uint i = 0; i < fn.getNumInputs(); i++) {
         char *str = NULL;
         int ret = asprintf(&str, "%sinput[%d].", prefix, i);
         VERIFY(ret > 0);
-        NeuralInput_Mutate(mreg, rate, nnType, str);
+        NeuralInput_Mutate(g, rate, nnType, str);
         free(str);
     }
 
@@ -227,7 +452,7 @@ void NeuralNet_Mutate(MBRegistry *mreg, const char *prefix, float rate,
         char *str = NULL;
         int ret = asprintf(&str, "%soutput[%d].", prefix, i);
         VERIFY(ret > 0);
-        NeuralOutput_Mutate(mreg, rate, nnType, str);
+        NeuralOutput_Mutate(g, rate, nnType, str);
         free(str);
     }
 }
@@ -249,9 +474,14 @@ void NeuralNet::fillInputs(Mob *mob)
 
 void NeuralNet::compute()
 {
-    float maxV = (1.0f / MICRON);
-
     floatNet.compute(inputs, outputs);
+    clampOutputs();
+}
+
+
+void NeuralNet::clampOutputs()
+{
+    float maxV = (1.0f / MICRON);
 
     ASSERT(outputs.size() == outputDescs.size());
     for (uint i = 0; i < outputs.size(); i++) {
@@ -268,6 +498,30 @@ void NeuralNet::compute()
 }
 
 
+/*
+ * computeInvariant --
+ *    Evaluate the mob-invariant inputs and nodes, if they haven't
+ *    already been evaluated this tick.
+ */
+void NeuralNet::computeInvariant(Mob *mob)
+{
+    if (invariantValid && invariantTick == aic.ai->tick) {
+        return;
+    }
+
+    ASSERT(inputs.size() == inputDescs.size());
+    for (uint i = 0; i < inputDescs.size(); i++) {
+        if (floatNet.isInputInvariant(i)) {
+            inputs[i] = getInputValue(mob, i);
+        }
+    }
+
+    floatNet.computeInvariant(inputs);
+    invariantTick = aic.ai->tick;
+    invariantValid = TRUE;
+}
+
+
 void NeuralNet::doScalars()
 {
     ASSERT(nnType == NN_TYPE_SCALARS);
@@ -291,25 +545,66 @@ void NeuralNet::doScalars()
 
 void NeuralNet::doForces(Mob *mob, FRPoint *outputForce)
 {
-    ASSERT(nnType == NN_TYPE_FORCES);
+    uint numLive = 0;
 
-    fillInputs(mob);
-    compute();
+    ASSERT(nnType == NN_TYPE_FORCES);
+    ASSERT(mob != NULL);
 
     FRPoint_Zero(outputForce);
+
+    /*
+     * Only the outputs whose condition applies to this mob can affect
+     * the result, so evaluate just the parts of the net (and the inputs)
+     * that feed them.
+     *
+     * Dead inputs are never read, so any that draw from the fleet
+     * RandomState no longer do; the forces themselves are still only
+     * computed for outputs that come out non-zero, in the same order.
+     */
     ASSERT(outputs.size() == outputDescs.size());
+    ASSERT(liveOutputs.size() == outputDescs.size());
     for (uint i = 0; i < outputDescs.size(); i++) {
-        FRPoint force;
+        liveOutputs.reset(i);
+
         if (outputDescs[i].value.valueType == NEURAL_VALUE_FORCE) {
             ASSERT(outputDescs[i].value.forceDesc.forceType != NEURAL_FORCE_ZERO);
-            if (outputs[i] != 0.0f &&
-                outputConditionApplies(mob, i) &&
-                getOutputForce(mob, i, &force)) {
-                NeuralCombiner_ApplyOutput(outputDescs[i].cType, outputs[i], &force);
-                FRPoint_Add(&force, outputForce, outputForce);
+            if (isOutputActive(&outputDescs[i]) &&
+                outputConditionApplies(mob, i)) {
+                liveOutputs.set(i);
+                numLive++;
             }
         } else {
             ASSERT(outputDescs[i].value.valueType == NEURAL_VALUE_VOID);
         }
     }
+
+    if (numLive == 0) {
+        return;
+    }
+
+    computeInvariant(mob);
+    floatNet.markLiveNodes(liveOutputs);
+
+    ASSERT(inputs.size() == inputDescs.size());
+    for (uint i = 0; i < inputDescs.size(); i++) {
+        if (floatNet.isInputInvariant(i)) {
+            continue;
+        } else if (floatNet.isInputLive(i)) {
+            inputs[i] = getInputValue(mob, i);
+        } else {
+            inputs[i] = 0.0f;
+        }
+    }
+
+    floatNet.computeLive(inputs, outputs);
+    clampOutputs();
+
+    for (uint i = 0; i < outputDescs.size(); i++) {
+        FRPoint force;
+        if (liveOutputs.get(i) && outputs[i] != 0.0f &&
+            getOutputForce(mob, i, &force)) {
+            NeuralCombiner_ApplyOutput(outputDescs[i].cType, outputs[i], &force);
+            FRPoint_Add(&force, outputForce, outputForce);
+        }
+    }
 }
@@ -27,6 +27,17 @@
 #include "neural.hpp"
 #include "MBString.hpp"
 
+/*
+ * Per-tick cache of a focus point that's shared by every mob.
+ */
+typedef struct NeuralFocusCache {
+    bool invariant;
+    bool valid;
+    uint tick;
+    bool haveFocus;
+    FPoint focus;
+} NeuralFocusCache;
+
 class NeuralNet {
 public:
     // Members
@@ -40,7 +51,9 @@ public:
     MBVector<float> scalarInputs;
     MBVector<NeuralLocusPosition> loci;
 
-    NeuralNet() {
+    NeuralNet()
+    :invariantValid(FALSE), invariantTick(0)
+    {
         MBUtil_Zero(&aic, sizeof(aic));
     }
 
@@ -61,6 +74,7 @@ public:
     void doForces(Mob *mob, FRPoint *outputForce);
 
     void pullScalars(const NeuralNet &nn) {
+        invariantValid = FALSE;
         scalarInputs.resize(nn.outputs.size());
 
         for (uint i = 0; i < scalarInputs.size(); i++) {
@@ -103,7 +117,39 @@ public:
     }
 
 private:
+    // Scratch space for demand-driven doForces.
+    CPBitVector liveOutputs;
+
+    // Mob-invariant part of the net, computed once per tick.
+    bool invariantValid;
+    uint invariantTick;
+    MBVector<NeuralFocusCache> inputFocus;
+    MBVector<NeuralFocusCache> outputFocus;
+
     // Helpers
+    void loadWork(MBRegistry *mreg, const char *prefix, NeuralNetType nnType);
+    void useNeighborRadii();
+    void copySpec(const NeuralNet &nn);
+    void clampOutputs();
+    void computeInvariant(Mob *mob);
+    void classifyFocus(NeuralValueDesc *desc, NeuralFocusCache *fc);
+
+    bool getCachedFocus(Mob *mob, NeuralForceDesc *desc,
+                        NeuralFocusCache *fc, FPoint *focusPoint) {
+        if (!fc->invariant) {
+            return getFocus(mob, desc, focusPoint);
+        }
+
+        if (!fc->valid || fc->tick != aic.ai->tick) {
+            fc->haveFocus = getFocus(mob, desc, &fc->focus);
+            fc->tick = aic.ai->tick;
+            fc->valid = TRUE;
+        }
+
+        *focusPoint = fc->focus;
+        return fc->haveFocus;
+    }
+
     bool getFocus(Mob *mob, NeuralForceDesc *desc, FPoint *focusPoint) {
         ASSERT(desc != NULL);
         ASSERT(mob != NULL);
@@ -150,6 +196,18 @@ private:
             bool haveFocus = getFocus(mob, &desc->value.forceDesc, &focus);
             return NeuralForce_FocusToValue(&aic, mob, &desc->value.forceDesc,
                                             &focus, haveFocus);
+        } else if (desc->value.valueType == NEURAL_VALUE_FORCE &&
+                   inputFocus[index].invariant) {
+            FPoint focus;
+            bool haveFocus = getCachedFocus(mob, &desc->value.forceDesc,
+                                            &inputFocus[index], &focus);
+            if (desc->value.forceDesc.filterForceValue) {
+                return NeuralForce_FocusToValue(&aic, mob,
+                                                &desc->value.forceDesc,
+                                                &focus, haveFocus);
+            } else {
+                return NeuralForce_FocusToRange(mob, &focus, haveFocus);
+            }
         } else if (desc->value.valueType == NEURAL_VALUE_SCALAR) {
             if (desc->value.scalarDesc.scalarID < 0 ||
                 desc->value.scalarDesc.scalarID >= scalarInputs.size()) {
@@ -169,7 +227,8 @@ private:
         ASSERT(desc->valueType == NEURAL_VALUE_FORCE);
         ASSERT(desc->forceDesc.forceType != NEURAL_FORCE_ZERO);
 
-        haveForce = getFocus(mob, &desc->forceDesc, &focus);
+        haveForce = getCachedFocus(mob, &desc->forceDesc,
+                                   &outputFocus[index], &focus);
         return NeuralForce_FocusToForce(&aic, mob, &desc->forceDesc,
                                         &focus, haveForce, rForce);
     }
@@ -188,7 +247,7 @@ private:
     }
 };
 
-void NeuralNet_Mutate(MBRegistry *mreg, const char *prefix, float rate,
+void NeuralNet_Mutate(Genome *g, const char *prefix, float rate,
                       NeuralNetType nnType,
                       uint maxInputs, uint maxOutputs, uint maxNodes,
                       uint maxNodeDegree);
@@ -0,0 +1,739 @@
+/*
+ * population.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "population.h"
+#include "MBUtil.h"
+
+static const char *popStatKeys[POP_STAT_MAX] = {
+    [POP_STAT_NUM_BATTLES] = "abattle.numBattles",
+    [POP_STAT_NUM_WINS]    = "abattle.numWins",
+    [POP_STAT_NUM_LOSSES]  = "abattle.numLosses",
+    [POP_STAT_NUM_DRAWS]   = "abattle.numDraws",
+    [POP_STAT_NUM_SPAWN]   = "abattle.numSpawn",
+    [POP_STAT_AGE]         = "abattle.age",
+};
+
+static int PopulationStatFromKey(const char *key)
+{
+    if (strncmp(key, "abattle.", 8) != 0) {
+        return -1;
+    }
+
+    for (uint s = 0; s < POP_STAT_MAX; s++) {
+        if (strcmp(key, popStatKeys[s]) == 0) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+/*
+ * PopulationParseStat --
+ *    Parse a counter, but only if it's in the same form that we'd
+ *    print it in, so it round-trips exactly.
+ */
+static bool PopulationParseStat(const char *value, uint32 *out)
+{
+    unsigned long x;
+    char *end;
+
+    if (!isdigit(value[0]) || (value[0] == '0' && value[1] != '\0')) {
+        return FALSE;
+    }
+
+    errno = 0;
+    x = strtoul(value, &end, 10);
+    if (*end != '\0' || errno != 0 || x > MAX_UINT) {
+        return FALSE;
+    }
+
+    *out = x;
+    return TRUE;
+}
+
+static uint64 PopulationHashBytes(uint64 hash, const char *s, uint len)
+{
+    for (uint i = 0; i < len; i++) {
+        hash ^= (uint8)s[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64 Population_HashFleet(MBRegistry *fleetReg)
+{
+    uint size = MBRegistry_NumEntries(fleetReg);
+    uint64 hash = 0;
+
+    /*
+     * Sum the per-key hashes, so the result doesn't depend on the
+     * order of the keys in the registry.
+     */
+    for (uint i = 0; i < size; i++) {
+        const char *key = MBRegistry_GetKeyAt(fleetReg, i);
+        const char *value = MBRegistry_GetValueAt(fleetReg, i);
+        uint64 h = 0xcbf29ce484222325ULL;
+
+        if (PopulationStatFromKey(key) >= 0) {
+            continue;
+        }
+
+        h = PopulationHashBytes(h, key, strlen(key) + 1);
+        h = PopulationHashBytes(h, value, strlen(value) + 1);
+        hash += h;
+    }
+
+    return hash;
+}
+
+bool Population_IsBinaryName(const char *file)
+{
+    const char *ext = ".bpop";
+    uint len = strlen(file);
+    uint extLen = strlen(ext);
+
+    return len >= extLen && strcmp(&file[len - extLen], ext) == 0;
+}
+
+bool Population_IsBinaryFile(const char *file)
+{
+    char magic[sizeof(POPULATION_MAGIC) - 1];
+    FILE *f = fopen(file, "rb");
+    bool binary = FALSE;
+
+    if (f == NULL) {
+        return FALSE;
+    }
+
+    if (fread(magic, sizeof(magic), 1, f) == 1 &&
+        memcmp(magic, POPULATION_MAGIC, sizeof(magic)) == 0) {
+        binary = TRUE;
+    }
+
+    fclose(f);
+    return binary;
+}
+
+/*
+ * PopulationOpenWork --
+ *    Map a binary population file.  Returns what's wrong with the file
+ *    if it can't be used, leaving nothing open.
+ */
+static const char *PopulationOpenWork(Population *pop, const char *file,
+                                      bool writable)
+{
+    struct stat st;
+    PopulationHeader *hdr;
+    const char *err = NULL;
+
+    MBUtil_Zero(pop, sizeof(*pop));
+    pop->writable = writable;
+
+    pop->fd = open(file, writable ? O_RDWR : O_RDONLY);
+    if (pop->fd < 0) {
+        return "Unable to open population file";
+    }
+
+    VERIFY(fstat(pop->fd, &st) == 0);
+    pop->size = st.st_size;
+    if (pop->size < sizeof(PopulationHeader)) {
+        close(pop->fd);
+        return "Truncated population file";
+    }
+
+    pop->base = mmap(NULL, pop->size,
+                     PROT_READ | (writable ? PROT_WRITE : 0),
+                     MAP_SHARED, pop->fd, 0);
+    if (pop->base == MAP_FAILED) {
+        close(pop->fd);
+        return "Unable to map population file";
+    }
+
+    hdr = (PopulationHeader *)pop->base;
+    pop->hdr = hdr;
+
+    if (memcmp(hdr->magic, POPULATION_MAGIC, sizeof(hdr->magic)) != 0) {
+        err = "Not a binary population file";
+    } else if (hdr->version != POPULATION_VERSION) {
+        err = "Unsupported population file version";
+    } else if (hdr->fileSize != pop->size ||
+               hdr->tableOffset % 8 != 0 ||
+               hdr->tableOffset > pop->size ||
+               (pop->size - hdr->tableOffset) /
+               sizeof(PopulationFleetEntry) < hdr->numFleets ||
+               hdr->globalOffset > pop->size ||
+               pop->size - hdr->globalOffset < hdr->globalSize) {
+        err = "Corrupt population file";
+    } else {
+        pop->table = (PopulationFleetEntry *)(pop->base + hdr->tableOffset);
+
+        for (uint i = 0; i < hdr->numFleets; i++) {
+            PopulationFleetEntry *e = &pop->table[i];
+            if (e->offset > pop->size || pop->size - e->offset < e->size) {
+                err = "Corrupt population file";
+                break;
+            }
+        }
+    }
+
+    if (err != NULL) {
+        munmap(pop->base, pop->size);
+        close(pop->fd);
+        MBUtil_Zero(pop, sizeof(*pop));
+    }
+    return err;
+}
+
+void Population_Open(Population *pop, const char *file, bool writable)
+{
+    const char *err = PopulationOpenWork(pop, file, writable);
+
+    if (err != NULL) {
+        PANIC("%s: %s\n", err, file);
+    }
+}
+
+void Population_Close(Population *pop)
+{
+    if (pop->writable) {
+        msync(pop->base, pop->size, MS_SYNC);
+    }
+    munmap(pop->base, pop->size);
+    close(pop->fd);
+    MBUtil_Zero(pop, sizeof(*pop));
+}
+
+/*
+ * PopulationLoadRecord --
+ *    Add the keys from a record to mreg, with an optional prefix.
+ */
+static void PopulationLoadRecord(Population *pop,
+                                 uint64 offset, uint32 size,
+                                 uint32 numEntries,
+                                 MBRegistry *mreg, const char *prefix)
+{
+    const char *p = (const char *)pop->base + offset;
+    const char *end = p + size;
+    char *key = NULL;
+
+    for (uint i = 0; i < numEntries; i++) {
+        const char *k = p;
+        const char *v;
+        uint len;
+
+        len = strnlen(p, end - p);
+        VERIFY(p + len < end);
+        p += len + 1;
+
+        v = p;
+        len = strnlen(p, end - p);
+        VERIFY(p + len < end);
+        p += len + 1;
+
+        if (prefix == NULL) {
+            MBRegistry_PutCopy(mreg, k, v);
+        } else {
+            int ret = asprintf(&key, "%s%s", prefix, k);
+            VERIFY(ret > 0);
+            MBRegistry_PutCopy(mreg, key, v);
+            free(key);
+            key = NULL;
+        }
+    }
+}
+
+/*
+ * PopulationCheckRecord --
+ *    Check that a record holds numEntries key/value pairs.
+ */
+static bool PopulationCheckRecord(Population *pop,
+                                  uint64 offset, uint32 size,
+                                  uint32 numEntries)
+{
+    const char *p = (const char *)pop->base + offset;
+    const char *end = p + size;
+
+    for (uint i = 0; i < 2 * numEntries; i++) {
+        uint len = strnlen(p, end - p);
+        if (p + len >= end) {
+            return FALSE;
+        }
+        p += len + 1;
+    }
+
+    return TRUE;
+}
+
+const char *Population_Check(const char *file)
+{
+    Population pop;
+    const char *err = PopulationOpenWork(&pop, file, FALSE);
+
+    if (err != NULL) {
+        return err;
+    }
+
+    if (!PopulationCheckRecord(&pop, pop.hdr->globalOffset,
+                               pop.hdr->globalSize, pop.hdr->numGlobals)) {
+        err = "Corrupt population file";
+    }
+    for (uint i = 0; err == NULL && i < pop.hdr->numFleets; i++) {
+        PopulationFleetEntry *e = &pop.table[i];
+        if (!PopulationCheckRecord(&pop, e->offset, e->size,
+                                   e->numEntries)) {
+            err = "Corrupt population file";
+        }
+    }
+
+    Population_Close(&pop);
+    return err;
+}
+
+static void PopulationLoadFleetWork(Population *pop, uint i,
+                                    MBRegistry *mreg, const char *prefix)
+{
+    PopulationFleetEntry *e;
+    char *key = NULL;
+    char value[16];
+    int ret;
+
+    VERIFY(i >= 1 && i <= Population_NumFleets(pop));
+    e = &pop->table[i - 1];
+
+    PopulationLoadRecord(pop, e->offset, e->size, e->numEntries,
+                         mreg, prefix);
+
+    for (uint s = 0; s < POP_STAT_MAX; s++) {
+        if ((e->statMask & (1 << s)) == 0) {
+            continue;
+        }
+
+        ret = snprintf(value, sizeof(value), "%u", e->stats[s]);
+        VERIFY(ret > 0 && ret < sizeof(value));
+
+        if (prefix == NULL) {
+            MBRegistry_PutCopy(mreg, popStatKeys[s], value);
+        } else {
+            ret = asprintf(&key, "%s%s", prefix, popStatKeys[s]);
+            VERIFY(ret > 0);
+            MBRegistry_PutCopy(mreg, key, value);
+            free(key);
+            key = NULL;
+        }
+    }
+}
+
+void Population_LoadFleet(Population *pop, uint i, MBRegistry *fleetReg)
+{
+    PopulationLoadFleetWork(pop, i, fleetReg, NULL);
+}
+
+bool Population_UpdateStats(Population *pop, uint i, MBRegistry *fleetReg)
+{
+    PopulationFleetEntry *e;
+    uint32 stats[POP_STAT_MAX];
+    uint32 statMask = 0;
+
+    VERIFY(pop->writable);
+    VERIFY(i >= 1 && i <= Population_NumFleets(pop));
+    e = &pop->table[i - 1];
+
+    if ((e->flags & POP_FLEET_FLAG_STATS_IN_RECORD) != 0 ||
+        e->hash != Population_HashFleet(fleetReg)) {
+        return FALSE;
+    }
+
+    MBUtil_Zero(stats, sizeof(stats));
+    for (uint s = 0; s < POP_STAT_MAX; s++) {
+        const char *value = MBRegistry_GetCStr(fleetReg, popStatKeys[s]);
+        if (value != NULL) {
+            if (!PopulationParseStat(value, &stats[s])) {
+                return FALSE;
+            }
+            statMask |= 1 << s;
+        }
+    }
+
+    e->statMask = statMask;
+    memcpy(e->stats, stats, sizeof(e->stats));
+    return TRUE;
+}
+
+static void PopulationWrite(PopulationWriter *w, const void *data, uint size)
+{
+    if (size > 0 && fwrite(data, size, 1, w->f) != 1) {
+        PANIC("Unable to write population file: %s\n", w->tmpFile);
+    }
+    w->offset += size;
+}
+
+static void PopulationWriteString(PopulationWriter *w, const char *s)
+{
+    PopulationWrite(w, s, strlen(s) + 1);
+}
+
+void PopulationWriter_Open(PopulationWriter *w, const char *file)
+{
+    PopulationHeader hdr;
+    int ret;
+
+    MBUtil_Zero(w, sizeof(*w));
+    w->file = strdup(file);
+    ret = asprintf(&w->tmpFile, "%s.tmp", file);
+    VERIFY(ret > 0);
+
+    w->f = fopen(w->tmpFile, "wb");
+    if (w->f == NULL) {
+        PANIC("Unable to create population file: %s\n", w->tmpFile);
+    }
+
+    /*
+     * The real header is written once everything else is known.
+     */
+    MBUtil_Zero(&hdr, sizeof(hdr));
+    PopulationWrite(w, &hdr, sizeof(hdr));
+}
+
+void PopulationWriter_AddFleet(PopulationWriter *w, MBRegistry *fleetReg)
+{
+    PopulationFleetEntry *e;
+    uint size = MBRegistry_NumEntries(fleetReg);
+
+    if (w->numFleets >= w->capacity) {
+        w->capacity = MAX(64, w->capacity * 2);
+        w->table = realloc(w->table, w->capacity * sizeof(w->table[0]));
+        VERIFY(w->table != NULL);
+    }
+
+    e = &w->table[w->numFleets++];
+    MBUtil_Zero(e, sizeof(*e));
+    e->offset = w->offset;
+    e->hash = Population_HashFleet(fleetReg);
+
+    for (uint i = 0; i < size; i++) {
+        const char *key = MBRegistry_GetKeyAt(fleetReg, i);
+        const char *value = MBRegistry_GetValueAt(fleetReg, i);
+        int s = PopulationStatFromKey(key);
+
+        if (s >= 0) {
+            if (PopulationParseStat(value, &e->stats[s])) {
+                e->statMask |= 1 << s;
+                continue;
+            }
+            e->flags |= POP_FLEET_FLAG_STATS_IN_RECORD;
+        }
+
+        PopulationWriteString(w, key);
+        PopulationWriteString(w, value);
+        e->numEntries++;
+    }
+
+    VERIFY(w->offset - e->offset <= MAX_UINT);
+    e->size = w->offset - e->offset;
+}
+
+void PopulationWriter_Close(PopulationWriter *w, MBRegistry *globalReg)
+{
+    PopulationHeader hdr;
+    uint64 pad = 0;
+
+    MBUtil_Zero(&hdr, sizeof(hdr));
+    memcpy(hdr.magic, POPULATION_MAGIC, sizeof(hdr.magic));
+    hdr.version = POPULATION_VERSION;
+    hdr.numFleets = w->numFleets;
+
+    hdr.globalOffset = w->offset;
+    if (globalReg == NULL) {
+        char value[16];
+        int ret = snprintf(value, sizeof(value), "%u", w->numFleets);
+        VERIFY(ret > 0 && ret < sizeof(value));
+        PopulationWriteString(w, "numFleets");
+        PopulationWriteString(w, value);
+        hdr.numGlobals = 1;
+    } else {
+        uint size = MBRegistry_NumEntries(globalReg);
+        VERIFY(MBRegistry_GetUint(globalReg, "numFleets") == w->numFleets);
+
+        for (uint i = 0; i < size; i++) {
+            PopulationWriteString(w, MBRegistry_GetKeyAt(globalReg, i));
+            PopulationWriteString(w, MBRegistry_GetValueAt(globalReg, i));
+        }
+        hdr.numGlobals = size;
+    }
+    VERIFY(w->offset - hdr.globalOffset <= MAX_UINT);
+    hdr.globalSize = w->offset - hdr.globalOffset;
+
+    PopulationWrite(w, &pad, (8 - w->offset % 8) % 8);
+    hdr.tableOffset = w->offset;
+    PopulationWrite(w, w->table, w->numFleets * sizeof(w->table[0]));
+    hdr.fileSize = w->offset;
+
+    hdr.hash = 0xcbf29ce484222325ULL;
+    for (uint i = 0; i < w->numFleets; i++) {
+        hdr.hash = PopulationHashBytes(hdr.hash,
+                                       (const char *)&w->table[i].hash,
+                                       sizeof(w->table[i].hash));
+    }
+
+    if (fseek(w->f, 0, SEEK_SET) != 0) {
+        PANIC("Unable to write population file: %s\n", w->tmpFile);
+    }
+    w->offset = 0;
+    PopulationWrite(w, &hdr, sizeof(hdr));
+
+    if (fclose(w->f) != 0) {
+        PANIC("Unable to write population file: %s\n", w->tmpFile);
+    }
+    if (rename(w->tmpFile, w->file) != 0) {
+        PANIC("Unable to rename population file: %s\n", w->tmpFile);
+    }
+
+    free(w->table);
+    free(w->file);
+    free(w->tmpFile);
+    MBUtil_Zero(w, sizeof(*w));
+}
+
+/*
+ * PopulationFleetFromKey --
+ *    Return N for a key starting with "fleetN.", or 0.
+ */
+static uint PopulationFleetFromKey(const char *key, uint *prefixLen)
+{
+    uint i = 5;
+    uint n = 0;
+
+    if (strncmp(key, "fleet", 5) != 0 || !isdigit(key[i]) || key[i] == '0') {
+        return 0;
+    }
+
+    while (isdigit(key[i])) {
+        n = n * 10 + (key[i] - '0');
+        if (n > MAX_UINT / 10) {
+            return 0;
+        }
+        i++;
+    }
+
+    if (key[i] != '.') {
+        return 0;
+    }
+
+    *prefixLen = i + 1;
+    return n;
+}
+
+void Population_Load(MBRegistry *popReg, const char *file)
+{
+    Population pop;
+    char *prefix = NULL;
+
+    if (!Population_IsBinaryFile(file)) {
+        MBRegistry_Load(popReg, file);
+        return;
+    }
+
+    Population_Open(&pop, file, FALSE);
+
+    PopulationLoadRecord(&pop, pop.hdr->globalOffset, pop.hdr->globalSize,
+                         pop.hdr->numGlobals, popReg, NULL);
+
+    for (uint i = 1; i <= Population_NumFleets(&pop); i++) {
+        int ret = asprintf(&prefix, "fleet%d.", i);
+        VERIFY(ret > 0);
+        PopulationLoadFleetWork(&pop, i, popReg, prefix);
+        free(prefix);
+        prefix = NULL;
+    }
+
+    Population_Close(&pop);
+}
+
+void Population_Save(MBRegistry *popReg, const char *file)
+{
+    PopulationWriter w;
+    MBRegistry *fleetReg;
+    MBRegistry *globalReg;
+    uint numFleets;
+    uint size;
+    uint *fleetOf;
+    uint *prefixLens;
+    uint *order;
+    uint *start;
+
+    if (!Population_IsBinaryName(file) && !Population_IsBinaryFile(file)) {
+        MBRegistry_Save(popReg, file);
+        return;
+    }
+
+    numFleets = MBRegistry_GetUint(popReg, "numFleets");
+    size = MBRegistry_NumEntries(popReg);
+
+    fleetOf = malloc(MAX(1, size) * sizeof(fleetOf[0]));
+    prefixLens = malloc(MAX(1, size) * sizeof(prefixLens[0]));
+    order = malloc(MAX(1, size) * sizeof(order[0]));
+    start = calloc(numFleets + 2, sizeof(start[0]));
+
+    /*
+     * Bucket the keys by fleet in one pass, keeping their order
+     * within each fleet.  Anything that isn't part of a fleet is a
+     * global key.
+     */
+    for (uint i = 0; i < size; i++) {
+        uint f = PopulationFleetFromKey(MBRegistry_GetKeyAt(popReg, i),
+                                        &prefixLens[i]);
+        if (f > numFleets) {
+            f = 0;
+        }
+        fleetOf[i] = f;
+        start[f + 1]++;
+    }
+    for (uint f = 1; f <= numFleets + 1; f++) {
+        start[f] += start[f - 1];
+    }
+    for (uint i = 0; i < size; i++) {
+        order[start[fleetOf[i]]++] = i;
+    }
+    for (uint f = numFleets + 1; f > 0; f--) {
+        start[f] = start[f - 1];
+    }
+    start[0] = 0;
+
+    fleetReg = MBRegistry_Alloc();
+    globalReg = MBRegistry_Alloc();
+
+    for (uint j = start[0]; j < start[1]; j++) {
+        uint i = order[j];
+        MBRegistry_PutCopy(globalReg, MBRegistry_GetKeyAt(popReg, i),
+                           MBRegistry_GetValueAt(popReg, i));
+    }
+
+    PopulationWriter_Open(&w, file);
+    for (uint f = 1; f <= numFleets; f++) {
+        MBRegistry_MakeEmpty(fleetReg);
+        for (uint j = start[f]; j < start[f + 1]; j++) {
+            uint i = order[j];
+            const char *key = MBRegistry_GetKeyAt(popReg, i);
+            MBRegistry_PutCopy(fleetReg, key + prefixLens[i],
+                               MBRegistry_GetValueAt(popReg, i));
+        }
+        PopulationWriter_AddFleet(&w, fleetReg);
+    }
+    PopulationWriter_Close(&w, globalReg);
+
+    MBRegistry_Free(fleetReg);
+    MBRegistry_Free(globalReg);
+    free(fleetOf);
+    free(prefixLens);
+    free(order);
+    free(start);
+}
+
+void Population_UnitTest(void)
+{
+    char file[] = "/tmp/sr2PopTestXXXXXX.bpop";
+    MBRegistry *popReg = MBRegistry_Alloc();
+    MBRegistry *loadReg = MBRegistry_Alloc();
+    MBRegistry *fleetReg = MBRegistry_Alloc();
+    Population pop;
+    uint size;
+    int fd;
+
+    fd = mkstemps(file, strlen(".bpop"));
+    VERIFY(fd >= 0);
+    close(fd);
+
+    MBRegistry_PutCopy(popReg, "numFleets", "2");
+    MBRegistry_PutCopy(popReg, "fleet1.abattle.fleetName", "BundleFleet");
+    MBRegistry_PutCopy(popReg, "fleet1.abattle.numWins", "12");
+    MBRegistry_PutCopy(popReg, "fleet1.abattle.age", "0");
+    MBRegistry_PutCopy(popReg, "fleet1.align.weight.value", "0.500000");
+    MBRegistry_PutCopy(popReg, "fleet2.abattle.fleetName", "NeuralFleet");
+    MBRegistry_PutCopy(popReg, "fleet2.abattle.numWins", "007");
+    MBRegistry_PutCopy(popReg, "fleet2.shipNet.fn.node[3].params",
+                       "{1.000000, }");
+    MBRegistry_PutCopy(popReg, "fleet3.orphan", "TRUE");
+    MBRegistry_PutCopy(popReg, "comment", "test");
+
+    /*
+     * Text -> binary -> text should give back the same registry.
+     */
+    Population_Save(popReg, file);
+    VERIFY(Population_IsBinaryFile(file));
+    Population_Load(loadReg, file);
+
+    size = MBRegistry_NumEntries(popReg);
+    VERIFY(MBRegistry_NumEntries(loadReg) == size);
+    for (uint i = 0; i < size; i++) {
+        const char *key = MBRegistry_GetKeyAt(popReg, i);
+        const char *value = MBRegistry_GetCStr(loadReg, key);
+        VERIFY(value != NULL);
+        VERIFY(strcmp(value, MBRegistry_GetValueAt(popReg, i)) == 0);
+    }
+
+    Population_Open(&pop, file, TRUE);
+    VERIFY(Population_NumFleets(&pop) == 2);
+
+    Population_LoadFleet(&pop, 1, fleetReg);
+    VERIFY(MBRegistry_NumEntries(fleetReg) == 4);
+    VERIFY(MBRegistry_GetUint(fleetReg, "abattle.numWins") == 12);
+    VERIFY(Population_GetFleetHash(&pop, 1) ==
+           Population_HashFleet(fleetReg));
+
+    MBRegistry_PutCopy(fleetReg, "abattle.numWins", "13");
+    MBRegistry_PutCopy(fleetReg, "abattle.numBattles", "20");
+    VERIFY(Population_UpdateStats(&pop, 1, fleetReg));
+
+    MBRegistry_PutCopy(fleetReg, "align.weight.value", "0.250000");
+    VERIFY(!Population_UpdateStats(&pop, 1, fleetReg));
+
+    MBRegistry_MakeEmpty(fleetReg);
+    Population_LoadFleet(&pop, 2, fleetReg);
+    VERIFY(!Population_UpdateStats(&pop, 2, fleetReg));
+    Population_Close(&pop);
+
+    Population_Open(&pop, file, FALSE);
+    MBRegistry_MakeEmpty(fleetReg);
+    Population_LoadFleet(&pop, 1, fleetReg);
+    VERIFY(MBRegistry_GetUint(fleetReg, "abattle.numWins") == 13);
+    VERIFY(MBRegistry_GetUint(fleetReg, "abattle.numBattles") == 20);
+    VERIFY(strcmp(MBRegistry_GetCStr(fleetReg, "align.weight.value"),
+                  "0.500000") == 0);
+    Population_Close(&pop);
+
+    /*
+     * A damaged file is reported instead of panicking.
+     */
+    VERIFY(Population_Check(file) == NULL);
+    VERIFY(truncate(file, sizeof(PopulationHeader) + 1) == 0);
+    VERIFY(Population_Check(file) != NULL);
+
+    unlink(file);
+    MBRegistry_Free(popReg);
+    MBRegistry_Free(loadReg);
+    MBRegistry_Free(fleetReg);
+}
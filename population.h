@@ -0,0 +1,189 @@
+/*
+ * population.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _POPULATION_H_202304291012
+#define _POPULATION_H_202304291012
+
+#include <stdio.h>
+
+#include "MBTypes.h"
+#include "MBAssert.h"
+#include "MBRegistry.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * Binary population files.
+ *
+ * A text population is a single MBRegistry with "numFleets" and a
+ * "fleetN." prefix on every key of each fleet.  The binary format holds
+ * the same keys, but each fleet is stored as its own record so it can be
+ * found through the fleet table and loaded without parsing the rest of
+ * the file.
+ *
+ * Layout (native byte order):
+ *    PopulationHeader
+ *    fleet records, each a list of "key\0value\0" pairs with the
+ *       "fleetN." prefix stripped
+ *    the global record, for all the keys that aren't part of a fleet
+ *    PopulationFleetEntry[numFleets], 8-byte aligned
+ *
+ * The abattle.* counters are kept in the fleet table rather than in
+ * the records, so they can be updated in place.  A counter that isn't
+ * in canonical "%u" form is left in the record instead, so the
+ * conversion to and from text is lossless.
+ *
+ * Each fleet's hash covers every key except those counters, so it
+ * identifies the fleet's parameters independently of its stats.
+ */
+
+#define POPULATION_MAGIC   "SR2POP\0\0"
+#define POPULATION_VERSION 1
+
+typedef enum PopulationStat {
+    POP_STAT_NUM_BATTLES,
+    POP_STAT_NUM_WINS,
+    POP_STAT_NUM_LOSSES,
+    POP_STAT_NUM_DRAWS,
+    POP_STAT_NUM_SPAWN,
+    POP_STAT_AGE,
+    POP_STAT_MAX,
+} PopulationStat;
+
+typedef struct PopulationHeader {
+    char magic[8];
+    uint32 version;
+    uint32 numFleets;
+    uint64 fileSize;
+    uint64 tableOffset;
+    uint64 globalOffset;
+    uint32 globalSize;
+    uint32 numGlobals;
+    uint64 hash;
+} PopulationHeader;
+
+/*
+ * Set when a counter couldn't be moved into the table, which prevents
+ * in-place updates for that fleet.
+ */
+#define POP_FLEET_FLAG_STATS_IN_RECORD (1 << 0)
+
+typedef struct PopulationFleetEntry {
+    uint64 offset;
+    uint32 size;
+    uint32 numEntries;
+    uint64 hash;
+    uint32 flags;
+    uint32 statMask;
+    uint32 stats[POP_STAT_MAX];
+} PopulationFleetEntry;
+
+typedef struct Population {
+    int fd;
+    bool writable;
+    uint8 *base;
+    uint64 size;
+    PopulationHeader *hdr;
+    PopulationFleetEntry *table;
+} Population;
+
+typedef struct PopulationWriter {
+    char *file;
+    char *tmpFile;
+    FILE *f;
+    uint64 offset;
+    uint numFleets;
+    uint capacity;
+    PopulationFleetEntry *table;
+} PopulationWriter;
+
+/*
+ * Binary files are recognized by their contents when reading, and
+ * are written when the file name ends in ".bpop", or when the existing
+ * file is already binary.
+ */
+bool Population_IsBinaryFile(const char *file);
+bool Population_IsBinaryName(const char *file);
+
+/*
+ * Map a binary population file.  Fleets are numbered from 1, matching
+ * the "fleetN." prefixes in the text format.
+ */
+void Population_Open(Population *pop, const char *file, bool writable);
+void Population_Close(Population *pop);
+
+/*
+ * Returns what's wrong with a binary population file, or NULL if
+ * Population_Open and Population_LoadFleet can use it.
+ */
+const char *Population_Check(const char *file);
+
+static inline uint Population_NumFleets(const Population *pop)
+{
+    return pop->hdr->numFleets;
+}
+
+static inline uint64 Population_GetFleetHash(const Population *pop, uint i)
+{
+    ASSERT(i >= 1 && i <= pop->hdr->numFleets);
+    return pop->table[i - 1].hash;
+}
+
+/*
+ * Load a single fleet's keys, without the "fleetN." prefix.
+ */
+void Population_LoadFleet(Population *pop, uint i, MBRegistry *fleetReg);
+
+/*
+ * Overwrite the abattle.* counters for fleet i with the values from
+ * fleetReg.  This only succeeds if the rest of fleetReg still matches
+ * the fleet in the file.
+ */
+bool Population_UpdateStats(Population *pop, uint i, MBRegistry *fleetReg);
+
+/*
+ * The hash stored for a fleet with these keys.
+ */
+uint64 Population_HashFleet(MBRegistry *fleetReg);
+
+/*
+ * Write a binary file one fleet at a time.  The new file replaces the
+ * old one when the writer is closed.
+ *
+ * If globalReg is NULL, only "numFleets" is written as a global key.
+ */
+void PopulationWriter_Open(PopulationWriter *w, const char *file);
+void PopulationWriter_AddFleet(PopulationWriter *w, MBRegistry *fleetReg);
+void PopulationWriter_Close(PopulationWriter *w, MBRegistry *globalReg);
+
+/*
+ * Load or save a whole population in the flat text-style registry
+ * form, in either format.
+ */
+void Population_Load(MBRegistry *popReg, const char *file);
+void Population_Save(MBRegistry *popReg, const char *file);
+
+void Population_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _POPULATION_H_202304291012
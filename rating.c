@@ -0,0 +1,371 @@
+/*
+ * rating.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "rating.h"
+#include "MBUtil.h"
+#include "MBDebug.h"
+#include "Random.h"
+#include "fleet.h"
+
+void Rating_Create(Rating *r, uint numPlayers)
+{
+    ASSERT(r != NULL);
+    ASSERT(numPlayers >= 1);
+
+    MBUtil_Zero(r, sizeof(*r));
+    r->numPlayers = numPlayers;
+    r->rating = malloc(numPlayers * sizeof(r->rating[0]));
+    r->games = calloc(numPlayers, sizeof(r->games[0]));
+    r->lastOpponent = calloc(numPlayers, sizeof(r->lastOpponent[0]));
+    r->pairs = malloc(MAX(1, numPlayers / 2) * sizeof(r->pairs[0]));
+    VERIFY(r->rating != NULL);
+    VERIFY(r->games != NULL);
+    VERIFY(r->lastOpponent != NULL);
+    VERIFY(r->pairs != NULL);
+
+    for (uint i = 0; i < numPlayers; i++) {
+        r->rating[i] = RATING_INITIAL;
+    }
+}
+
+void Rating_Destroy(Rating *r)
+{
+    free(r->rating);
+    free(r->games);
+    free(r->lastOpponent);
+    free(r->pairs);
+    MBUtil_Zero(r, sizeof(*r));
+}
+
+/*
+ * Rating_Update --
+ *    Apply the Elo update for one battle.  A winner that's neither
+ *    player counts as a draw.
+ */
+void Rating_Update(Rating *r, uint p1, uint p2, uint winner)
+{
+    float expected1;
+    float score1;
+    float k1, k2;
+
+    ASSERT(p1 < r->numPlayers);
+    ASSERT(p2 < r->numPlayers);
+
+    expected1 = 1.0f / (1.0f + powf(10.0f,
+                                    (r->rating[p2] - r->rating[p1]) /
+                                    400.0f));
+    if (winner == p1) {
+        score1 = 1.0f;
+    } else if (winner == p2) {
+        score1 = 0.0f;
+    } else {
+        score1 = 0.5f;
+    }
+
+    k1 = RATING_MIN_K + RATING_EXTRA_K / (1.0f + r->games[p1] / 4.0f);
+    k2 = RATING_MIN_K + RATING_EXTRA_K / (1.0f + r->games[p2] / 4.0f);
+
+    r->rating[p1] += k1 * (score1 - expected1);
+    r->rating[p2] -= k2 * (score1 - expected1);
+    r->games[p1]++;
+    r->games[p2]++;
+}
+
+/*
+ * Rating_SortPlayers --
+ *    Fill order with the non-neutral players, sorted by rating from
+ *    lowest to highest, and return how many there are.  Ties are broken
+ *    randomly.
+ */
+uint Rating_SortPlayers(Rating *r, uint *order)
+{
+    uint n = 0;
+
+    for (uint i = 1; i < r->numPlayers; i++) {
+        order[n++] = i;
+    }
+
+    for (uint i = n; i > 1; i--) {
+        uint j = Random_Int(0, i - 1);
+        uint tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+
+    for (uint i = 1; i < n; i++) {
+        uint x = order[i];
+        uint j = i;
+        while (j > 0 && r->rating[order[j - 1]] > r->rating[x]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = x;
+    }
+
+    return n;
+}
+
+/*
+ * Rating_PairPlayers --
+ *    Pick the matchups for the next round: each fleet plays the closest
+ *    rated fleet it didn't just play.
+ */
+void Rating_PairPlayers(Rating *r)
+{
+    uint *order = malloc(r->numPlayers * sizeof(order[0]));
+    bool *paired = calloc(r->numPlayers, sizeof(paired[0]));
+    uint n;
+
+    VERIFY(order != NULL);
+    VERIFY(paired != NULL);
+    n = Rating_SortPlayers(r, order);
+    r->numPairs = 0;
+
+    if (n % 2 == 1) {
+        /*
+         * Sit out whoever has played the most.
+         */
+        uint most = 0;
+        for (uint i = 1; i < n; i++) {
+            if (r->games[order[i]] > r->games[order[most]]) {
+                most = i;
+            }
+        }
+        paired[most] = TRUE;
+    }
+
+    for (uint i = 0; i < n; i++) {
+        uint partner = n;
+
+        if (paired[i]) {
+            continue;
+        }
+
+        for (uint j = i + 1; j < n; j++) {
+            if (paired[j]) {
+                continue;
+            }
+            if (partner == n) {
+                partner = j;
+            }
+            if (r->lastOpponent[order[i]] != order[j]) {
+                partner = j;
+                break;
+            }
+        }
+
+        if (partner == n) {
+            continue;
+        }
+
+        paired[i] = TRUE;
+        paired[partner] = TRUE;
+
+        ASSERT(r->numPairs < r->numPlayers / 2);
+        r->pairs[r->numPairs][0] = order[i];
+        r->pairs[r->numPairs][1] = order[partner];
+        r->lastOpponent[order[i]] = order[partner];
+        r->lastOpponent[order[partner]] = order[i];
+        r->numPairs++;
+    }
+
+    free(order);
+    free(paired);
+}
+
+/*
+ * Rating_UpdateRankingsFile --
+ *    Rewrite the gRankings table in fleet.c in order of rating, from
+ *    weakest to strongest.
+ *
+ *    Each entry keeps its existing line, including the measured win
+ *    rate comments, and just moves to its new place; the ratings
+ *    themselves are only printed.  Every ranked fleet has to be in the
+ *    tournament exactly once.
+ */
+void Rating_UpdateRankingsFile(Rating *r, const BattlePlayer *players,
+                               const char *file)
+{
+    const char *startMarker = "gRankings[] = {";
+    char *lines[FLEET_AI_MAX];
+    uint numLines = 0;
+    uint *order;
+    uint n;
+    bool seen[FLEET_AI_MAX];
+    char *line = NULL;
+    size_t lineSize = 0;
+    char *tmpFile = NULL;
+    FILE *in;
+    FILE *out;
+    int state = 0;
+
+    MBUtil_Zero(lines, sizeof(lines));
+    MBUtil_Zero(seen, sizeof(seen));
+
+    order = malloc(r->numPlayers * sizeof(order[0]));
+    VERIFY(order != NULL);
+    n = Rating_SortPlayers(r, order);
+    for (uint i = 0; i < n; i++) {
+        FleetAIType aiType = players[order[i]].aiType;
+        int rank = Fleet_GetRanking(aiType);
+
+        if (Fleet_GetTypeFromRanking(rank) != aiType || seen[rank]) {
+            PANIC("--updateRankings needs each ranked fleet exactly once\n");
+        }
+        seen[rank] = TRUE;
+    }
+    if (Fleet_GetTypeFromRanking(n) != FLEET_AI_INVALID) {
+        PANIC("--updateRankings needs each ranked fleet exactly once\n");
+    }
+
+    in = fopen(file, "r");
+    if (in == NULL) {
+        PANIC("Unable to open %s\n", file);
+    }
+
+    int ret = asprintf(&tmpFile, "%s.tmp", file);
+    VERIFY(ret > 0);
+    out = fopen(tmpFile, "w");
+    if (out == NULL) {
+        PANIC("Unable to create %s\n", tmpFile);
+    }
+
+    while (getline(&line, &lineSize, in) >= 0) {
+        if (state == 0) {
+            fputs(line, out);
+            if (strstr(line, startMarker) != NULL) {
+                state = 1;
+            }
+        } else if (state == 1) {
+            if (strstr(line, "FLEET_AI_") != NULL) {
+                VERIFY(numLines < ARRAYSIZE(lines));
+                lines[numLines++] = strdup(line);
+            } else if (strstr(line, "};") != NULL) {
+                if (numLines != n) {
+                    PANIC("Unexpected gRankings table in %s\n", file);
+                }
+
+                for (uint i = 0; i < n; i++) {
+                    int rank = Fleet_GetRanking(players[order[i]].aiType);
+                    fputs(lines[rank], out);
+                }
+                fputs(line, out);
+                state = 2;
+            } else {
+                /*
+                 * Keep the column headings.
+                 */
+                fputs(line, out);
+            }
+        } else {
+            fputs(line, out);
+        }
+    }
+
+    if (state != 2) {
+        PANIC("Unable to find the gRankings table in %s\n", file);
+    }
+
+    fclose(in);
+    if (fclose(out) != 0 || rename(tmpFile, file) != 0) {
+        PANIC("Unable to write %s\n", file);
+    }
+    Warning("Updated gRankings in %s\n", file);
+
+    for (uint i = 0; i < numLines; i++) {
+        free(lines[i]);
+    }
+    free(line);
+    free(tmpFile);
+    free(order);
+}
+
+void Rating_UnitTest(void)
+{
+    Rating r;
+    uint order[6];
+    uint n;
+
+    /*
+     * A win between two new players moves them by the same amount, and
+     * a draw between equals doesn't move them at all.
+     */
+    Rating_Create(&r, 3);
+    Rating_Update(&r, 1, 2, 1);
+    VERIFY(r.rating[1] > RATING_INITIAL);
+    VERIFY(fabsf((r.rating[1] - RATING_INITIAL) -
+                 (RATING_INITIAL - r.rating[2])) < 0.001f);
+    VERIFY(r.games[1] == 1 && r.games[2] == 1);
+    VERIFY(r.rating[0] == RATING_INITIAL && r.games[0] == 0);
+
+    Rating_Update(&r, 1, 2, 0);
+    VERIFY(r.rating[1] < RATING_INITIAL + RATING_MIN_K + RATING_EXTRA_K);
+    Rating_Destroy(&r);
+
+    Rating_Create(&r, 3);
+    Rating_Update(&r, 2, 1, 0);
+    VERIFY(r.rating[1] == RATING_INITIAL);
+    VERIFY(r.rating[2] == RATING_INITIAL);
+    Rating_Destroy(&r);
+
+    /*
+     * Sorting leaves out the neutral player.
+     */
+    Rating_Create(&r, 6);
+    for (uint i = 0; i < 6; i++) {
+        r.rating[i] = RATING_INITIAL - 100.0f * i;
+    }
+    n = Rating_SortPlayers(&r, order);
+    VERIFY(n == 5);
+    for (uint i = 0; i < n; i++) {
+        VERIFY(order[i] == 5 - i);
+    }
+
+    /*
+     * Pairing matches neighbours, sits out the odd player who has played
+     * the most, and avoids a repeat of the last matchup.
+     */
+    r.games[5] = 10;
+    Rating_PairPlayers(&r);
+    VERIFY(r.numPairs == 2);
+    VERIFY(r.pairs[0][0] == 4 && r.pairs[0][1] == 3);
+    VERIFY(r.pairs[1][0] == 2 && r.pairs[1][1] == 1);
+
+    r.games[5] = 0;
+    r.games[1] = 10;
+    Rating_PairPlayers(&r);
+    VERIFY(r.numPairs == 2);
+    VERIFY(r.pairs[0][0] == 5 && r.pairs[0][1] == 4);
+    VERIFY(r.pairs[1][0] == 3 && r.pairs[1][1] == 2);
+
+    r.games[1] = 0;
+    r.games[2] = 10;
+    Rating_PairPlayers(&r);
+    VERIFY(r.numPairs == 2);
+    VERIFY(r.pairs[0][0] == 5 && r.pairs[0][1] == 3);
+    VERIFY(r.pairs[1][0] == 4 && r.pairs[1][1] == 1);
+    for (uint i = 0; i < r.numPairs; i++) {
+        VERIFY(r.pairs[i][0] != 0 && r.pairs[i][1] != 0);
+    }
+    Rating_Destroy(&r);
+}
@@ -0,0 +1,73 @@
+/*
+ * rating.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RATING_H_202306031510
+#define _RATING_H_202306031510
+
+#include "MBTypes.h"
+#include "MBAssert.h"
+#include "battleTypes.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * Elo ratings for rated tournaments.
+ *
+ * Each round pairs up fleets with the closest ratings, since those are
+ * the battles whose outcome is least certain, and so tell us the most.
+ * The K factor starts high and shrinks as a fleet plays more battles.
+ *
+ * Players are numbered like a run's players, and player 0 is the
+ * neutral player, which is never rated or paired.
+ */
+#define RATING_INITIAL (1500.0f)
+#define RATING_MIN_K   (16.0f)
+#define RATING_EXTRA_K (48.0f)
+
+typedef struct Rating {
+    uint numPlayers;
+    float *rating;
+    uint *games;
+    uint *lastOpponent;
+
+    /*
+     * The matchups for the current round, from Rating_PairPlayers.
+     */
+    uint numPairs;
+    uint (*pairs)[2];
+} Rating;
+
+void Rating_Create(Rating *r, uint numPlayers);
+void Rating_Destroy(Rating *r);
+
+void Rating_Update(Rating *r, uint p1, uint p2, uint winner);
+uint Rating_SortPlayers(Rating *r, uint *order);
+void Rating_PairPlayers(Rating *r);
+
+void Rating_UpdateRankingsFile(Rating *r, const BattlePlayer *players,
+                               const char *file);
+
+void Rating_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _RATING_H_202306031510
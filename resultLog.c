@@ -0,0 +1,436 @@
+/*
+ * resultLog.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "resultLog.h"
+#include "MBUtil.h"
+#include "MBDebug.h"
+
+typedef struct ResultLogHeader {
+    char magic[8];
+    uint32 version;
+    uint32 battleSize;
+} ResultLogHeader;
+
+typedef struct ResultLogRecordHeader {
+    uint32 type;
+    uint32 length;
+} ResultLogRecordHeader;
+
+#define RESULT_LOG_BUFFER_SIZE (1024 * 1024)
+
+bool ResultLog_IsJsonName(const char *file)
+{
+    const char *ext = ".jsonl";
+    uint len = strlen(file);
+    uint extLen = strlen(ext);
+
+    return len >= extLen && strcmp(file + len - extLen, ext) == 0;
+}
+
+static void ResultLogWrite(ResultLog *rl, const void *data, uint size)
+{
+    if (size > 0 && fwrite(data, size, 1, rl->f) != 1) {
+        PANIC("Unable to write result log: %s\n", rl->file);
+    }
+}
+
+static void ResultLogWriteJsonString(ResultLog *rl, const char *str)
+{
+    fputc('"', rl->f);
+    for (const char *c = str; c != NULL && *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(rl->f, "\\%c", *c);
+        } else if ((uint8)*c < 0x20) {
+            fprintf(rl->f, "\\u%04x", (uint8)*c);
+        } else {
+            fputc(*c, rl->f);
+        }
+    }
+    fputc('"', rl->f);
+}
+
+/*
+ * ResultLogOpenBinary --
+ *    Check the header of an existing binary log, and find the end of its
+ *    last complete record.  A partial record at the end (from an
+ *    interrupted run) is truncated away.
+ */
+static void ResultLogOpenBinary(ResultLog *rl, bool newFile)
+{
+    ResultLogHeader hdr;
+    ResultLogRecordHeader rh;
+
+    if (newFile || fread(&hdr, sizeof(hdr), 1, rl->f) != 1) {
+        MBUtil_Zero(&hdr, sizeof(hdr));
+        memcpy(hdr.magic, RESULT_LOG_MAGIC, sizeof(hdr.magic));
+        hdr.version = RESULT_LOG_VERSION;
+        hdr.battleSize = sizeof(ResultLogBattle);
+
+        VERIFY(fseek(rl->f, 0, SEEK_SET) == 0);
+        VERIFY(ftruncate(fileno(rl->f), 0) == 0);
+        ResultLogWrite(rl, &hdr, sizeof(hdr));
+        return;
+    }
+
+    if (memcmp(hdr.magic, RESULT_LOG_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != RESULT_LOG_VERSION ||
+        hdr.battleSize != sizeof(ResultLogBattle)) {
+        PANIC("Unsupported result log: %s\n", rl->file);
+    }
+
+    VERIFY(fseek(rl->f, 0, SEEK_END) == 0);
+    long size = ftell(rl->f);
+    long end = sizeof(hdr);
+    VERIFY(fseek(rl->f, end, SEEK_SET) == 0);
+    while (fread(&rh, sizeof(rh), 1, rl->f) == 1 &&
+           end + (long)sizeof(rh) + rh.length <= size) {
+        end += sizeof(rh) + rh.length;
+        VERIFY(fseek(rl->f, end, SEEK_SET) == 0);
+    }
+
+    if (end < size) {
+        VERIFY(ftruncate(fileno(rl->f), end) == 0);
+    }
+    VERIFY(fseek(rl->f, end, SEEK_SET) == 0);
+}
+
+/*
+ * ResultLogOpenJson --
+ *    Make sure the next record starts on a new line, even if the last
+ *    run was interrupted in the middle of one.
+ */
+static void ResultLogOpenJson(ResultLog *rl, bool newFile)
+{
+    VERIFY(fseek(rl->f, 0, SEEK_END) == 0);
+    if (!newFile && ftell(rl->f) > 0) {
+        VERIFY(fseek(rl->f, -1, SEEK_END) == 0);
+        int c = fgetc(rl->f);
+        VERIFY(fseek(rl->f, 0, SEEK_END) == 0);
+        if (c != '\n') {
+            fputc('\n', rl->f);
+        }
+    }
+}
+
+void ResultLog_Open(ResultLog *rl, const char *file)
+{
+    bool newFile;
+
+    MBUtil_Zero(rl, sizeof(*rl));
+    rl->file = strdup(file);
+    rl->jsonl = ResultLog_IsJsonName(file);
+
+    rl->f = fopen(file, "r+b");
+    newFile = rl->f == NULL;
+    if (newFile) {
+        rl->f = fopen(file, "w+b");
+        if (rl->f == NULL) {
+            PANIC("Unable to create result log: %s\n", file);
+        }
+    }
+    setvbuf(rl->f, NULL, _IOFBF, RESULT_LOG_BUFFER_SIZE);
+
+    if (rl->jsonl) {
+        ResultLogOpenJson(rl, newFile);
+    } else {
+        ResultLogOpenBinary(rl, newFile);
+    }
+}
+
+void ResultLog_Close(ResultLog *rl)
+{
+    if (rl->numBattles > 0) {
+        Warning("Result log: %d battles written to %s.\n",
+                rl->numBattles, rl->file);
+    }
+
+    if (fclose(rl->f) != 0) {
+        PANIC("Unable to write result log: %s\n", rl->file);
+    }
+    free(rl->file);
+    MBUtil_Zero(rl, sizeof(*rl));
+}
+
+void ResultLog_Flush(ResultLog *rl)
+{
+    if (fflush(rl->f) != 0) {
+        PANIC("Unable to write result log: %s\n", rl->file);
+    }
+}
+
+/*
+ * ResultLog_GetOffset --
+ *    Flush the log, and return where the next record will go, for a
+ *    later ResultLog_Truncate.
+ */
+uint64 ResultLog_GetOffset(ResultLog *rl)
+{
+    long offset;
+
+    ResultLog_Flush(rl);
+    offset = ftell(rl->f);
+    VERIFY(offset >= 0);
+    return offset;
+}
+
+/*
+ * ResultLog_Truncate --
+ *    Drop everything written after offset, because the battles that
+ *    wrote it are going to be run again.  Returns FALSE, leaving the log
+ *    alone, if the log doesn't go that far.
+ */
+bool ResultLog_Truncate(ResultLog *rl, uint64 offset)
+{
+    long size;
+
+    ResultLog_Flush(rl);
+    VERIFY(fseek(rl->f, 0, SEEK_END) == 0);
+    size = ftell(rl->f);
+    VERIFY(size >= 0);
+
+    if (offset > (uint64)size) {
+        return FALSE;
+    }
+    if (offset < (uint64)size) {
+        VERIFY(ftruncate(fileno(rl->f), offset) == 0);
+    }
+    VERIFY(fseek(rl->f, offset, SEEK_SET) == 0);
+    return TRUE;
+}
+
+void ResultLog_AddRun(ResultLog *rl, const BattlePlayer *players,
+                      uint numPlayers)
+{
+    if (rl->jsonl) {
+        fprintf(rl->f, "{\"type\":\"run\",\"players\":[");
+        for (uint i = 0; i < numPlayers; i++) {
+            fprintf(rl->f, "%s{\"uid\":%u,\"name\":", i > 0 ? "," : "",
+                    players[i].playerUID);
+            ResultLogWriteJsonString(rl, players[i].playerName);
+            fputc('}', rl->f);
+        }
+        fprintf(rl->f, "]}\n");
+        return;
+    }
+
+    ResultLogRecordHeader rh;
+    uint32 n = numPlayers;
+
+    rh.type = RESULT_LOG_RECORD_RUN;
+    rh.length = sizeof(n);
+    for (uint i = 0; i < numPlayers; i++) {
+        const char *name = players[i].playerName;
+        rh.length += 2 * sizeof(uint32) + (name != NULL ? strlen(name) : 0);
+    }
+
+    ResultLogWrite(rl, &rh, sizeof(rh));
+    ResultLogWrite(rl, &n, sizeof(n));
+    for (uint i = 0; i < numPlayers; i++) {
+        const char *name = players[i].playerName;
+        uint32 uid = players[i].playerUID;
+        uint32 len = name != NULL ? strlen(name) : 0;
+
+        ResultLogWrite(rl, &uid, sizeof(uid));
+        ResultLogWrite(rl, &len, sizeof(len));
+        ResultLogWrite(rl, name, len);
+    }
+}
+
+void ResultLog_AddBattle(ResultLog *rl, const ResultLogBattle *battle,
+                         const BattlePlayer *players)
+{
+    rl->numBattles++;
+
+    if (rl->jsonl) {
+        fprintf(rl->f, "{\"type\":\"battle\",\"seed\":%llu,\"loop\":%u,"
+                "\"players\":[",
+                (unsigned long long)battle->seed, battle->loopIndex);
+        for (uint i = 0; i < battle->numPlayers; i++) {
+            fprintf(rl->f, "%s%u", i > 0 ? "," : "", players[i].playerUID);
+        }
+        fprintf(rl->f, "],\"winner\":%u,\"tick\":%u,\"collisions\":%u,"
+                "\"sensorContacts\":%u,\"spawns\":%u,\"shipSpawns\":%u,"
+                "\"wallMS\":%u,\"finished\":%s,\"cached\":%s}\n",
+                battle->winnerUID, battle->tick, battle->collisions,
+                battle->sensorContacts, battle->spawns, battle->shipSpawns,
+                battle->durationMS,
+                (battle->flags & RESULT_LOG_FLAG_FINISHED) ? "true" : "false",
+                (battle->flags & RESULT_LOG_FLAG_CACHED) ? "true" : "false");
+        return;
+    }
+
+    ResultLogRecordHeader rh;
+
+    rh.type = RESULT_LOG_RECORD_BATTLE;
+    rh.length = sizeof(*battle) + battle->numPlayers * sizeof(uint32);
+    ResultLogWrite(rl, &rh, sizeof(rh));
+    ResultLogWrite(rl, battle, sizeof(*battle));
+    for (uint i = 0; i < battle->numPlayers; i++) {
+        uint32 uid = players[i].playerUID;
+        ResultLogWrite(rl, &uid, sizeof(uid));
+    }
+}
+
+void ResultLog_UnitTest(void)
+{
+    char binFile[] = "/tmp/sr2ResultLogTestXXXXXX";
+    char jsonFile[] = "/tmp/sr2ResultLogTestXXXXXX.jsonl";
+    BattlePlayer players[3];
+    ResultLogBattle battle;
+    ResultLogHeader hdr;
+    ResultLogRecordHeader rh;
+    ResultLog rl;
+    char line[1024];
+    uint32 n, uid, len;
+    uint64 offset;
+    struct stat st;
+    FILE *f;
+    int fd;
+
+    fd = mkstemp(binFile);
+    VERIFY(fd >= 0);
+    close(fd);
+    unlink(binFile);
+
+    fd = mkstemps(jsonFile, strlen(".jsonl"));
+    VERIFY(fd >= 0);
+    close(fd);
+    unlink(jsonFile);
+
+    VERIFY(!ResultLog_IsJsonName(binFile));
+    VERIFY(ResultLog_IsJsonName(jsonFile));
+
+    MBUtil_Zero(players, sizeof(players));
+    players[0].playerUID = 0;
+    players[1].playerUID = 1;
+    players[1].playerName = "Fleet \"One\"";
+    players[2].playerUID = 2;
+    players[2].playerName = "Fleet2";
+
+    MBUtil_Zero(&battle, sizeof(battle));
+    battle.seed = 0x123456789ULL;
+    battle.tick = 500;
+    battle.winnerUID = 2;
+    battle.collisions = 7;
+    battle.flags = RESULT_LOG_FLAG_FINISHED;
+    battle.numPlayers = ARRAYSIZE(players);
+
+    /*
+     * Binary, across two opens, with a partial record at the end of the
+     * first one.
+     */
+    ResultLog_Open(&rl, binFile);
+    ResultLog_AddRun(&rl, players, ARRAYSIZE(players));
+    ResultLog_AddBattle(&rl, &battle, players);
+    ResultLog_Close(&rl);
+
+    f = fopen(binFile, "ab");
+    VERIFY(f != NULL);
+    rh.type = RESULT_LOG_RECORD_BATTLE;
+    rh.length = sizeof(battle);
+    VERIFY(fwrite(&rh, sizeof(rh), 1, f) == 1);
+    fclose(f);
+
+    ResultLog_Open(&rl, binFile);
+    battle.loopIndex = 1;
+    battle.flags |= RESULT_LOG_FLAG_CACHED;
+    ResultLog_AddBattle(&rl, &battle, players);
+    ResultLog_Close(&rl);
+
+    f = fopen(binFile, "rb");
+    VERIFY(f != NULL);
+    VERIFY(fread(&hdr, sizeof(hdr), 1, f) == 1);
+    VERIFY(memcmp(hdr.magic, RESULT_LOG_MAGIC, sizeof(hdr.magic)) == 0);
+
+    VERIFY(fread(&rh, sizeof(rh), 1, f) == 1);
+    VERIFY(rh.type == RESULT_LOG_RECORD_RUN);
+    VERIFY(fread(&n, sizeof(n), 1, f) == 1);
+    VERIFY(n == ARRAYSIZE(players));
+    for (uint i = 0; i < n; i++) {
+        VERIFY(fread(&uid, sizeof(uid), 1, f) == 1);
+        VERIFY(fread(&len, sizeof(len), 1, f) == 1);
+        VERIFY(uid == i);
+        VERIFY(len < sizeof(line));
+        VERIFY(len == 0 || fread(line, len, 1, f) == 1);
+    }
+
+    for (uint b = 0; b < 2; b++) {
+        ResultLogBattle rb;
+
+        VERIFY(fread(&rh, sizeof(rh), 1, f) == 1);
+        VERIFY(rh.type == RESULT_LOG_RECORD_BATTLE);
+        VERIFY(rh.length == sizeof(rb) + 3 * sizeof(uint32));
+        VERIFY(fread(&rb, sizeof(rb), 1, f) == 1);
+        VERIFY(rb.seed == battle.seed);
+        VERIFY(rb.loopIndex == b);
+        VERIFY(rb.winnerUID == 2);
+        VERIFY(rb.collisions == 7);
+        VERIFY(((rb.flags & RESULT_LOG_FLAG_CACHED) != 0) == (b == 1));
+        for (uint i = 0; i < rb.numPlayers; i++) {
+            VERIFY(fread(&uid, sizeof(uid), 1, f) == 1);
+            VERIFY(uid == players[i].playerUID);
+        }
+    }
+    VERIFY(fread(&rh, sizeof(rh), 1, f) == 0);
+    fclose(f);
+
+    /*
+     * Truncating back to an earlier offset drops the records after it.
+     */
+    ResultLog_Open(&rl, binFile);
+    offset = ResultLog_GetOffset(&rl);
+    ResultLog_AddBattle(&rl, &battle, players);
+    VERIFY(ResultLog_GetOffset(&rl) > offset);
+    VERIFY(!ResultLog_Truncate(&rl, offset + 1024 * 1024));
+    VERIFY(ResultLog_Truncate(&rl, offset));
+    VERIFY(ResultLog_GetOffset(&rl) == offset);
+    ResultLog_AddBattle(&rl, &battle, players);
+    VERIFY(ResultLog_Truncate(&rl, offset));
+    ResultLog_Close(&rl);
+    VERIFY(stat(binFile, &st) == 0);
+    VERIFY((uint64)st.st_size == offset);
+
+    /*
+     * JSONL.
+     */
+    ResultLog_Open(&rl, jsonFile);
+    ResultLog_AddRun(&rl, players, ARRAYSIZE(players));
+    ResultLog_AddBattle(&rl, &battle, players);
+    ResultLog_Close(&rl);
+
+    f = fopen(jsonFile, "r");
+    VERIFY(f != NULL);
+    VERIFY(fgets(line, sizeof(line), f) != NULL);
+    VERIFY(strstr(line, "\"type\":\"run\"") != NULL);
+    VERIFY(strstr(line, "\"name\":\"Fleet \\\"One\\\"\"") != NULL);
+    VERIFY(fgets(line, sizeof(line), f) != NULL);
+    VERIFY(strstr(line, "\"type\":\"battle\"") != NULL);
+    VERIFY(strstr(line, "\"seed\":4886718345,") != NULL);
+    VERIFY(strstr(line, "\"players\":[0,1,2]") != NULL);
+    VERIFY(strstr(line, "\"cached\":true}") != NULL);
+    VERIFY(fgets(line, sizeof(line), f) == NULL);
+    fclose(f);
+
+    unlink(binFile);
+    unlink(jsonFile);
+}
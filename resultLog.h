@@ -0,0 +1,110 @@
+/*
+ * resultLog.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RESULTLOG_H_202305201415
+#define _RESULTLOG_H_202305201415
+
+#include <stdio.h>
+
+#include "MBTypes.h"
+#include "MBAssert.h"
+#include "battleTypes.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * An append-only log of every battle's result, for analysis without
+ * re-running the battles.
+ *
+ * Each run starts with a run record listing its players, and is
+ * followed by one battle record per battle.  Battle records name the
+ * players by PlayerUID, which refers to the closest run record before
+ * them.
+ *
+ * Files whose name ends in ".jsonl" get one JSON object per line:
+ *
+ *    {"type":"run","players":[{"uid":1,"name":"..."},...]}
+ *    {"type":"battle","seed":...,"loop":...,"players":[0,1,2],
+ *     "winner":1,"tick":...,"collisions":...,"sensorContacts":...,
+ *     "spawns":...,"shipSpawns":...,"wallMS":...,"finished":true,
+ *     "cached":false}
+ *
+ * Anything else is binary: a header, then records made of a type and a
+ * length, and then the payload.  A run's payload is the number of
+ * players, and a (uid, name length, name) for each one.  A battle's
+ * payload is a ResultLogBattle followed by the uid of each seat.
+ *
+ * Writes are buffered, and only reach the file on ResultLog_Flush.
+ */
+
+#define RESULT_LOG_MAGIC   "SR2RLOG1"
+#define RESULT_LOG_VERSION 1
+
+typedef enum ResultLogRecordType {
+    RESULT_LOG_RECORD_INVALID = 0,
+    RESULT_LOG_RECORD_RUN     = 1,
+    RESULT_LOG_RECORD_BATTLE  = 2,
+} ResultLogRecordType;
+
+#define RESULT_LOG_FLAG_FINISHED (1 << 0)
+#define RESULT_LOG_FLAG_CACHED   (1 << 1)
+
+typedef struct ResultLogBattle {
+    uint64 seed;
+    uint32 loopIndex;
+    uint32 tick;
+    uint32 winnerUID;
+    uint32 collisions;
+    uint32 sensorContacts;
+    uint32 spawns;
+    uint32 shipSpawns;
+    uint32 durationMS;
+    uint32 flags;
+    uint32 numPlayers;
+} ResultLogBattle;
+
+typedef struct ResultLog {
+    char *file;
+    FILE *f;
+    bool jsonl;
+    uint numBattles;
+} ResultLog;
+
+void ResultLog_Open(ResultLog *rl, const char *file);
+void ResultLog_Close(ResultLog *rl);
+void ResultLog_Flush(ResultLog *rl);
+
+uint64 ResultLog_GetOffset(ResultLog *rl);
+bool ResultLog_Truncate(ResultLog *rl, uint64 offset);
+
+bool ResultLog_IsJsonName(const char *file);
+
+void ResultLog_AddRun(ResultLog *rl, const BattlePlayer *players,
+                      uint numPlayers);
+void ResultLog_AddBattle(ResultLog *rl, const ResultLogBattle *battle,
+                         const BattlePlayer *players);
+
+void ResultLog_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _RESULTLOG_H_202305201415
@@ -0,0 +1,464 @@
+/*
+ * schedule.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <SDL2/SDL_timer.h>
+
+#include "schedule.h"
+#include "battleCache.h"
+#include "MBUtil.h"
+#include "MBDebug.h"
+#include "MBRegistry.h"
+
+/*
+ * Keeps the pair and per-fleet entries in the cost table apart.
+ */
+#define SCHEDULE_FLEET_TAG 0x5bd1e9955bd1e995ULL
+
+static uint64 ScheduleMix(uint64 a, uint64 b)
+{
+    uint64 z = a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+
+    // Zero marks an empty entry.
+    return z == 0 ? 1 : z;
+}
+
+/*
+ * ScheduleCostFind --
+ *    Look up key in the cost table, adding it if create is set.
+ */
+static ScheduleCostEntry *ScheduleCostFind(Schedule *s, uint64 key,
+                                           bool create)
+{
+    if (create && 2 * (s->numEntries + 1) > s->capacity) {
+        ScheduleCostEntry *oldTable = s->table;
+        uint oldCapacity = s->capacity;
+
+        s->capacity = MAX(64, 2 * oldCapacity);
+        s->table = calloc(s->capacity, sizeof(s->table[0]));
+        VERIFY(s->table != NULL);
+
+        for (uint i = 0; i < oldCapacity; i++) {
+            if (oldTable[i].key != 0) {
+                uint h = oldTable[i].key & (s->capacity - 1);
+                while (s->table[h].key != 0) {
+                    h = (h + 1) & (s->capacity - 1);
+                }
+                s->table[h] = oldTable[i];
+            }
+        }
+        free(oldTable);
+    }
+
+    if (s->capacity == 0) {
+        return NULL;
+    }
+
+    uint h = key & (s->capacity - 1);
+    while (s->table[h].key != 0) {
+        if (s->table[h].key == key) {
+            return &s->table[h];
+        }
+        h = (h + 1) & (s->capacity - 1);
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    s->table[h].key = key;
+    s->numEntries++;
+    return &s->table[h];
+}
+
+static void ScheduleCostAdd(Schedule *s, uint64 key, float ms)
+{
+    ScheduleCostEntry *e = ScheduleCostFind(s, key, TRUE);
+
+    e->count++;
+    e->meanMS += (ms - e->meanMS) / e->count;
+}
+
+static inline uint ScheduleSeat(Schedule *s, uint bscIndex, uint seat)
+{
+    return s->seatFn(s->cbData, bscIndex, seat);
+}
+
+/*
+ * SchedulePairKey --
+ *    The cost table key for the fleets playing in scenario bscIndex.
+ *    The fleet hashes are summed, so the seating doesn't matter.
+ */
+static uint64 SchedulePairKey(Schedule *s, uint bscIndex)
+{
+    uint64 sum = 0;
+
+    for (uint p = 1; p < s->numSeats; p++) {
+        sum += s->fleetHashes[ScheduleSeat(s, bscIndex, p)];
+    }
+    return ScheduleMix(s->paramsHash, sum);
+}
+
+static uint64 ScheduleFleetKey(Schedule *s, uint i)
+{
+    return ScheduleMix(s->paramsHash ^ SCHEDULE_FLEET_TAG,
+                       s->fleetHashes[i]);
+}
+
+/*
+ * SchedulePredict --
+ *    Predict how long scenario bscIndex will take to run.
+ */
+static float SchedulePredict(Schedule *s, uint bscIndex)
+{
+    ScheduleCostEntry *e;
+    float sum = 0.0f;
+    uint n = 0;
+
+    e = ScheduleCostFind(s, SchedulePairKey(s, bscIndex), FALSE);
+    if (e != NULL) {
+        return e->meanMS;
+    }
+
+    for (uint p = 1; p < s->numSeats; p++) {
+        uint i = ScheduleSeat(s, bscIndex, p);
+        e = ScheduleCostFind(s, ScheduleFleetKey(s, i), FALSE);
+        if (e != NULL) {
+            sum += e->meanMS;
+            n++;
+        }
+    }
+    if (n > 0) {
+        return sum / n;
+    }
+
+    return s->totalMeanMS;
+}
+
+void Schedule_Record(Schedule *s, uint bscIndex, uint32 durationMS,
+                     float predictedMS)
+{
+    float ms = durationMS;
+
+    ScheduleCostAdd(s, SchedulePairKey(s, bscIndex), ms);
+    for (uint p = 1; p < s->numSeats; p++) {
+        ScheduleCostAdd(s, ScheduleFleetKey(s, ScheduleSeat(s, bscIndex, p)),
+                        ms);
+    }
+
+    s->totalCount++;
+    s->totalMeanMS += (ms - s->totalMeanMS) / s->totalCount;
+
+    s->numTimed++;
+    s->sumErrorMS += fabsf(ms - predictedMS);
+}
+
+static int ScheduleCompare(const ScheduleItem *a, const ScheduleItem *b)
+{
+    if (a->isNew != b->isNew) {
+        return a->isNew ? -1 : 1;
+    }
+    if (a->predictedMS != b->predictedMS) {
+        return a->predictedMS > b->predictedMS ? -1 : 1;
+    }
+    return a->bscIndex < b->bscIndex ? -1 :
+           a->bscIndex > b->bscIndex ? 1 : 0;
+}
+
+void Schedule_Create(Schedule *s, bool preferNew)
+{
+    MBUtil_Zero(s, sizeof(*s));
+    s->preferNew = preferNew;
+}
+
+void Schedule_Destroy(Schedule *s)
+{
+    ASSERT(s->fleetHashes == NULL);
+    free(s->table);
+    MBUtil_Zero(s, sizeof(*s));
+}
+
+/*
+ * Schedule_BeginRun --
+ *    Set up the scheduler for a run of numScenarios scenarios, with
+ *    numRunners threads or workers running the battles.
+ */
+void Schedule_BeginRun(Schedule *s, const BattleParams *bp,
+                       const BattlePlayer *players, uint numPlayers,
+                       uint numScenarios, uint numSeats,
+                       ScheduleSeatFn seatFn, void *cbData,
+                       uint numRunners)
+{
+    ASSERT(s->fleetHashes == NULL);
+    ASSERT(numRunners > 0);
+
+    s->seatFn = seatFn;
+    s->cbData = cbData;
+    s->numSeats = numSeats;
+    s->numScenarios = numScenarios;
+    s->paramsHash = BattleCache_HashParams(bp);
+    s->fleetHashes = malloc(numPlayers * sizeof(s->fleetHashes[0]));
+    s->isNew = malloc(numPlayers * sizeof(s->isNew[0]));
+    s->windowSize = MIN(numScenarios, SCHEDULE_WINDOW);
+    s->window = malloc(MAX(1, s->windowSize) * sizeof(s->window[0]));
+    s->numRunners = numRunners;
+    s->threadFreeMS = calloc(s->numRunners, sizeof(s->threadFreeMS[0]));
+    VERIFY(s->fleetHashes != NULL);
+    VERIFY(s->isNew != NULL);
+    VERIFY(s->window != NULL);
+    VERIFY(s->threadFreeMS != NULL);
+
+    for (uint i = 0; i < numPlayers; i++) {
+        const BattlePlayer *player = &players[i];
+        s->fleetHashes[i] = BattleCache_HashFleet(player);
+
+        /*
+         * Fleets that haven't fought yet are the newly spawned ones.
+         */
+        s->isNew[i] = FALSE;
+        if (s->preferNew && player->playerType == PLAYER_TYPE_TARGET) {
+            MBRegistry *mreg = player->mreg;
+            s->isNew[i] =
+                mreg == NULL ||
+                !MBRegistry_ContainsKey(mreg, "abattle.numBattles") ||
+                MBRegistry_GetUint(mreg, "abattle.numBattles") == 0;
+        }
+    }
+
+    s->startMS = SDL_GetTicks();
+    s->numTimed = 0;
+    s->sumErrorMS = 0.0f;
+}
+
+static void ScheduleSwap(Schedule *s, uint i, uint j)
+{
+    ScheduleItem tmp = s->window[i];
+
+    s->window[i] = s->window[j];
+    s->window[j] = tmp;
+}
+
+/*
+ * SchedulePush --
+ *    Add scenario b to the window, which is a heap with the scenario to
+ *    queue first at the top.
+ */
+static void SchedulePush(Schedule *s, uint b)
+{
+    ScheduleItem *item;
+    uint i = s->numWindow++;
+
+    ASSERT(s->numWindow <= s->windowSize);
+    item = &s->window[i];
+    item->bscIndex = b;
+    item->predictedMS = SchedulePredict(s, b);
+    item->isNew = FALSE;
+    for (uint p = 1; p < s->numSeats; p++) {
+        item->isNew |= s->isNew[ScheduleSeat(s, b, p)];
+    }
+
+    while (i > 0) {
+        uint parent = (i - 1) / 2;
+        if (ScheduleCompare(&s->window[i], &s->window[parent]) >= 0) {
+            break;
+        }
+        ScheduleSwap(s, i, parent);
+        i = parent;
+    }
+}
+
+/*
+ * Schedule_BeginLoop --
+ *    Start picking the scenarios for the next loop iteration.
+ */
+void Schedule_BeginLoop(Schedule *s)
+{
+    ASSERT(s->numWindow == 0);
+    s->nextScenario = 0;
+}
+
+/*
+ * Schedule_Next --
+ *    Pick the next scenario of the current loop iteration to queue,
+ *    using everything learned so far.  Each scenario is picked once per
+ *    loop iteration.
+ */
+ScheduleItem Schedule_Next(Schedule *s)
+{
+    ScheduleItem top;
+    uint i = 0;
+
+    while (s->numWindow < s->windowSize &&
+           s->nextScenario < s->numScenarios) {
+        SchedulePush(s, s->nextScenario++);
+    }
+
+    VERIFY(s->numWindow > 0);
+    top = s->window[0];
+    s->window[0] = s->window[--s->numWindow];
+
+    while (TRUE) {
+        uint l = 2 * i + 1;
+        uint r = l + 1;
+        uint best = i;
+
+        if (l < s->numWindow &&
+            ScheduleCompare(&s->window[l], &s->window[best]) < 0) {
+            best = l;
+        }
+        if (r < s->numWindow &&
+            ScheduleCompare(&s->window[r], &s->window[best]) < 0) {
+            best = r;
+        }
+        if (best == i) {
+            break;
+        }
+        ScheduleSwap(s, i, best);
+        i = best;
+    }
+
+    return top;
+}
+
+/*
+ * Schedule_Assign --
+ *    Account for a queued battle in the predicted makespan, by giving it
+ *    to whichever thread is predicted to free up first.
+ */
+void Schedule_Assign(Schedule *s, float predictedMS)
+{
+    uint t = 0;
+
+    for (uint i = 1; i < s->numRunners; i++) {
+        if (s->threadFreeMS[i] < s->threadFreeMS[t]) {
+            t = i;
+        }
+    }
+    s->threadFreeMS[t] += predictedMS;
+}
+
+void Schedule_EndRun(Schedule *s)
+{
+    uint32 actualMS = SDL_GetTicks() - s->startMS;
+    float predictedMS = 0.0f;
+
+    for (uint i = 0; i < s->numRunners; i++) {
+        predictedMS = MAX(predictedMS, s->threadFreeMS[i]);
+    }
+
+    Warning("Schedule: predicted makespan %.1fs, actual %.1fs\n",
+            predictedMS / 1000.0f, actualMS / 1000.0f);
+    if (s->numTimed > 0) {
+        Warning("Schedule: mean error %.0fms over %d battles\n",
+                s->sumErrorMS / s->numTimed, s->numTimed);
+    }
+
+    free(s->fleetHashes);
+    free(s->isNew);
+    free(s->window);
+    free(s->threadFreeMS);
+    s->fleetHashes = NULL;
+    s->isNew = NULL;
+    s->window = NULL;
+    s->numWindow = 0;
+    s->threadFreeMS = NULL;
+}
+
+/*
+ * Scenario b of the unit test has players 1 and 2 + (b % 2).
+ */
+static uint ScheduleTestSeat(void *cbData, uint bscIndex, uint seat)
+{
+    ASSERT(cbData == NULL);
+    if (seat == 0) {
+        return 0;
+    }
+    return seat == 1 ? 1 : 2 + (bscIndex % 2);
+}
+
+void Schedule_UnitTest(void)
+{
+    BattlePlayer players[4];
+    BattleParams bp;
+    Schedule s;
+    ScheduleItem item;
+
+    MBUtil_Zero(players, sizeof(players));
+    MBUtil_Zero(&bp, sizeof(bp));
+    players[0].aiType = FLEET_AI_NEUTRAL;
+    players[0].playerType = PLAYER_TYPE_NEUTRAL;
+    for (uint i = 1; i < ARRAYSIZE(players); i++) {
+        players[i].aiType = FLEET_AI_SIMPLE + i;
+        players[i].playerType = PLAYER_TYPE_CONTROL;
+    }
+
+    Schedule_Create(&s, FALSE);
+
+    /*
+     * With no history, every scenario is predicted the same, and they
+     * come out in order.
+     */
+    Schedule_BeginRun(&s, &bp, players, ARRAYSIZE(players), 4, 3,
+                      ScheduleTestSeat, NULL, 2);
+    Schedule_BeginLoop(&s);
+    for (uint b = 0; b < 4; b++) {
+        item = Schedule_Next(&s);
+        VERIFY(item.bscIndex == b);
+        VERIFY(item.predictedMS == 0.0f);
+        Schedule_Assign(&s, item.predictedMS);
+    }
+
+    // The odd scenarios are the slow ones.
+    Schedule_Record(&s, 0, 10, 0.0f);
+    Schedule_Record(&s, 1, 100, 0.0f);
+    Schedule_EndRun(&s);
+
+    /*
+     * The next run has learned from the last one, so the slow matchup
+     * goes first, even across the two runs.
+     */
+    Schedule_BeginRun(&s, &bp, players, ARRAYSIZE(players), 4, 3,
+                      ScheduleTestSeat, NULL, 2);
+    Schedule_BeginLoop(&s);
+    item = Schedule_Next(&s);
+    VERIFY(item.bscIndex == 1);
+    VERIFY(item.predictedMS == 100.0f);
+    Schedule_Assign(&s, item.predictedMS);
+    item = Schedule_Next(&s);
+    VERIFY(item.bscIndex == 3);
+    Schedule_Assign(&s, item.predictedMS);
+    item = Schedule_Next(&s);
+    VERIFY(item.bscIndex == 0);
+    VERIFY(item.predictedMS == 10.0f);
+    Schedule_Assign(&s, item.predictedMS);
+    item = Schedule_Next(&s);
+    VERIFY(item.bscIndex == 2);
+    Schedule_Assign(&s, item.predictedMS);
+
+    // Two runners: 100 + 10 on one, and 100 + 10 on the other.
+    VERIFY(MAX(s.threadFreeMS[0], s.threadFreeMS[1]) == 110.0f);
+    Schedule_EndRun(&s);
+
+    Schedule_Destroy(&s);
+}
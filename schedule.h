@@ -0,0 +1,120 @@
+/*
+ * schedule.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCHEDULE_H_202306031020
+#define _SCHEDULE_H_202306031020
+
+#include "MBTypes.h"
+#include "MBAssert.h"
+#include "battleTypes.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * Cost-aware scheduling.
+ *
+ * Each battle's running time is predicted from earlier battles between
+ * the same fleets on the same scenario, falling back to each fleet's
+ * own average and then to the overall average.  The battles in each
+ * loop iteration pass through a window of the next SCHEDULE_WINDOW
+ * scenarios, and the longest one in the window is queued first, so the
+ * long ones don't start at the end of a run while the other threads sit
+ * idle.  The window keeps the memory and sorting bounded when there are
+ * far more scenarios than that, as in big tournaments.  The history
+ * lasts until Schedule_Destroy, so later rounds and stages learn from
+ * earlier ones.
+ *
+ * Scenarios are only known by their index.  The caller's seatFn maps a
+ * scenario and seat to an index into the run's players, and seat 0 is
+ * the neutral player, which doesn't count towards the cost.
+ */
+#define SCHEDULE_WINDOW 1024
+
+typedef uint (*ScheduleSeatFn)(void *cbData, uint bscIndex, uint seat);
+
+typedef struct ScheduleCostEntry {
+    uint64 key;
+    uint count;
+    float meanMS;
+} ScheduleCostEntry;
+
+typedef struct ScheduleItem {
+    uint bscIndex;
+    bool isNew;
+    float predictedMS;
+} ScheduleItem;
+
+typedef struct Schedule {
+    bool preferNew;
+
+    uint numEntries;
+    uint capacity;
+    ScheduleCostEntry *table;
+    uint totalCount;
+    float totalMeanMS;
+
+    /*
+     * For the current run.
+     */
+    ScheduleSeatFn seatFn;
+    void *cbData;
+    uint numSeats;
+    uint numScenarios;
+    uint64 paramsHash;
+    uint64 *fleetHashes;
+    bool *isNew;
+    ScheduleItem *window;
+    uint windowSize;
+    uint numWindow;
+    uint nextScenario;
+    uint numRunners;
+    float *threadFreeMS;
+    uint32 startMS;
+    uint numTimed;
+    float sumErrorMS;
+} Schedule;
+
+/*
+ * With preferNew, battles with a target fleet that hasn't fought yet
+ * are queued ahead of the rest.
+ */
+void Schedule_Create(Schedule *s, bool preferNew);
+void Schedule_Destroy(Schedule *s);
+
+void Schedule_BeginRun(Schedule *s, const BattleParams *bp,
+                       const BattlePlayer *players, uint numPlayers,
+                       uint numScenarios, uint numSeats,
+                       ScheduleSeatFn seatFn, void *cbData,
+                       uint numRunners);
+void Schedule_EndRun(Schedule *s);
+
+void Schedule_BeginLoop(Schedule *s);
+ScheduleItem Schedule_Next(Schedule *s);
+void Schedule_Assign(Schedule *s, float predictedMS);
+void Schedule_Record(Schedule *s, uint bscIndex, uint32 durationMS,
+                     float predictedMS);
+
+void Schedule_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _SCHEDULE_H_202306031020
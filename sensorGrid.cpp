@@ -35,7 +35,8 @@ void SensorGrid::updateTick(FleetAI *ai)
     int trackedEnemyBases = myTargets.getNumTrackedBases();
 
     myLastTick = ai->tick;
-
+    myNeighbors.friendsValid = FALSE;
+    myNeighbors.targetsValid = FALSE;
 
     myFriends.unpin();
     myTargets.unpin();
@@ -127,45 +128,126 @@ void SensorGrid::updateTick(FleetAI *ai)
 }
 
 
+MBVector<Mob *> &SensorGrid::getNeighbors(const FPoint *pos,
+                                          float radiusSquared,
+                                          bool useFriends)
+{
+    MobSet *ms = useFriends ? &myFriends : &myTargets;
+    float cacheRadiusSquared = useFriends ?
+                               myNeighbors.friendRadiusSquared :
+                               myNeighbors.targetRadiusSquared;
+    MBVector<Mob *> *v;
+    bool *valid;
+    MobFilter f;
+
+    MobFilter_Init(&f);
+
+    if (radiusSquared <= 0.0f || radiusSquared > cacheRadiusSquared) {
+        /*
+         * The cache doesn't cover this query, so gather just what
+         * was asked for.
+         */
+        MobFilter_UseRangeSquared(&f, pos, radiusSquared);
+        myNeighbors.uncached.makeEmpty();
+        if (!MobFilter_IsTriviallyEmpty(&f)) {
+            ms->pushMobs(myNeighbors.uncached, &f);
+        }
+        return myNeighbors.uncached;
+    }
+
+    if (myNeighbors.pos.x != pos->x || myNeighbors.pos.y != pos->y) {
+        myNeighbors.pos = *pos;
+        myNeighbors.friendsValid = FALSE;
+        myNeighbors.targetsValid = FALSE;
+    }
+
+    if (useFriends) {
+        v = &myNeighbors.friends;
+        valid = &myNeighbors.friendsValid;
+    } else {
+        v = &myNeighbors.targets;
+        valid = &myNeighbors.targetsValid;
+    }
+
+    if (!*valid) {
+        MobFilter_UseRangeSquared(&f, pos, cacheRadiusSquared);
+        v->makeEmpty();
+        ms->pushMobs(*v, &f);
+        *valid = TRUE;
+    }
+
+    return *v;
+}
+
+
+static uint SensorGridAccumulateFlock(Mob **ma, uint mn,
+                                      FPoint *avgVel, FPoint *avgPos)
+{
+    for (uint x = 0; x < mn; x++) {
+        Mob *m = ma[x];
+        ASSERT(m != NULL);
+
+        avgVel->x += (m->pos.x - m->lastPos.x);
+        avgVel->y += (m->pos.y - m->lastPos.y);
+        avgPos->x += m->pos.x;
+        avgPos->y += m->pos.y;
+    }
+
+    return mn;
+}
+
+
 bool SensorGrid::avgFlock(FPoint *avgVel, FPoint *avgPos,
                           const MobFilter *f, bool useFriends)
 {
     uint n = 0;
-    MobSet::MobIt mit;
     FPoint lAvgVel;
     FPoint lAvgPos;
 
     ASSERT(f != NULL);
 
-    if (useFriends) {
-        mit = myFriends.iterator();
-    } else {
-        mit = myTargets.iterator();
-    }
-
     lAvgVel.x = 0.0f;
     lAvgVel.y = 0.0f;
 
     lAvgPos.x = 0.0f;
     lAvgPos.y = 0.0f;
 
-    if (!MobFilter_IsTriviallyEmpty(f)) {
-        while (mit.hasNext()) {
+    if (MobFilter_IsTriviallyEmpty(f)) {
+        /* Nothing to do. */
+    } else if ((f->filterTypeFlags & MOB_FILTER_TFLAG_RANGE) != 0) {
+        /*
+         * Ranged queries only need to look at the cached neighborhood.
+         */
+        MBVector<Mob *> &v = getNeighbors(&f->rangeF.pos,
+                                          f->rangeF.radiusSquared,
+                                          useFriends);
+        uint i = 0;
+
+        while (i < v.size()) {
             Mob *ma[512];
             uint mn = 0;
-            mit.nextBatch(ma, &mn, ARRAYSIZE(ma));
+
+            while (mn < ARRAYSIZE(ma) && i < v.size()) {
+                ma[mn++] = v[i++];
+            }
             MobFilter_Batch(ma, &mn, f);
+            n += SensorGridAccumulateFlock(ma, mn, &lAvgVel, &lAvgPos);
+        }
+    } else {
+        MobSet::MobIt mit;
 
-            n += mn;
-            for (uint x = 0; x < mn; x++) {
-                Mob *m = ma[x];
-                ASSERT(m != NULL);
+        if (useFriends) {
+            mit = myFriends.iterator();
+        } else {
+            mit = myTargets.iterator();
+        }
 
-                lAvgVel.x += (m->pos.x - m->lastPos.x);
-                lAvgVel.y += (m->pos.y - m->lastPos.y);
-                lAvgPos.x += m->pos.x;
-                lAvgPos.y += m->pos.y;
-            }
+        while (mit.hasNext()) {
+            Mob *ma[512];
+            uint mn = 0;
+            mit.nextBatch(ma, &mn, ARRAYSIZE(ma));
+            MobFilter_Batch(ma, &mn, f);
+            n += SensorGridAccumulateFlock(ma, mn, &lAvgVel, &lAvgPos);
         }
     }
 
@@ -411,7 +493,7 @@ void MappingSensorGrid::generateEnemyBaseGuess()
 }
 
 
-void SensorGrid_Mutate(MBRegistry *mreg, float rate, const char *prefix)
+void SensorGrid_Mutate(Genome *g, float rate, const char *prefix)
 {
     MutationFloatParams vf[] = {
         // key                     min     max       mag   jump   mutation
@@ -423,10 +505,11 @@ void SensorGrid_Mutate(MBRegistry *mreg, float rate, const char *prefix)
 
     VERIFY(strcmp(prefix, "") == 0);
 
-    Mutate_Float(mreg, vf, ARRAYSIZE(vf));
+    Mutate_GenomeFloat(g, vf, ARRAYSIZE(vf));
 
-    Mutate_FloatType(mreg, "sensorGrid.mapping.recentlyScannedResetTicks",
-                     MUTATION_TYPE_TICKS);
-    Mutate_FloatType(mreg, "sensorGrid.mapping.recentlyScannedMoveFocusTicks",
-                     MUTATION_TYPE_TICKS);
+    Mutate_GenomeFloatType(g, "sensorGrid.mapping.recentlyScannedResetTicks",
+                           MUTATION_TYPE_TICKS);
+    Mutate_GenomeFloatType(g,
+                           "sensorGrid.mapping.recentlyScannedMoveFocusTicks",
+                           MUTATION_TYPE_TICKS);
 }
\ No newline at end of file
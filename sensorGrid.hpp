@@ -23,6 +23,7 @@ extern "C" {
 #include "battleTypes.h"
 #include "mob.h"
 #include "MBRegistry.h"
+#include "genome.h"
 #include "Random.h"
 }
 
@@ -37,7 +38,7 @@ extern "C" {
 #define SG_RECENTLY_SCANNED_RESET_TICKS_DEFAULT       2048
 #define SG_RECENTLY_SCANNED_MOVE_FOCUS_TICKS_DEFAULT  2048
 
-void SensorGrid_Mutate(MBRegistry *mreg, float rate, const char *prefix);
+void SensorGrid_Mutate(Genome *g, float rate, const char *prefix);
 
 class SensorGrid
 {
@@ -60,6 +61,13 @@ public:
 
         myStaleCoreTime = SG_STALE_CORE_DEFAULT;
         myStaleFighterTime = SG_STALE_FIGHTER_DEFAULT;
+
+        myNeighbors.pos.x = 0.0f;
+        myNeighbors.pos.y = 0.0f;
+        myNeighbors.friendsValid = FALSE;
+        myNeighbors.targetsValid = FALSE;
+        myNeighbors.friendRadiusSquared = 0.0f;
+        myNeighbors.targetRadiusSquared = 0.0f;
     }
 
     /**
@@ -345,7 +353,65 @@ public:
     bool avgFlock(FPoint *avgVel, FPoint *avgPos,
                   const MobFilter *f, bool useFriends);
 
+    /**
+     * Make the per-tick neighborhood cache cover queries of up to the
+     * specified radius for friends (or targets).
+     *
+     * Fleets call this when they load their config, with the largest
+     * radius any of their flocking forces can ask for.  Radii only
+     * grow, so fleets with several nets can call it for each of them.
+     */
+    void useNeighborRadius(float radius, bool useFriends) {
+        float *radiusSquared = useFriends ?
+                               &myNeighbors.friendRadiusSquared :
+                               &myNeighbors.targetRadiusSquared;
+
+        if (radius > 0.0f && radius * radius > *radiusSquared) {
+            *radiusSquared = radius * radius;
+            myNeighbors.friendsValid = FALSE;
+            myNeighbors.targetsValid = FALSE;
+        }
+    }
+
+    /**
+     * Get the friends (or targets) of any type that are near the
+     * specified point.
+     *
+     * Queries within the radius from useNeighborRadius come from the
+     * per-tick neighborhood cache, which is gathered once per point at
+     * that radius, so the list may contain mobs outside of the requested
+     * radius, and callers must still filter it.  Larger queries are
+     * gathered at the requested radius without being cached.  A radius
+     * of zero or less gives an empty list.
+     *
+     * The returned list is only valid until the next neighbors call.
+     */
+    MBVector<Mob *> &neighbors(const FPoint *pos, float radius,
+                               bool useFriends) {
+        return getNeighbors(pos, radius > 0.0f ? radius * radius : 0.0f,
+                            useFriends);
+    }
+
 private:
+    /*
+     * Flocking forces for a mob tend to be evaluated back-to-back, so
+     * we only cache the neighborhood of the most recent point, and only
+     * gather the side(s) that have been asked for.
+     */
+    struct {
+        FPoint pos;
+        bool friendsValid;
+        bool targetsValid;
+        float friendRadiusSquared;
+        float targetRadiusSquared;
+        MBVector<Mob *> friends;
+        MBVector<Mob *> targets;
+        MBVector<Mob *> uncached;
+    } myNeighbors;
+
+    MBVector<Mob *> &getNeighbors(const FPoint *pos, float radiusSquared,
+                                  bool useFriends);
+
     int myEnemyBaseDestroyedCount;
     Mob myFriendBaseShadow;
 
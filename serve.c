@@ -0,0 +1,552 @@
+/*
+ * serve.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "serve.h"
+#include "MBUtil.h"
+#include "MBDebug.h"
+
+void Serve_Create(Serve *s, const ServeOps *ops, void *cbData)
+{
+    ASSERT(s != NULL);
+    ASSERT(ops != NULL);
+
+    MBUtil_Zero(s, sizeof(*s));
+    s->ops = ops;
+    s->cbData = cbData;
+}
+
+void Serve_Destroy(Serve *s)
+{
+    ASSERT(s->out == NULL);
+
+    for (uint i = 0; i < SERVE_CACHE_SIZE; i++) {
+        if (s->cache[i].file != NULL) {
+            s->ops->freePopulation(s->cbData, s->cache[i].pop);
+            free(s->cache[i].file);
+        }
+    }
+    free(s->scenario);
+    MBUtil_Zero(s, sizeof(*s));
+}
+
+/*
+ * Serve_GetPopulation --
+ *    Load a population file, or reuse the copy from an earlier request
+ *    if the file hasn't changed since.  Returns NULL and sets err if the
+ *    file can't be used.
+ */
+void *Serve_GetPopulation(Serve *s, const char *file, const char **err)
+{
+    ServeCacheEntry *e = NULL;
+    struct stat st;
+
+    if (access(file, R_OK) != 0 || stat(file, &st) != 0) {
+        *err = "cannot read population";
+        return NULL;
+    }
+
+    for (uint i = 0; i < SERVE_CACHE_SIZE; i++) {
+        ServeCacheEntry *c = &s->cache[i];
+        if (c->file != NULL && strcmp(c->file, file) == 0) {
+            e = c;
+            break;
+        }
+        if (e == NULL || c->lastUse < e->lastUse) {
+            e = c;
+        }
+    }
+
+    /*
+     * A rewrite within the same second can keep the same size, so this
+     * compares the full timestamp, and the inode to catch a file that
+     * was replaced by a rename.
+     */
+    e->lastUse = ++s->useCount;
+    if (e->file != NULL && strcmp(e->file, file) == 0 &&
+        e->st.st_dev == st.st_dev && e->st.st_ino == st.st_ino &&
+        e->st.st_mtim.tv_sec == st.st_mtim.tv_sec &&
+        e->st.st_mtim.tv_nsec == st.st_mtim.tv_nsec &&
+        e->st.st_size == st.st_size) {
+        s->hits++;
+        return e->pop;
+    }
+
+    /*
+     * Check the file before evicting anything for it.
+     */
+    *err = s->ops->checkPopulation(s->cbData, file);
+    if (*err != NULL) {
+        return NULL;
+    }
+
+    s->misses++;
+    if (e->file != NULL) {
+        s->ops->freePopulation(s->cbData, e->pop);
+        free(e->file);
+    }
+    e->file = strdup(file);
+    VERIFY(e->file != NULL);
+    e->st = st;
+    e->pop = s->ops->loadPopulation(s->cbData, file);
+    return e->pop;
+}
+
+/*
+ * Serve_ForgetPopulation --
+ *    Drop a population from the cache, after it's been rewritten.
+ */
+void Serve_ForgetPopulation(Serve *s, const char *file)
+{
+    for (uint i = 0; i < SERVE_CACHE_SIZE; i++) {
+        ServeCacheEntry *c = &s->cache[i];
+        if (c->file != NULL && strcmp(c->file, file) == 0) {
+            s->ops->freePopulation(s->cbData, c->pop);
+            free(c->file);
+            MBUtil_Zero(c, sizeof(*c));
+        }
+    }
+}
+
+void Serve_ReportPlayers(Serve *s, const BattlePlayer *players,
+                         uint numPlayers)
+{
+    for (uint i = 0; i < numPlayers; i++) {
+        fprintf(s->out, "player %d %s\n", players[i].playerUID,
+                players[i].playerName);
+    }
+    fflush(s->out);
+}
+
+void Serve_ReportBattle(Serve *s, uint loopIndex, PlayerUID uid1,
+                        PlayerUID uid2, PlayerUID winnerUID, uint tick)
+{
+    fprintf(s->out, "battle %d %d %d %d %d\n",
+            loopIndex, uid1, uid2, winnerUID, tick);
+    fflush(s->out);
+}
+
+/*
+ * Serve_ReportFleet --
+ *    Report one fleet's results.  These come in a batch, so the caller
+ *    flushes them with Serve_Flush.
+ */
+void Serve_ReportFleet(Serve *s, const BattlePlayer *player, uint battles,
+                       uint wins, uint losses, uint draws)
+{
+    fprintf(s->out, "fleet %d %d %d %d %d %s\n",
+            player->playerUID, battles, wins, losses, draws,
+            player->playerName);
+}
+
+void Serve_Flush(Serve *s)
+{
+    fflush(s->out);
+}
+
+/*
+ * ServeParseLoop --
+ *    Parse the number of loops for a request, which must be positive.
+ */
+static bool ServeParseLoop(const char *str, uint *loop)
+{
+    char *end = NULL;
+    unsigned long value;
+
+    if (!isdigit(str[0])) {
+        return FALSE;
+    }
+
+    errno = 0;
+    value = strtoul(str, &end, 10);
+    if (errno != 0 || *end != '\0' || value == 0 || value > MAX_INT32) {
+        return FALSE;
+    }
+
+    *loop = value;
+    return TRUE;
+}
+
+/*
+ * ServeRequest --
+ *    Handle one request line.  Returns FALSE if the server should stop.
+ *    Bad requests get an error reply rather than stopping the server.
+ */
+static bool ServeRequest(Serve *s, char *line)
+{
+    char *argv[5];
+    uint argc = 0;
+    char *save = NULL;
+    const char *err = NULL;
+    uint loop = 0;
+
+    for (char *tok = strtok_r(line, " \t\r\n", &save);
+         tok != NULL && argc < ARRAYSIZE(argv);
+         tok = strtok_r(NULL, " \t\r\n", &save)) {
+        argv[argc++] = tok;
+    }
+
+    if (argc == 0) {
+        return TRUE;
+    }
+
+    if (strcmp(argv[0], "quit") == 0) {
+        fprintf(s->out, "done\n");
+        fflush(s->out);
+        return FALSE;
+    } else if (strcmp(argv[0], "scenario") == 0 && argc == 2) {
+        if (strchr(argv[1], '/') != NULL ||
+            !s->ops->scenarioExists(s->cbData, argv[1])) {
+            err = "unknown scenario";
+        } else {
+            free(s->scenario);
+            s->scenario = strdup(argv[1]);
+            VERIFY(s->scenario != NULL);
+            s->ops->setScenario(s->cbData, s->scenario);
+        }
+    } else if (strcmp(argv[0], "measure") == 0 && argc == 4) {
+        if (!ServeParseLoop(argv[3], &loop)) {
+            err = "bad loop count";
+        } else {
+            err = s->ops->measure(s->cbData, argv[1], argv[2], loop);
+        }
+    } else if (strcmp(argv[0], "tournament") == 0 && argc == 3) {
+        if (!ServeParseLoop(argv[2], &loop)) {
+            err = "bad loop count";
+        } else {
+            err = s->ops->tournament(s->cbData, argv[1], loop);
+        }
+    } else if (strcmp(argv[0], "pair") == 0 && argc == 4) {
+        if (!ServeParseLoop(argv[3], &loop)) {
+            err = "bad loop count";
+        } else {
+            err = s->ops->pair(s->cbData, argv[1], argv[2], loop);
+        }
+    } else {
+        err = "bad request";
+    }
+
+    if (err != NULL) {
+        fprintf(s->out, "error %s\n", err);
+    } else {
+        fprintf(s->out, "done\n");
+    }
+    fflush(s->out);
+    return TRUE;
+}
+
+/*
+ * Serve_Run --
+ *    Listen on path and handle requests, one connection at a time,
+ *    until a client asks us to quit.
+ */
+void Serve_Run(Serve *s, const char *path)
+{
+    struct sockaddr_un addr;
+    bool running = TRUE;
+    int listenFd;
+
+    MBUtil_Zero(&addr, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    VERIFY(strlen(path) < sizeof(addr.sun_path));
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    VERIFY(listenFd >= 0);
+    unlink(path);
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listenFd, 4) != 0) {
+        PANIC("Cannot listen on %s\n", path);
+    }
+
+    /*
+     * A client that goes away mid-request shouldn't take the server
+     * with it.
+     */
+    signal(SIGPIPE, SIG_IGN);
+
+    Warning("Serving on %s\n", path);
+
+    while (running) {
+        char *line = NULL;
+        size_t lineLen = 0;
+        FILE *in;
+        int fd;
+
+        fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            VERIFY(errno == EINTR || errno == ECONNABORTED);
+            continue;
+        }
+
+        in = fdopen(fd, "r");
+        s->out = fdopen(dup(fd), "w");
+        VERIFY(in != NULL && s->out != NULL);
+
+        while (running && getline(&line, &lineLen, in) > 0) {
+            running = ServeRequest(s, line);
+        }
+
+        fclose(s->out);
+        fclose(in);
+        s->out = NULL;
+        free(line);
+
+        if (s->scenario != NULL) {
+            s->ops->setScenario(s->cbData, NULL);
+            free(s->scenario);
+            s->scenario = NULL;
+        }
+    }
+
+    Warning("Population cache: %d hits, %d misses\n", s->hits, s->misses);
+
+    close(listenFd);
+    unlink(path);
+}
+
+typedef struct ServeTestData {
+    const char *scenario;
+    uint numLoads;
+    uint numLive;
+    uint lastLoop;
+    const char *lastPair[2];
+} ServeTestData;
+
+static bool ServeTestScenarioExists(void *cbData, const char *scenario)
+{
+    return strcmp(scenario, "missing") != 0;
+}
+
+static void ServeTestSetScenario(void *cbData, const char *scenario)
+{
+    ServeTestData *td = cbData;
+    td->scenario = scenario;
+}
+
+static const char *ServeTestMeasure(void *cbData, const char *file,
+                                    const char *controlFile, uint loop)
+{
+    ServeTestData *td = cbData;
+    td->lastLoop = loop;
+    return "measure failed";
+}
+
+static const char *ServeTestTournament(void *cbData, const char *file,
+                                       uint loop)
+{
+    ServeTestData *td = cbData;
+    td->lastLoop = loop;
+    return NULL;
+}
+
+static const char *ServeTestPair(void *cbData, const char *fleet1,
+                                 const char *fleet2, uint loop)
+{
+    ServeTestData *td = cbData;
+    td->lastLoop = loop;
+    td->lastPair[0] = fleet1;
+    td->lastPair[1] = fleet2;
+    return NULL;
+}
+
+static const char *ServeTestCheckPopulation(void *cbData, const char *file)
+{
+    return NULL;
+}
+
+static void *ServeTestLoadPopulation(void *cbData, const char *file)
+{
+    ServeTestData *td = cbData;
+    uint *pop = malloc(sizeof(*pop));
+    VERIFY(pop != NULL);
+    *pop = ++td->numLoads;
+    td->numLive++;
+    return pop;
+}
+
+static void ServeTestFreePopulation(void *cbData, void *pop)
+{
+    ServeTestData *td = cbData;
+    ASSERT(td->numLive > 0);
+    td->numLive--;
+    free(pop);
+}
+
+static const ServeOps gServeTestOps = {
+    ServeTestScenarioExists,
+    ServeTestSetScenario,
+    ServeTestMeasure,
+    ServeTestTournament,
+    ServeTestPair,
+    ServeTestCheckPopulation,
+    ServeTestLoadPopulation,
+    ServeTestFreePopulation,
+};
+
+/*
+ * ServeTestRequest --
+ *    Run one request, and check its reply.
+ */
+static bool ServeTestRequest(Serve *s, const char *request,
+                             const char *reply)
+{
+    char line[128];
+    char buf[128];
+    bool running;
+
+    VERIFY(strlen(request) < sizeof(line));
+    strcpy(line, request);
+
+    s->out = tmpfile();
+    VERIFY(s->out != NULL);
+    running = ServeRequest(s, line);
+
+    rewind(s->out);
+    if (reply == NULL) {
+        VERIFY(fgets(buf, sizeof(buf), s->out) == NULL);
+    } else {
+        VERIFY(fgets(buf, sizeof(buf), s->out) != NULL);
+        VERIFY(strcmp(buf, reply) == 0);
+    }
+    fclose(s->out);
+    s->out = NULL;
+    return running;
+}
+
+static void ServeTestWrite(const char *file, const char *contents,
+                           long nsec)
+{
+    struct timespec times[2];
+    FILE *f = fopen(file, "w");
+
+    VERIFY(f != NULL);
+    VERIFY(fputs(contents, f) >= 0);
+    VERIFY(fclose(f) == 0);
+
+    times[0].tv_sec = 1000000;
+    times[0].tv_nsec = nsec;
+    times[1] = times[0];
+    VERIFY(utimensat(AT_FDCWD, file, times, 0) == 0);
+}
+
+void Serve_UnitTest(void)
+{
+    char file[] = "/tmp/sr2ServeTestXXXXXX";
+    char *tmpFile = NULL;
+    ServeTestData td;
+    const char *err = NULL;
+    uint *pop;
+    Serve s;
+    int oldFd;
+    int fd;
+
+    MBUtil_Zero(&td, sizeof(td));
+    Serve_Create(&s, &gServeTestOps, &td);
+
+    /*
+     * Request parsing.
+     */
+    VERIFY(ServeTestRequest(&s, "\n", NULL));
+    VERIFY(ServeTestRequest(&s, "bogus 1 2\n", "error bad request\n"));
+    VERIFY(ServeTestRequest(&s, "pair a b\n", "error bad request\n"));
+    VERIFY(ServeTestRequest(&s, "pair a b 0\n", "error bad loop count\n"));
+    VERIFY(ServeTestRequest(&s, "pair a b -3\n", "error bad loop count\n"));
+    VERIFY(ServeTestRequest(&s, "pair a b 3x\n", "error bad loop count\n"));
+    VERIFY(ServeTestRequest(&s, "tournament - 4294967296\n",
+                            "error bad loop count\n"));
+    VERIFY(td.lastLoop == 0);
+
+    VERIFY(ServeTestRequest(&s, "pair alpha beta 12\r\n", "done\n"));
+    VERIFY(td.lastLoop == 12);
+    VERIFY(td.lastPair[0] != NULL && td.lastPair[1] != NULL);
+    VERIFY(ServeTestRequest(&s, "tournament -  7\n", "done\n"));
+    VERIFY(td.lastLoop == 7);
+    VERIFY(ServeTestRequest(&s, "measure t c 5\n",
+                            "error measure failed\n"));
+    VERIFY(td.lastLoop == 5);
+
+    VERIFY(ServeTestRequest(&s, "scenario missing\n",
+                            "error unknown scenario\n"));
+    VERIFY(ServeTestRequest(&s, "scenario ../x\n",
+                            "error unknown scenario\n"));
+    VERIFY(td.scenario == NULL);
+    VERIFY(ServeTestRequest(&s, "scenario duel\n", "done\n"));
+    VERIFY(td.scenario != NULL && strcmp(td.scenario, "duel") == 0);
+
+    VERIFY(!ServeTestRequest(&s, "quit\n", "done\n"));
+
+    /*
+     * The population cache.
+     */
+    fd = mkstemp(file);
+    VERIFY(fd >= 0);
+    close(fd);
+
+    VERIFY(Serve_GetPopulation(&s, "/nonexistent/sr2", &err) == NULL);
+    VERIFY(err != NULL);
+
+    ServeTestWrite(file, "aaaa", 100);
+    pop = Serve_GetPopulation(&s, file, &err);
+    VERIFY(pop != NULL && *pop == 1);
+    pop = Serve_GetPopulation(&s, file, &err);
+    VERIFY(pop != NULL && *pop == 1);
+    VERIFY(s.hits == 1 && s.misses == 1);
+
+    /*
+     * A same-size rewrite in the same second is still a miss.
+     */
+    ServeTestWrite(file, "bbbb", 200);
+    pop = Serve_GetPopulation(&s, file, &err);
+    VERIFY(pop != NULL && *pop == 2);
+    VERIFY(td.numLive == 1);
+
+    /*
+     * So is a same-size file renamed into place with the same timestamp.
+     * Holding the old file open keeps its inode from being reused.
+     */
+    VERIFY(asprintf(&tmpFile, "%s.tmp", file) > 0);
+    oldFd = open(file, O_RDONLY);
+    VERIFY(oldFd >= 0);
+    ServeTestWrite(tmpFile, "cccc", 200);
+    VERIFY(rename(tmpFile, file) == 0);
+    pop = Serve_GetPopulation(&s, file, &err);
+    VERIFY(pop != NULL && *pop == 3);
+    close(oldFd);
+    VERIFY(s.hits == 1 && s.misses == 3);
+
+    Serve_ForgetPopulation(&s, file);
+    VERIFY(td.numLive == 0);
+    pop = Serve_GetPopulation(&s, file, &err);
+    VERIFY(pop != NULL && *pop == 4);
+
+    Serve_Destroy(&s);
+    VERIFY(td.numLive == 0);
+
+    unlink(file);
+    free(tmpFile);
+}
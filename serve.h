@@ -0,0 +1,143 @@
+/*
+ * serve.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SERVE_H_202306031620
+#define _SERVE_H_202306031620
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "MBTypes.h"
+#include "MBAssert.h"
+#include "battleTypes.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * The serve command: a long-running process that takes batches of
+ * battles over a UNIX socket, keeping the engine threads, the result
+ * cache, and recently used populations loaded between requests.
+ *
+ * The protocol is line-based.  Each request is one line:
+ *
+ *    scenario <name>                         (for later requests)
+ *    measure <targetFile> <controlFile> <loop>
+ *    tournament <file|-> <loop>
+ *    pair <fleetName> <fleetName> <loop>
+ *    quit
+ *
+ * and results are streamed back as they come in:
+ *
+ *    player <uid> <name>
+ *    battle <loopIndex> <uid1> <uid2> <winnerUID> <tick>
+ *    fleet <uid> <battles> <wins> <losses> <draws> <name>
+ *
+ * followed by "done", or "error <message>" if the request failed.
+ * measure writes the measured fleets back to targetFile, like the
+ * measure command does.
+ *
+ * This module owns the socket, the protocol and the population cache;
+ * the requests themselves are run by the caller's ServeOps.
+ */
+#define SERVE_DEFAULT_SOCKET "build/tmp/sr2.sock"
+#define SERVE_CACHE_SIZE     8
+
+typedef struct ServeOps {
+    /*
+     * Scenarios are per-connection.  setScenario is called with NULL
+     * to go back to the default when a connection closes.
+     */
+    bool (*scenarioExists)(void *cbData, const char *scenario);
+    void (*setScenario)(void *cbData, const char *scenario);
+
+    /*
+     * The requests, which return an error message, or NULL if they
+     * succeeded.
+     */
+    const char *(*measure)(void *cbData, const char *file,
+                           const char *controlFile, uint loop);
+    const char *(*tournament)(void *cbData, const char *file, uint loop);
+    const char *(*pair)(void *cbData, const char *fleet1,
+                        const char *fleet2, uint loop);
+
+    /*
+     * For the population cache.  checkPopulation returns what's wrong
+     * with a file, or NULL, so that a bad file fails the request instead
+     * of the server.
+     */
+    const char *(*checkPopulation)(void *cbData, const char *file);
+    void *(*loadPopulation)(void *cbData, const char *file);
+    void (*freePopulation)(void *cbData, void *pop);
+} ServeOps;
+
+typedef struct ServeCacheEntry {
+    char *file;
+    struct stat st;
+    uint64 lastUse;
+    void *pop;
+} ServeCacheEntry;
+
+typedef struct Serve {
+    const ServeOps *ops;
+    void *cbData;
+
+    /*
+     * The current connection, if there is one.
+     */
+    FILE *out;
+    char *scenario;
+
+    uint64 useCount;
+    ServeCacheEntry cache[SERVE_CACHE_SIZE];
+    uint hits;
+    uint misses;
+} Serve;
+
+void Serve_Create(Serve *s, const ServeOps *ops, void *cbData);
+void Serve_Destroy(Serve *s);
+
+void Serve_Run(Serve *s, const char *path);
+
+void *Serve_GetPopulation(Serve *s, const char *file, const char **err);
+void Serve_ForgetPopulation(Serve *s, const char *file);
+
+/*
+ * Whether there's a client to report results to.
+ */
+static inline bool Serve_IsConnected(const Serve *s)
+{
+    return s->out != NULL;
+}
+
+void Serve_ReportPlayers(Serve *s, const BattlePlayer *players,
+                         uint numPlayers);
+void Serve_ReportBattle(Serve *s, uint loopIndex, PlayerUID uid1,
+                        PlayerUID uid2, PlayerUID winnerUID, uint tick);
+void Serve_ReportFleet(Serve *s, const BattlePlayer *player, uint battles,
+                       uint wins, uint losses, uint draws);
+void Serve_Flush(Serve *s);
+
+void Serve_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _SERVE_H_202306031620
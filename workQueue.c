@@ -16,203 +16,452 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL_thread.h>
+
 #include "workQueue.h"
+#include "MBUtil.h"
+
+#define WORK_QUEUE_INITIAL_CAPACITY 16
+
+static WorkQueueBuffer *WorkQueueAllocBuffer(WorkQueue *wq, uint capacity)
+{
+    WorkQueueBuffer *buf = malloc(sizeof(*buf));
+    VERIFY(buf != NULL);
+
+    ASSERT((capacity & (capacity - 1)) == 0);
+    buf->retired = NULL;
+    buf->capacity = capacity;
+    buf->items = malloc((size_t)capacity * wq->itemSize);
+    VERIFY(buf->items != NULL);
+    return buf;
+}
 
-void WorkQueue_Create(WorkQueue *wq, uint itemSize)
+static inline uint8 *WorkQueueSlotItem(WorkQueue *wq, WorkQueueBuffer *buf,
+                                       int i)
+{
+    return &buf->items[(size_t)(i & (buf->capacity - 1)) * wq->itemSize];
+}
+
+void WorkQueue_Create(WorkQueue *wq, uint itemSize, uint numSlots)
 {
     ASSERT(wq != NULL);
-    MBUtil_Zero(wq, sizeof(wq));
+    MBUtil_Zero(wq, sizeof(*wq));
 
     ASSERT(itemSize != 0);
+    ASSERT(numSlots != 0);
 
     wq->itemSize = itemSize;
+    wq->numSlots = numSlots;
     SDL_AtomicSet(&wq->numQueued, 0);
     SDL_AtomicSet(&wq->numInProgress, 0);
+    SDL_AtomicSet(&wq->numFinished, 0);
+    SDL_AtomicSet(&wq->numSleeping, 0);
     SDL_AtomicSet(&wq->finishWaitingCount, 0);
-    SDL_AtomicSet(&wq->anyFinishWaitingCount, 0);
 
-    MBRing_Create(&wq->items, itemSize);
+    /*
+     * Keep each deque on its own cache lines, so that stealing from
+     * one doesn't bounce the others around.
+     */
+    wq->slots = aligned_alloc(WORK_QUEUE_CACHE_LINE,
+                              numSlots * sizeof(wq->slots[0]));
+    VERIFY(wq->slots != NULL);
+    MBUtil_Zero(wq->slots, numSlots * sizeof(wq->slots[0]));
+
+    wq->lanes = aligned_alloc(WORK_QUEUE_CACHE_LINE,
+                              numSlots * numSlots * sizeof(wq->lanes[0]));
+    VERIFY(wq->lanes != NULL);
+    MBUtil_Zero(wq->lanes, numSlots * numSlots * sizeof(wq->lanes[0]));
+
+    for (uint i = 0; i < numSlots * numSlots; i++) {
+        WorkQueueDeque *d = &wq->lanes[i];
+        SDL_AtomicSet(&d->top, 0);
+        SDL_AtomicSet(&d->bottom, 0);
+        SDL_AtomicSetPtr(&d->buffer, NULL);
+    }
+
+    for (uint i = 0; i < numSlots; i++) {
+        WorkQueueSlot *s = &wq->slots[i];
+        s->lanes = &wq->lanes[i * numSlots];
+        s->nextLane = i;
+        s->nextVictim = i;
+    }
 
-    MBLock_Create(&wq->lock);
     wq->workerSem = SDL_CreateSemaphore(0);
     wq->finishSem = SDL_CreateSemaphore(0);
-    wq->anyFinishSem = SDL_CreateSemaphore(0);
 }
 
 void WorkQueue_Destroy(WorkQueue *wq)
 {
     ASSERT(wq->itemSize != 0);
     ASSERT(SDL_AtomicGet(&wq->finishWaitingCount) == 0);
-    ASSERT(SDL_AtomicGet(&wq->anyFinishWaitingCount) == 0);
+    ASSERT(SDL_AtomicGet(&wq->numSleeping) == 0);
+
+    for (uint i = 0; i < wq->numSlots; i++) {
+        ASSERT(!wq->slots[i].inBatch);
+    }
+
+    for (uint i = 0; i < wq->numSlots * wq->numSlots; i++) {
+        WorkQueueBuffer *buf = SDL_AtomicGetPtr(&wq->lanes[i].buffer);
+
+        while (buf != NULL) {
+            WorkQueueBuffer *next = buf->retired;
+            free(buf->items);
+            free(buf);
+            buf = next;
+        }
+    }
+    free(wq->lanes);
+    free(wq->slots);
+    wq->lanes = NULL;
+    wq->slots = NULL;
 
-    MBRing_Destroy(&wq->items);
-    MBLock_Destroy(&wq->lock);
     SDL_DestroySemaphore(wq->workerSem);
     SDL_DestroySemaphore(wq->finishSem);
-    SDL_DestroySemaphore(wq->anyFinishSem);
 
     wq->workerSem = NULL;
     wq->finishSem = NULL;
-    wq->anyFinishSem = NULL;
 }
 
-void WorkQueue_QueueItem(WorkQueue *wq, void *item, uint itemSize)
+void WorkQueue_SetSpinCount(WorkQueue *wq, uint spinCount)
 {
-    WorkQueue_Lock(wq);
-    WorkQueue_QueueItemLocked(wq, item, itemSize);
-    WorkQueue_Unlock(wq);
+    wq->spinCount = spinCount;
 }
 
+/*
+ * WorkQueueTryDecrement --
+ *    Decrement a count if it's positive, returning whether it was.
+ */
+static bool WorkQueueTryDecrement(SDL_atomic_t *a)
+{
+    while (TRUE) {
+        int x = SDL_AtomicGet(a);
+        if (x <= 0) {
+            return FALSE;
+        }
+        if (SDL_AtomicCAS(a, x, x - 1)) {
+            return TRUE;
+        }
+    }
+}
 
-void WorkQueue_QueueItemLocked(WorkQueue *wq, void *item, uint itemSize)
+/*
+ * WorkQueuePublish --
+ *    Make count new items visible to the consumers, and wake up
+ *    anybody that's parked waiting for them.
+ */
+static void WorkQueuePublish(WorkQueue *wq, WorkQueueDeque *d, int bottom,
+                             uint count)
 {
-    ASSERT(wq != NULL);
-    ASSERT(MBLock_IsLocked(&wq->lock));
+    int old;
 
-    ASSERT(wq->itemSize == itemSize);
-    uint numQueued = SDL_AtomicGet(&wq->numQueued);
+    /*
+     * Count the items before they're visible, so a consumer never sees
+     * numQueued go negative.
+     *
+     * SDL_AtomicAdd is a full barrier, which pairs with the numSleeping
+     * increment in WorkQueue_WaitForItem: either we see the sleeper
+     * below, or it sees the new items before it parks.
+     */
+    SDL_AtomicAdd(&wq->numQueued, count);
+    old = SDL_AtomicAdd(&d->bottom, count);
+    ASSERT(old + (int)count == bottom);
 
-    MBRing_InsertTail(&wq->items, item, itemSize);
-    numQueued++;
-    ASSERT(MBRing_Size(&wq->items) == numQueued);
+    for (uint i = 0; i < count; i++) {
+        if (!WorkQueueTryDecrement(&wq->numSleeping)) {
+            break;
+        }
+        SDL_SemPost(wq->workerSem);
+    }
+}
+
+/*
+ * WorkQueueNextLane --
+ *    Pick the lane for the next batched item, dealing them out
+ *    round-robin to everybody but ourselves.
+ */
+static uint WorkQueueNextLane(WorkQueue *wq, uint slot)
+{
+    WorkQueueSlot *s = &wq->slots[slot];
 
-    SDL_AtomicSet(&wq->numQueued, numQueued);
+    if (wq->numSlots == 1) {
+        return slot;
+    }
 
-    int res = SDL_SemPost(wq->workerSem);
-    ASSERT(res == 0);
+    do {
+        s->nextLane = (s->nextLane + 1) % wq->numSlots;
+    } while (s->nextLane == slot);
+
+    return s->nextLane;
 }
 
-static void WorkQueueGetItemLocked(WorkQueue *wq, void *item, uint itemSize,
-                                   bool useSemaphore)
+void WorkQueue_QueueItem(WorkQueue *wq, uint slot, void *item, uint itemSize)
 {
-    ASSERT(wq != NULL);
-    ASSERT(MBLock_IsLocked(&wq->lock));
-
-    uint numQueued = SDL_AtomicGet(&wq->numQueued);
+    WorkQueueSlot *s;
+    WorkQueueDeque *d;
+    WorkQueueBuffer *buf;
+    int b, t;
 
+    ASSERT(wq != NULL);
     ASSERT(wq->itemSize == itemSize);
-    ASSERT(numQueued > 0);
+    ASSERT(slot < wq->numSlots);
+
+    s = &wq->slots[slot];
+    d = &s->lanes[s->inBatch ? WorkQueueNextLane(wq, slot) : slot];
+    buf = SDL_AtomicGetPtr(&d->buffer);
+    b = s->inBatch ? d->batchBottom : SDL_AtomicGet(&d->bottom);
+    t = SDL_AtomicGet(&d->top);
 
-    if (useSemaphore) {
+    if (buf == NULL) {
         /*
-         * Keep the semaphore synced, if we didn't already decrement it.
+         * Nobody reads the buffer until bottom moves past top, which
+         * only happens after it's published below.
          */
-        ASSERT(SDL_SemValue(wq->workerSem) > 0);
-        int res = SDL_SemWait(wq->workerSem);
-        ASSERT(res == 0);
+        buf = WorkQueueAllocBuffer(wq, WORK_QUEUE_INITIAL_CAPACITY);
+        SDL_AtomicSetPtr(&d->buffer, buf);
+    } else if (b - t >= (int)buf->capacity - 1) {
+        /*
+         * Grow the buffer.  Thieves may still be reading the old one,
+         * so it's retired rather than freed.
+         */
+        WorkQueueBuffer *newBuf = WorkQueueAllocBuffer(wq, 2 * buf->capacity);
+        for (int i = t; i < b; i++) {
+            memcpy(WorkQueueSlotItem(wq, newBuf, i),
+                   WorkQueueSlotItem(wq, buf, i), itemSize);
+        }
+        newBuf->retired = buf;
+        SDL_AtomicSetPtr(&d->buffer, newBuf);
+        buf = newBuf;
     }
 
-    MBRing_RemoveHead(&wq->items, item, itemSize);
-    numQueued--;
-    ASSERT(MBRing_Size(&wq->items) == numQueued);
-
-    SDL_AtomicSet(&wq->numQueued, numQueued);
+    memcpy(WorkQueueSlotItem(wq, buf, b), item, itemSize);
+    b++;
 
-    SDL_AtomicIncRef(&wq->numInProgress);
+    if (s->inBatch) {
+        d->batchBottom = b;
+    } else {
+        WorkQueuePublish(wq, d, b, 1);
+    }
 }
 
-void WorkQueue_GetItemLocked(WorkQueue *wq, void *item, uint itemSize)
+void WorkQueue_BeginBatch(WorkQueue *wq, uint slot)
 {
-    WorkQueueGetItemLocked(wq, item, itemSize, TRUE);
-}
+    WorkQueueSlot *s;
 
-void WorkQueue_WaitForItem(WorkQueue *wq, void *item, uint itemSize)
-{
-    int res = SDL_SemWait(wq->workerSem);
-    ASSERT(res == 0);
+    ASSERT(slot < wq->numSlots);
+    s = &wq->slots[slot];
 
-    WorkQueue_Lock(wq);
-    WorkQueueGetItemLocked(wq, item, itemSize, FALSE);
-    WorkQueue_Unlock(wq);
+    ASSERT(!s->inBatch);
+    s->inBatch = TRUE;
+    for (uint i = 0; i < wq->numSlots; i++) {
+        WorkQueueDeque *d = &s->lanes[i];
+        d->batchBottom = SDL_AtomicGet(&d->bottom);
+    }
 }
 
-void WorkQueue_FinishItem(WorkQueue *wq)
+void WorkQueue_EndBatch(WorkQueue *wq, uint slot)
 {
-    bool pEmpty;
-    bool doLock = FALSE;
+    WorkQueueSlot *s;
 
-    pEmpty = SDL_AtomicDecRef(&wq->numInProgress);
+    ASSERT(slot < wq->numSlots);
+    s = &wq->slots[slot];
 
-    if (pEmpty || SDL_AtomicGet(&wq->anyFinishWaitingCount) > 0) {
-        doLock = TRUE;
+    ASSERT(s->inBatch);
+    s->inBatch = FALSE;
+
+    for (uint i = 0; i < wq->numSlots; i++) {
+        WorkQueueDeque *d = &s->lanes[i];
+        int count = d->batchBottom - SDL_AtomicGet(&d->bottom);
+        ASSERT(count >= 0);
+        if (count > 0) {
+            WorkQueuePublish(wq, d, d->batchBottom, count);
+        }
     }
+}
 
-    if (doLock) {
-        WorkQueue_Lock(wq);
-        ASSERT(SDL_AtomicGet(&wq->numInProgress) >= 0);
+/*
+ * WorkQueuePop --
+ *    Take the newest item off our own deque.
+ */
+static bool WorkQueuePop(WorkQueue *wq, WorkQueueDeque *d, void *item)
+{
+    WorkQueueBuffer *buf = SDL_AtomicGetPtr(&d->buffer);
+    bool success = TRUE;
+    int b, t;
 
-        if (SDL_AtomicGet(&wq->anyFinishWaitingCount) > 0) {
-            SDL_AtomicDecRef(&wq->anyFinishWaitingCount);
-            SDL_SemPost(wq->anyFinishSem);
-        }
+    /*
+     * SDL_AtomicAdd is a full barrier, which keeps the read of top
+     * below from moving ahead of the write to bottom.
+     */
+    b = SDL_AtomicAdd(&d->bottom, -1) - 1;
+    t = SDL_AtomicGet(&d->top);
 
-        if (WorkQueue_IsIdle(wq) &&
-            SDL_AtomicGet(&wq->finishWaitingCount) > 0) {
-            SDL_AtomicDecRef(&wq->finishWaitingCount);
-            SDL_SemPost(wq->finishSem);
-        }
+    if (t > b) {
+        // It was already empty.
+        SDL_AtomicSet(&d->bottom, b + 1);
+        return FALSE;
+    }
+
+    memcpy(item, WorkQueueSlotItem(wq, buf, b), wq->itemSize);
 
-        WorkQueue_Unlock(wq);
+    if (t == b) {
+        // This was the last item, so race the thieves for it.
+        success = SDL_AtomicCAS(&d->top, t, t + 1);
+        SDL_AtomicSet(&d->bottom, b + 1);
     }
+
+    return success;
 }
 
-void WorkQueue_WaitForAnyFinished(WorkQueue *wq)
+/*
+ * WorkQueueSteal --
+ *    Take the oldest item off somebody else's deque.
+ */
+static bool WorkQueueSteal(WorkQueue *wq, WorkQueueDeque *d, void *item)
 {
-    bool wait = FALSE;
-    ASSERT(wq != NULL);
+    WorkQueueBuffer *buf;
+    int t, b;
+
+    t = SDL_AtomicGet(&d->top);
+    SDL_MemoryBarrierAcquire();
+    b = SDL_AtomicGet(&d->bottom);
+
+    if (t >= b) {
+        return FALSE;
+    }
 
     /*
-     * We don't properly support multi-waiters.
+     * If the owner has since wrapped around and overwritten this item,
+     * then top has moved too, and the CAS will fail.
      */
-    ASSERT(SDL_AtomicGet(&wq->anyFinishWaitingCount) == 0);
+    buf = SDL_AtomicGetPtr(&d->buffer);
+    memcpy(item, WorkQueueSlotItem(wq, buf, t), wq->itemSize);
+
+    return SDL_AtomicCAS(&d->top, t, t + 1);
+}
+
+bool WorkQueue_TryGetItem(WorkQueue *wq, uint slot, void *item,
+                          uint itemSize)
+{
+    bool found = FALSE;
+
+    ASSERT(wq->itemSize == itemSize);
+    ASSERT(slot < wq->numSlots);
+
+    if (SDL_AtomicGet(&wq->numQueued) <= 0) {
+        return FALSE;
+    }
+
+    WorkQueueSlot *s = &wq->slots[slot];
+    if (!s->inBatch) {
+        found = WorkQueuePop(wq, &s->lanes[slot], item);
+    }
+
+    // Then whatever the other slots queued for us.
+    for (uint i = 1; !found && i < wq->numSlots; i++) {
+        uint producer = (slot + i) % wq->numSlots;
+        found = WorkQueueSteal(wq, &wq->slots[producer].lanes[slot], item);
+    }
 
     /*
-     * If nothing is queued or in-progress, don't wait.
+     * Only then steal somebody else's share, starting with a different
+     * victim each time so the thieves don't all pile onto the same one.
      */
-    if (WorkQueue_IsIdle(wq)) {
-        return;
+    if (!found && wq->numSlots > 1) {
+        s->nextVictim = (s->nextVictim + 1) % wq->numSlots;
+        if (s->nextVictim == slot) {
+            s->nextVictim = (s->nextVictim + 1) % wq->numSlots;
+        }
+    }
+    for (uint i = 0; !found && i < wq->numSlots; i++) {
+        uint victim = (s->nextVictim + i) % wq->numSlots;
+        if (victim == slot) {
+            continue;
+        }
+        for (uint p = 0; !found && p < wq->numSlots; p++) {
+            uint producer = (victim + p) % wq->numSlots;
+            found = WorkQueueSteal(wq, &wq->slots[producer].lanes[victim],
+                                   item);
+        }
     }
 
-    WorkQueue_Lock(wq);
-    if (!WorkQueue_IsIdle(wq)) {
-        SDL_AtomicIncRef(&wq->anyFinishWaitingCount);
-        wait = TRUE;
+    if (found) {
+        /*
+         * Count it as in progress first, so the queue never looks idle
+         * while it's still around.
+         */
+        SDL_AtomicIncRef(&wq->numInProgress);
+        SDL_AtomicDecRef(&wq->numQueued);
     }
-    WorkQueue_Unlock(wq);
 
-    if (wait) {
-        int error = SDL_SemWait(wq->anyFinishSem);
-        if (error != 0) {
+    return found;
+}
+
+void WorkQueue_WaitForItem(WorkQueue *wq, uint slot, void *item,
+                           uint itemSize)
+{
+    while (TRUE) {
+        for (uint i = 0; i <= wq->spinCount; i++) {
+            if (WorkQueue_TryGetItem(wq, slot, item, itemSize)) {
+                return;
+            }
+        }
+
+        SDL_AtomicIncRef(&wq->numSleeping);
+        if (!WorkQueue_IsEmpty(wq)) {
+            /*
+             * Something showed up while we were getting ready to park.
+             * If a producer already claimed our wake-up, consume it.
+             */
+            if (!WorkQueueTryDecrement(&wq->numSleeping)) {
+                SDL_SemWait(wq->workerSem);
+            }
+            continue;
+        }
+
+        int res = SDL_SemWait(wq->workerSem);
+        if (res != 0) {
             PANIC("Failed to wait for WorkQueue: %s\n", SDL_GetError());
         }
     }
 }
 
-void WorkQueue_WaitForAllFinished(WorkQueue *wq)
+void WorkQueue_FinishItem(WorkQueue *wq)
 {
-    bool wait = FALSE;
-    ASSERT(wq != NULL);
+    int old = SDL_AtomicAdd(&wq->numInProgress, -1);
+    ASSERT(old > 0);
+
+    SDL_AtomicIncRef(&wq->numFinished);
+
+    if (WorkQueueTryDecrement(&wq->finishWaitingCount)) {
+        SDL_SemPost(wq->finishSem);
+    }
+}
 
+/*
+ * WorkQueueWaitForFinish --
+ *    Park until done() is true, re-checking each time an item finishes.
+ */
+static void WorkQueueWaitForFinish(WorkQueue *wq,
+                                   bool (*done)(WorkQueue *wq, int arg),
+                                   int arg)
+{
     /*
      * We don't properly support multi-waiters.
-     * If things are actively being queued while we're
-     * waiting here, it's possible to racily miss a transient
-     * state of being empty, or incorrectly detect being empty.
      */
     ASSERT(SDL_AtomicGet(&wq->finishWaitingCount) == 0);
 
-    if (WorkQueue_IsIdle(wq)) {
-        return;
-    }
-
-    WorkQueue_Lock(wq);
-    if (!WorkQueue_IsIdle(wq)) {
+    while (!done(wq, arg)) {
         SDL_AtomicIncRef(&wq->finishWaitingCount);
-        wait = TRUE;
-    }
-    WorkQueue_Unlock(wq);
+        if (done(wq, arg)) {
+            if (!WorkQueueTryDecrement(&wq->finishWaitingCount)) {
+                SDL_SemWait(wq->finishSem);
+            }
+            break;
+        }
 
-    if (wait) {
         int error = SDL_SemWait(wq->finishSem);
         if (error != 0) {
             PANIC("Failed to wait for WorkQueue: %s\n", SDL_GetError());
@@ -220,45 +469,195 @@ void WorkQueue_WaitForAllFinished(WorkQueue *wq)
     }
 }
 
+static bool WorkQueueIsCountBelow(WorkQueue *wq, int count)
+{
+    return WorkQueue_IsCountBelow(wq, count);
+}
+
+static bool WorkQueueFinishedSince(WorkQueue *wq, int numFinished)
+{
+    return WorkQueue_IsIdle(wq) ||
+           SDL_AtomicGet(&wq->numFinished) != numFinished;
+}
+
+void WorkQueue_WaitForAnyFinished(WorkQueue *wq)
+{
+    ASSERT(wq != NULL);
+    WorkQueueWaitForFinish(wq, WorkQueueFinishedSince,
+                           SDL_AtomicGet(&wq->numFinished));
+}
+
+void WorkQueue_WaitForAllFinished(WorkQueue *wq)
+{
+    /*
+     * If things are actively being queued while we're waiting here,
+     * it's possible to racily miss a transient state of being empty.
+     */
+    ASSERT(wq != NULL);
+    WorkQueueWaitForFinish(wq, WorkQueueIsCountBelow, 1);
+}
+
 void WorkQueue_WaitForCountBelow(WorkQueue *wq, uint count)
 {
-    uint32 waitCount;
     ASSERT(wq != NULL);
     ASSERT(count < MAX_INT32 / 2);
+    WorkQueueWaitForFinish(wq, WorkQueueIsCountBelow, count);
+}
+
+typedef struct WorkQueueTestData {
+    WorkQueue *workQ;
+    WorkQueue *resultQ;
+    uint slot;
+} WorkQueueTestData;
+
+static int WorkQueueTestThread(void *data)
+{
+    WorkQueueTestData *td = data;
+    uint64 item[3];
+
+    while (TRUE) {
+        WorkQueue_WaitForItem(td->workQ, td->slot, &item, sizeof(item));
+        if (item[0] == 0) {
+            WorkQueue_FinishItem(td->workQ);
+            return 0;
+        }
+
+        item[1] = item[0] * item[0];
+        item[2] = td->slot;
+        WorkQueue_QueueItem(td->resultQ, td->slot, &item, sizeof(item));
+        WorkQueue_FinishItem(td->workQ);
+    }
+}
+
+void WorkQueue_UnitTest(void)
+{
+    WorkQueue workQ;
+    WorkQueue resultQ;
+    WorkQueueTestData td[4];
+    SDL_Thread *threads[ARRAYSIZE(td)];
+    const uint numThreads = ARRAYSIZE(td);
+    const uint numItems = 10000;
+    uint64 item[3];
+    uint64 sum = 0;
+    uint numResults = 0;
 
     /*
-     * Doesn't work correctly if someone is actively queueing new
-     * items, or we have multi-waiters.
+     * Single-threaded: our own pops are LIFO, and the buffer grows.
      */
-    ASSERT(SDL_AtomicGet(&wq->anyFinishWaitingCount) == 0);
-
-    if (WorkQueue_IsCountBelow(wq, count)) {
-        return;
+    WorkQueue_Create(&workQ, sizeof(item), 2);
+    for (uint64 i = 1; i <= 100; i++) {
+        item[0] = i;
+        WorkQueue_QueueItem(&workQ, 0, &item, sizeof(item));
+    }
+    VERIFY(WorkQueue_QueueSize(&workQ) == 100);
+    for (uint64 i = 100; i >= 1; i--) {
+        VERIFY(WorkQueue_TryGetItem(&workQ, 0, &item, sizeof(item)));
+        VERIFY(item[0] == i);
+        WorkQueue_FinishItem(&workQ);
     }
+    VERIFY(!WorkQueue_TryGetItem(&workQ, 0, &item, sizeof(item)));
+    VERIFY(WorkQueue_IsIdle(&workQ));
+
+    // Thieves take the oldest, and batches stay hidden until the end.
+    WorkQueue_BeginBatch(&workQ, 0);
+    for (uint64 i = 1; i <= 3; i++) {
+        item[0] = i;
+        WorkQueue_QueueItem(&workQ, 0, &item, sizeof(item));
+    }
+    VERIFY(!WorkQueue_TryGetItem(&workQ, 1, &item, sizeof(item)));
+    WorkQueue_EndBatch(&workQ, 0);
+    VERIFY(WorkQueue_TryGetItem(&workQ, 1, &item, sizeof(item)));
+    VERIFY(item[0] == 1);
+    WorkQueue_FinishItem(&workQ);
+    VERIFY(WorkQueue_TryGetItem(&workQ, 0, &item, sizeof(item)));
+    VERIFY(item[0] == 2);
+    WorkQueue_FinishItem(&workQ);
+    VERIFY(WorkQueue_TryGetItem(&workQ, 1, &item, sizeof(item)));
+    VERIFY(item[0] == 3);
+    WorkQueue_FinishItem(&workQ);
+    VERIFY(WorkQueue_IsIdle(&workQ));
+    WorkQueue_Destroy(&workQ);
+
+    // Batches are dealt out round-robin to the other slots.
+    WorkQueue_Create(&workQ, sizeof(item), 3);
+    WorkQueue_BeginBatch(&workQ, 0);
+    for (uint64 i = 1; i <= 4; i++) {
+        item[0] = i;
+        WorkQueue_QueueItem(&workQ, 0, &item, sizeof(item));
+    }
+    WorkQueue_EndBatch(&workQ, 0);
+    VERIFY(WorkQueue_TryGetItem(&workQ, 2, &item, sizeof(item)));
+    VERIFY(item[0] == 2);
+    WorkQueue_FinishItem(&workQ);
+    VERIFY(WorkQueue_TryGetItem(&workQ, 2, &item, sizeof(item)));
+    VERIFY(item[0] == 4);
+    WorkQueue_FinishItem(&workQ);
+    VERIFY(WorkQueue_TryGetItem(&workQ, 1, &item, sizeof(item)));
+    VERIFY(item[0] == 1);
+    WorkQueue_FinishItem(&workQ);
+    VERIFY(WorkQueue_TryGetItem(&workQ, 1, &item, sizeof(item)));
+    VERIFY(item[0] == 3);
+    WorkQueue_FinishItem(&workQ);
+    VERIFY(WorkQueue_IsIdle(&workQ));
+    WorkQueue_Destroy(&workQ);
 
-    WorkQueue_Lock(wq);
-    if (WorkQueue_IsCountBelow(wq, count)) {
-        waitCount = 0;
-    } else {
-        waitCount = WorkQueue_GetCount(wq) - count;
-        SDL_AtomicAdd(&wq->anyFinishWaitingCount, waitCount);
+    /*
+     * Multi-threaded: every item comes back exactly once.
+     */
+    WorkQueue_Create(&workQ, sizeof(item), numThreads + 1);
+    WorkQueue_Create(&resultQ, sizeof(item), numThreads + 1);
+    WorkQueue_SetSpinCount(&workQ, 16);
+
+    for (uint i = 0; i < numThreads; i++) {
+        td[i].workQ = &workQ;
+        td[i].resultQ = &resultQ;
+        td[i].slot = i + 1;
+        threads[i] = SDL_CreateThread(WorkQueueTestThread, "wqTest", &td[i]);
+        VERIFY(threads[i] != NULL);
     }
-    WorkQueue_Unlock(wq);
 
-    while (waitCount > 0) {
-        int error = SDL_SemWait(wq->anyFinishSem);
-        if (error != 0) {
-            PANIC("Failed to wait for WorkQueue: %s\n", SDL_GetError());
+    for (uint64 i = 1; i <= numItems; i++) {
+        if (i % 8 == 1) {
+            WorkQueue_BeginBatch(&workQ, 0);
+        }
+        item[0] = i;
+        WorkQueue_QueueItem(&workQ, 0, &item, sizeof(item));
+        if (i % 8 == 0 || i == numItems) {
+            WorkQueue_EndBatch(&workQ, 0);
+        }
+
+        if (i % 64 == 0) {
+            WorkQueue_WaitForCountBelow(&workQ, 32);
+        }
+        while (WorkQueue_TryGetItem(&resultQ, 0, &item, sizeof(item))) {
+            VERIFY(item[1] == item[0] * item[0]);
+            sum += item[0];
+            numResults++;
+            WorkQueue_FinishItem(&resultQ);
         }
-        waitCount--;
     }
-}
 
-void WorkQueue_MakeEmpty(WorkQueue *wq)
-{
-    WorkQueue_Lock(wq);
-    SDL_AtomicSet(&wq->numInProgress, 0);
-    SDL_AtomicSet(&wq->numQueued, 0);
-    MBRing_MakeEmpty(&wq->items);
-    WorkQueue_Unlock(wq);
+    WorkQueue_WaitForAllFinished(&workQ);
+    for (uint i = 0; i < numThreads; i++) {
+        item[0] = 0;
+        WorkQueue_QueueItem(&workQ, 0, &item, sizeof(item));
+    }
+    for (uint i = 0; i < numThreads; i++) {
+        SDL_WaitThread(threads[i], NULL);
+    }
+
+    while (WorkQueue_TryGetItem(&resultQ, 0, &item, sizeof(item))) {
+        VERIFY(item[1] == item[0] * item[0]);
+        sum += item[0];
+        numResults++;
+        WorkQueue_FinishItem(&resultQ);
+    }
+
+    VERIFY(numResults == numItems);
+    VERIFY(sum == (uint64)numItems * (numItems + 1) / 2);
+    VERIFY(WorkQueue_IsIdle(&workQ));
+    VERIFY(WorkQueue_IsIdle(&resultQ));
+
+    WorkQueue_Destroy(&workQ);
+    WorkQueue_Destroy(&resultQ);
 }
@@ -22,41 +22,117 @@
 #include <SDL2/SDL_mutex.h>
 #include <SDL2/SDL_atomic.h>
 
-#include "MBVector.h"
-#include "MBLock.h"
-#include "MBRing.h"
+#include "MBTypes.h"
+#include "MBAssert.h"
+
+/*
+ * A work-stealing queue of fixed-size items.
+ *
+ * Each thread using the queue has its own slot, which owns one Chase-Lev
+ * deque (a "lane") per slot in the queue.  Only the owning thread pushes
+ * onto its lanes, so producers never contend with each other.  Single
+ * items go onto the owner's own lane, while batches are dealt
+ * round-robin onto the lanes meant for the other slots, so that each
+ * consumer has its own share of the work to take.
+ *
+ * Consumers pop their own lane from the bottom, then take from the top
+ * of the lanes the other slots filled for them, and only then steal
+ * from the lanes meant for somebody else, starting at a different
+ * victim each time.  Producers and consumers only meet on a CAS of a
+ * lane's top index, which is normally uncontended.  Items are still
+ * copied in and out, but never under a lock.
+ *
+ * Consumers that find nothing to do spin for a while (see
+ * WorkQueue_SetSpinCount) and then park on a semaphore, which producers
+ * only post when somebody is actually parked.
+ */
+
+#define WORK_QUEUE_CACHE_LINE 64
+
+typedef struct WorkQueueBuffer {
+    /*
+     * Buffers that were outgrown, kept until the queue is destroyed
+     * since a thief may still be reading from them.
+     */
+    struct WorkQueueBuffer *retired;
+
+    uint capacity;
+    uint8 *items;
+} WorkQueueBuffer;
+
+typedef struct WorkQueueDeque {
+    SDL_atomic_t top;
+    uint8 _pad0[WORK_QUEUE_CACHE_LINE - sizeof(SDL_atomic_t)];
+
+    SDL_atomic_t bottom;
+
+    /*
+     * Allocated on the first push, since most lanes stay empty.
+     */
+    void *buffer;
+
+    /*
+     * Only touched by the owning thread.
+     */
+    int batchBottom;
+} __attribute__ ((aligned (WORK_QUEUE_CACHE_LINE))) WorkQueueDeque;
+
+typedef struct WorkQueueSlot {
+    /*
+     * lanes[i] holds the items this slot queued for slot i.
+     */
+    WorkQueueDeque *lanes;
+
+    /*
+     * Only touched by the owning thread.
+     */
+    bool inBatch;
+    uint nextLane;
+    uint nextVictim;
+} __attribute__ ((aligned (WORK_QUEUE_CACHE_LINE))) WorkQueueSlot;
 
 typedef struct WorkQueue {
     SDL_atomic_t numQueued;
     SDL_atomic_t numInProgress;
+    SDL_atomic_t numFinished;
+    SDL_atomic_t numSleeping;
     SDL_atomic_t finishWaitingCount;
-    SDL_atomic_t anyFinishWaitingCount;
     uint itemSize;
-    MBRing items;
-    MBLock lock;
+    uint spinCount;
+    uint numSlots;
+    WorkQueueSlot *slots;
+    WorkQueueDeque *lanes;
     SDL_sem *workerSem;
     SDL_sem *finishSem;
-    SDL_sem *anyFinishSem;
 } WorkQueue;
 
-void WorkQueue_Create(WorkQueue *wq, uint itemSize);
+void WorkQueue_Create(WorkQueue *wq, uint itemSize, uint numSlots);
 void WorkQueue_Destroy(WorkQueue *wq);
+void WorkQueue_SetSpinCount(WorkQueue *wq, uint spinCount);
+
+/*
+ * Each of these must only be called by the thread that owns the slot.
+ */
+void WorkQueue_QueueItem(WorkQueue *wq, uint slot, void *item, uint itemSize);
+void WorkQueue_WaitForItem(WorkQueue *wq, uint slot, void *item,
+                           uint itemSize);
+bool WorkQueue_TryGetItem(WorkQueue *wq, uint slot, void *item,
+                          uint itemSize);
+
+/*
+ * Items queued between BeginBatch and EndBatch are spread round-robin
+ * across the other slots, and only become visible to the consumers at
+ * EndBatch, so a batch costs one publish per lane and one round of
+ * wake-ups.
+ */
+void WorkQueue_BeginBatch(WorkQueue *wq, uint slot);
+void WorkQueue_EndBatch(WorkQueue *wq, uint slot);
 
-void WorkQueue_QueueItem(WorkQueue *wq, void *item, uint itemSize);
-void WorkQueue_WaitForItem(WorkQueue *wq, void *item, uint itemSize);
 void WorkQueue_FinishItem(WorkQueue *wq);
 void WorkQueue_WaitForAllFinished(WorkQueue *wq);
 void WorkQueue_WaitForAnyFinished(WorkQueue *wq);
 void WorkQueue_WaitForCountBelow(WorkQueue *wq, uint count);
 
-void WorkQueue_GetItemLocked(WorkQueue *wq, void *item, uint itemSize);
-void WorkQueue_QueueItemLocked(WorkQueue *wq, void *item, uint itemSize);
-
-void WorkQueue_MakeEmpty(WorkQueue *wq);
-
-/*
- * The following functions don't require the lock.
- */
 static inline int WorkQueue_QueueSize(WorkQueue *wq)
 {
     return SDL_AtomicGet(&wq->numQueued);
@@ -84,18 +160,6 @@ static inline bool WorkQueue_IsCountBelow(WorkQueue *wq, uint count)
     return WorkQueue_GetCount(wq) < count;
 }
 
-static inline void WorkQueue_Lock(WorkQueue *wq)
-{
-    ASSERT(wq != NULL);
-    MBLock_Lock(&wq->lock);
-}
-
-static inline void WorkQueue_Unlock(WorkQueue *wq)
-{
-    ASSERT(wq != NULL);
-    MBLock_Unlock(&wq->lock);
-}
-
+void WorkQueue_UnitTest(void);
 
 #endif // _WORKQUEUE_H_202006241219
-
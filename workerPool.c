@@ -0,0 +1,466 @@
+/*
+ * workerPool.c -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "workerPool.h"
+#include "MBUtil.h"
+#include "MBDebug.h"
+
+/*
+ * WorkerPoolRead --
+ *    Read exactly size bytes from fd.  Returns FALSE on EOF or error.
+ */
+static bool WorkerPoolRead(int fd, void *buf, uint size)
+{
+    uint8 *b = buf;
+
+    while (size > 0) {
+        ssize_t n = read(fd, b, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return FALSE;
+        }
+        b += n;
+        size -= n;
+    }
+    return TRUE;
+}
+
+static bool WorkerPoolWrite(int fd, const void *buf, uint size)
+{
+    const uint8 *b = buf;
+
+    while (size > 0) {
+        ssize_t n = write(fd, b, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return FALSE;
+        }
+        b += n;
+        size -= n;
+    }
+    return TRUE;
+}
+
+/*
+ * WorkerPoolWorkerMain --
+ *    The body of a worker process: run items until the pool closes the
+ *    work pipe.
+ */
+static void WorkerPoolWorkerMain(WorkerPool *wp, uint workerId,
+                                 int workFd, int resultFd)
+{
+    uint8 *work = malloc(wp->workSize);
+    VERIFY(work != NULL);
+
+    wp->ops->workerInit(wp->cbData, workerId);
+
+    while (WorkerPoolRead(workFd, work, wp->workSize)) {
+        wp->ops->workerRun(wp->cbData, work, wp->resultBuf);
+
+        if (!WorkerPoolWrite(resultFd, wp->resultBuf, wp->resultSize)) {
+            break;
+        }
+    }
+
+    wp->ops->workerExit(wp->cbData);
+    free(work);
+    fflush(stdout);
+    fflush(stderr);
+    _exit(0);
+}
+
+static void WorkerPoolSpawn(WorkerPool *wp, uint w)
+{
+    WorkerPoolWorker *worker = &wp->workers[w];
+    int workPipe[2];
+    int resultPipe[2];
+
+    VERIFY(pipe(workPipe) == 0);
+    VERIFY(pipe(resultPipe) == 0);
+
+    /*
+     * Otherwise anything still buffered would be printed twice.
+     */
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    VERIFY(pid >= 0);
+
+    if (pid == 0) {
+        /*
+         * Drop the other workers' pipes, so that they see EOF when the
+         * pool closes them.
+         */
+        for (uint i = 0; i < wp->numWorkers; i++) {
+            if (i != w && wp->workers[i].pid != 0) {
+                close(wp->workers[i].workFd);
+                close(wp->workers[i].resultFd);
+            }
+        }
+        close(workPipe[1]);
+        close(resultPipe[0]);
+        WorkerPoolWorkerMain(wp, w, workPipe[0], resultPipe[1]);
+        NOT_REACHED();
+    }
+
+    close(workPipe[0]);
+    close(resultPipe[1]);
+
+    worker->pid = pid;
+    worker->workFd = workPipe[1];
+    worker->resultFd = resultPipe[0];
+    worker->numInFlight = 0;
+}
+
+static void WorkerPoolPushPending(WorkerPool *wp, const WorkerPoolJob *job)
+{
+    if (wp->numPending == wp->maxPending) {
+        wp->maxPending = MAX(16, 2 * wp->maxPending);
+        wp->pending = realloc(wp->pending,
+                              wp->maxPending * sizeof(wp->pending[0]));
+        VERIFY(wp->pending != NULL);
+    }
+    wp->pending[wp->numPending++] = *job;
+}
+
+/*
+ * WorkerPoolDied --
+ *    Clean up after a worker that crashed, queue its items again, and
+ *    start a new one in its place.
+ */
+static void WorkerPoolDied(WorkerPool *wp, uint w)
+{
+    WorkerPoolWorker *worker = &wp->workers[w];
+    int status = 0;
+
+    close(worker->workFd);
+    close(worker->resultFd);
+    while (waitpid(worker->pid, &status, 0) < 0 && errno == EINTR) {
+        // Try again.
+    }
+
+    if (WIFSIGNALED(status)) {
+        Warning("Worker %d (pid %d) was killed by signal %d\n",
+                w, worker->pid, WTERMSIG(status));
+    } else {
+        Warning("Worker %d (pid %d) exited early with status %d\n",
+                w, worker->pid, WEXITSTATUS(status));
+    }
+    wp->numCrashes++;
+
+    for (uint i = 0; i < worker->numInFlight; i++) {
+        WorkerPoolJob *job = &worker->inFlight[i];
+
+        /*
+         * Workers run their items in order, so only the oldest one was
+         * running when the worker died.  The rest were just waiting.
+         */
+        if (i == 0) {
+            job->retries++;
+        }
+        if (job->retries > WORKER_POOL_MAX_RETRIES) {
+            PANIC("Work item %d crashed %d workers\n", job->id, job->retries);
+        }
+        Warning("Re-queueing work item %d\n", job->id);
+        WorkerPoolPushPending(wp, job);
+    }
+
+    worker->pid = 0;
+    worker->numInFlight = 0;
+    WorkerPoolSpawn(wp, w);
+}
+
+/*
+ * WorkerPoolDispatch --
+ *    Hand out pending items to any worker with room for them.
+ */
+static void WorkerPoolDispatch(WorkerPool *wp)
+{
+    for (uint w = 0; w < wp->numWorkers && wp->numPending > 0; w++) {
+        WorkerPoolWorker *worker = &wp->workers[w];
+
+        while (worker->numInFlight < WORKER_POOL_DEPTH &&
+               wp->numPending > 0) {
+            WorkerPoolJob *job = &worker->inFlight[worker->numInFlight];
+
+            *job = wp->pending[--wp->numPending];
+            worker->numInFlight++;
+
+            if (!WorkerPoolWrite(worker->workFd, job->work, wp->workSize)) {
+                WorkerPoolDied(wp, w);
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * WorkerPoolWait --
+ *    Wait for at least one worker to finish an item (or die), and pass
+ *    along whatever results came in.
+ */
+static void WorkerPoolWait(WorkerPool *wp)
+{
+    struct pollfd *fds = wp->pollFds;
+    uint numFds = 0;
+    int n;
+
+    for (uint w = 0; w < wp->numWorkers; w++) {
+        fds[w].fd = wp->workers[w].resultFd;
+        fds[w].events = POLLIN;
+        fds[w].revents = 0;
+        if (wp->workers[w].numInFlight > 0) {
+            numFds++;
+        } else {
+            fds[w].fd = -1;
+        }
+    }
+    ASSERT(numFds > 0);
+
+    do {
+        n = poll(fds, wp->numWorkers, -1);
+    } while (n < 0 && errno == EINTR);
+    VERIFY(n > 0);
+
+    for (uint w = 0; w < wp->numWorkers; w++) {
+        WorkerPoolWorker *worker = &wp->workers[w];
+        WorkerPoolJob job;
+
+        if (fds[w].fd < 0 || fds[w].revents == 0) {
+            continue;
+        }
+
+        if (!WorkerPoolRead(worker->resultFd, wp->resultBuf,
+                            wp->resultSize)) {
+            WorkerPoolDied(wp, w);
+            continue;
+        }
+
+        ASSERT(worker->numInFlight > 0);
+        job = worker->inFlight[0];
+        worker->numInFlight--;
+        memmove(&worker->inFlight[0], &worker->inFlight[1],
+                worker->numInFlight * sizeof(worker->inFlight[0]));
+
+        wp->ops->result(wp->cbData, job.work, wp->resultBuf);
+        free(job.work);
+    }
+}
+
+void WorkerPool_Start(WorkerPool *wp, uint numWorkers,
+                      uint workSize, uint resultSize,
+                      const WorkerPoolOps *ops, void *cbData)
+{
+    ASSERT(numWorkers > 0);
+    ASSERT(workSize > 0);
+    ASSERT(resultSize > 0);
+
+    MBUtil_Zero(wp, sizeof(*wp));
+    wp->ops = ops;
+    wp->cbData = cbData;
+    wp->workSize = workSize;
+    wp->resultSize = resultSize;
+    wp->numWorkers = numWorkers;
+
+    /*
+     * A dead worker shows up as a failed write, instead.
+     */
+    signal(SIGPIPE, SIG_IGN);
+
+    wp->resultBuf = malloc(resultSize);
+    wp->workers = calloc(numWorkers, sizeof(wp->workers[0]));
+    wp->pollFds = calloc(numWorkers, sizeof(wp->pollFds[0]));
+    VERIFY(wp->resultBuf != NULL);
+    VERIFY(wp->workers != NULL);
+    VERIFY(wp->pollFds != NULL);
+
+    for (uint w = 0; w < numWorkers; w++) {
+        WorkerPoolSpawn(wp, w);
+    }
+}
+
+/*
+ * WorkerPool_Submit --
+ *    Queue an item on the workers, waiting for one of them to have room
+ *    for it.  The id is only used to report crashes.
+ */
+void WorkerPool_Submit(WorkerPool *wp, uint id, const void *work)
+{
+    WorkerPoolJob job;
+
+    MBUtil_Zero(&job, sizeof(job));
+    job.id = id;
+    job.work = malloc(wp->workSize);
+    VERIFY(job.work != NULL);
+    memcpy(job.work, work, wp->workSize);
+    WorkerPoolPushPending(wp, &job);
+
+    WorkerPoolDispatch(wp);
+    while (wp->numPending > 0) {
+        WorkerPoolWait(wp);
+        WorkerPoolDispatch(wp);
+    }
+}
+
+/*
+ * WorkerPool_Finish --
+ *    Wait for every item to come back, and shut the workers down.
+ */
+void WorkerPool_Finish(WorkerPool *wp)
+{
+    while (TRUE) {
+        bool busy = wp->numPending > 0;
+
+        for (uint w = 0; w < wp->numWorkers; w++) {
+            busy |= wp->workers[w].numInFlight > 0;
+        }
+        if (!busy) {
+            break;
+        }
+
+        WorkerPoolDispatch(wp);
+        WorkerPoolWait(wp);
+    }
+
+    for (uint w = 0; w < wp->numWorkers; w++) {
+        close(wp->workers[w].workFd);
+    }
+    for (uint w = 0; w < wp->numWorkers; w++) {
+        WorkerPoolWorker *worker = &wp->workers[w];
+        int status;
+
+        while (waitpid(worker->pid, &status, 0) < 0 && errno == EINTR) {
+            // Try again.
+        }
+        close(worker->resultFd);
+    }
+
+    if (wp->numCrashes > 0) {
+        Warning("Recovered from %d worker crashes.\n", wp->numCrashes);
+    }
+
+    free(wp->resultBuf);
+    free(wp->workers);
+    free(wp->pollFds);
+    free(wp->pending);
+    MBUtil_Zero(wp, sizeof(*wp));
+}
+
+typedef struct WorkerPoolTestData {
+    WorkerPool *wp;
+    uint workerId;
+    uint numResults;
+    uint64 sum;
+} WorkerPoolTestData;
+
+static void WorkerPoolTestInit(void *cbData, uint workerId)
+{
+    WorkerPoolTestData *td = cbData;
+    td->workerId = workerId;
+}
+
+/*
+ * Items are { value, crash }, and an item with crash set kills the first
+ * worker that runs it.
+ */
+static void WorkerPoolTestRun(void *cbData, void *work, void *result)
+{
+    WorkerPoolTestData *td = cbData;
+    uint64 *item = work;
+    uint64 *r = result;
+
+    /*
+     * The replacement worker is forked after the crash is counted.
+     */
+    if (item[1] != 0 && td->wp->numCrashes == 0) {
+        _exit(1);
+    }
+
+    r[0] = item[0] * item[0];
+    r[1] = td->workerId;
+}
+
+static void WorkerPoolTestExit(void *cbData)
+{
+    // Nothing to clean up.
+}
+
+static void WorkerPoolTestResult(void *cbData, const void *work,
+                                 void *result)
+{
+    WorkerPoolTestData *td = cbData;
+    const uint64 *item = work;
+    uint64 *r = result;
+
+    VERIFY(r[0] == item[0] * item[0]);
+    td->sum += item[0];
+    td->numResults++;
+}
+
+void WorkerPool_UnitTest(void)
+{
+    static const WorkerPoolOps ops = {
+        WorkerPoolTestInit,
+        WorkerPoolTestRun,
+        WorkerPoolTestExit,
+        WorkerPoolTestResult,
+    };
+    WorkerPoolTestData td;
+    WorkerPool wp;
+    const uint numItems = 100;
+    uint64 item[2];
+
+    MBUtil_Zero(&td, sizeof(td));
+    td.wp = &wp;
+    WorkerPool_Start(&wp, 3, sizeof(item), sizeof(item), &ops, &td);
+    for (uint64 i = 1; i <= numItems; i++) {
+        item[0] = i;
+        item[1] = 0;
+        WorkerPool_Submit(&wp, i, item);
+    }
+    WorkerPool_Finish(&wp);
+
+    VERIFY(td.numResults == numItems);
+    VERIFY(td.sum == (uint64)numItems * (numItems + 1) / 2);
+
+    /*
+     * One item crashes a worker, and gets run again by its replacement.
+     */
+    MBUtil_Zero(&td, sizeof(td));
+    td.wp = &wp;
+    WorkerPool_Start(&wp, 2, sizeof(item), sizeof(item), &ops, &td);
+    item[0] = 7;
+    item[1] = 1;
+    WorkerPool_Submit(&wp, 7, item);
+    WorkerPool_Finish(&wp);
+
+    VERIFY(wp.numWorkers == 0);
+    VERIFY(td.numResults == 1);
+    VERIFY(td.sum == 7);
+}
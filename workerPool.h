@@ -0,0 +1,116 @@
+/*
+ * workerPool.h -- part of SpaceRobots2
+ * Copyright (C) 2023 Michael Banack <github@banack.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WORKERPOOL_H_202306031330
+#define _WORKERPOOL_H_202306031330
+
+#include <poll.h>
+#include <sys/types.h>
+
+#include "MBTypes.h"
+#include "MBAssert.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*
+ * A pool of worker processes, for running work items that might crash.
+ *
+ * The workers are forked by WorkerPool_Start, so each one starts with
+ * its own copy of everything the caller set up beforehand.  Fixed-size
+ * work items go out and results come back over a pair of pipes per
+ * worker, and each worker runs its items in order.  When a worker dies,
+ * the items it had in flight are queued again, and a new worker takes
+ * its place.  An item that keeps killing workers is fatal.
+ */
+#define WORKER_POOL_DEPTH       2
+#define WORKER_POOL_MAX_RETRIES 3
+
+typedef struct WorkerPoolOps {
+    /*
+     * Called in each new worker process, before it runs anything.
+     */
+    void (*workerInit)(void *cbData, uint workerId);
+
+    /*
+     * Called in a worker process to run one item and fill in its result.
+     */
+    void (*workerRun)(void *cbData, void *work, void *result);
+
+    /*
+     * Called in a worker process once there's no more work.
+     */
+    void (*workerExit)(void *cbData);
+
+    /*
+     * Called in the calling process with each result, along with the
+     * item it came from.
+     */
+    void (*result)(void *cbData, const void *work, void *result);
+} WorkerPoolOps;
+
+typedef struct WorkerPoolJob {
+    uint id;
+    uint retries;
+    uint8 *work;
+} WorkerPoolJob;
+
+typedef struct WorkerPoolWorker {
+    pid_t pid;
+    int workFd;
+    int resultFd;
+
+    /*
+     * Oldest first, which is the order the results come back in.
+     */
+    uint numInFlight;
+    WorkerPoolJob inFlight[WORKER_POOL_DEPTH];
+} WorkerPoolWorker;
+
+typedef struct WorkerPool {
+    const WorkerPoolOps *ops;
+    void *cbData;
+    uint workSize;
+    uint resultSize;
+    uint8 *resultBuf;
+
+    uint numWorkers;
+    WorkerPoolWorker *workers;
+    struct pollfd *pollFds;
+
+    uint numPending;
+    uint maxPending;
+    WorkerPoolJob *pending;
+
+    uint numCrashes;
+} WorkerPool;
+
+void WorkerPool_Start(WorkerPool *wp, uint numWorkers,
+                      uint workSize, uint resultSize,
+                      const WorkerPoolOps *ops, void *cbData);
+void WorkerPool_Submit(WorkerPool *wp, uint id, const void *work);
+void WorkerPool_Finish(WorkerPool *wp);
+
+void WorkerPool_UnitTest(void);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // _WORKERPOOL_H_202306031330